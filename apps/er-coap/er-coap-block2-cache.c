@@ -0,0 +1,417 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      Cache of Block2 representations.
+ */
+
+#include <string.h>
+#include "lib/list.h"
+#include "lib/memb.h"
+#include "lib/mmem.h"
+#include "lib/crc16.h"
+#include "er-coap-block2-cache.h"
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+/* no Accept option in the request, or no Content-Format in the response */
+#define NO_FORMAT 0xFFFF
+
+typedef struct block2_cache_entry {
+  struct block2_cache_entry *next;
+  resource_t *resource;
+  struct mmem mem;              /* URI path, URI query, representation */
+  clock_time_t last_used;
+  uint16_t path_len;
+  uint16_t query_len;
+  uint16_t length;
+  uint16_t accept;
+  uint16_t content_format;
+  uint8_t etag_len;
+  uint8_t etag[COAP_ETAG_LEN];
+} block2_cache_entry_t;
+
+MEMB(entries_memb, block2_cache_entry_t, COAP_BLOCK2_CACHE_ENTRIES);
+LIST(entries_list);             /* most recently used first */
+
+/* representations that did not fit in the whole budget, by resource and
+   CRC-16 of their key, not cached for a while */
+static struct {
+  resource_t *resource;
+  clock_time_t since;
+  unsigned short key;
+} too_large[COAP_BLOCK2_CACHE_ENTRIES];
+
+static uint16_t used;           /* managed memory taken by the entries */
+static uint8_t initialized;
+/*---------------------------------------------------------------------------*/
+/*- Internal API ------------------------------------------------------------*/
+/*---------------------------------------------------------------------------*/
+static void
+init(void)
+{
+  if(!initialized) {
+    mmem_init();
+    memb_init(&entries_memb);
+    list_init(entries_list);
+    initialized = 1;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+remove_entry(block2_cache_entry_t *e)
+{
+  PRINTF("Block2 cache: dropping /%s, %u bytes\n", e->resource->url,
+         e->length);
+
+  used -= e->mem.size;
+  mmem_free(&e->mem);
+  list_remove(entries_list, e);
+  memb_free(&entries_memb, e);
+}
+/*---------------------------------------------------------------------------*/
+static void
+remove_expired(void)
+{
+  block2_cache_entry_t *e;
+  block2_cache_entry_t *next;
+
+  for(e = list_head(entries_list); e != NULL; e = next) {
+    next = e->next;
+    if(clock_time() - e->last_used >= COAP_BLOCK2_CACHE_LIFETIME) {
+      remove_entry(e);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+get_accept(coap_packet_t *request)
+{
+  return IS_OPTION(request, COAP_OPTION_ACCEPT) ? request->accept : NO_FORMAT;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned short
+hash_key(coap_packet_t *request)
+{
+  unsigned short crc;
+  uint16_t accept = get_accept(request);
+
+  crc = crc16_data((const unsigned char *)request->uri_path,
+                   request->uri_path_len, 0);
+  crc = crc16_data((const unsigned char *)request->uri_query,
+                   request->uri_query_len, crc);
+  return crc16_data((const unsigned char *)&accept, sizeof(accept), crc);
+}
+/*---------------------------------------------------------------------------*/
+static int
+is_too_large(resource_t *resource, coap_packet_t *request)
+{
+  unsigned short key = hash_key(request);
+  int i;
+
+  for(i = 0; i < COAP_BLOCK2_CACHE_ENTRIES; i++) {
+    if(too_large[i].resource == resource && too_large[i].key == key) {
+      if(clock_time() - too_large[i].since < COAP_BLOCK2_CACHE_LIFETIME) {
+        return 1;
+      }
+      /* the representation may have shrunk, try again */
+      too_large[i].resource = NULL;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+set_too_large(resource_t *resource, coap_packet_t *request)
+{
+  int i;
+  int oldest = 0;
+
+  for(i = 0; i < COAP_BLOCK2_CACHE_ENTRIES; i++) {
+    if(too_large[i].resource == NULL) {
+      oldest = i;
+      break;
+    }
+    if(clock_time() - too_large[i].since
+       > clock_time() - too_large[oldest].since) {
+      oldest = i;
+    }
+  }
+  too_large[oldest].resource = resource;
+  too_large[oldest].since = clock_time();
+  too_large[oldest].key = hash_key(request);
+}
+/*---------------------------------------------------------------------------*/
+static block2_cache_entry_t *
+lookup(resource_t *resource, coap_packet_t *request)
+{
+  block2_cache_entry_t *e;
+  uint16_t accept = get_accept(request);
+  const uint8_t *key;
+
+  for(e = list_head(entries_list); e != NULL; e = e->next) {
+    key = (uint8_t *)MMEM_PTR(&e->mem);
+    if(e->resource == resource && e->accept == accept
+       && e->path_len == request->uri_path_len
+       && e->query_len == request->uri_query_len
+       && memcmp(key, request->uri_path, e->path_len) == 0
+       && memcmp(key + e->path_len, request->uri_query, e->query_len) == 0) {
+      return e;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+serve(block2_cache_entry_t *e, coap_packet_t *response, uint8_t *buffer,
+      uint16_t preferred_size, int32_t *offset)
+{
+  const uint8_t *representation;
+  uint16_t len;
+
+  if(*offset >= e->length) {
+    coap_set_status_code(response, BAD_OPTION_4_02);
+    coap_set_payload(response, "BlockOutOfScope", 15);
+    *offset = -1;
+    return;
+  }
+
+  representation = (uint8_t *)MMEM_PTR(&e->mem) + e->path_len + e->query_len;
+  len = MIN(e->length - *offset, preferred_size);
+  memcpy(buffer, representation + *offset, len);
+  coap_set_payload(response, buffer, len);
+
+  if(e->content_format != NO_FORMAT) {
+    coap_set_header_content_format(response, e->content_format);
+  }
+  if(e->etag_len) {
+    coap_set_header_etag(response, e->etag, e->etag_len);
+  }
+
+  *offset += len;
+  if(*offset >= e->length) {
+    /* the transfer is complete */
+    *offset = -1;
+    remove_entry(e);
+  } else {
+    e->last_used = clock_time();
+    list_remove(entries_list, e);
+    list_push(entries_list, e);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Invokes the handler with all the memory left in the budget, and
+ * evicts the least recently used entries until the representation fits.
+ * The handler runs more than once only when it did not fit.
+ */
+static int
+fill(resource_t *resource, coap_packet_t *request, coap_packet_t *response,
+     uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
+{
+  block2_cache_entry_t *e;
+  uint16_t key_len = request->uri_path_len + request->uri_query_len;
+  uint16_t size;
+  uint8_t *representation;
+  unsigned short crc;
+  int complete;
+
+  /* every transfer starts from a fresh representation */
+  if((e = lookup(resource, request)) != NULL) {
+    remove_entry(e);
+  }
+  if(list_length(entries_list) == COAP_BLOCK2_CACHE_ENTRIES) {
+    remove_entry(list_tail(entries_list));
+  }
+  e = memb_alloc(&entries_memb);
+
+  for(;;) {
+    /* one byte more for handlers that terminate their strings */
+    if(used + key_len + 1 < COAP_BLOCK2_CACHE_SIZE
+       && mmem_alloc(&e->mem, COAP_BLOCK2_CACHE_SIZE - used)) {
+      size = e->mem.size - key_len - 1;
+      representation = (uint8_t *)MMEM_PTR(&e->mem) + key_len;
+
+      coap_payload_limit = size;
+      *offset = 0;
+      resource->get_handler(request, response, representation, size, offset);
+      coap_payload_limit = REST_MAX_CHUNK_SIZE;
+
+      if(response->code != CONTENT_2_05 || erbium_status_code != NO_ERROR) {
+        break;
+      }
+
+      /* resources unaware of blockwise transfers leave the offset at 0 */
+      complete = (*offset == -1 || *offset == 0)
+        && response->payload_len <= size;
+      if(complete) {
+        if(response->payload != representation) {
+          memcpy(representation, response->payload, response->payload_len);
+        }
+        break;
+      }
+
+      mmem_free(&e->mem);
+    }
+
+    if(list_tail(entries_list) == NULL) {
+      /* the handler runs once more for this request, but not for the next */
+      PRINTF("Block2 cache: /%s does not fit\n", resource->url);
+      set_too_large(resource, request);
+      memb_free(&entries_memb, e);
+      *offset = 0;
+      return 0;
+    }
+    remove_entry(list_tail(entries_list));
+  }
+
+  if(response->code != CONTENT_2_05 || erbium_status_code != NO_ERROR
+     || response->payload_len <= preferred_size) {
+    /* nothing to cache for errors or a representation in a single block */
+    if(response->payload_len) {
+      memcpy(buffer, response->payload,
+             MIN(response->payload_len, preferred_size));
+      coap_set_payload(response, buffer,
+                       MIN(response->payload_len, preferred_size));
+    }
+    mmem_free(&e->mem);
+    memb_free(&entries_memb, e);
+    return 1;
+  }
+
+  PRINTF("Block2 cache: /%s, %u bytes\n", resource->url,
+         response->payload_len);
+
+  mmem_realloc(&e->mem, key_len + response->payload_len);
+  used += e->mem.size;
+  memcpy(MMEM_PTR(&e->mem), request->uri_path, request->uri_path_len);
+  memcpy((uint8_t *)MMEM_PTR(&e->mem) + request->uri_path_len,
+         request->uri_query, request->uri_query_len);
+
+  e->resource = resource;
+  e->path_len = request->uri_path_len;
+  e->query_len = request->uri_query_len;
+  e->length = response->payload_len;
+  e->accept = get_accept(request);
+  e->content_format = IS_OPTION(response, COAP_OPTION_CONTENT_FORMAT)
+    ? response->content_format : NO_FORMAT;
+  if(IS_OPTION(response, COAP_OPTION_ETAG)) {
+    e->etag_len = response->etag_len;
+    memcpy(e->etag, response->etag, e->etag_len);
+  } else {
+    /* lets clients tell blocks of different representations apart */
+    crc = crc16_data((uint8_t *)MMEM_PTR(&e->mem) + key_len, e->length, 0);
+    e->etag[0] = crc >> 8;
+    e->etag[1] = crc & 0xFF;
+    e->etag_len = 2;
+  }
+  list_push(entries_list, e);
+
+  *offset = 0;
+  serve(e, response, buffer, preferred_size, offset);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/*- Block2 Cache API --------------------------------------------------------*/
+/*---------------------------------------------------------------------------*/
+int
+coap_block2_cache_get(void *request, void *response, uint8_t *buffer,
+                      uint16_t preferred_size, int32_t *offset)
+{
+  coap_packet_t *const coap_req = (coap_packet_t *)request;
+  resource_t *resource;
+  block2_cache_entry_t *e;
+
+  if(coap_req->code != COAP_GET || IS_OPTION(coap_req, COAP_OPTION_OBSERVE)) {
+    return 0;
+  }
+  resource = rest_find_resource(request);
+  if(resource == NULL || !(resource->flags & IS_CACHED)
+     || (resource->flags & (IS_SEPARATE | IS_OBSERVABLE))
+     || resource->get_handler == NULL) {
+    return 0;
+  }
+
+  init();
+  remove_expired();
+
+  if(*offset == 0) {
+    if(is_too_large(resource, coap_req)) {
+      return 0;
+    }
+    return fill(resource, coap_req, (coap_packet_t *)response, buffer,
+                preferred_size, offset);
+  }
+
+  e = lookup(resource, coap_req);
+  if(e == NULL) {
+    return 0;
+  }
+  if(IS_OPTION(coap_req, COAP_OPTION_ETAG)
+     && (coap_req->etag_len != e->etag_len
+         || memcmp(coap_req->etag, e->etag, e->etag_len) != 0)) {
+    /* the client started on another representation */
+    return 0;
+  }
+  serve(e, (coap_packet_t *)response, buffer, preferred_size, offset);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_block2_cache_flush(resource_t *resource)
+{
+  block2_cache_entry_t *e;
+  block2_cache_entry_t *next;
+
+  init();
+  for(e = list_head(entries_list); e != NULL; e = next) {
+    next = e->next;
+    if(resource == NULL || e->resource == resource) {
+      remove_entry(e);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+coap_block2_cache_count(void)
+{
+  init();
+  return list_length(entries_list);
+}
+/*---------------------------------------------------------------------------*/
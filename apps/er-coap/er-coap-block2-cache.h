@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      Cache of Block2 representations.
+ *
+ *      Resources flagged IS_CACHED are asked for their whole
+ *      representation when a GET starts at offset 0, and the later
+ *      blocks of the transfer are copied from managed memory instead
+ *      of calling the handler again. Entries are keyed by resource,
+ *      URI path, URI query and Accept, dropped after the last block
+ *      or COAP_BLOCK2_CACHE_LIFETIME, and evicted least recently used
+ *      first to stay within COAP_BLOCK2_CACHE_SIZE bytes.
+ *
+ *      Representations without an ETag get the CRC-16 of their content
+ *      as ETag, and block requests carrying another ETag are passed to
+ *      the handler. A representation that does not fit in the whole
+ *      budget is not cached for COAP_BLOCK2_CACHE_LIFETIME, so that its
+ *      handler is not invoked twice for every transfer.
+ */
+
+#ifndef ER_COAP_BLOCK2_CACHE_H_
+#define ER_COAP_BLOCK2_CACHE_H_
+
+#include "er-coap.h"
+
+/**
+ * \brief Serve a GET request of an IS_CACHED resource
+ * \param request The request
+ * \param response The response, initialized by the engine
+ * \param buffer The buffer for the payload of the response
+ * \param preferred_size The block size
+ * \param offset The offset of the block, updated like by a handler
+ * \return 1 if the request was served, 0 if the resource handler has
+ *         to be invoked as usual
+ */
+int coap_block2_cache_get(void *request, void *response, uint8_t *buffer,
+                          uint16_t preferred_size, int32_t *offset);
+
+/**
+ * \brief Drop the cached representations of a resource
+ * \param resource The resource, or NULL for all resources
+ *
+ * Resources call this when their representation changes, so that the
+ * remaining blocks of a running transfer come from the handler again.
+ */
+void coap_block2_cache_flush(resource_t *resource);
+
+/**
+ * \brief Number of cached representations
+ */
+int coap_block2_cache_count(void);
+
+#endif /* ER_COAP_BLOCK2_CACHE_H_ */
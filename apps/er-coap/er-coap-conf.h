@@ -53,6 +53,19 @@
 #define COAP_MAX_OPEN_TRANSACTIONS     4
 #endif /* COAP_MAX_OPEN_TRANSACTIONS */
 
+/* Number of buckets of the MID hash used to look up open transactions (power of two) */
+#ifndef COAP_TRANSACTION_HASH_SIZE
+#define COAP_TRANSACTION_HASH_SIZE     8
+#endif /* COAP_TRANSACTION_HASH_SIZE */
+
+/* Slots of the retransmission timer wheel (power of two) and the clock ticks each slot covers */
+#ifndef COAP_TRANSACTION_WHEEL_SLOTS
+#define COAP_TRANSACTION_WHEEL_SLOTS   16
+#endif /* COAP_TRANSACTION_WHEEL_SLOTS */
+#ifndef COAP_TRANSACTION_WHEEL_TICK
+#define COAP_TRANSACTION_WHEEL_TICK    (CLOCK_SECOND / 4)
+#endif /* COAP_TRANSACTION_WHEEL_TICK */
+
 /* Maximum number of failed request attempts before action */
 #ifndef COAP_MAX_ATTEMPTS
 #define COAP_MAX_ATTEMPTS              4
@@ -71,4 +84,49 @@
 /* Interval in notifies in which NON notifies are changed to CON notifies to check client. */
 #define COAP_OBSERVE_REFRESH_INTERVAL  20
 
+/* Schedule notifications instead of sending them from coap_notify_observers():
+   the representation is generated once per content-format, rapid changes are
+   coalesced, and transmissions are paced by a token bucket. */
+#ifndef COAP_OBSERVE_BATCHING
+#define COAP_OBSERVE_BATCHING          0
+#endif /* COAP_OBSERVE_BATCHING */
+
+/* Number of distinct notifying URIs that can be pending at the same time.
+   Changes to other URIs are notified at once, without pacing. */
+#ifndef COAP_OBSERVE_MAX_PENDING
+#define COAP_OBSERVE_MAX_PENDING       2
+#endif /* COAP_OBSERVE_MAX_PENDING */
+
+/* Token bucket refill interval in clock ticks (one notification per interval) */
+#ifndef COAP_OBSERVE_PACING_INTERVAL
+#define COAP_OBSERVE_PACING_INTERVAL   (CLOCK_SECOND / 8)
+#endif /* COAP_OBSERVE_PACING_INTERVAL */
+
+/* Token bucket depth, i.e., the number of notifications that may leave back-to-back */
+#ifndef COAP_OBSERVE_PACING_BURST
+#define COAP_OBSERVE_PACING_BURST      2
+#endif /* COAP_OBSERVE_PACING_BURST */
+
+/* Keep the whole representation of IS_CACHED resources in managed memory
+   for the duration of a Block2 transfer, so that the handler runs once per
+   transfer instead of once per block. */
+#ifndef COAP_BLOCK2_CACHE
+#define COAP_BLOCK2_CACHE              0
+#endif /* COAP_BLOCK2_CACHE */
+
+/* Number of representations that can be cached at the same time */
+#ifndef COAP_BLOCK2_CACHE_ENTRIES
+#define COAP_BLOCK2_CACHE_ENTRIES      2
+#endif /* COAP_BLOCK2_CACHE_ENTRIES */
+
+/* Bytes of managed memory all cached representations and their URIs may take */
+#ifndef COAP_BLOCK2_CACHE_SIZE
+#define COAP_BLOCK2_CACHE_SIZE         512
+#endif /* COAP_BLOCK2_CACHE_SIZE */
+
+/* Clock ticks after the last block request before a representation is dropped */
+#ifndef COAP_BLOCK2_CACHE_LIFETIME
+#define COAP_BLOCK2_CACHE_LIFETIME     (30 * CLOCK_SECOND)
+#endif /* COAP_BLOCK2_CACHE_LIFETIME */
+
 #endif /* ER_COAP_CONF_H_ */
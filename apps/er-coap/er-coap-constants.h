@@ -42,9 +42,13 @@
 #define COAP_DEFAULT_PORT                    5683
 
 #define COAP_DEFAULT_MAX_AGE                 60
+#ifndef COAP_RESPONSE_TIMEOUT
 #define COAP_RESPONSE_TIMEOUT                3
+#endif
 #define COAP_RESPONSE_RANDOM_FACTOR          1.5
+#ifndef COAP_MAX_RETRANSMIT
 #define COAP_MAX_RETRANSMIT                  4
+#endif
 
 #define COAP_HEADER_LEN                      4  /* | version:0x03 type:0x0C tkl:0xF0 | code | mid:0x00FF | mid:0xFF00 | */
 #define COAP_TOKEN_LEN                       8  /* The maximum number of bytes for the Token */
@@ -65,6 +65,20 @@ static service_callback_t service_cbk = NULL;
 /*- Internal API ------------------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
 static int
+invoke_service(coap_packet_t *request, coap_packet_t *response,
+               uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
+{
+#if COAP_BLOCK2_CACHE
+  /* IS_CACHED resources serve the later blocks of a transfer from memory */
+  if(coap_block2_cache_get(request, response, buffer, preferred_size,
+                           offset)) {
+    return 1;
+  }
+#endif /* COAP_BLOCK2_CACHE */
+  return service_cbk(request, response, buffer, preferred_size, offset);
+}
+/*---------------------------------------------------------------------------*/
+static int
 coap_receive(void)
 {
   erbium_status_code = NO_ERROR;
@@ -134,7 +148,7 @@ coap_receive(void)
           if(service_cbk) {
 
             /* call REST framework and check if found and allowed */
-            if(service_cbk
+            if(invoke_service
                  (message, response, transaction->packet + COAP_MAX_HEADER_SIZE,
                  block_size, &new_offset)) {
 
@@ -45,6 +45,7 @@
 #include "er-coap-observe.h"
 #include "er-coap-separate.h"
 #include "er-coap-observe-client.h"
+#include "er-coap-block2-cache.h"
 
 #define SERVER_LISTEN_PORT      UIP_HTONS(COAP_SERVER_PORT)
 
@@ -60,7 +60,7 @@ LIST(observers_list);
 /*---------------------------------------------------------------------------*/
 static coap_observer_t *
 add_observer(uip_ipaddr_t *addr, uint16_t port, const uint8_t *token,
-             size_t token_len, const char *uri, int uri_len)
+             size_t token_len, const char *uri, int uri_len, uint16_t accept)
 {
   /* Remove existing observe relationship, if any. */
   coap_remove_observer_by_uri(addr, port, uri);
@@ -79,6 +79,10 @@ add_observer(uip_ipaddr_t *addr, uint16_t port, const uint8_t *token,
     o->token_len = token_len;
     memcpy(o->token, token, token_len);
     o->last_mid = 0;
+#if COAP_OBSERVE_BATCHING
+    o->accept = accept;
+    o->pending = 0;
+#endif /* COAP_OBSERVE_BATCHING */
 
     PRINTF("Adding observer (%u/%u) for /%s [0x%02X%02X]\n",
            list_length(observers_list) + 1, COAP_MAX_OBSERVERS,
@@ -180,11 +184,289 @@ coap_remove_observer_by_mid(uip_ipaddr_t *addr, uint16_t port, uint16_t mid)
 /*---------------------------------------------------------------------------*/
 /*- Notification ------------------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
+static void
+build_notification_url(char *url, resource_t *resource, const char *subpath)
+{
+  int url_len;
+
+  url_len = strlen(resource->url);
+  strncpy(url, resource->url, COAP_OBSERVER_URL_LEN - 1);
+  if(url_len < COAP_OBSERVER_URL_LEN - 1 && subpath != NULL) {
+    strncpy(&url[url_len], subpath, COAP_OBSERVER_URL_LEN - url_len - 1);
+  }
+  /* Ensure url is null terminated because strncpy does not guarantee this */
+  url[COAP_OBSERVER_URL_LEN - 1] = '\0';
+}
+/*---------------------------------------------------------------------------*/
+static int
+observer_matches(coap_observer_t *obs, resource_t *resource,
+                 const char *url, int url_len)
+{
+  int obs_url_len = strlen(obs->url);
+
+  /* Do a match based on the parent/sub-resource match so that it is
+     possible to do parent-node observe */
+  return (obs_url_len == url_len
+          || (obs_url_len > url_len
+              && (resource->flags & HAS_SUB_RESOURCES)
+              && obs->url[url_len] == '/'))
+         && strncmp(url, obs->url, url_len) == 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_notification(coap_observer_t *obs, coap_packet_t *notification,
+                  coap_transaction_t *transaction)
+{
+  if(obs->obs_counter % COAP_OBSERVE_REFRESH_INTERVAL == 0) {
+    PRINTF("           Force Confirmable for\n");
+    notification->type = COAP_TYPE_CON;
+  } else {
+    notification->type = COAP_TYPE_NON;
+  }
+
+  PRINTF("           Observer ");
+  PRINT6ADDR(&obs->addr);
+  PRINTF(":%u\n", obs->port);
+
+  /* update last MID for RST matching */
+  obs->last_mid = transaction->mid;
+
+  /* prepare response */
+  notification->mid = transaction->mid;
+
+  if(notification->code < BAD_REQUEST_4_00) {
+    coap_set_header_observe(notification, (obs->obs_counter)++);
+  }
+  coap_set_token(notification, obs->token, obs->token_len);
+
+  transaction->packet_len =
+    coap_serialize_message(notification, transaction->packet);
+
+  coap_send_transaction(transaction);
+}
+/*---------------------------------------------------------------------------*/
+#if COAP_OBSERVE_BATCHING
+/*
+ * Notifications are not sent from coap_notify_observers() directly. Instead,
+ * matching observers are flagged as pending and a ctimer drains them, paced
+ * by a token bucket. The representation is generated when the notification
+ * actually leaves, so changes that happen while an observer is still pending
+ * are coalesced into the latest value. The handler is invoked once per
+ * content-format and the result is shared by all observers asking for it.
+ */
+typedef struct coap_pending_notification {
+  resource_t *resource;
+  char url[COAP_OBSERVER_URL_LEN];
+} coap_pending_notification_t;
+
+static coap_pending_notification_t pending[COAP_OBSERVE_MAX_PENDING];
+static struct ctimer notify_timer;
+static uint8_t notify_tokens = COAP_OBSERVE_PACING_BURST;
+static clock_time_t notify_refill_time;
+static uint8_t notify_buffer[REST_MAX_CHUNK_SIZE + 1];
+
+static void notify_pending_observers(void *ptr);
+/*---------------------------------------------------------------------------*/
+static void
+refill_tokens(void)
+{
+  clock_time_t now = clock_time();
+  clock_time_t elapsed = now - notify_refill_time;
+
+  if(elapsed >= COAP_OBSERVE_PACING_INTERVAL * COAP_OBSERVE_PACING_BURST) {
+    notify_tokens = COAP_OBSERVE_PACING_BURST;
+    notify_refill_time = now;
+  } else {
+    while(elapsed >= COAP_OBSERVE_PACING_INTERVAL) {
+      if(notify_tokens < COAP_OBSERVE_PACING_BURST) {
+        notify_tokens++;
+      }
+      elapsed -= COAP_OBSERVE_PACING_INTERVAL;
+      notify_refill_time += COAP_OBSERVE_PACING_INTERVAL;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+schedule_notifications(clock_time_t delay)
+{
+  if(ctimer_expired(&notify_timer)) {
+    ctimer_set(&notify_timer, delay, notify_pending_observers, NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+generate_representation(coap_pending_notification_t *p, uint16_t accept,
+                        coap_packet_t *notification)
+{
+  coap_packet_t request[1]; /* this way the packet can be treated as pointer as usual */
+
+  coap_init_message(notification, COAP_TYPE_NON, CONTENT_2_05, 0);
+  /* create a "fake" request for the URI */
+  coap_init_message(request, COAP_TYPE_CON, COAP_GET, 0);
+  coap_set_header_uri_path(request, p->url);
+  if(accept != COAP_OBSERVE_NO_ACCEPT) {
+    coap_set_header_accept(request, accept);
+  }
+
+  p->resource->get_handler(request, notification, notify_buffer,
+                           REST_MAX_CHUNK_SIZE, NULL);
+}
+/*---------------------------------------------------------------------------*/
+static void
+notify_pending_observers(void *ptr)
+{
+  coap_packet_t notification[1]; /* this way the packet can be treated as pointer as usual */
+  coap_transaction_t *transaction;
+  coap_observer_t *obs;
+  coap_observer_t *next;
+  uint8_t i;
+  uint16_t accept;
+  int generated;
+
+  refill_tokens();
+
+  for(i = 0; i < COAP_OBSERVE_MAX_PENDING; ++i) {
+    if(pending[i].resource == NULL) {
+      continue;
+    }
+
+    /* one pass per content-format still pending for this URI */
+    for(obs = (coap_observer_t *)list_head(observers_list); obs;
+        obs = obs->next) {
+      if(obs->pending == i + 1) {
+        break;
+      }
+    }
+    while(obs != NULL && notify_tokens > 0) {
+      accept = obs->accept;
+      generated = 0;
+      for(; obs != NULL && notify_tokens > 0; obs = next) {
+        next = obs->next;
+        if(obs->pending != i + 1 || obs->accept != accept) {
+          continue;
+        }
+        if((transaction = coap_new_transaction(coap_get_mid(), &obs->addr,
+                                               obs->port)) == NULL) {
+          /* out of transaction buffers, retry on the next tick */
+          notify_tokens = 0;
+          break;
+        }
+        if(!generated) {
+          PRINTF("Observe: Notification from %s (accept %u)\n",
+                 pending[i].url, accept);
+          generate_representation(&pending[i], accept, notification);
+          generated = 1;
+        }
+        obs->pending = 0;
+        --notify_tokens;
+        send_notification(obs, notification, transaction);
+      }
+
+      /* find the next observer still waiting for this URI */
+      for(obs = (coap_observer_t *)list_head(observers_list); obs;
+          obs = obs->next) {
+        if(obs->pending == i + 1) {
+          break;
+        }
+      }
+    }
+
+    if(obs != NULL) {
+      /* bucket empty, continue once a token becomes available */
+      ctimer_set(&notify_timer, COAP_OBSERVE_PACING_INTERVAL,
+                 notify_pending_observers, NULL);
+      return;
+    }
+    pending[i].resource = NULL;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Notifies the observers of url right away, bypassing the token bucket */
+static void
+notify_observers_now(resource_t *resource, const char *url, int url_len)
+{
+  coap_packet_t notification[1]; /* this way the packet can be treated as pointer as usual */
+  coap_pending_notification_t now;
+  coap_transaction_t *transaction;
+  coap_observer_t *obs;
+  uint16_t accept = COAP_OBSERVE_NO_ACCEPT;
+  int generated = 0;
+
+  now.resource = resource;
+  memcpy(now.url, url, COAP_OBSERVER_URL_LEN);
+
+  for(obs = (coap_observer_t *)list_head(observers_list); obs;
+      obs = obs->next) {
+    if(!observer_matches(obs, resource, url, url_len)) {
+      continue;
+    }
+    if((transaction = coap_new_transaction(coap_get_mid(), &obs->addr,
+                                           obs->port)) == NULL) {
+      PRINTF("Observe: No transaction left to notify the observers of %s\n",
+             url);
+      return;
+    }
+    if(!generated || obs->accept != accept) {
+      accept = obs->accept;
+      generate_representation(&now, accept, notification);
+      generated = 1;
+    }
+    send_notification(obs, notification, transaction);
+  }
+}
+/*---------------------------------------------------------------------------*/
 void
-coap_notify_observers(resource_t *resource)
+coap_notify_observers_sub(resource_t *resource, const char *subpath)
 {
-  coap_notify_observers_sub(resource, NULL);
+  coap_observer_t *obs = NULL;
+  coap_pending_notification_t *p = NULL;
+  char url[COAP_OBSERVER_URL_LEN];
+  int url_len;
+  uint8_t i;
+
+  build_notification_url(url, resource, subpath);
+  url_len = strlen(url);
+
+  /* latest value wins: reuse an entry that is already pending for this URI */
+  for(i = 0; i < COAP_OBSERVE_MAX_PENDING; ++i) {
+    if(pending[i].resource == resource && strcmp(pending[i].url, url) == 0) {
+      p = &pending[i];
+      break;
+    }
+  }
+  if(p == NULL) {
+    for(i = 0; i < COAP_OBSERVE_MAX_PENDING; ++i) {
+      if(pending[i].resource == NULL) {
+        p = &pending[i];
+        break;
+      }
+    }
+  }
+  if(p == NULL) {
+    /* rather lose the pacing than the change */
+    PRINTF("Observe: No free pending slot for %s, notifying now\n", url);
+    notify_observers_now(resource, url, url_len);
+    return;
+  }
+
+  for(obs = (coap_observer_t *)list_head(observers_list); obs;
+      obs = obs->next) {
+    if(observer_matches(obs, resource, url, url_len)) {
+      obs->pending = (p - pending) + 1;
+    }
+  }
+
+  if(p->resource == NULL) {
+    p->resource = resource;
+    memcpy(p->url, url, COAP_OBSERVER_URL_LEN);
+  }
+  PRINTF("Observe: Scheduled notification from %s\n", url);
+
+  schedule_notifications(0);
 }
+#else /* COAP_OBSERVE_BATCHING */
+/*---------------------------------------------------------------------------*/
 void
 coap_notify_observers_sub(resource_t *resource, const char *subpath)
 {
@@ -192,16 +474,10 @@ coap_notify_observers_sub(resource_t *resource, const char *subpath)
   coap_packet_t notification[1]; /* this way the packet can be treated as pointer as usual */
   coap_packet_t request[1]; /* this way the packet can be treated as pointer as usual */
   coap_observer_t *obs = NULL;
-  int url_len, obs_url_len;
+  int url_len;
   char url[COAP_OBSERVER_URL_LEN];
 
-  url_len = strlen(resource->url);
-  strncpy(url, resource->url, COAP_OBSERVER_URL_LEN - 1);
-  if(url_len < COAP_OBSERVER_URL_LEN - 1 && subpath != NULL) {
-    strncpy(&url[url_len], subpath, COAP_OBSERVER_URL_LEN - url_len - 1);
-  }
-  /* Ensure url is null terminated because strncpy does not guarantee this */
-  url[COAP_OBSERVER_URL_LEN - 1] = '\0';
+  build_notification_url(url, resource, subpath);
   /* url now contains the notify URL that needs to match the observer */
   PRINTF("Observe: Notification from %s\n", url);
 
@@ -214,52 +490,26 @@ coap_notify_observers_sub(resource_t *resource, const char *subpath)
   url_len = strlen(url);
   for(obs = (coap_observer_t *)list_head(observers_list); obs;
       obs = obs->next) {
-    obs_url_len = strlen(obs->url);
-
-    /* Do a match based on the parent/sub-resource match so that it is
-       possible to do parent-node observe */
-    if((obs_url_len == url_len
-        || (obs_url_len > url_len
-            && (resource->flags & HAS_SUB_RESOURCES)
-            && obs->url[url_len] == '/'))
-       && strncmp(url, obs->url, url_len) == 0) {
+    if(observer_matches(obs, resource, url, url_len)) {
       coap_transaction_t *transaction = NULL;
 
-      /*TODO implement special transaction for CON, sharing the same buffer to allow for more observers */
-
       if((transaction = coap_new_transaction(coap_get_mid(), &obs->addr, obs->port))) {
-        if(obs->obs_counter % COAP_OBSERVE_REFRESH_INTERVAL == 0) {
-          PRINTF("           Force Confirmable for\n");
-          notification->type = COAP_TYPE_CON;
-        }
-
-        PRINTF("           Observer ");
-        PRINT6ADDR(&obs->addr);
-        PRINTF(":%u\n", obs->port);
-
-        /* update last MID for RST matching */
-        obs->last_mid = transaction->mid;
-
-        /* prepare response */
-        notification->mid = transaction->mid;
-
         resource->get_handler(request, notification,
                               transaction->packet + COAP_MAX_HEADER_SIZE,
                               REST_MAX_CHUNK_SIZE, NULL);
 
-        if(notification->code < BAD_REQUEST_4_00) {
-          coap_set_header_observe(notification, (obs->obs_counter)++);
-        }
-        coap_set_token(notification, obs->token, obs->token_len);
-
-        transaction->packet_len =
-          coap_serialize_message(notification, transaction->packet);
-
-        coap_send_transaction(transaction);
+        send_notification(obs, notification, transaction);
       }
     }
   }
 }
+#endif /* COAP_OBSERVE_BATCHING */
+/*---------------------------------------------------------------------------*/
+void
+coap_notify_observers(resource_t *resource)
+{
+  coap_notify_observers_sub(resource, NULL);
+}
 /*---------------------------------------------------------------------------*/
 void
 coap_observe_handler(resource_t *resource, void *request, void *response)
@@ -273,7 +523,9 @@ coap_observe_handler(resource_t *resource, void *request, void *response)
       if(coap_req->observe == 0) {
         obs = add_observer(&UIP_IP_BUF->srcipaddr, UIP_UDP_BUF->srcport,
                            coap_req->token, coap_req->token_len,
-                           coap_req->uri_path, coap_req->uri_path_len);
+                           coap_req->uri_path, coap_req->uri_path_len,
+                           IS_OPTION(coap_req, COAP_OPTION_ACCEPT) ?
+                           coap_req->accept : COAP_OBSERVE_NO_ACCEPT);
        if(obs) {
           coap_set_header_observe(coap_res, (obs->obs_counter)++);
           /*
@@ -67,8 +67,15 @@ typedef struct coap_observer {
 
   struct etimer retrans_timer;
   uint8_t retrans_counter;
+
+#if COAP_OBSERVE_BATCHING
+  uint16_t accept;              /* requested content-format or COAP_OBSERVE_NO_ACCEPT */
+  uint8_t pending;              /* index + 1 of the pending notification, 0 if none */
+#endif /* COAP_OBSERVE_BATCHING */
 } coap_observer_t;
 
+#define COAP_OBSERVE_NO_ACCEPT 0xFFFF
+
 list_t coap_get_observers(void);
 void coap_remove_observer(coap_observer_t *o);
 int coap_remove_observer_by_client(uip_ipaddr_t *addr, uint16_t port);
@@ -54,11 +54,89 @@
 #endif
 
 /*---------------------------------------------------------------------------*/
+#if (COAP_TRANSACTION_HASH_SIZE & (COAP_TRANSACTION_HASH_SIZE - 1)) != 0
+#error "COAP_TRANSACTION_HASH_SIZE must be a power of two"
+#endif
+#if (COAP_TRANSACTION_WHEEL_SLOTS & (COAP_TRANSACTION_WHEEL_SLOTS - 1)) != 0 \
+  || COAP_TRANSACTION_WHEEL_SLOTS > 128
+#error "COAP_TRANSACTION_WHEEL_SLOTS must be a power of two <= 128"
+#endif
+
+#define MID_HASH(mid) ((mid) & (COAP_TRANSACTION_HASH_SIZE - 1))
+#define WHEEL_MASK    (COAP_TRANSACTION_WHEEL_SLOTS - 1)
+
 MEMB(transactions_memb, coap_transaction_t, COAP_MAX_OPEN_TRANSACTIONS);
-LIST(transactions_list);
+
+/* Open transactions hashed by MID. Consecutive MIDs land in consecutive
+   buckets, so the chains stay short. */
+static void *transactions_hash[COAP_TRANSACTION_HASH_SIZE];
+static uint16_t transactions_open;
+
+/* Hashed timing wheel driving all retransmissions from a single etimer.
+   Each slot covers COAP_TRANSACTION_WHEEL_TICK; transactions further away
+   than one revolution wait for wheel_rounds extra turns. */
+static coap_transaction_t *wheel[COAP_TRANSACTION_WHEEL_SLOTS];
+static uint8_t wheel_cursor;
+static uint16_t wheel_scheduled;
+static clock_time_t wheel_time;
+static struct etimer wheel_timer;
 
 static struct process *transaction_handler_process = NULL;
 
+/*---------------------------------------------------------------------------*/
+/*- Timer wheel -------------------------------------------------------------*/
+/*---------------------------------------------------------------------------*/
+static void
+wheel_remove(coap_transaction_t *t)
+{
+  coap_transaction_t **p;
+
+  if(t->wheel_slot == COAP_TRANSACTION_NOT_SCHEDULED) {
+    return;
+  }
+
+  for(p = &wheel[t->wheel_slot]; *p != NULL; p = &(*p)->wheel_next) {
+    if(*p == t) {
+      *p = t->wheel_next;
+      break;
+    }
+  }
+  t->wheel_next = NULL;
+  t->wheel_slot = COAP_TRANSACTION_NOT_SCHEDULED;
+
+  if(--wheel_scheduled == 0) {
+    etimer_stop(&wheel_timer);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+wheel_insert(coap_transaction_t *t, clock_time_t interval)
+{
+  clock_time_t ticks;
+
+  if(wheel_scheduled == 0) {
+    /* wheel was idle, let it run from now on */
+    wheel_time = clock_time();
+    PROCESS_CONTEXT_BEGIN(transaction_handler_process);
+    etimer_set(&wheel_timer, COAP_TRANSACTION_WHEEL_TICK);
+    PROCESS_CONTEXT_END(transaction_handler_process);
+  }
+
+  /* slot cursor + n is due at wheel_time + n ticks, which may already
+     lie in the past: count from wheel_time and round up, so that the
+     transaction never fires before interval has elapsed */
+  ticks = (interval + (clock_time() - wheel_time) +
+           COAP_TRANSACTION_WHEEL_TICK - 1) / COAP_TRANSACTION_WHEEL_TICK;
+  if(ticks == 0) {
+    ticks = 1;
+  }
+
+  t->wheel_slot = (wheel_cursor + ticks) & WHEEL_MASK;
+  t->wheel_rounds = (ticks - 1) / COAP_TRANSACTION_WHEEL_SLOTS;
+  t->wheel_next = wheel[t->wheel_slot];
+  wheel[t->wheel_slot] = t;
+  wheel_scheduled++;
+}
 /*---------------------------------------------------------------------------*/
 /*- Internal API ------------------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
@@ -75,12 +153,15 @@ coap_new_transaction(uint16_t mid, uip_ipaddr_t *addr, uint16_t port)
   if(t) {
     t->mid = mid;
     t->retrans_counter = 0;
+    t->wheel_next = NULL;
+    t->wheel_slot = COAP_TRANSACTION_NOT_SCHEDULED;
 
     /* save client address */
     uip_ipaddr_copy(&t->addr, addr);
     t->port = port;
 
-    list_add(transactions_list, t); /* list itself makes sure same element is not added twice */
+    list_add(&transactions_hash[MID_HASH(mid)], t); /* list itself makes sure same element is not added twice */
+    transactions_open++;
   }
 
   return t;
@@ -100,22 +181,21 @@ coap_send_transaction(coap_transaction_t *t)
       PRINTF("Keeping transaction %u\n", t->mid);
 
       if(t->retrans_counter == 0) {
-        t->retrans_timer.timer.interval =
+        t->retrans_interval =
           COAP_RESPONSE_TIMEOUT_TICKS + (random_rand()
                                          %
                                          (clock_time_t)
                                          COAP_RESPONSE_TIMEOUT_BACKOFF_MASK);
         PRINTF("Initial interval %f\n",
-               (float)t->retrans_timer.timer.interval / CLOCK_SECOND);
+               (float)t->retrans_interval / CLOCK_SECOND);
       } else {
-        t->retrans_timer.timer.interval <<= 1;  /* double */
+        t->retrans_interval <<= 1;  /* double */
         PRINTF("Doubled (%u) interval %f\n", t->retrans_counter,
-               (float)t->retrans_timer.timer.interval / CLOCK_SECOND);
+               (float)t->retrans_interval / CLOCK_SECOND);
       }
 
-      PROCESS_CONTEXT_BEGIN(transaction_handler_process);
-      etimer_restart(&t->retrans_timer);        /* interval updated above */
-      PROCESS_CONTEXT_END(transaction_handler_process);
+      wheel_remove(t);
+      wheel_insert(t, t->retrans_interval);
 
       t = NULL;
     } else {
@@ -144,9 +224,10 @@ coap_clear_transaction(coap_transaction_t *t)
   if(t) {
     PRINTF("Freeing transaction %u: %p\n", t->mid, t);
 
-    etimer_stop(&t->retrans_timer);
-    list_remove(transactions_list, t);
+    wheel_remove(t);
+    list_remove(&transactions_hash[MID_HASH(t->mid)], t);
     memb_free(&transactions_memb, t);
+    transactions_open--;
   }
 }
 coap_transaction_t *
@@ -154,7 +235,8 @@ coap_get_transaction_by_mid(uint16_t mid)
 {
   coap_transaction_t *t = NULL;
 
-  for(t = (coap_transaction_t *)list_head(transactions_list); t; t = t->next) {
+  for(t = (coap_transaction_t *)list_head(&transactions_hash[MID_HASH(mid)]);
+      t; t = t->next) {
     if(t->mid == mid) {
       PRINTF("Found transaction for MID %u: %p\n", t->mid, t);
       return t;
@@ -166,14 +248,58 @@ coap_get_transaction_by_mid(uint16_t mid)
 void
 coap_check_transactions()
 {
-  coap_transaction_t *t = NULL;
+  coap_transaction_t *expired;
+  coap_transaction_t *t;
+  coap_transaction_t **p;
+
+  if(wheel_scheduled == 0 || !etimer_expired(&wheel_timer)) {
+    return;
+  }
 
-  for(t = (coap_transaction_t *)list_head(transactions_list); t; t = t->next) {
-    if(etimer_expired(&t->retrans_timer)) {
+  /* catch up with every slot that elapsed since the last turn */
+  while(wheel_scheduled > 0
+        && clock_time() - wheel_time >= COAP_TRANSACTION_WHEEL_TICK) {
+    wheel_time += COAP_TRANSACTION_WHEEL_TICK;
+    wheel_cursor = (wheel_cursor + 1) & WHEEL_MASK;
+
+    /* unlink due transactions first, retransmitting re-inserts them */
+    expired = NULL;
+    p = &wheel[wheel_cursor];
+    while((t = *p) != NULL) {
+      if(t->wheel_rounds > 0) {
+        t->wheel_rounds--;
+        p = &t->wheel_next;
+      } else {
+        *p = t->wheel_next;
+        t->wheel_next = expired;
+        t->wheel_slot = COAP_TRANSACTION_NOT_SCHEDULED;
+        expired = t;
+        wheel_scheduled--;
+      }
+    }
+
+    while((t = expired) != NULL) {
+      expired = t->wheel_next;
+      t->wheel_next = NULL;
       ++(t->retrans_counter);
       PRINTF("Retransmitting %u (%u)\n", t->mid, t->retrans_counter);
       coap_send_transaction(t);
     }
   }
+
+  if(wheel_scheduled > 0) {
+    PROCESS_CONTEXT_BEGIN(transaction_handler_process);
+    etimer_set(&wheel_timer, COAP_TRANSACTION_WHEEL_TICK -
+               (clock_time() - wheel_time));
+    PROCESS_CONTEXT_END(transaction_handler_process);
+  } else {
+    etimer_stop(&wheel_timer);
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+coap_transaction_count(void)
+{
+  return transactions_open;
 }
 /*---------------------------------------------------------------------------*/
@@ -48,14 +48,21 @@
 #define COAP_RESPONSE_TIMEOUT_TICKS         (CLOCK_SECOND * COAP_RESPONSE_TIMEOUT)
 #define COAP_RESPONSE_TIMEOUT_BACKOFF_MASK  (long)((CLOCK_SECOND * COAP_RESPONSE_TIMEOUT * ((float)COAP_RESPONSE_RANDOM_FACTOR - 1.0)) + 0.5) + 1
 
+#define COAP_TRANSACTION_NOT_SCHEDULED 0xFF
+
 /* container for transactions with message buffer and retransmission info */
 typedef struct coap_transaction {
-  struct coap_transaction *next;        /* for LIST */
+  struct coap_transaction *next;        /* for LIST of the MID hash bucket */
 
   uint16_t mid;
-  struct etimer retrans_timer;
+  clock_time_t retrans_interval;
   uint8_t retrans_counter;
 
+  /* retransmission timer wheel */
+  struct coap_transaction *wheel_next;
+  uint16_t wheel_rounds;
+  uint8_t wheel_slot;                   /* COAP_TRANSACTION_NOT_SCHEDULED if not armed */
+
   uip_ipaddr_t addr;
   uint16_t port;
 
@@ -76,5 +83,6 @@ void coap_clear_transaction(coap_transaction_t *t);
 coap_transaction_t *coap_get_transaction_by_mid(uint16_t mid);
 
 void coap_check_transactions(void);
+int coap_transaction_count(void);
 
 #endif /* COAP_TRANSACTIONS_H_ */
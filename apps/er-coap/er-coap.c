@@ -65,6 +65,9 @@ static uint16_t current_mid = 0;
 
 coap_status_t erbium_status_code = NO_ERROR;
 char *coap_error_message = "";
+
+/* raised by the Block2 cache while a handler generates a whole representation */
+size_t coap_payload_limit = REST_MAX_CHUNK_SIZE;
 /*---------------------------------------------------------------------------*/
 /*- Local helper functions --------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
@@ -1203,7 +1206,7 @@ coap_set_payload(void *packet, const void *payload, size_t length)
   coap_packet_t *const coap_pkt = (coap_packet_t *)packet;
 
   coap_pkt->payload = (uint8_t *)payload;
-  coap_pkt->payload_len = MIN(REST_MAX_CHUNK_SIZE, length);
+  coap_pkt->payload_len = MIN(coap_payload_limit, length);
 
   return coap_pkt->payload_len;
 }
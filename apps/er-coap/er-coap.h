@@ -176,6 +176,9 @@ typedef struct {
 extern coap_status_t erbium_status_code;
 extern char *coap_error_message;
 
+/* upper bound of the payload length accepted by coap_set_payload() */
+extern size_t coap_payload_limit;
+
 void coap_init_connection(uint16_t port);
 uint16_t coap_get_mid(void);
 
@@ -0,0 +1,481 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+#include "jsonstream.h"
+#include <string.h>
+
+#define FLAG_PARTIAL 0x01
+
+#define IS_HIGH_SURROGATE(c) ((c) >= 0xd800 && (c) <= 0xdbff)
+#define IS_LOW_SURROGATE(c)  ((c) >= 0xdc00 && (c) <= 0xdfff)
+#define REPLACEMENT_CHARACTER 0xfffd
+#define FLAG_END     0x02
+
+/*--------------------------------------------------------------------*/
+static int
+error(struct jsonstream_state *state, char error)
+{
+  state->error = error;
+  return JSON_TYPE_ERROR;
+}
+/*--------------------------------------------------------------------*/
+static int
+push(struct jsonstream_state *state, char c)
+{
+  if(state->depth == JSONSTREAM_MAX_DEPTH) {
+    return error(state, JSON_ERROR_TOO_DEEP);
+  }
+  state->stack[state->depth] = c;
+  state->depth++;
+  state->vtype = 0;
+  return c;
+}
+/*--------------------------------------------------------------------*/
+static void
+modify(struct jsonstream_state *state, char c)
+{
+  if(state->depth > 0) {
+    state->stack[state->depth - 1] = c;
+  }
+}
+/*--------------------------------------------------------------------*/
+static int
+pop(struct jsonstream_state *state, char c)
+{
+  state->depth--;
+  /* a complete value, for the checks of the next token */
+  state->vtype = c;
+  return c;
+}
+/*--------------------------------------------------------------------*/
+static const char *
+literal(char type)
+{
+  switch(type) {
+  case JSON_TYPE_NULL:  return "null";
+  case JSON_TYPE_TRUE:  return "true";
+  default:              return "false";
+  }
+}
+/*--------------------------------------------------------------------*/
+static int
+is_number_char(char c)
+{
+  return (c >= '0' && c <= '9') || c == '.' || c == '-' || c == '+' ||
+    c == 'e' || c == 'E';
+}
+/*--------------------------------------------------------------------*/
+/* read as much of the token in progress as there is in the chunk, and
+   return it if it is complete, or a piece of it */
+/*--------------------------------------------------------------------*/
+static int
+scan(struct jsonstream_state *state)
+{
+  const char *str;
+  char c;
+
+  state->vstart = state->pos;
+  state->flags &= ~FLAG_PARTIAL;
+
+  if(state->ttype == JSON_TYPE_STRING || state->ttype == JSON_TYPE_PAIR_NAME) {
+    while(state->pos < state->len) {
+      c = state->json[state->pos++];
+      if(state->lex) {
+        state->lex = 0;
+      } else if(c == '\\') {
+        state->lex = 1;
+      } else if(c == '"') {
+        state->vlen = state->pos - state->vstart - 1;
+        state->vtype = state->ttype;
+        state->ttype = 0;
+        return state->vtype;
+      }
+    }
+  } else if(state->ttype == JSON_TYPE_NUMBER) {
+    while(state->pos < state->len && is_number_char(state->json[state->pos])) {
+      state->pos++;
+    }
+    if(state->pos < state->len || (state->flags & FLAG_END)) {
+      state->vlen = state->pos - state->vstart;
+      state->vtype = state->ttype;
+      state->ttype = 0;
+      return state->vtype;
+    }
+  } else {
+    str = literal(state->ttype);
+    while(state->pos < state->len && str[state->lex] != 0) {
+      if(state->json[state->pos] != str[state->lex]) {
+        return error(state, JSON_ERROR_SYNTAX);
+      }
+      state->pos++;
+      state->lex++;
+    }
+    if(str[state->lex] == 0) {
+      /* the view is the literal itself, as it may span chunks */
+      state->vlen = state->lex;
+      state->vtype = state->ttype;
+      state->ttype = 0;
+      return state->vtype;
+    }
+  }
+
+  if(state->flags & FLAG_END) {
+    return error(state, JSON_ERROR_SYNTAX);
+  }
+  state->vlen = state->pos - state->vstart;
+  if(state->vlen == 0 || state->ttype == JSON_TYPE_NULL ||
+     state->ttype == JSON_TYPE_TRUE || state->ttype == JSON_TYPE_FALSE) {
+    return JSONSTREAM_MORE;
+  }
+  state->flags |= FLAG_PARTIAL;
+  return state->ttype;
+}
+/*--------------------------------------------------------------------*/
+static int
+start(struct jsonstream_state *state, char type)
+{
+  state->ttype = type;
+  state->lex = 0;
+  state->esc = 0;
+  state->surrogate = 0;
+  return scan(state);
+}
+/*--------------------------------------------------------------------*/
+void
+jsonstream_init(struct jsonstream_state *state)
+{
+  memset(state, 0, sizeof(*state));
+}
+/*--------------------------------------------------------------------*/
+void
+jsonstream_feed(struct jsonstream_state *state, const char *json, int len)
+{
+  state->json = json;
+  state->pos = 0;
+  state->len = len;
+  state->vstart = 0;
+  state->vlen = 0;
+}
+/*--------------------------------------------------------------------*/
+void
+jsonstream_end(struct jsonstream_state *state)
+{
+  jsonstream_feed(state, NULL, 0);
+  state->flags |= FLAG_END;
+}
+/*--------------------------------------------------------------------*/
+int
+jsonstream_next(struct jsonstream_state *state)
+{
+  char c;
+  char s;
+  char v;
+  int value_ok;
+
+  if(state->error) {
+    return JSON_TYPE_ERROR;
+  }
+  if(state->ttype != 0) {
+    return scan(state);
+  }
+  state->flags &= ~FLAG_PARTIAL;
+  state->vlen = 0;
+
+  while(state->pos < state->len) {
+    c = state->json[state->pos];
+    if(c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+      state->pos++;
+      continue;
+    }
+
+    s = jsonstream_get_type(state);
+    v = state->vtype;
+    /* a value may start the document, or follow a '[', ':' or ',' */
+    value_ok = (v == 0 || v == ',') &&
+      ((s == 0 && v == 0) || s == '[' || s == ':');
+
+    state->pos++;
+    switch(c) {
+    case '{':
+    case '[':
+      if(!value_ok) {
+        return error(state, c == '{' ? JSON_ERROR_UNEXPECTED_OBJECT :
+                     JSON_ERROR_UNEXPECTED_ARRAY);
+      }
+      return push(state, c);
+    case '}':
+      if((s == ':' && v != 0 && v != ',') || (s == '{' && v == 0)) {
+        return pop(state, c);
+      }
+      return error(state, JSON_ERROR_UNEXPECTED_END_OF_OBJECT);
+    case ']':
+      if(s == '[' && v != ',') {
+        return pop(state, c);
+      }
+      return error(state, JSON_ERROR_UNEXPECTED_END_OF_ARRAY);
+    case ':':
+      if(s == '{' && v == JSON_TYPE_PAIR_NAME) {
+        modify(state, ':');
+        state->vtype = 0;
+        continue;
+      }
+      return error(state, JSON_ERROR_SYNTAX);
+    case ',':
+      if(s == ':' && v != 0) {
+        modify(state, '{');
+      } else if(s != '[' || v == 0 || v == ',') {
+        return error(state, JSON_ERROR_SYNTAX);
+      }
+      state->vtype = c;
+      return c;
+    case '"':
+      if(s == '{' && (v == 0 || v == ',')) {
+        return start(state, JSON_TYPE_PAIR_NAME);
+      }
+      if(!value_ok) {
+        return error(state, JSON_ERROR_UNEXPECTED_STRING);
+      }
+      return start(state, JSON_TYPE_STRING);
+    default:
+      if(!value_ok) {
+        return error(state, JSON_ERROR_SYNTAX);
+      }
+      if(c == '-' || (c >= '0' && c <= '9')) {
+        state->pos--;
+        return start(state, JSON_TYPE_NUMBER);
+      } else if(c == 'n' || c == 't' || c == 'f') {
+        state->pos--;
+        return start(state, c);
+      }
+      return error(state, JSON_ERROR_SYNTAX);
+    }
+  }
+
+  if(!(state->flags & FLAG_END)) {
+    return JSONSTREAM_MORE;
+  }
+  /* the end of the document */
+  if(state->vtype == 0 || state->depth > 0) {
+    state->error = JSON_ERROR_SYNTAX;
+  }
+  return JSON_TYPE_ERROR;
+}
+/*--------------------------------------------------------------------*/
+const char *
+jsonstream_get_value(struct jsonstream_state *state)
+{
+  if(state->ttype == 0 && (state->vtype == JSON_TYPE_NULL ||
+                           state->vtype == JSON_TYPE_TRUE ||
+                           state->vtype == JSON_TYPE_FALSE)) {
+    return literal(state->vtype);
+  }
+  return state->json + state->vstart;
+}
+/*--------------------------------------------------------------------*/
+int
+jsonstream_get_len(struct jsonstream_state *state)
+{
+  return state->vlen;
+}
+/*--------------------------------------------------------------------*/
+int
+jsonstream_is_partial(struct jsonstream_state *state)
+{
+  return (state->flags & FLAG_PARTIAL) != 0;
+}
+/*--------------------------------------------------------------------*/
+int
+jsonstream_get_type(struct jsonstream_state *state)
+{
+  if(state->depth == 0) {
+    return 0;
+  }
+  return state->stack[state->depth - 1];
+}
+/*--------------------------------------------------------------------*/
+static int
+hex(char c)
+{
+  if(c >= '0' && c <= '9') {
+    return c - '0';
+  } else if(c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  } else if(c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return 0;
+}
+/*--------------------------------------------------------------------*/
+/* o counts the whole value, the bytes that do not fit are dropped */
+static int
+put(char *buf, int o, int size, char c)
+{
+  if(o < size - 1) {
+    buf[o] = c;
+  }
+  return o + 1;
+}
+/*--------------------------------------------------------------------*/
+static int
+put_code(char *buf, int o, int size, uint32_t code)
+{
+  if(code < 0x80) {
+    o = put(buf, o, size, code);
+  } else if(code < 0x800) {
+    o = put(buf, o, size, 0xc0 | (code >> 6));
+    o = put(buf, o, size, 0x80 | (code & 0x3f));
+  } else if(code < 0x10000) {
+    o = put(buf, o, size, 0xe0 | (code >> 12));
+    o = put(buf, o, size, 0x80 | ((code >> 6) & 0x3f));
+    o = put(buf, o, size, 0x80 | (code & 0x3f));
+  } else {
+    o = put(buf, o, size, 0xf0 | (code >> 18));
+    o = put(buf, o, size, 0x80 | ((code >> 12) & 0x3f));
+    o = put(buf, o, size, 0x80 | ((code >> 6) & 0x3f));
+    o = put(buf, o, size, 0x80 | (code & 0x3f));
+  }
+  return o;
+}
+/*--------------------------------------------------------------------*/
+/* a high surrogate that is not followed by a low one is replaced */
+static int
+put_lone_surrogate(struct jsonstream_state *state, char *buf, int o, int size)
+{
+  if(state->surrogate != 0) {
+    state->surrogate = 0;
+    o = put_code(buf, o, size, REPLACEMENT_CHARACTER);
+  }
+  return o;
+}
+/*--------------------------------------------------------------------*/
+/* terminate buf after the last UTF-8 sequence that fits completely */
+static int
+terminate(char *buf, int o, int size)
+{
+  int i, len;
+  unsigned char c;
+
+  if(o > size - 1) {
+    o = size - 1;
+    for(i = o - 1; i >= 0 && i >= o - 4; i--) {
+      c = buf[i];
+      if((c & 0xc0) != 0x80) {
+        len = c < 0x80 ? 1 : (c & 0xe0) == 0xc0 ? 2 : (c & 0xf0) == 0xe0 ? 3 : 4;
+        if(o - i < len) {
+          o = i;
+        }
+        break;
+      }
+    }
+  }
+  buf[o] = 0;
+  return o;
+}
+/*--------------------------------------------------------------------*/
+int
+jsonstream_copy_value(struct jsonstream_state *state, char *buf, int size)
+{
+  const char *value;
+  int i, o;
+  char c;
+  char type;
+
+  if(size <= 0) {
+    return 0;
+  }
+  value = jsonstream_get_value(state);
+  o = 0;
+
+  /* a piece of a value has the type of the token being read */
+  type = state->ttype != 0 ? state->ttype : state->vtype;
+  if(type != JSON_TYPE_STRING && type != JSON_TYPE_PAIR_NAME) {
+    for(i = 0; i < state->vlen; i++) {
+      o = put(buf, o, size, value[i]);
+    }
+    return terminate(buf, o, size);
+  }
+
+  /* the whole piece is decoded, even when it does not fit, to keep the
+     escape state right for the next piece */
+  for(i = 0; i < state->vlen; i++) {
+    c = value[i];
+    if(state->esc == 0) {
+      if(c == '\\') {
+        state->esc = 1;
+      } else {
+        o = put_lone_surrogate(state, buf, o, size);
+        o = put(buf, o, size, c);
+      }
+    } else if(state->esc == 1) {
+      state->esc = 0;
+      switch(c) {
+      case 'b': c = '\b'; break;
+      case 'f': c = '\f'; break;
+      case 'n': c = '\n'; break;
+      case 'r': c = '\r'; break;
+      case 't': c = '\t'; break;
+      case 'u':
+        state->esc = 2;
+        state->ucode = 0;
+        continue;
+      }
+      o = put_lone_surrogate(state, buf, o, size);
+      o = put(buf, o, size, c);
+    } else {
+      state->ucode = (state->ucode << 4) | hex(c);
+      if(++state->esc < 6) {
+        continue;
+      }
+      state->esc = 0;
+      if(IS_LOW_SURROGATE(state->ucode) && state->surrogate != 0) {
+        o = put_code(buf, o, size, 0x10000 +
+                     ((uint32_t)(state->surrogate - 0xd800) << 10) +
+                     (state->ucode - 0xdc00));
+        state->surrogate = 0;
+        continue;
+      }
+      o = put_lone_surrogate(state, buf, o, size);
+      if(IS_HIGH_SURROGATE(state->ucode)) {
+        state->surrogate = state->ucode;
+      } else if(IS_LOW_SURROGATE(state->ucode)) {
+        o = put_code(buf, o, size, REPLACEMENT_CHARACTER);
+      } else {
+        o = put_code(buf, o, size, state->ucode);
+      }
+    }
+  }
+  if(!jsonstream_is_partial(state)) {
+    o = put_lone_surrogate(state, buf, o, size);
+  }
+  return terminate(buf, o, size);
+}
+/*--------------------------------------------------------------------*/
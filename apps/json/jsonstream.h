@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         A resumable JSON tokenizer that is fed the document in chunks.
+ *
+ *         Unlike jsonparse, which needs the whole document in one
+ *         buffer, the tokenizer keeps its nesting state between chunks
+ *         and returns the values as views into the current chunk, so
+ *         a document of any size is parsed in constant memory.
+ *
+ *         A string or number that does not end in the chunk it starts
+ *         in is returned in pieces, one per chunk, and
+ *         jsonstream_is_partial() is true for every piece but the
+ *         last. The last piece may be empty. null, true and false are
+ *         only returned once complete, with a view of a constant
+ *         string.
+ */
+
+#ifndef JSONSTREAM_H_
+#define JSONSTREAM_H_
+
+#include "contiki-conf.h"
+#include "json.h"
+
+#ifdef JSONSTREAM_CONF_MAX_DEPTH
+#define JSONSTREAM_MAX_DEPTH JSONSTREAM_CONF_MAX_DEPTH
+#else
+#define JSONSTREAM_MAX_DEPTH 10
+#endif
+
+/* Returned by jsonstream_next() when the chunk is used up */
+#define JSONSTREAM_MORE -1
+
+struct jsonstream_state {
+  /* the current chunk */
+  const char *json;
+  int pos;
+  int len;
+  int depth;
+  /* view of the current value in the chunk */
+  int vstart;
+  int vlen;
+  /* last complete token, and the token being read */
+  char vtype;
+  char ttype;
+  char error;
+  uint8_t flags;
+  uint8_t lex;
+  /* escape sequence being decoded by jsonstream_copy_value() */
+  uint8_t esc;
+  uint16_t ucode;
+  /* high surrogate waiting for the low one */
+  uint16_t surrogate;
+  char stack[JSONSTREAM_MAX_DEPTH];
+};
+
+/**
+ * \brief      Initialize a JSON tokenizer state.
+ * \param state A pointer to a JSON tokenizer state
+ */
+void jsonstream_init(struct jsonstream_state *state);
+
+/**
+ * \brief      Give the tokenizer the next chunk of the document.
+ * \param state A pointer to a JSON tokenizer state
+ * \param json The chunk
+ * \param len  The length of the chunk
+ *
+ *             The previous chunk must have been used up, that is
+ *             jsonstream_next() must have returned JSONSTREAM_MORE.
+ *             The chunk has to stay in place until then.
+ */
+void jsonstream_feed(struct jsonstream_state *state, const char *json,
+                     int len);
+
+/**
+ * \brief      Tell the tokenizer that the document has ended.
+ * \param state A pointer to a JSON tokenizer state
+ *
+ *             A number at the end of the document is only known to
+ *             be complete after this.
+ */
+void jsonstream_end(struct jsonstream_state *state);
+
+/**
+ * \brief      Move to the next JSON element.
+ * \param state A pointer to a JSON tokenizer state
+ * \return     The type of the element, as for jsonparse_next(),
+ *             JSONSTREAM_MORE if the next chunk is needed, or
+ *             JSON_TYPE_ERROR at the end of the document or on errors,
+ *             with the error in state->error.
+ */
+int jsonstream_next(struct jsonstream_state *state);
+
+/* the view of the current value, valid until the next chunk is fed */
+const char *jsonstream_get_value(struct jsonstream_state *state);
+
+/* get the length of the view of the current value */
+int jsonstream_get_len(struct jsonstream_state *state);
+
+/* is the current value continued in the next chunk */
+int jsonstream_is_partial(struct jsonstream_state *state);
+
+/* get the type of the innermost array or object, 0 at the top level */
+int jsonstream_get_type(struct jsonstream_state *state);
+
+/**
+ * \brief      Copy the current value, or piece of it, into a buffer.
+ * \param state A pointer to a JSON tokenizer state
+ * \param buf  The buffer
+ * \param buf_size The size of the buffer
+ * \return     The number of bytes written, without the terminating 0
+ *
+ *             Escape sequences of strings are decoded, \\u into UTF-8.
+ *             A surrogate pair becomes one 4-byte sequence, and a lone
+ *             surrogate becomes U+FFFD. The pieces of a value can be
+ *             appended one after the other, as an escape sequence split
+ *             between two pieces is completed in the second one.
+ *
+ *             A value that does not fit is cut after the last whole
+ *             UTF-8 sequence that does.
+ */
+int jsonstream_copy_value(struct jsonstream_state *state, char *buf,
+                          int buf_size);
+
+#endif /* JSONSTREAM_H_ */
@@ -42,6 +42,7 @@
 #include "sys/compower.h"
 #include "powertrace.h"
 #include "net/rime/rime.h"
+#include "lib/crc16.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -57,6 +58,8 @@ struct powertrace_sniff_stats {
   uint16_t channel;
   unsigned long last_input_txtime, last_input_rxtime;
   unsigned long last_output_txtime, last_output_rxtime;
+  /* Values at the previous binary record, in the order of the record. */
+  unsigned long record_last[POWERTRACE_RECORD_CHANNEL_VALUES];
 };
 
 #define INPUT  1
@@ -64,9 +67,50 @@ struct powertrace_sniff_stats {
 
 #define MAX_NUM_STATS  16
 
+/* Emit binary records instead of text lines from the periodic process. */
+#ifdef POWERTRACE_CONF_BINARY
+#define POWERTRACE_BINARY POWERTRACE_CONF_BINARY
+#else
+#define POWERTRACE_BINARY 0
+#endif
+
+/* Every Nth binary record holds absolute values, so that a receiver that
+   missed records can resynchronize. */
+#ifdef POWERTRACE_CONF_KEYFRAME_INTERVAL
+#define KEYFRAME_INTERVAL POWERTRACE_CONF_KEYFRAME_INTERVAL
+#else
+#define KEYFRAME_INTERVAL 16
+#endif
+
+#if NETSTACK_CONF_WITH_IPV6
+#define RECORD_FLAGS POWERTRACE_RECORD_PROTO
+#else
+#define RECORD_FLAGS 0
+#endif
+
+#define SLIP_END     0300
+#define SLIP_ESC     0333
+#define SLIP_ESC_END 0334
+#define SLIP_ESC_ESC 0335
+
 MEMB(stats_memb, struct powertrace_sniff_stats, MAX_NUM_STATS);
 LIST(stats_list);
 
+/* Counters at the previous binary record. The text report keeps its
+   own, so that using both does not mix up their deltas. */
+static unsigned long record_last[POWERTRACE_RECORD_COUNTERS];
+static clock_time_t record_last_time;
+static unsigned long record_seqno;
+
+/* Destination of a binary record: a buffer, or a SLIP frame on the
+   serial line if buf is NULL. */
+struct record_writer {
+  uint8_t *buf;
+  int size;
+  int len;
+  unsigned short crc;
+};
+
 PROCESS(powertrace_process, "Periodic power output");
 /*---------------------------------------------------------------------------*/
 void
@@ -186,11 +230,139 @@ powertrace_print(char *str)
     s->last_input_rxtime = s->input_rxtime;
     s->last_output_txtime = s->output_txtime;
     s->last_output_rxtime = s->output_rxtime;
-    
   }
   seqno++;
 }
 /*---------------------------------------------------------------------------*/
+static void
+put_byte(struct record_writer *w, uint8_t b)
+{
+  if(w->buf == NULL) {
+    w->crc = crc16_add(b, w->crc);
+    if(b == SLIP_END) {
+      putchar(SLIP_ESC);
+      b = SLIP_ESC_END;
+    } else if(b == SLIP_ESC) {
+      putchar(SLIP_ESC);
+      b = SLIP_ESC_ESC;
+    }
+    putchar(b);
+  } else if(w->len < w->size) {
+    w->buf[w->len] = b;
+  }
+  w->len++;
+}
+/*---------------------------------------------------------------------------*/
+static void
+put_varint(struct record_writer *w, unsigned long value)
+{
+  while(value >= 0x80) {
+    put_byte(w, (value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  put_byte(w, value);
+}
+/*---------------------------------------------------------------------------*/
+static int
+write_record(struct record_writer *w)
+{
+  unsigned long now[POWERTRACE_RECORD_COUNTERS];
+  unsigned long values[POWERTRACE_RECORD_CHANNEL_VALUES];
+  struct powertrace_sniff_stats *s;
+  clock_time_t time;
+  uint8_t keyframe;
+  uint8_t count;
+  int i;
+
+  if(w->buf != NULL && w->size < POWERTRACE_RECORD_NODE_MAX_LEN) {
+    return -1;
+  }
+
+  energest_flush();
+
+  time = clock_time();
+  now[0] = energest_type_time(ENERGEST_TYPE_CPU);
+  now[1] = energest_type_time(ENERGEST_TYPE_LPM);
+  now[2] = energest_type_time(ENERGEST_TYPE_TRANSMIT);
+  now[3] = energest_type_time(ENERGEST_TYPE_LISTEN);
+  now[4] = compower_idle_activity.transmit;
+  now[5] = compower_idle_activity.listen;
+
+  keyframe = (record_seqno % KEYFRAME_INTERVAL) == 0;
+
+  /* Channels that don't fit are left for the next record. */
+  count = list_length(stats_list);
+  if(w->buf != NULL && count > (w->size - POWERTRACE_RECORD_NODE_MAX_LEN) /
+     POWERTRACE_RECORD_STATS_MAX_LEN) {
+    count = (w->size - POWERTRACE_RECORD_NODE_MAX_LEN) /
+      POWERTRACE_RECORD_STATS_MAX_LEN;
+  }
+
+  put_byte(w, POWERTRACE_RECORD_TYPE | RECORD_FLAGS |
+           (keyframe ? POWERTRACE_RECORD_KEYFRAME : 0));
+  put_byte(w, linkaddr_node_addr.u8[0]);
+  put_byte(w, linkaddr_node_addr.u8[1]);
+  put_varint(w, record_seqno);
+  put_varint(w, keyframe ? time : (clock_time_t)(time - record_last_time));
+  for(i = 0; i < POWERTRACE_RECORD_COUNTERS; i++) {
+    put_varint(w, keyframe ? now[i] : now[i] - record_last[i]);
+    record_last[i] = now[i];
+  }
+  record_last_time = time;
+
+  put_byte(w, count);
+  for(s = list_head(stats_list); s != NULL && count > 0;
+      s = list_item_next(s), count--) {
+    put_varint(w, s->channel);
+#if NETSTACK_CONF_WITH_IPV6
+    put_varint(w, s->proto);
+#endif
+    values[0] = s->num_input;
+    values[1] = s->input_txtime;
+    values[2] = s->input_rxtime;
+    values[3] = s->num_output;
+    values[4] = s->output_txtime;
+    values[5] = s->output_rxtime;
+    for(i = 0; i < POWERTRACE_RECORD_CHANNEL_VALUES; i++) {
+      put_varint(w, keyframe ? values[i] : values[i] - s->record_last[i]);
+      s->record_last[i] = values[i];
+    }
+  }
+
+  record_seqno++;
+  return w->len;
+}
+/*---------------------------------------------------------------------------*/
+int
+powertrace_record(uint8_t *buf, int size)
+{
+  struct record_writer w;
+
+  w.buf = buf;
+  w.size = size;
+  w.len = 0;
+  return write_record(&w);
+}
+/*---------------------------------------------------------------------------*/
+void
+powertrace_print_binary(void)
+{
+  struct record_writer w;
+  unsigned short crc;
+
+  w.buf = NULL;
+  w.len = 0;
+  w.crc = 0;
+
+  /* A leading END flushes any text on the line before the record. */
+  putchar(SLIP_END);
+  write_record(&w);
+  crc = w.crc;
+  put_byte(&w, crc & 0xff);
+  put_byte(&w, crc >> 8);
+  putchar(SLIP_END);
+}
+/*---------------------------------------------------------------------------*/
 PROCESS_THREAD(powertrace_process, ev, data)
 {
   static struct etimer periodic;
@@ -207,7 +379,11 @@ PROCESS_THREAD(powertrace_process, ev, data)
   while(1) {
     PROCESS_WAIT_UNTIL(etimer_expired(&periodic));
     etimer_reset(&periodic);
+#if POWERTRACE_BINARY
+    powertrace_print_binary();
+#else
     powertrace_print("");
+#endif
   }
 
   PROCESS_END();
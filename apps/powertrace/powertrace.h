@@ -41,6 +41,7 @@
 #define POWERTRACE_H
 
 #include "sys/clock.h"
+#include <stdint.h>
 
 void powertrace_start(clock_time_t perioc);
 void powertrace_stop(void);
@@ -54,4 +55,56 @@ void powertrace_sniff(powertrace_onoff_t onoff);
 
 void powertrace_print(char *str);
 
+/*
+ * Binary records carry the same values as the text report, as varints:
+ *
+ *  type      POWERTRACE_RECORD_TYPE | flags
+ *  node      2 bytes, the link-layer address
+ *  seqno
+ *  time      clock_time()
+ *  counters  cpu, lpm, transmit, listen, idle transmit, idle listen
+ *  channels  1 byte, followed by that many channels of:
+ *              channel, proto (with POWERTRACE_RECORD_PROTO), num_input,
+ *              input_txtime, input_rxtime, num_output, output_txtime,
+ *              output_rxtime
+ *
+ * Values are deltas to the previous record, except in records with
+ * POWERTRACE_RECORD_KEYFRAME where they are absolute. The deltas of the
+ * binary records do not depend on calls to powertrace_print().
+ */
+#define POWERTRACE_RECORD_TYPE      0xd0
+#define POWERTRACE_RECORD_KEYFRAME  0x01
+#define POWERTRACE_RECORD_PROTO     0x02
+#define POWERTRACE_RECORD_COUNTERS  6
+#define POWERTRACE_RECORD_CHANNEL_VALUES 6
+
+/* Longest encoding of a varint, of the node part of a record including
+   its channel count, and of each channel. A buffer of
+   POWERTRACE_RECORD_NODE_MAX_LEN + n * POWERTRACE_RECORD_STATS_MAX_LEN
+   bytes holds a record with at least n channels. */
+#define POWERTRACE_VARINT_MAX_LEN ((sizeof(unsigned long) * 8 + 6) / 7)
+#define POWERTRACE_RECORD_NODE_MAX_LEN \
+  (1 + 2 + (2 + POWERTRACE_RECORD_COUNTERS) * POWERTRACE_VARINT_MAX_LEN + 1)
+#define POWERTRACE_RECORD_STATS_MAX_LEN \
+  ((2 + POWERTRACE_RECORD_CHANNEL_VALUES) * POWERTRACE_VARINT_MAX_LEN)
+
+/**
+ * \brief      Write a binary record of the power consumption since the previous record
+ * \param buf  The buffer to write the record to
+ * \param size The size of buf
+ * \return     The length of the record, or -1 if buf is too small
+ *
+ *              Channels that don't fit in buf are left out, their deltas
+ *              are carried over to the next record that has room for them.
+ */
+int powertrace_record(uint8_t *buf, int size);
+
+/**
+ * \brief      Print a binary record on the serial line
+ *
+ *              The record is followed by its CRC-16 (core/lib/crc16.h),
+ *              little endian, and SLIP framed.
+ */
+void powertrace_print_binary(void);
+
 #endif /* POWERTRACE_H */
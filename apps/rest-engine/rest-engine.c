@@ -124,13 +124,9 @@ rest_get_resources(void)
   return restful_services;
 }
 /*---------------------------------------------------------------------------*/
-int
-rest_invoke_restful_service(void *request, void *response, uint8_t *buffer,
-                            uint16_t buffer_size, int32_t *offset)
+resource_t *
+rest_find_resource(void *request)
 {
-  uint8_t found = 0;
-  uint8_t allowed = 1;
-
   resource_t *resource = NULL;
   const char *url = NULL;
   int url_len, res_url_len;
@@ -146,33 +142,47 @@ rest_invoke_restful_service(void *request, void *response, uint8_t *buffer,
             && (resource->flags & HAS_SUB_RESOURCES)
             && url[res_url_len] == '/'))
        && strncmp(resource->url, url, res_url_len) == 0) {
-      found = 1;
-      rest_resource_flags_t method = REST.get_method_type(request);
-
-      PRINTF("/%s, method %u, resource->flags %u\n", resource->url,
-             (uint16_t)method, resource->flags);
-
-      if((method & METHOD_GET) && resource->get_handler != NULL) {
-        /* call handler function */
-        resource->get_handler(request, response, buffer, buffer_size, offset);
-      } else if((method & METHOD_POST) && resource->post_handler != NULL) {
-        /* call handler function */
-        resource->post_handler(request, response, buffer, buffer_size,
-                               offset);
-      } else if((method & METHOD_PUT) && resource->put_handler != NULL) {
-        /* call handler function */
-        resource->put_handler(request, response, buffer, buffer_size, offset);
-      } else if((method & METHOD_DELETE) && resource->delete_handler != NULL) {
-        /* call handler function */
-        resource->delete_handler(request, response, buffer, buffer_size,
-                                 offset);
-      } else {
-        allowed = 0;
-        REST.set_response_status(response, REST.status.METHOD_NOT_ALLOWED);
-      }
       break;
     }
   }
+  return resource;
+}
+/*---------------------------------------------------------------------------*/
+int
+rest_invoke_restful_service(void *request, void *response, uint8_t *buffer,
+                            uint16_t buffer_size, int32_t *offset)
+{
+  uint8_t found = 0;
+  uint8_t allowed = 1;
+
+  resource_t *resource = rest_find_resource(request);
+
+  if(resource != NULL) {
+    found = 1;
+    rest_resource_flags_t method = REST.get_method_type(request);
+
+    PRINTF("/%s, method %u, resource->flags %u\n", resource->url,
+           (uint16_t)method, resource->flags);
+
+    if((method & METHOD_GET) && resource->get_handler != NULL) {
+      /* call handler function */
+      resource->get_handler(request, response, buffer, buffer_size, offset);
+    } else if((method & METHOD_POST) && resource->post_handler != NULL) {
+      /* call handler function */
+      resource->post_handler(request, response, buffer, buffer_size,
+                             offset);
+    } else if((method & METHOD_PUT) && resource->put_handler != NULL) {
+      /* call handler function */
+      resource->put_handler(request, response, buffer, buffer_size, offset);
+    } else if((method & METHOD_DELETE) && resource->delete_handler != NULL) {
+      /* call handler function */
+      resource->delete_handler(request, response, buffer, buffer_size,
+                               offset);
+    } else {
+      allowed = 0;
+      REST.set_response_status(response, REST.status.METHOD_NOT_ALLOWED);
+    }
+  }
   if(!found) {
     REST.set_response_status(response, REST.status.NOT_FOUND);
   } else if(allowed) {
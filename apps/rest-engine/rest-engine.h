@@ -117,6 +117,14 @@ typedef struct periodic_resource_s periodic_resource_t;
 #define PARENT_RESOURCE(name, attributes, get_handler, post_handler, put_handler, delete_handler) \
   resource_t name = { NULL, NULL, HAS_SUB_RESOURCES, attributes, get_handler, post_handler, put_handler, delete_handler, { NULL } }
 
+/*
+ * Macro to define a resource whose GET representation is generated once per blockwise transfer.
+ * With COAP_BLOCK2_CACHE, the handler is asked for the whole representation at offset 0,
+ * and the later blocks are served from memory.
+ */
+#define CACHED_RESOURCE(name, attributes, get_handler, post_handler, put_handler, delete_handler) \
+  resource_t name = { NULL, NULL, IS_CACHED, attributes, get_handler, post_handler, put_handler, delete_handler, { NULL } }
+
 #define SEPARATE_RESOURCE(name, attributes, get_handler, post_handler, put_handler, delete_handler, resume_handler) \
   resource_t name = { NULL, NULL, IS_SEPARATE, attributes, get_handler, post_handler, put_handler, delete_handler, { .resume = resume_handler } }
 
@@ -254,5 +262,13 @@ void rest_activate_resource(resource_t *resource, char *path);
  */
 list_t rest_get_resources(void);
 /*---------------------------------------------------------------------------*/
+/**
+ * \brief      Returns the resource that serves the URI path of a request.
+ * \param request
+ *             The request.
+ * \return     The resource, or NULL if no resource matches.
+ */
+resource_t *rest_find_resource(void *request);
+/*---------------------------------------------------------------------------*/
 
 #endif /*REST_ENGINE_H_ */
@@ -49,6 +49,11 @@ SHELL_COMMAND(ps_command,
 	      "ps",
 	      "ps: list all running processes",
 	      &shell_ps_process);
+PROCESS(shell_pstat_process, "pstat");
+SHELL_COMMAND(pstat_command,
+	      "pstat",
+	      "pstat [reset]: show the CPU time of processes, in rtimer ticks",
+	      &shell_pstat_process);
 /*---------------------------------------------------------------------------*/
 PROCESS_THREAD(shell_ps_process, ev, data)
 {
@@ -65,9 +70,35 @@ PROCESS_THREAD(shell_ps_process, ev, data)
   PROCESS_END();
 }
 /*---------------------------------------------------------------------------*/
+PROCESS_THREAD(shell_pstat_process, ev, data)
+{
+#if PROCESS_CONF_PROFILE
+  struct process *p;
+  char buf[40];
+#endif
+  PROCESS_BEGIN();
+
+#if PROCESS_CONF_PROFILE
+  shell_output_str(&pstat_command, "Calls, ticks, max ticks:", "");
+  for(p = PROCESS_LIST(); p != NULL; p = p->next) {
+    snprintf(buf, sizeof(buf), "%lu %lu %lu ",
+             p->profile.calls, p->profile.ticks, p->profile.max_ticks);
+    shell_output_str(&pstat_command, buf, PROCESS_NAME_STRING(p));
+  }
+  if(data != NULL && strcmp(data, "reset") == 0) {
+    process_profile_reset();
+  }
+#else
+  shell_output_str(&pstat_command, "pstat: PROCESS_CONF_PROFILE is not set", "");
+#endif
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
 void
 shell_ps_init(void)
 {
   shell_register_command(&ps_command);
+  shell_register_command(&pstat_command);
 }
 /*---------------------------------------------------------------------------*/
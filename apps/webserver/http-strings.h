@@ -14,8 +14,13 @@ extern const char http_index_htm[11];
 extern const char http_index_html[12];
 extern const char http_404_html[10];
 extern const char http_referer[9];
-extern const char http_header_200[85];
-extern const char http_header_404[92];
+extern const char http_connection[12];
+extern const char http_if_none_match[15];
+extern const char http_header_200[66];
+extern const char http_header_304[76];
+extern const char http_header_404[73];
+extern const char http_connection_close[20];
+extern const char http_content_encoding_gzip[25];
 extern const char http_content_type_plain[29];
 extern const char http_content_type_html[28];
 extern const char http_content_type_css [27];
@@ -131,6 +131,7 @@ PT_THREAD(send_headers(struct httpd_state *s, const char *statushdr))
   PSOCK_BEGIN(&s->sout);
 
   SEND_STRING(&s->sout, statushdr);
+  SEND_STRING(&s->sout, http_connection_close);
   SEND_STRING(&s->sout, get_content_type(s->filename));
 
   PSOCK_END(&s->sout);
@@ -32,16 +32,31 @@
  *
  */
 
+#include <string.h>
+
 #include "contiki-net.h"
+#include "lib/crc16.h"
 #include "httpd.h"
 #include "httpd-fs.h"
 #include "httpd-fsdata.h"
 
 #include "httpd-fsdata.c"
 
+/* The files are looked up in an open addressed hash table, built on
+   the first lookup, that is at most half full. */
+#define TABLE_SIZE (2 * HTTPD_FS_NUMFILES)
+
+#define IS_NAME_END(c) ((c) == 0 || (c) == '\r' || (c) == '\n' || (c) == '?')
+
+static struct {
+  struct httpd_fsdata_file_noconst *file;
+  uint16_t etag;
 #if HTTPD_FS_STATISTICS
-static uint16_t count[HTTPD_FS_NUMFILES];
+  uint16_t count;
 #endif /* HTTPD_FS_STATISTICS */
+} table[TABLE_SIZE];
+
+static uint8_t table_built;
 
 /*-----------------------------------------------------------------------------------*/
 static uint8_t
@@ -51,10 +66,8 @@ httpd_fs_strcmp(const char *str1, const char *str2)
   i = 0;
 
 loop:
-  if(str2[i] == 0 ||
-     str1[i] == '\r' || 
-     str1[i] == '\n') {
-    return 0;
+  if(str2[i] == 0) {
+    return !IS_NAME_END(str1[i]);
   }
 
   if(str1[i] != str2[i]) {
@@ -65,63 +78,91 @@ loop:
   goto loop;
 }
 /*-----------------------------------------------------------------------------------*/
-int
-httpd_fs_open(const char *name, struct httpd_fs_file *file)
+static uint16_t
+httpd_fs_hash(const char *name)
+{
+  uint16_t hash;
+
+  hash = 0;
+  while(!IS_NAME_END(*name)) {
+    hash = hash * 31 + (unsigned char)*name++;
+  }
+  return hash % TABLE_SIZE;
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+build_table(void)
 {
-#if HTTPD_FS_STATISTICS
-  uint16_t i = 0;
-#endif /* HTTPD_FS_STATISTICS */
   struct httpd_fsdata_file_noconst *f;
+  uint16_t i;
 
+  memset(table, 0, sizeof(table));
   for(f = (struct httpd_fsdata_file_noconst *)HTTPD_FS_ROOT;
       f != NULL;
       f = (struct httpd_fsdata_file_noconst *)f->next) {
+    for(i = httpd_fs_hash(f->name); table[i].file != NULL;
+        i = (i + 1) % TABLE_SIZE);
+    table[i].file = f;
+    table[i].etag = crc16_data((unsigned char *)f->data, f->len, 0);
+  }
+  table_built = 1;
+}
+/*-----------------------------------------------------------------------------------*/
+static int
+lookup(const char *name)
+{
+  uint16_t i;
 
-    if(httpd_fs_strcmp(name, f->name) == 0) {
-      file->data = f->data;
-      file->len = f->len;
-#if HTTPD_FS_STATISTICS
-      ++count[i];
-#endif /* HTTPD_FS_STATISTICS */
-      return 1;
+  if(!table_built) {
+    build_table();
+  }
+
+  for(i = httpd_fs_hash(name); table[i].file != NULL;
+      i = (i + 1) % TABLE_SIZE) {
+    if(httpd_fs_strcmp(name, table[i].file->name) == 0) {
+      return i;
     }
-#if HTTPD_FS_STATISTICS
-    ++i;
-#endif /* HTTPD_FS_STATISTICS */
+  }
+  return -1;
+}
+/*-----------------------------------------------------------------------------------*/
+int
+httpd_fs_open(const char *name, struct httpd_fs_file *file)
+{
+  int i;
 
+  i = lookup(name);
+  if(i < 0) {
+    return 0;
   }
-  return 0;
+
+  file->data = table[i].file->data;
+  file->len = table[i].file->len;
+  file->etag = table[i].etag;
+  file->flags = table[i].file->flags;
+#if HTTPD_FS_STATISTICS
+  ++table[i].count;
+#endif /* HTTPD_FS_STATISTICS */
+  return 1;
 }
 /*-----------------------------------------------------------------------------------*/
 void
 httpd_fs_init(void)
 {
-#if HTTPD_FS_STATISTICS
-  uint16_t i;
-  for(i = 0; i < HTTPD_FS_NUMFILES; i++) {
-    count[i] = 0;
-  }
-#endif /* HTTPD_FS_STATISTICS */
+  build_table();
 }
 /*-----------------------------------------------------------------------------------*/
 #if HTTPD_FS_STATISTICS
 uint16_t
 httpd_fs_count(char *name)
 {
-  struct httpd_fsdata_file_noconst *f;
-  uint16_t i;
-
-  i = 0;
-  for(f = (struct httpd_fsdata_file_noconst *)HTTPD_FS_ROOT;
-      f != NULL;
-      f = (struct httpd_fsdata_file_noconst *)f->next) {
+  int i;
 
-    if(httpd_fs_strcmp(name, f->name) == 0) {
-      return count[i];
-    }
-    ++i;
+  i = lookup(name);
+  if(i < 0) {
+    return 0;
   }
-  return 0;
+  return table[i].count;
 }
 #endif /* HTTPD_FS_STATISTICS */
 /*-----------------------------------------------------------------------------------*/
@@ -38,13 +38,19 @@
 
 #define HTTPD_FS_STATISTICS 1
 
+/* Flags of a file, set by makefsdata. */
+#define HTTPD_FS_GZIP 0x01
+
 struct httpd_fs_file {
   char *data;
   int len;
+  uint16_t etag;
+  uint8_t flags;
 };
 
 /* file must be allocated by caller and will be filled in
-   by the function. */
+   by the function. The name ends at a NUL, a line break or a query
+   string. The etag is a CRC of the file data. */
 int httpd_fs_open(const char *name, struct httpd_fs_file *file);
 
 #ifdef HTTPD_FS_STATISTICS
@@ -41,6 +41,7 @@ struct httpd_fsdata_file {
   const char *name;
   const char *data;
   const int len;
+  const uint8_t flags;
 #ifdef HTTPD_FS_STATISTICS
 #if HTTPD_FS_STATISTICS == 1
   uint16_t count;
@@ -53,6 +54,7 @@ struct httpd_fsdata_file_noconst {
   char *name;
   char *data;
   int len;
+  uint8_t flags;
 #ifdef HTTPD_FS_STATISTICS
 #if HTTPD_FS_STATISTICS == 1
   uint16_t count;
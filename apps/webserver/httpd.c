@@ -33,6 +33,7 @@
  */
  
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "contiki-net.h"
@@ -53,13 +54,24 @@
 
 #define STATE_WAITING 0
 #define STATE_OUTPUT  1
+#define STATE_CLOSING 2
+
+#define INPUT_STOPPED   0x01
+#define INPUT_LINESTART 0x02
+
+/* The slot of the request that is being read. The output thread only
+   ever dequeues the head, so this does not move while it is read. */
+#define INPUT_REQUEST(s) \
+  (&(s)->requests[((s)->head + (s)->pending) % HTTPD_PIPELINE_DEPTH])
 
 #define SEND_STRING(s, str) PSOCK_SEND(s, (uint8_t *)str, (unsigned int)strlen(str))
 MEMB(conns, struct httpd_state, CONNS);
 
 #define ISO_nl      0x0a
+#define ISO_cr      0x0d
 #define ISO_space   0x20
 #define ISO_bang    0x21
+#define ISO_quote   0x22
 #define ISO_percent 0x25
 #define ISO_period  0x2e
 #define ISO_slash   0x2f
@@ -181,19 +193,12 @@ PT_THREAD(handle_script(struct httpd_state *s))
   PT_END(&s->scriptpt);
 }
 /*---------------------------------------------------------------------------*/
-static
-PT_THREAD(send_headers(struct httpd_state *s, const char *statushdr))
+static const char *
+get_content_type(const char *filename)
 {
-/* gcc warning if not initialized. 
- * If initialized, minimal-net platform segmentation fault if not static...
- */
-  static const char *ptr = NULL;
-
-  PSOCK_BEGIN(&s->sout);
+  const char *ptr;
 
-  SEND_STRING(&s->sout, statushdr);
-
-  ptr = strrchr(s->filename, ISO_period);
+  ptr = strrchr(filename, ISO_period);
   if(ptr == NULL) {
     ptr = http_content_type_binary;
   } else if(strncmp(http_html, ptr, 5) == 0 ||
@@ -210,90 +215,275 @@ PT_THREAD(send_headers(struct httpd_state *s, const char *statushdr))
   } else {
     ptr = http_content_type_plain;
   }
-  SEND_STRING(&s->sout, ptr);
+  return ptr;
+}
+/*---------------------------------------------------------------------------*/
+static int
+is_script(const char *filename)
+{
+  const char *ptr;
+
+  ptr = strrchr(filename, ISO_period);
+  return ptr != NULL && strncmp(ptr, http_shtml, 6) == 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+add_header(struct httpd_state *s, const char *str)
+{
+  /* Only the part of the headers that has not been sent yet, and that
+     fits in a segment, goes into the buffer. */
+  for(; *str != 0; str++, s->hdrlen++) {
+    if(s->hdrlen >= s->hdrsent && s->len < uip_mss()) {
+      ((char *)uip_appdata)[s->len++] = *str;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static unsigned short
+generate_headers(void *state)
+{
+  struct httpd_state *s = (struct httpd_state *)state;
+  char line[sizeof("Content-Length: 4294967295\r\n")];
+
+  s->len = 0;
+  s->hdrlen = 0;
+  add_header(s, s->statushdr);
+  if(s->requests[s->head].flags & HTTPD_REQUEST_CLOSE) {
+    add_header(s, http_connection_close);
+  }
+  if(!is_script(s->filename)) {
+    if(s->statushdr != http_header_304) {
+      snprintf(line, sizeof(line), "Content-Length: %u\r\n",
+               (unsigned int)s->file.len);
+      add_header(s, line);
+    }
+    if(s->statushdr != http_header_404) {
+      snprintf(line, sizeof(line), "ETag: \"%04x\"\r\n", s->file.etag);
+      add_header(s, line);
+    }
+  }
+  if(s->statushdr != http_header_304 && (s->file.flags & HTTPD_FS_GZIP)) {
+    add_header(s, http_content_encoding_gzip);
+  }
+  add_header(s, get_content_type(s->filename));
+
+  return s->len;
+}
+/*---------------------------------------------------------------------------*/
+static
+PT_THREAD(send_headers(struct httpd_state *s, const char *statushdr))
+{
+  PSOCK_BEGIN(&s->sout);
+
+  s->statushdr = statushdr;
+  s->hdrsent = 0;
+  do {
+    PSOCK_GENERATOR_SEND(&s->sout, generate_headers, s);
+    s->hdrsent += s->len;
+  } while(s->hdrsent < s->hdrlen);
+
   PSOCK_END(&s->sout);
 }
 /*---------------------------------------------------------------------------*/
+static void
+stop_input(struct httpd_state *s)
+{
+  s->inputflags |= INPUT_STOPPED;
+  if(s->pending == 0) {
+    s->state = STATE_CLOSING;
+    uip_close();
+  } else {
+    /* Close once the requests that are already queued are answered. */
+    s->requests[(s->head + s->pending - 1) % HTTPD_PIPELINE_DEPTH].flags |=
+      HTTPD_REQUEST_CLOSE;
+  }
+}
+/*---------------------------------------------------------------------------*/
 static
 PT_THREAD(handle_output(struct httpd_state *s))
 {
-  char *ptr;
-  
   PT_BEGIN(&s->outputpt);
- 
-  if(!httpd_fs_open(s->filename, &s->file)) {
-    strcpy(s->filename, http_404_html);
-    httpd_fs_open(s->filename, &s->file);
-    PT_WAIT_THREAD(&s->outputpt,
-		   send_headers(s,
-		   http_header_404));
-    PT_WAIT_THREAD(&s->outputpt,
-		   send_file(s));
-  } else {
-    PT_WAIT_THREAD(&s->outputpt,
-		   send_headers(s,
-		   http_header_200));
-    ptr = strrchr(s->filename, ISO_period);
-    if(ptr != NULL && strncmp(ptr, http_shtml, 6) == 0) {
+
+  while(1) {
+    s->state = STATE_WAITING;
+    PT_WAIT_UNTIL(&s->outputpt, s->pending > 0);
+    s->state = STATE_OUTPUT;
+
+    memcpy(s->filename, s->requests[s->head].filename, sizeof(s->filename));
+    if(!httpd_fs_open(s->filename, &s->file)) {
+      strcpy(s->filename, http_404_html);
+      httpd_fs_open(s->filename, &s->file);
+      PT_WAIT_THREAD(&s->outputpt,
+		     send_headers(s,
+		     http_header_404));
+      PT_WAIT_THREAD(&s->outputpt,
+		     send_file(s));
+    } else if(is_script(s->filename)) {
+      /* The length of a script is not known until it has run, so the
+	 end of the connection marks the end of the response. */
+      s->requests[s->head].flags |= HTTPD_REQUEST_CLOSE;
+      s->inputflags |= INPUT_STOPPED;
+      PT_WAIT_THREAD(&s->outputpt,
+		     send_headers(s,
+		     http_header_200));
       PT_INIT(&s->scriptpt);
       PT_WAIT_THREAD(&s->outputpt, handle_script(s));
+    } else if((s->requests[s->head].flags & HTTPD_REQUEST_ETAG) &&
+	      s->requests[s->head].etag == s->file.etag) {
+      PT_WAIT_THREAD(&s->outputpt,
+		     send_headers(s,
+		     http_header_304));
     } else {
+      PT_WAIT_THREAD(&s->outputpt,
+		     send_headers(s,
+		     http_header_200));
       PT_WAIT_THREAD(&s->outputpt,
 		     send_file(s));
     }
+
+    if(s->requests[s->head].flags & HTTPD_REQUEST_CLOSE) {
+      s->state = STATE_CLOSING;
+      PSOCK_CLOSE(&s->sout);
+      PT_EXIT(&s->outputpt);
+    }
+
+    s->head = (s->head + 1) % HTTPD_PIPELINE_DEPTH;
+    s->pending--;
+    /* There is room for another request, open the window if
+       handle_input() closed it. */
+    uip_conn->tcpstateflags &= ~UIP_STOPPED;
   }
-  PSOCK_CLOSE(&s->sout);
+
   PT_END(&s->outputpt);
 }
 /*---------------------------------------------------------------------------*/
 static
 PT_THREAD(handle_input(struct httpd_state *s))
 {
+  char *ptr;
+  unsigned long etag;
+
   PSOCK_BEGIN(&s->sin);
 
-  PSOCK_READTO(&s->sin, ISO_space);
-  
-  if(strncmp(s->inputbuf, http_get, 4) != 0) {
-    PSOCK_CLOSE_EXIT(&s->sin);
-  }
-  PSOCK_READTO(&s->sin, ISO_space);
+  while(1) {
+    PSOCK_WAIT_UNTIL(&s->sin, s->pending < HTTPD_PIPELINE_DEPTH);
 
-  if(s->inputbuf[0] != ISO_slash) {
-    PSOCK_CLOSE_EXIT(&s->sin);
-  }
+    PSOCK_READTO(&s->sin, ISO_space);
 
-  if(s->inputbuf[1] == ISO_space) {
-    strncpy(s->filename, http_index_html, sizeof(s->filename));
-  } else {
-    s->inputbuf[PSOCK_DATALEN(&s->sin) - 1] = 0;
-    strncpy(s->filename, s->inputbuf, sizeof(s->filename));
-  }
+    if(strncmp(s->inputbuf, http_get, 4) != 0) {
+      stop_input(s);
+      PSOCK_EXIT(&s->sin);
+    }
+    PSOCK_READTO(&s->sin, ISO_space);
 
-  petsciiconv_topetscii(s->filename, sizeof(s->filename));
-  webserver_log_file(&uip_conn->ripaddr, s->filename);
-  petsciiconv_toascii(s->filename, sizeof(s->filename));
-  s->state = STATE_OUTPUT;
+    if(s->inputbuf[0] != ISO_slash) {
+      stop_input(s);
+      PSOCK_EXIT(&s->sin);
+    }
 
-  while(1) {
+    if(s->inputbuf[1] == ISO_space) {
+      strncpy(INPUT_REQUEST(s)->filename, http_index_html,
+	      sizeof(INPUT_REQUEST(s)->filename));
+    } else {
+      s->inputbuf[PSOCK_DATALEN(&s->sin) - 1] = 0;
+      strncpy(INPUT_REQUEST(s)->filename, s->inputbuf,
+	      sizeof(INPUT_REQUEST(s)->filename));
+    }
+    INPUT_REQUEST(s)->filename[sizeof(INPUT_REQUEST(s)->filename) - 1] = 0;
+    INPUT_REQUEST(s)->flags = 0;
+
+    petsciiconv_topetscii(INPUT_REQUEST(s)->filename,
+			  sizeof(INPUT_REQUEST(s)->filename));
+    webserver_log_file(&uip_conn->ripaddr, INPUT_REQUEST(s)->filename);
+    petsciiconv_toascii(INPUT_REQUEST(s)->filename,
+			sizeof(INPUT_REQUEST(s)->filename));
+
+    /* Only HTTP/1.1 clients keep the connection open by default. */
     PSOCK_READTO(&s->sin, ISO_nl);
+    if(strncmp(s->inputbuf, http_11, 8) != 0) {
+      INPUT_REQUEST(s)->flags |= HTTPD_REQUEST_CLOSE;
+    }
+
+    /* Header lines may come in more than one piece if they are longer
+       than the input buffer, only the first piece is looked at. */
+    while(1) {
+      if(s->inputbuf[PSOCK_DATALEN(&s->sin) - 1] == ISO_nl) {
+	s->inputflags |= INPUT_LINESTART;
+      } else {
+	s->inputflags &= ~INPUT_LINESTART;
+      }
+      PSOCK_READTO(&s->sin, ISO_nl);
+      if(!(s->inputflags & INPUT_LINESTART)) {
+	continue;
+      }
+      if(s->inputbuf[0] == ISO_nl ||
+	 (s->inputbuf[0] == ISO_cr && PSOCK_DATALEN(&s->sin) == 2)) {
+	break;
+      }
+      s->inputbuf[PSOCK_DATALEN(&s->sin)] = 0;
+
+      if(strncmp(s->inputbuf, http_referer, 8) == 0) {
+	s->inputbuf[PSOCK_DATALEN(&s->sin) - 2] = 0;
+	petsciiconv_topetscii(s->inputbuf, PSOCK_DATALEN(&s->sin) - 2);
+	webserver_log(s->inputbuf);
+      } else if(strncmp(s->inputbuf, http_connection, 11) == 0) {
+	if(strstr(s->inputbuf, "close") != NULL) {
+	  INPUT_REQUEST(s)->flags |= HTTPD_REQUEST_CLOSE;
+	}
+      } else if(strncmp(s->inputbuf, http_if_none_match, 14) == 0) {
+	ptr = strchr(s->inputbuf, ISO_quote);
+	if(ptr != NULL) {
+	  etag = strtoul(ptr + 1, &ptr, 16);
+	  if(*ptr == ISO_quote && etag <= 0xffff) {
+	    INPUT_REQUEST(s)->etag = (uint16_t)etag;
+	    INPUT_REQUEST(s)->flags |= HTTPD_REQUEST_ETAG;
+	  }
+	}
+      }
+    }
 
-    if(strncmp(s->inputbuf, http_referer, 8) == 0) {
-      s->inputbuf[PSOCK_DATALEN(&s->sin) - 2] = 0;
-      petsciiconv_topetscii(s->inputbuf, PSOCK_DATALEN(&s->sin) - 2);
-      webserver_log(s->inputbuf);
+    s->pending++;
+    if(s->requests[(s->head + s->pending - 1) % HTTPD_PIPELINE_DEPTH].flags &
+       HTTPD_REQUEST_CLOSE) {
+      s->inputflags |= INPUT_STOPPED;
+      PSOCK_EXIT(&s->sin);
+    }
+    if(s->pending == HTTPD_PIPELINE_DEPTH) {
+      /* Hold off the client until a response has been sent. */
+      uip_stop();
     }
   }
-  
+
   PSOCK_END(&s->sin);
 }
 /*---------------------------------------------------------------------------*/
 static void
 handle_connection(struct httpd_state *s)
 {
-  handle_input(s);
-  if(s->state == STATE_OUTPUT) {
+  unsigned char full;
+
+  /* The input is read before the output thread overwrites uip_appdata. */
+  full = 0;
+  if(s->state != STATE_CLOSING && !(s->inputflags & INPUT_STOPPED)) {
+    handle_input(s);
+    if(s->sin.readlen > 0 && !(s->inputflags & INPUT_STOPPED)) {
+      /* The queue is full and the rest of the segment can not be kept,
+	 so the connection is closed after the queued requests. The
+	 client sends the others again. */
+      s->sin.readlen = 0;
+      stop_input(s);
+    }
+    full = s->pending == HTTPD_PIPELINE_DEPTH;
+  }
+  if(s->state != STATE_CLOSING) {
     handle_output(s);
   }
+  if(full && s->pending < HTTPD_PIPELINE_DEPTH &&
+     s->state != STATE_CLOSING && !(s->inputflags & INPUT_STOPPED)) {
+    /* Let the input thread get past the full queue now, while there is
+       no new data, so that it waits for the next segment. */
+    handle_input(s);
+  }
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -316,6 +506,8 @@ httpd_appcall(void *state)
     PSOCK_INIT(&s->sout, (uint8_t *)s->inputbuf, sizeof(s->inputbuf) - 1);
     PT_INIT(&s->outputpt);
     s->state = STATE_WAITING;
+    s->head = s->pending = 0;
+    s->inputflags = 0;
     /*    timer_set(&s->timer, CLOCK_SECOND * 100);*/
     s->timer = 0;
     handle_connection(s);
@@ -323,8 +515,15 @@ httpd_appcall(void *state)
     if(uip_poll()) {
       ++s->timer;
       if(s->timer >= 20) {
-	uip_abort();
-	memb_free(&conns, s);
+	if(s->pending == 0 && s->state != STATE_CLOSING) {
+	  /* An idle persistent connection. */
+	  s->state = STATE_CLOSING;
+	  uip_close();
+	} else {
+	  uip_abort();
+	  memb_free(&conns, s);
+	  return;
+	}
       }
     } else {
       s->timer = 0;
@@ -38,6 +38,23 @@
 #include "contiki-net.h"
 #include "httpd-fs.h"
 
+/* Number of pipelined requests that are queued on a connection before
+   the receive window is closed. */
+#ifdef WEBSERVER_CONF_PIPELINE_DEPTH
+#define HTTPD_PIPELINE_DEPTH WEBSERVER_CONF_PIPELINE_DEPTH
+#else /* WEBSERVER_CONF_PIPELINE_DEPTH */
+#define HTTPD_PIPELINE_DEPTH 2
+#endif /* WEBSERVER_CONF_PIPELINE_DEPTH */
+
+#define HTTPD_REQUEST_CLOSE 0x01
+#define HTTPD_REQUEST_ETAG  0x02
+
+struct httpd_request {
+  char filename[20];
+  unsigned char flags;
+  uint16_t etag;
+};
+
 struct httpd_state {
   unsigned char timer;
   struct psock sin, sout;
@@ -45,6 +62,11 @@ struct httpd_state {
   char inputbuf[50];
   char filename[20];
   char state;
+  struct httpd_request requests[HTTPD_PIPELINE_DEPTH];
+  unsigned char head, pending;
+  unsigned char inputflags;
+  const char *statushdr;
+  unsigned short hdrlen, hdrsent;
   struct httpd_fs_file file;  
   int len;
   char *scriptptr;
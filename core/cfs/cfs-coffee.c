@@ -100,6 +100,34 @@
 #define COFFEE_EXTENDED_WEAR_LEVELLING  1
 #endif
 
+/*
+ * The free extent map keeps up to this many runs of free pages in RAM,
+ * so that reservations do not have to read the headers of the whole
+ * file system. Runs that do not fit in the map are found by scanning
+ * once the runs in the map are all too short. 0, the default, always
+ * scans.
+ */
+#ifndef COFFEE_FREE_EXTENTS
+#define COFFEE_FREE_EXTENTS 0
+#endif
+
+/*
+ * Files can be made of up to this many extents, so that large files
+ * can be reserved, and files extended, when the free pages are spread
+ * over several runs. Every extent starts with a header, and the
+ * headers link the extents of a file together, which changes the
+ * header layout on the storage. Set to 1 for contiguous files only.
+ * The extents of a file are taken from the runs of the free extent map,
+ * which needs room for at least as many runs.
+ */
+#ifndef COFFEE_MAX_EXTENTS
+#define COFFEE_MAX_EXTENTS 1
+#endif
+
+#if COFFEE_MAX_EXTENTS > 1 && COFFEE_FREE_EXTENTS < COFFEE_MAX_EXTENTS
+#error "COFFEE_MAX_EXTENTS > 1 requires COFFEE_FREE_EXTENTS >= COFFEE_MAX_EXTENTS."
+#endif
+
 #if COFFEE_START & (COFFEE_SECTOR_SIZE - 1)
 #error COFFEE_START must point to the first byte in a sector.
 #endif
@@ -142,6 +170,8 @@
 #define HDR_FLAG_MODIFIED  0x08 /* Modified file, log exists. */
 #define HDR_FLAG_LOG       0x10 /* Log file. */
 #define HDR_FLAG_ISOLATED  0x20 /* Isolated page. */
+#define HDR_FLAG_EXTENT    0x40 /* Extent of a file, after its first. */
+#define HDR_FLAG_CHAINED   0x80 /* Extent followed by next_extent. */
 
 /* File header macros. */
 #define CHECK_FLAG(hdr, flag) ((hdr).flags & (flag))
@@ -152,9 +182,14 @@
 #define HDR_MODIFIED(hdr)     CHECK_FLAG(hdr, HDR_FLAG_MODIFIED)
 #define HDR_ISOLATED(hdr)     CHECK_FLAG(hdr, HDR_FLAG_ISOLATED)
 #define HDR_OBSOLETE(hdr)     CHECK_FLAG(hdr, HDR_FLAG_OBSOLETE)
+#define HDR_EXTENT(hdr)       CHECK_FLAG(hdr, HDR_FLAG_EXTENT)
+#define HDR_CHAINED(hdr)      CHECK_FLAG(hdr, HDR_FLAG_CHAINED)
 #define HDR_ACTIVE(hdr)       (HDR_ALLOCATED(hdr) && \
                                !HDR_OBSOLETE(hdr) && \
                                !HDR_ISOLATED(hdr))
+/* The first extent of a file that is not a log. */
+#define HDR_NAMED(hdr)        (HDR_ACTIVE(hdr) && !HDR_LOG(hdr) && \
+                               !HDR_EXTENT(hdr))
 
 /* Shortcuts derived from the hardware-dependent configuration of Coffee. */
 #define COFFEE_SECTOR_COUNT \
@@ -169,6 +204,8 @@ struct sector_status {
   coffee_page_t active;
   coffee_page_t obsolete;
   coffee_page_t free;
+  /* An obsolete file that starts in the sector and goes on after it. */
+  coffee_page_t obsolete_start;
 };
 
 /* The structure of cached file objects. */
@@ -179,6 +216,13 @@ struct file {
   int16_t record_count;
   uint8_t references;
   uint8_t flags;
+#if COFFEE_MAX_EXTENTS > 1
+  uint8_t extents;
+  /* The extent accessed last, and its offset in the file. */
+  coffee_page_t ext_page;
+  coffee_page_t ext_pages;
+  cfs_offset_t ext_start;
+#endif
 };
 
 /* The file descriptor structure. */
@@ -200,6 +244,11 @@ struct file_header {
   uint16_t log_record_size;
 #endif /* !COFFEE_SMALL_HEADERS */
   coffee_page_t max_pages;
+#if COFFEE_MAX_EXTENTS > 1
+  coffee_page_t next_extent;
+  /* In the later extents of a file, the first extent of the file. */
+  coffee_page_t first_extent;
+#endif
 #if !COFFEE_SMALL_HEADERS
   uint8_t deprecated_eof_hint;
 #endif /* !COFFEE_SMALL_HEADERS */
@@ -225,6 +274,37 @@ static struct file_desc coffee_fd_set[COFFEE_FD_SET_SIZE];
 static coffee_page_t next_free;
 static char gc_wait;
 
+#if COFFEE_FREE_EXTENTS
+/* A run of free pages. Runs start at the first free page of a sector,
+   and go on through the following sectors as long as they are free. */
+struct free_extent {
+  coffee_page_t start;
+  coffee_page_t pages;
+};
+
+/* The state of the free extent map. */
+#define FREE_MAP_INVALID  0 /* Not built since the last erase. */
+#define FREE_MAP_PARTIAL  1 /* Some runs did not fit. */
+#define FREE_MAP_COMPLETE 2
+
+static struct free_extent free_extents[COFFEE_FREE_EXTENTS];
+static uint8_t free_extent_count;
+static uint8_t free_map_state;
+#endif /* COFFEE_FREE_EXTENTS */
+
+#if COFFEE_MAX_EXTENTS > 1
+#define FILE_EXTENTS(file)  ((file)->extents)
+#else
+#define FILE_EXTENTS(file)  1
+#endif
+
+/* The bytes of data that an extent, or the extents of a file, hold. */
+#define EXTENT_SIZE(pages) \
+  ((cfs_offset_t)(pages) * COFFEE_PAGE_SIZE - sizeof(struct file_header))
+#define FILE_CAPACITY(file) \
+  ((cfs_offset_t)(file)->max_pages * COFFEE_PAGE_SIZE - \
+   FILE_EXTENTS(file) * sizeof(struct file_header))
+
 /*---------------------------------------------------------------------------*/
 static void
 write_header(struct file_header *hdr, coffee_page_t page)
@@ -250,6 +330,116 @@ absolute_offset(coffee_page_t page, cfs_offset_t offset)
   return page * COFFEE_PAGE_SIZE + sizeof(struct file_header) + offset;
 }
 /*---------------------------------------------------------------------------*/
+#if COFFEE_MAX_EXTENTS > 1
+static cfs_offset_t
+file_address(struct file *file, cfs_offset_t offset, cfs_offset_t *len)
+{
+  struct file_header hdr;
+
+  /* Walk the extents from the one accessed last, or from the first. */
+  if(offset < file->ext_start) {
+    read_header(&hdr, file->page);
+    file->ext_page = file->page;
+    file->ext_pages = hdr.max_pages;
+    file->ext_start = 0;
+  }
+  while(offset - file->ext_start >= EXTENT_SIZE(file->ext_pages)) {
+    read_header(&hdr, file->ext_page);
+    if(!HDR_CHAINED(hdr)) {
+      break;
+    }
+    file->ext_start += EXTENT_SIZE(file->ext_pages);
+    file->ext_page = hdr.next_extent;
+    read_header(&hdr, file->ext_page);
+    file->ext_pages = hdr.max_pages;
+  }
+
+  /* The bytes up to the end of the extent are contiguous. */
+  offset -= file->ext_start;
+  *len = EXTENT_SIZE(file->ext_pages) - offset;
+  return absolute_offset(file->ext_page, offset);
+}
+/*---------------------------------------------------------------------------*/
+static void
+file_read(struct file *file, void *buf, cfs_offset_t size,
+          cfs_offset_t offset)
+{
+  cfs_offset_t address, len;
+
+  while(size > 0) {
+    address = file_address(file, offset, &len);
+    if(len <= 0) {
+      break;
+    } else if(len > size) {
+      len = size;
+    }
+    COFFEE_READ(buf, len, address);
+    buf = (char *)buf + len;
+    offset += len;
+    size -= len;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+file_write(struct file *file, const void *buf, cfs_offset_t size,
+           cfs_offset_t offset)
+{
+  cfs_offset_t address, len;
+
+  while(size > 0) {
+    address = file_address(file, offset, &len);
+    if(len <= 0) {
+      break;
+    } else if(len > size) {
+      len = size;
+    }
+    COFFEE_WRITE(buf, len, address);
+    buf = (const char *)buf + len;
+    offset += len;
+    size -= len;
+  }
+}
+#else /* COFFEE_MAX_EXTENTS > 1 */
+#define file_read(file, buf, size, offset) \
+  COFFEE_READ((buf), (size), absolute_offset((file)->page, (offset)))
+#define file_write(file, buf, size, offset) \
+  COFFEE_WRITE((buf), (size), absolute_offset((file)->page, (offset)))
+#endif /* COFFEE_MAX_EXTENTS > 1 */
+/*---------------------------------------------------------------------------*/
+#if COFFEE_MAX_EXTENTS > 1
+/*
+ * The later extents of a file are written before the header that links
+ * them to the file. An extent that its file does not link to was left
+ * by an interrupted reservation or extension, and is not in use.
+ */
+static int
+is_orphan_extent(coffee_page_t page, struct file_header *hdr)
+{
+  struct file_header owner;
+  int i;
+
+  if(!HDR_EXTENT(*hdr)) {
+    return 0;
+  }
+  if((unsigned long)hdr->first_extent >= (unsigned long)COFFEE_PAGE_COUNT) {
+    return 1;
+  }
+  read_header(&owner, hdr->first_extent);
+  if(!HDR_ACTIVE(owner) || HDR_EXTENT(owner)) {
+    return 1;
+  }
+  for(i = 1; i < COFFEE_MAX_EXTENTS && HDR_CHAINED(owner); i++) {
+    if(owner.next_extent == page) {
+      return 0;
+    }
+    read_header(&owner, owner.next_extent);
+  }
+  return 1;
+}
+#else
+#define is_orphan_extent(page, hdr) 0
+#endif /* COFFEE_MAX_EXTENTS > 1 */
+/*---------------------------------------------------------------------------*/
 static coffee_page_t
 get_sector_status(coffee_page_t sector, struct sector_status *stats)
 {
@@ -258,9 +448,10 @@ get_sector_status(coffee_page_t sector, struct sector_status *stats)
   struct file_header hdr;
   coffee_page_t active, obsolete, free;
   coffee_page_t sector_start, sector_end;
-  coffee_page_t page;
+  coffee_page_t page, obsolete_start;
 
   memset(stats, 0, sizeof(*stats));
+  stats->obsolete_start = INVALID_PAGE;
   active = obsolete = free = 0;
 
   /*
@@ -299,9 +490,17 @@ get_sector_status(coffee_page_t sector, struct sector_status *stats)
 
   /* Determine the amount of pages of each type that have not been
      accounted for yet in the current sector. */
+  obsolete_start = INVALID_PAGE;
   for(page = sector_start + skip_pages; page < sector_end;) {
     read_header(&hdr, page);
+    if(HDR_ACTIVE(hdr) && is_orphan_extent(page, &hdr)) {
+      PRINTF("Coffee: Reclaiming the unlinked extent at page %u\n",
+             (unsigned)page);
+      hdr.flags |= HDR_FLAG_OBSOLETE;
+      write_header(&hdr, page);
+    }
     last_pages_are_active = 0;
+    obsolete_start = INVALID_PAGE;
     if(HDR_ACTIVE(hdr)) {
       last_pages_are_active = 1;
       page += hdr.max_pages;
@@ -310,6 +509,7 @@ get_sector_status(coffee_page_t sector, struct sector_status *stats)
       page++;
       obsolete++;
     } else if(HDR_OBSOLETE(hdr)) {
+      obsolete_start = page;
       page += hdr.max_pages;
       obsolete += hdr.max_pages;
     } else {
@@ -338,6 +538,9 @@ get_sector_status(coffee_page_t sector, struct sector_status *stats)
   stats->active = active;
   stats->obsolete = obsolete;
   stats->free = free;
+  if(page > sector_end) {
+    stats->obsolete_start = obsolete_start;
+  }
 
   /*
    * To avoid unnecessary page isolation, we notify the caller that
@@ -374,7 +577,7 @@ collect_garbage(int mode)
 {
   coffee_page_t sector;
   struct sector_status stats;
-  coffee_page_t first_page, isolation_count;
+  coffee_page_t first_page, isolation_count, obsolete_start;
 
   PRINTF("Coffee: Running the garbage collector in %s mode\n",
          mode == GC_RELUCTANT ? "reluctant" : "greedy");
@@ -382,7 +585,9 @@ collect_garbage(int mode)
    * The garbage collector erases as many sectors as possible. A sector is
    * erasable if there are only free or obsolete pages in it.
    */
-  for(sector = 0; sector < COFFEE_SECTOR_COUNT; sector++) {
+  obsolete_start = INVALID_PAGE;
+  for(sector = 0; sector < COFFEE_SECTOR_COUNT;
+      obsolete_start = stats.obsolete_start, sector++) {
     isolation_count = get_sector_status(sector, &stats);
     PRINTF("Coffee: Sector %u has %u active, %u obsolete, and %u free pages.\n",
            (unsigned)sector, (unsigned)stats.active,
@@ -403,8 +608,21 @@ collect_garbage(int mode)
         isolate_pages(first_page + COFFEE_PAGES_PER_SECTOR, isolation_count);
       }
 
+      /*
+       * An obsolete file that starts in the previous sector, which is
+       * kept, would still span the pages of this sector once they are
+       * reused. Its pages in the previous sector are isolated instead.
+       */
+      if(obsolete_start != INVALID_PAGE) {
+        isolate_pages(obsolete_start, first_page - obsolete_start);
+      }
+      stats.obsolete_start = INVALID_PAGE;
+
       COFFEE_ERASE(sector);
       PRINTF("Coffee: Erased sector %d!\n", sector);
+#if COFFEE_FREE_EXTENTS
+      free_map_state = FREE_MAP_INVALID;
+#endif
 
       if(mode == GC_RELUCTANT && isolation_count > 0) {
         break;
@@ -467,6 +685,22 @@ load_file(coffee_page_t start, struct file_header *hdr)
   file->end = UNKNOWN_OFFSET;
   file->max_pages = hdr->max_pages;
   file->flags = 0;
+#if COFFEE_MAX_EXTENTS > 1
+  file->extents = 1;
+  file->ext_page = start;
+  file->ext_pages = hdr->max_pages;
+  file->ext_start = 0;
+  if(HDR_CHAINED(*hdr)) {
+    struct file_header ext;
+
+    ext.next_extent = hdr->next_extent;
+    do {
+      read_header(&ext, ext.next_extent);
+      file->max_pages += ext.max_pages;
+      file->extents++;
+    } while(HDR_CHAINED(ext));
+  }
+#endif
   if(HDR_MODIFIED(*hdr)) {
     file->flags |= COFFEE_FILE_MODIFIED;
   }
@@ -490,7 +724,7 @@ find_file(const char *name)
     }
 
     read_header(&hdr, coffee_files[i].page);
-    if(HDR_ACTIVE(hdr) && !HDR_LOG(hdr) && strcmp(name, hdr.name) == 0) {
+    if(HDR_NAMED(hdr) && strcmp(name, hdr.name) == 0) {
       return &coffee_files[i];
     }
   }
@@ -498,7 +732,7 @@ find_file(const char *name)
   /* Scan the flash memory sequentially otherwise. */
   for(page = 0; page < COFFEE_PAGE_COUNT; page = next_file(page, &hdr)) {
     read_header(&hdr, page);
-    if(HDR_ACTIVE(hdr) && !HDR_LOG(hdr) && strcmp(name, hdr.name) == 0) {
+    if(HDR_NAMED(hdr) && strcmp(name, hdr.name) == 0) {
       return load_file(page, &hdr);
     }
   }
@@ -507,15 +741,12 @@ find_file(const char *name)
 }
 /*---------------------------------------------------------------------------*/
 static cfs_offset_t
-file_end(coffee_page_t start)
+extent_end(coffee_page_t start, coffee_page_t pages)
 {
-  struct file_header hdr;
   unsigned char buf[COFFEE_PAGE_SIZE];
   coffee_page_t page;
   int i;
 
-  read_header(&hdr, start);
-
   /*
    * Move from the end of the range towards the beginning and look for
    * a byte that has been modified.
@@ -524,14 +755,15 @@ file_end(coffee_page_t start)
    * are zeroes, then these are skipped from the calculation.
    */
 
-  for(page = hdr.max_pages - 1; page >= 0; page--) {
+  for(page = pages - 1; page >= 0; page--) {
     COFFEE_READ(buf, sizeof(buf), (start + page) * COFFEE_PAGE_SIZE);
     for(i = COFFEE_PAGE_SIZE - 1; i >= 0; i--) {
       if(buf[i] != 0) {
-        if(page == 0 && i < sizeof(hdr)) {
+        if(page == 0 && i < sizeof(struct file_header)) {
           return 0;
         }
-        return 1 + i + (page * COFFEE_PAGE_SIZE) - sizeof(hdr);
+        return 1 + i + (page * COFFEE_PAGE_SIZE) -
+               sizeof(struct file_header);
       }
     }
   }
@@ -540,11 +772,129 @@ file_end(coffee_page_t start)
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+static cfs_offset_t
+file_end(coffee_page_t start)
+{
+  struct file_header hdr;
+#if COFFEE_MAX_EXTENTS > 1
+  cfs_offset_t end, extent_start, n;
+
+  /* The end is in the last extent with anything written to it. */
+  end = extent_start = 0;
+  for(;;) {
+    read_header(&hdr, start);
+    n = extent_end(start, hdr.max_pages);
+    if(n > 0) {
+      end = extent_start + n;
+    }
+    if(!HDR_CHAINED(hdr)) {
+      return end;
+    }
+    extent_start += EXTENT_SIZE(hdr.max_pages);
+    start = hdr.next_extent;
+  }
+#else
+  read_header(&hdr, start);
+  return extent_end(start, hdr.max_pages);
+#endif
+}
+/*---------------------------------------------------------------------------*/
+#if COFFEE_FREE_EXTENTS
+static void
+free_map_add(coffee_page_t start, coffee_page_t pages)
+{
+  int i, shortest;
+
+  if(free_extent_count < COFFEE_FREE_EXTENTS) {
+    i = free_extent_count++;
+  } else {
+    /* Keep the longest runs, in the order of their pages. */
+    free_map_state = FREE_MAP_PARTIAL;
+    for(i = shortest = 0; i < COFFEE_FREE_EXTENTS; i++) {
+      if(free_extents[i].pages < free_extents[shortest].pages) {
+        shortest = i;
+      }
+    }
+    if(free_extents[shortest].pages >= pages) {
+      return;
+    }
+    memmove(&free_extents[shortest], &free_extents[shortest + 1],
+            (COFFEE_FREE_EXTENTS - shortest - 1) * sizeof(free_extents[0]));
+    i = COFFEE_FREE_EXTENTS - 1;
+  }
+  free_extents[i].start = start;
+  free_extents[i].pages = pages;
+}
+/*---------------------------------------------------------------------------*/
+static void
+free_map_build(void)
+{
+  struct file_header hdr;
+  coffee_page_t page, start;
+
+  free_extent_count = 0;
+  free_map_state = FREE_MAP_COMPLETE;
+
+  start = INVALID_PAGE;
+  for(page = 0; page < COFFEE_PAGE_COUNT; page = next_file(page, &hdr)) {
+    read_header(&hdr, page);
+    if(HDR_FREE(hdr)) {
+      if(start == INVALID_PAGE) {
+        start = page;
+      }
+    } else if(start != INVALID_PAGE) {
+      free_map_add(start, page - start);
+      start = INVALID_PAGE;
+    }
+  }
+  if(start != INVALID_PAGE) {
+    free_map_add(start, COFFEE_PAGE_COUNT - start);
+  }
+  PRINTF("Coffee: Built the free extent map, %d runs%s\n",
+         free_extent_count,
+         free_map_state == FREE_MAP_PARTIAL ? " and more" : "");
+}
+/*---------------------------------------------------------------------------*/
+static coffee_page_t
+free_map_take(int i, coffee_page_t pages)
+{
+  coffee_page_t start;
+
+  /* Pages are taken from the start of a run, which keeps the free pages
+     of each sector at its end. */
+  start = free_extents[i].start;
+  free_extents[i].start += pages;
+  free_extents[i].pages -= pages;
+  if(free_extents[i].pages == 0) {
+    free_extent_count--;
+    memmove(&free_extents[i], &free_extents[i + 1],
+            (free_extent_count - i) * sizeof(free_extents[0]));
+  }
+  return start;
+}
+#endif /* COFFEE_FREE_EXTENTS */
+/*---------------------------------------------------------------------------*/
 static coffee_page_t
 find_contiguous_pages(coffee_page_t amount)
 {
   coffee_page_t page, start;
   struct file_header hdr;
+#if COFFEE_FREE_EXTENTS
+  int i;
+
+  if(free_map_state == FREE_MAP_INVALID) {
+    free_map_build();
+  }
+  for(i = 0; i < free_extent_count; i++) {
+    if(free_extents[i].pages >= amount) {
+      return free_map_take(i, amount);
+    }
+  }
+  if(free_map_state == FREE_MAP_COMPLETE) {
+    return INVALID_PAGE;
+  }
+  /* The run may be one of those left out of the map. */
+#endif /* COFFEE_FREE_EXTENTS */
 
   start = INVALID_PAGE;
   for(page = next_free; page < COFFEE_PAGE_COUNT;) {
@@ -576,6 +926,128 @@ find_contiguous_pages(coffee_page_t amount)
   return INVALID_PAGE;
 }
 /*---------------------------------------------------------------------------*/
+#if COFFEE_MAX_EXTENTS > 1
+/* Returns the number of runs of the map chosen to make up the amount,
+   or -1 if there are too few long enough. */
+static int
+choose_runs(coffee_page_t amount, int max_extents,
+            uint8_t *chosen, coffee_page_t *taken)
+{
+  int count, i, j, longest;
+
+  /*
+   * Make up the amount from the longest runs in the free extent map.
+   * Every extent after the first takes one more page for its header.
+   */
+  for(count = 0; amount > 0; count++) {
+    if(count == max_extents) {
+      return -1;
+    }
+    longest = -1;
+    for(i = 0; i < free_extent_count; i++) {
+      for(j = 0; j < count && chosen[j] != i; j++);
+      if(j == count && (longest < 0 ||
+                        free_extents[i].pages > free_extents[longest].pages)) {
+        longest = i;
+      }
+    }
+    if(longest < 0 || (free_extents[longest].pages < amount &&
+                       free_extents[longest].pages < 2)) {
+      return -1;
+    }
+    chosen[count] = longest;
+    if(free_extents[longest].pages >= amount) {
+      taken[count] = amount;
+      amount = 0;
+    } else {
+      taken[count] = free_extents[longest].pages;
+      amount -= taken[count] - 1;
+    }
+  }
+  return count;
+}
+/*---------------------------------------------------------------------------*/
+static coffee_page_t
+find_extents(coffee_page_t amount, int max_extents, coffee_page_t first,
+             coffee_page_t *first_pages, coffee_page_t *next)
+{
+  struct file_header hdr;
+  uint8_t chosen[COFFEE_MAX_EXTENTS];
+  coffee_page_t taken[COFFEE_MAX_EXTENTS];
+  coffee_page_t page;
+  int count, i, j;
+
+  count = choose_runs(amount, max_extents, chosen, taken);
+  if(count < 0 && free_map_state == FREE_MAP_PARTIAL) {
+    /* The runs taken since the map was built may have left longer ones
+       out of it. */
+    free_map_build();
+    count = choose_runs(amount, max_extents, chosen, taken);
+  }
+  if(count < 0) {
+    return INVALID_PAGE;
+  }
+
+  page = free_extents[chosen[0]].start;
+  if(first == INVALID_PAGE) {
+    first = page;
+  }
+
+  /* Write the headers from the last extent, so that each can be linked
+     to the next one. The caller writes the header of the first. */
+  *next = INVALID_PAGE;
+  for(i = count - 1; i > 0; i--) {
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.max_pages = taken[i];
+    hdr.flags = HDR_FLAG_ALLOCATED | HDR_FLAG_EXTENT;
+    hdr.first_extent = first;
+    if(*next != INVALID_PAGE) {
+      hdr.flags |= HDR_FLAG_CHAINED;
+      hdr.next_extent = *next;
+    }
+    write_header(&hdr, free_extents[chosen[i]].start);
+    *next = free_extents[chosen[i]].start;
+  }
+  *first_pages = taken[0];
+
+  /* Runs that are used up leave the map, so take the later ones first. */
+  for(i = free_extent_count - 1; i >= 0; i--) {
+    for(j = 0; j < count; j++) {
+      if(chosen[j] == i) {
+        free_map_take(i, taken[j]);
+      }
+    }
+  }
+
+  PRINTF("Coffee: Reserved %d extents starting from %u\n",
+         count, (unsigned)page);
+  return page;
+}
+#endif /* COFFEE_MAX_EXTENTS > 1 */
+/*---------------------------------------------------------------------------*/
+static coffee_page_t
+find_pages(struct file_header *hdr, unsigned flags)
+{
+  coffee_page_t page;
+#if COFFEE_MAX_EXTENTS > 1
+  coffee_page_t next;
+#endif
+
+  page = find_contiguous_pages(hdr->max_pages);
+#if COFFEE_MAX_EXTENTS > 1
+  /* Logs are accessed directly, and have to be contiguous. */
+  if(page == INVALID_PAGE && !(flags & HDR_FLAG_LOG)) {
+    page = find_extents(hdr->max_pages, COFFEE_MAX_EXTENTS, INVALID_PAGE,
+                        &hdr->max_pages, &next);
+    if(page != INVALID_PAGE && next != INVALID_PAGE) {
+      hdr->flags |= HDR_FLAG_CHAINED;
+      hdr->next_extent = next;
+    }
+  }
+#endif /* COFFEE_MAX_EXTENTS > 1 */
+  return page;
+}
+/*---------------------------------------------------------------------------*/
 static int
 remove_by_page(coffee_page_t page, int remove_log, int close_fds,
                int gc_allowed)
@@ -596,6 +1068,23 @@ remove_by_page(coffee_page_t page, int remove_log, int close_fds,
   }
 #endif /* COFFEE_MICRO_LOGS */
 
+#if COFFEE_MAX_EXTENTS > 1
+  /* The first extent is obsoleted last, so that the file can be removed
+     again if the removal is interrupted. */
+  if(HDR_CHAINED(hdr)) {
+    struct file_header ext;
+    coffee_page_t ext_page;
+
+    ext.next_extent = hdr.next_extent;
+    do {
+      ext_page = ext.next_extent;
+      read_header(&ext, ext_page);
+      ext.flags |= HDR_FLAG_OBSOLETE;
+      write_header(&ext, ext_page);
+    } while(HDR_CHAINED(ext));
+  }
+#endif /* COFFEE_MAX_EXTENTS > 1 */
+
   hdr.flags |= HDR_FLAG_OBSOLETE;
   write_header(&hdr, page);
 
@@ -646,23 +1135,23 @@ reserve(const char *name, coffee_page_t pages,
     return NULL;
   }
 
-  page = find_contiguous_pages(pages);
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.max_pages = pages;
+  page = find_pages(&hdr, flags);
   if(page == INVALID_PAGE) {
     if(gc_wait) {
       return NULL;
     }
     collect_garbage(GC_GREEDY);
-    page = find_contiguous_pages(pages);
+    page = find_pages(&hdr, flags);
     if(page == INVALID_PAGE) {
       gc_wait = 1;
       return NULL;
     }
   }
 
-  memset(&hdr, 0, sizeof(hdr));
   strncpy(hdr.name, name, sizeof(hdr.name) - 1);
-  hdr.max_pages = pages;
-  hdr.flags = HDR_FLAG_ALLOCATED | flags;
+  hdr.flags |= HDR_FLAG_ALLOCATED | flags;
   write_header(&hdr, page);
 
   PRINTF("Coffee: Reserved %u pages starting from %u for file %s\n",
@@ -826,7 +1315,7 @@ merge_log(coffee_page_t file_page, int extend)
    * The reservation function adds extra space for the header, which has
    * already been accounted for in the previous reservation.
    */
-  max_pages = hdr.max_pages << extend;
+  max_pages = coffee_fd_set[fd].file->max_pages << extend;
   new_file = reserve(hdr.name, max_pages, 1, 0);
   if(new_file == NULL) {
     cfs_close(fd);
@@ -846,7 +1335,7 @@ merge_log(coffee_page_t file_page, int extend)
       cfs_close(fd);
       return -1;
     } else if(n > 0) {
-      COFFEE_WRITE(buf, n, absolute_offset(new_file->page, offset));
+      file_write(new_file, buf, n, offset);
       offset += n;
     }
   } while(n != 0);
@@ -969,8 +1458,7 @@ write_log_page(struct file *file, struct log_param *lp)
 
     if((lp->offset > 0 || lp->size != log_record_size) &&
        read_log_page(&hdr, log_record, &lp_out) < 0) {
-      COFFEE_READ(copy_buf, sizeof(copy_buf),
-                  absolute_offset(file->page, offset));
+      file_read(file, copy_buf, sizeof(copy_buf), offset);
     }
 
     memcpy(&copy_buf[lp->offset], lp->buf, lp->size);
@@ -994,6 +1482,65 @@ write_log_page(struct file *file, struct log_param *lp)
 }
 #endif /* COFFEE_MICRO_LOGS */
 /*---------------------------------------------------------------------------*/
+#if COFFEE_MAX_EXTENTS > 1
+static int
+extend_file(struct file *file)
+{
+  struct file_header hdr;
+  coffee_page_t page, last, next;
+
+  if(file->extents >= COFFEE_MAX_EXTENTS) {
+    return -1;
+  }
+
+  /* Double the size of the file without moving it. */
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.max_pages = file->max_pages;
+  page = find_contiguous_pages(hdr.max_pages);
+  next = INVALID_PAGE;
+  if(page == INVALID_PAGE) {
+    page = find_extents(hdr.max_pages, COFFEE_MAX_EXTENTS - file->extents,
+                        file->page, &hdr.max_pages, &next);
+    if(page == INVALID_PAGE) {
+      return -1;
+    }
+  }
+  hdr.flags = HDR_FLAG_ALLOCATED | HDR_FLAG_EXTENT;
+  hdr.first_extent = file->page;
+  if(next != INVALID_PAGE) {
+    hdr.flags |= HDR_FLAG_CHAINED;
+    hdr.next_extent = next;
+  }
+  write_header(&hdr, page);
+
+  /* Link the new extents to the last one of the file. */
+  next = page;
+  for(last = file->ext_page;; last = hdr.next_extent) {
+    read_header(&hdr, last);
+    if(!HDR_CHAINED(hdr)) {
+      break;
+    }
+  }
+  hdr.flags |= HDR_FLAG_CHAINED;
+  hdr.next_extent = next;
+  write_header(&hdr, last);
+
+  for(;;) {
+    read_header(&hdr, next);
+    file->max_pages += hdr.max_pages;
+    file->extents++;
+    if(!HDR_CHAINED(hdr)) {
+      break;
+    }
+    next = hdr.next_extent;
+  }
+
+  PRINTF("Coffee: Extended the file at page %u to %u pages\n",
+         (unsigned)file->page, (unsigned)file->max_pages);
+  return 0;
+}
+#endif /* COFFEE_MAX_EXTENTS > 1 */
+/*---------------------------------------------------------------------------*/
 static int
 get_available_fd(void)
 {
@@ -1144,7 +1691,7 @@ cfs_read(int fd, void *buf, unsigned size)
 
   /* If the file is not modified, read directly from the file extent. */
   if(!FILE_MODIFIED(file)) {
-    COFFEE_READ(buf, size, absolute_offset(file->page, fdp->offset));
+    file_read(file, buf, size, fdp->offset);
     fdp->offset += size;
     return size;
   }
@@ -1165,7 +1712,7 @@ cfs_read(int fd, void *buf, unsigned size)
 
     /* Read from the original file if we cannot find the data in the log. */
     if(r < 0) {
-      COFFEE_READ(buf, lp.size, absolute_offset(file->page, fdp->offset));
+      file_read(file, buf, lp.size, fdp->offset);
       r = lp.size;
     }
     fdp->offset += r;
@@ -1200,8 +1747,12 @@ cfs_write(int fd, const void *buf, unsigned size)
 #if COFFEE_IO_SEMANTICS
   if(!(fdp->io_flags & CFS_COFFEE_IO_FIRM_SIZE)) {
 #endif
-  while(size + fdp->offset + sizeof(struct file_header) >
-        (file->max_pages * COFFEE_PAGE_SIZE)) {
+  while(size + fdp->offset > FILE_CAPACITY(file)) {
+#if COFFEE_MAX_EXTENTS > 1
+    if(extend_file(file) == 0) {
+      continue;
+    }
+#endif
     if(merge_log(file->page, 1) < 0) {
       return -1;
     }
@@ -1256,7 +1807,7 @@ cfs_write(int fd, const void *buf, unsigned size)
        * corresponding end offset in the original extent to ensure that
        * the correct file size is calculated when opening the file again.
        */
-      COFFEE_WRITE(dummy, 1, absolute_offset(file->page, fdp->offset - 1));
+      file_write(file, dummy, 1, fdp->offset - 1);
     }
   } else {
 #endif /* COFFEE_MICRO_LOGS */
@@ -1266,7 +1817,7 @@ cfs_write(int fd, const void *buf, unsigned size)
   }
 #endif /* COFFEE_APPEND_ONLY */
 
-  COFFEE_WRITE(buf, size, absolute_offset(file->page, fdp->offset));
+  file_write(file, buf, size, fdp->offset);
   fdp->offset += size;
 #if COFFEE_MICRO_LOGS
 }
@@ -1301,8 +1852,8 @@ cfs_readdir(struct cfs_dir *dir, struct cfs_dirent *record)
 
   while(page < COFFEE_PAGE_COUNT) {
     read_header(&hdr, page);
-    if(HDR_ACTIVE(hdr) && !HDR_LOG(hdr)) {
-      memcpy(record->name, hdr.name, sizeof(record->name));
+    if(HDR_NAMED(hdr)) {
+      strncpy(record->name, hdr.name, sizeof(record->name) - 1);
       record->name[sizeof(record->name) - 1] = '\0';
       record->size = file_end(page);
 
@@ -1391,6 +1942,9 @@ cfs_coffee_format(void)
   memset(&coffee_fd_set, 0, sizeof(coffee_fd_set));
   next_free = 0;
   gc_wait = 1;
+#if COFFEE_FREE_EXTENTS
+  free_map_state = FREE_MAP_INVALID;
+#endif
 
   PRINTF(" done!\n");
 
@@ -6,6 +6,7 @@
 #include "contiki-conf.h"
 
 #include "dev/protobuf-handler.h"
+#include "lib/crc16.h"
 
 
 //#define PROTOBUF_HANDLER_DEBUG
@@ -22,33 +23,6 @@ static uint8_t processed_data[PROTBUF_MAX_MESSAGE_LENGTH -4]; //doesn't have src
 static protobuf_data_t callback_data;
 
 
-static uint16_t crc16_up(uint16_t crc, uint8_t a);
-
-/*
- * The exact crc function used in the AVR & python
- * There is a contiki CRC function but not sure it'll
- * behave in the same way.
- */
-uint16_t 
-crc16_up(uint16_t crc, uint8_t a)
-{
-//    PRINTF("Starting CRC with 0x%04x\n", crc);
-    uint8_t i;
-//    PRINTF("Processing CRC for 0x%04x\n", a);
-    crc ^= (uint16_t)a;
-//    PRINTF("After XOR = 0x%04x\n", crc);
-    for (i = 0; i < 8; ++i){
-        if (crc & 1){
-            crc = (crc >> 1) ^ 0xA001;
-        }else{
-            crc = (crc >> 1);
-        }
-//        PRINTF("CRC r%d = 0x%04x\n",i, crc);
-    }
-//    PRINTF("CRC RET = 0x%04x\n", crc);
-    return crc;
-}
-
 void 
 protobuf_init(void)
 {
@@ -65,8 +39,10 @@ protobuf_process_message(uint8_t *buf, uint8_t bytes)
 {
     uint16_t rec_crc, cal_crc;
     uint8_t processed_data_length;
+#ifdef PROTOBUF_HANDLER_DEBUG
     uint8_t i;
     i = 0;
+#endif
     cal_crc = 0xFFFF;
     if(bytes == 0){
       PRINTF("Spurious interrupt, ignoring\n");
@@ -91,9 +67,8 @@ protobuf_process_message(uint8_t *buf, uint8_t bytes)
     }else{
         rec_crc = ((uint16_t)buf[bytes - 1] << 8) | buf[bytes-2];
         PRINTF("Recieved CRC: %d\n", rec_crc);
-        for(i=0; i < bytes-2; i++){
-            cal_crc = crc16_up(cal_crc, buf[i]);
-        }
+        /* The AVR & python use the Modbus CRC16 */
+        cal_crc = crc16_modbus_data(buf, bytes - 2, cal_crc);
         PRINTF("Calculated CRC: %d\n", cal_crc);
         if (rec_crc == cal_crc){
           PRINTF("CRCs match\n");
@@ -161,9 +136,7 @@ void protobuf_send_message(uint8_t addr, uint8_t opcode, uint8_t *payload,
 	      PRINTF("buf:%i\n", buf[buf_length-1]);
       }
     }
-    for(i=0; i <  buf_length; i++){
-        crc = crc16_up(crc, buf[i]);
-    }
+    crc = crc16_modbus_data(buf, buf_length, crc);
     buf[buf_length++] = crc & 0xFF; //Get the low order bits
     buf[buf_length++] = (crc >> 8) & 0xFF;
     PRINTF("CRC: %04x\n", crc);
@@ -32,7 +32,7 @@
 #include "dev/serial-line.h"
 #include <string.h> /* for memcpy() */
 
-#include "lib/ringbuf.h"
+#include "lib/ringbuf16.h"
 
 #ifdef SERIAL_LINE_CONF_BUFSIZE
 #define BUFSIZE SERIAL_LINE_CONF_BUFSIZE
@@ -40,15 +40,10 @@
 #define BUFSIZE 128
 #endif /* SERIAL_LINE_CONF_BUFSIZE */
 
-#if (BUFSIZE & (BUFSIZE - 1)) != 0
-#error SERIAL_LINE_CONF_BUFSIZE must be a power of two (i.e., 1, 2, 4, 8, 16, 32, 64, ...).
-#error Change SERIAL_LINE_CONF_BUFSIZE in contiki-conf.h.
-#endif
-
 #define IGNORE_CHAR(c) (c == 0x0d)
 #define END 0x0a
 
-static struct ringbuf rxbuf;
+static struct ringbuf16 rxbuf;
 static uint8_t rxbuf_data[BUFSIZE];
 
 PROCESS(serial_line_process, "Serial driver");
@@ -67,14 +62,14 @@ serial_line_input_byte(unsigned char c)
 
   if(!overflow) {
     /* Add character */
-    if(ringbuf_put(&rxbuf, c) == 0) {
+    if(ringbuf16_put(&rxbuf, c) == 0) {
       /* Buffer overflow: ignore the rest of the line */
       overflow = 1;
     }
   } else {
     /* Buffer overflowed:
      * Only (try to) add terminator characters, otherwise skip */
-    if(c == END && ringbuf_put(&rxbuf, c) != 0) {
+    if(c == END && ringbuf16_put(&rxbuf, c) != 0) {
       overflow = 0;
     }
   }
@@ -95,20 +90,31 @@ PROCESS_THREAD(serial_line_process, ev, data)
   ptr = 0;
 
   while(1) {
+    uint8_t *span, *eol;
+    uint16_t len, n;
+
     /* Fill application buffer until newline or empty */
-    int c = ringbuf_get(&rxbuf);
-    
-    if(c == -1) {
+    len = ringbuf16_peek(&rxbuf, &span);
+
+    if(len == 0) {
       /* Buffer empty, wait for poll */
       PROCESS_YIELD();
     } else {
-      if(c != END) {
-        if(ptr < BUFSIZE-1) {
-          buf[ptr++] = (uint8_t)c;
-        } else {
-          /* Ignore character (wait for EOL) */
-        }
-      } else {
+      /* Copy the whole span up to the end of the line at once */
+      eol = memchr(span, END, len);
+      if(eol != NULL) {
+        len = eol - span;
+      }
+      n = len;
+      if(n > BUFSIZE - 1 - ptr) {
+        /* Ignore characters that don't fit (wait for EOL) */
+        n = BUFSIZE - 1 - ptr;
+      }
+      memcpy(&buf[ptr], span, n);
+      ptr += n;
+      ringbuf16_consume(&rxbuf, eol != NULL ? len + 1 : len);
+
+      if(eol != NULL) {
         /* Terminate */
         buf[ptr++] = (uint8_t)'\0';
 
@@ -131,7 +137,7 @@ PROCESS_THREAD(serial_line_process, ev, data)
 void
 serial_line_init(void)
 {
-  ringbuf_init(&rxbuf, rxbuf_data, sizeof(rxbuf_data));
+  ringbuf16_init(&rxbuf, rxbuf_data, sizeof(rxbuf_data));
   process_start(&serial_line_process, NULL);
 }
 /*---------------------------------------------------------------------------*/
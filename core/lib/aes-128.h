@@ -74,4 +74,9 @@ void aes_128_set_padded_key(uint8_t *key, uint8_t key_len);
 
 extern const struct aes_128_driver AES_128;
 
+/**
+ * Table-driven software implementation for 32-bit targets, see aes-128-ttable.c
+ */
+extern const struct aes_128_driver aes_128_ttable_driver;
+
 #endif /* AES_128_H_ */
@@ -40,6 +40,7 @@
 
 #include "ccm-star.h"
 #include "lib/aes-128.h"
+#include "sys/cc.h"
 #include <string.h>
 
 /* see RFC 3610 */
@@ -59,86 +60,41 @@ set_iv(uint8_t *iv,
   iv[15] = counter;
 }
 /*---------------------------------------------------------------------------*/
-/* XORs the block m[pos] ... m[pos + 15] with K_{counter} */
 static void
-ctr_step(const uint8_t *nonce,
-    uint8_t pos,
-    uint8_t *m_and_result,
-    uint8_t m_len,
-    uint8_t counter)
+xor_block(uint8_t *dst, const uint8_t *src, uint8_t len)
 {
-  uint8_t a[AES_128_BLOCK_SIZE];
   uint8_t i;
-  
-  set_iv(a, CCM_STAR_ENCRYPTION_FLAGS, nonce, counter);
-  AES_128.encrypt(a);
-  
-  for(i = 0; (pos + i < m_len) && (i < AES_128_BLOCK_SIZE); i++) {
-    m_and_result[pos + i] ^= a[i];
+
+  for(i = 0; i < len; i++) {
+    dst[i] ^= src[i];
   }
 }
 /*---------------------------------------------------------------------------*/
+/* CBC-MAC over B_0 and the length-prefixed additional data */
 static void
-mic(const uint8_t *nonce,
-    const uint8_t *m, uint8_t m_len,
+mic_header(const uint8_t *nonce,
     const uint8_t *a, uint8_t a_len,
-    uint8_t *result,
+    uint8_t m_len,
+    uint8_t *x,
     uint8_t mic_len)
 {
-  uint8_t x[AES_128_BLOCK_SIZE];
-  uint8_t pos;
-  uint8_t i;
-  
+  uint16_t pos;
+
   set_iv(x, CCM_STAR_AUTH_FLAGS(a_len, mic_len), nonce, m_len);
   AES_128.encrypt(x);
-  
+
   if(a_len) {
-    x[1] = x[1] ^ a_len;
-    for(i = 2; (i - 2 < a_len) && (i < AES_128_BLOCK_SIZE); i++) {
-      x[i] ^= a[i - 2];
-    }
-    
+    x[1] ^= a_len;
+    xor_block(x + 2, a, MIN(a_len, AES_128_BLOCK_SIZE - 2));
     AES_128.encrypt(x);
-    
-    pos = 14;
-    while(pos < a_len) {
-      for(i = 0; (pos + i < a_len) && (i < AES_128_BLOCK_SIZE); i++) {
-        x[i] ^= a[pos + i];
-      }
-      pos += AES_128_BLOCK_SIZE;
-      AES_128.encrypt(x);
-    }
-  }
-  
-  if(m_len) {
-    pos = 0;
-    while(pos < m_len) {
-      for(i = 0; (pos + i < m_len) && (i < AES_128_BLOCK_SIZE); i++) {
-        x[i] ^= m[pos + i];
-      }
-      pos += AES_128_BLOCK_SIZE;
+
+    for(pos = AES_128_BLOCK_SIZE - 2; pos < a_len; pos += AES_128_BLOCK_SIZE) {
+      xor_block(x, a + pos, MIN(a_len - pos, AES_128_BLOCK_SIZE));
       AES_128.encrypt(x);
     }
   }
-  
-  ctr_step(nonce, 0, x, AES_128_BLOCK_SIZE, 0);
-  
-  memcpy(result, x, mic_len);
 }
 /*---------------------------------------------------------------------------*/
-static void
-ctr(const uint8_t *nonce, uint8_t *m, uint8_t m_len)
-{
-  uint8_t pos;
-  uint8_t counter;
-  
-  pos = 0;
-  counter = 1;
-  while(pos < m_len) {
-    ctr_step(nonce, pos, m, m_len, counter++);
-    pos += AES_128_BLOCK_SIZE;
-  }
-}
 /*---------------------------------------------------------------------------*/
 static void
 set_key(const uint8_t *key)
@@ -153,21 +109,41 @@ aead(const uint8_t* nonce,
     uint8_t *result, uint8_t mic_len,
     int forward)
 {
-  if(!forward) {
-    /* decrypt */
-    ctr(nonce, m, m_len);
-  }
-  
-  mic(nonce,
-    m, m_len,
-    a, a_len,
-    result,
-    mic_len);
-  
-  if(forward) {
-    /* encrypt */
-    ctr(nonce, m, m_len);
+  uint8_t x[AES_128_BLOCK_SIZE];
+  uint8_t counter_block[AES_128_BLOCK_SIZE];
+  uint8_t key_stream[AES_128_BLOCK_SIZE];
+  uint16_t pos;
+  uint8_t len;
+
+  mic_header(nonce, a, a_len, m_len, x, mic_len);
+
+  /* Authenticate and en-/decrypt the payload in a single pass. Only the
+     counter byte of A_i changes from one block to the next. */
+  set_iv(counter_block, CCM_STAR_ENCRYPTION_FLAGS, nonce, 0);
+  for(pos = 0; pos < m_len; pos += AES_128_BLOCK_SIZE) {
+    len = MIN(m_len - pos, AES_128_BLOCK_SIZE);
+
+    counter_block[AES_128_BLOCK_SIZE - 1]++;
+    memcpy(key_stream, counter_block, AES_128_BLOCK_SIZE);
+    AES_128.encrypt(key_stream);
+
+    if(forward) {
+      /* the MIC is computed over the plaintext */
+      xor_block(x, m + pos, len);
+      AES_128.encrypt(x);
+      xor_block(m + pos, key_stream, len);
+    } else {
+      xor_block(m + pos, key_stream, len);
+      xor_block(x, m + pos, len);
+      AES_128.encrypt(x);
+    }
   }
+
+  /* U = T XOR S_0 */
+  counter_block[AES_128_BLOCK_SIZE - 1] = 0;
+  AES_128.encrypt(counter_block);
+  xor_block(x, counter_block, mic_len);
+  memcpy(result, x, mic_len);
 }
 /*---------------------------------------------------------------------------*/
 const struct ccm_star_driver ccm_star_driver = {
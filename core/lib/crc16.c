@@ -41,11 +41,178 @@
  *
  */
 
-/* CITT CRC16 polynomial ^16 + ^12 + ^5 + 1 */
+#include "contiki-conf.h"
+#include "lib/crc16.h"
+#include <stddef.h>
+
+#ifdef CRC16_CONF_TABLE_ATTR
+#define CRC16_TABLE_ATTR CRC16_CONF_TABLE_ATTR
+#else /* CRC16_CONF_TABLE_ATTR */
+#define CRC16_TABLE_ATTR
+#endif /* CRC16_CONF_TABLE_ATTR */
+
+#ifdef CRC16_CONF_TABLE_READ
+#define TABLE_READ(table, i) CRC16_CONF_TABLE_READ(table, i)
+#else /* CRC16_CONF_TABLE_READ */
+#define TABLE_READ(table, i) ((table)[(i)])
+#endif /* CRC16_CONF_TABLE_READ */
+
+#if CRC16_METHOD == CRC16_METHOD_SLICE8
+#define SLICES 8
+#elif CRC16_METHOD == CRC16_METHOD_SLICE4
+#define SLICES 4
+#else
+#define SLICES 1
+#endif
+
+/*
+ * Both CRCs are reflected, so the table-driven methods share one engine.
+ * table[i] is the CRC of byte i, and slices[k - 1][i] is the CRC of byte
+ * i followed by k zero bytes.
+ */
+#if CRC16_METHOD != CRC16_METHOD_BITWISE
+/* x^16 + x^12 + x^5 + 1, reflected (0x8408) */
+static const unsigned short ccitt_table[256] CRC16_TABLE_ATTR = {
+  0x0000, 0x1189, 0x2312, 0x329b, 0x4624, 0x57ad, 0x6536, 0x74bf,
+  0x8c48, 0x9dc1, 0xaf5a, 0xbed3, 0xca6c, 0xdbe5, 0xe97e, 0xf8f7,
+  0x1081, 0x0108, 0x3393, 0x221a, 0x56a5, 0x472c, 0x75b7, 0x643e,
+  0x9cc9, 0x8d40, 0xbfdb, 0xae52, 0xdaed, 0xcb64, 0xf9ff, 0xe876,
+  0x2102, 0x308b, 0x0210, 0x1399, 0x6726, 0x76af, 0x4434, 0x55bd,
+  0xad4a, 0xbcc3, 0x8e58, 0x9fd1, 0xeb6e, 0xfae7, 0xc87c, 0xd9f5,
+  0x3183, 0x200a, 0x1291, 0x0318, 0x77a7, 0x662e, 0x54b5, 0x453c,
+  0xbdcb, 0xac42, 0x9ed9, 0x8f50, 0xfbef, 0xea66, 0xd8fd, 0xc974,
+  0x4204, 0x538d, 0x6116, 0x709f, 0x0420, 0x15a9, 0x2732, 0x36bb,
+  0xce4c, 0xdfc5, 0xed5e, 0xfcd7, 0x8868, 0x99e1, 0xab7a, 0xbaf3,
+  0x5285, 0x430c, 0x7197, 0x601e, 0x14a1, 0x0528, 0x37b3, 0x263a,
+  0xdecd, 0xcf44, 0xfddf, 0xec56, 0x98e9, 0x8960, 0xbbfb, 0xaa72,
+  0x6306, 0x728f, 0x4014, 0x519d, 0x2522, 0x34ab, 0x0630, 0x17b9,
+  0xef4e, 0xfec7, 0xcc5c, 0xddd5, 0xa96a, 0xb8e3, 0x8a78, 0x9bf1,
+  0x7387, 0x620e, 0x5095, 0x411c, 0x35a3, 0x242a, 0x16b1, 0x0738,
+  0xffcf, 0xee46, 0xdcdd, 0xcd54, 0xb9eb, 0xa862, 0x9af9, 0x8b70,
+  0x8408, 0x9581, 0xa71a, 0xb693, 0xc22c, 0xd3a5, 0xe13e, 0xf0b7,
+  0x0840, 0x19c9, 0x2b52, 0x3adb, 0x4e64, 0x5fed, 0x6d76, 0x7cff,
+  0x9489, 0x8500, 0xb79b, 0xa612, 0xd2ad, 0xc324, 0xf1bf, 0xe036,
+  0x18c1, 0x0948, 0x3bd3, 0x2a5a, 0x5ee5, 0x4f6c, 0x7df7, 0x6c7e,
+  0xa50a, 0xb483, 0x8618, 0x9791, 0xe32e, 0xf2a7, 0xc03c, 0xd1b5,
+  0x2942, 0x38cb, 0x0a50, 0x1bd9, 0x6f66, 0x7eef, 0x4c74, 0x5dfd,
+  0xb58b, 0xa402, 0x9699, 0x8710, 0xf3af, 0xe226, 0xd0bd, 0xc134,
+  0x39c3, 0x284a, 0x1ad1, 0x0b58, 0x7fe7, 0x6e6e, 0x5cf5, 0x4d7c,
+  0xc60c, 0xd785, 0xe51e, 0xf497, 0x8028, 0x91a1, 0xa33a, 0xb2b3,
+  0x4a44, 0x5bcd, 0x6956, 0x78df, 0x0c60, 0x1de9, 0x2f72, 0x3efb,
+  0xd68d, 0xc704, 0xf59f, 0xe416, 0x90a9, 0x8120, 0xb3bb, 0xa232,
+  0x5ac5, 0x4b4c, 0x79d7, 0x685e, 0x1ce1, 0x0d68, 0x3ff3, 0x2e7a,
+  0xe70e, 0xf687, 0xc41c, 0xd595, 0xa12a, 0xb0a3, 0x8238, 0x93b1,
+  0x6b46, 0x7acf, 0x4854, 0x59dd, 0x2d62, 0x3ceb, 0x0e70, 0x1ff9,
+  0xf78f, 0xe606, 0xd49d, 0xc514, 0xb1ab, 0xa022, 0x92b9, 0x8330,
+  0x7bc7, 0x6a4e, 0x58d5, 0x495c, 0x3de3, 0x2c6a, 0x1ef1, 0x0f78
+};
+/* x^16 + x^15 + x^2 + 1, reflected (0xa001) */
+static const unsigned short modbus_table[256] CRC16_TABLE_ATTR = {
+  0x0000, 0xc0c1, 0xc181, 0x0140, 0xc301, 0x03c0, 0x0280, 0xc241,
+  0xc601, 0x06c0, 0x0780, 0xc741, 0x0500, 0xc5c1, 0xc481, 0x0440,
+  0xcc01, 0x0cc0, 0x0d80, 0xcd41, 0x0f00, 0xcfc1, 0xce81, 0x0e40,
+  0x0a00, 0xcac1, 0xcb81, 0x0b40, 0xc901, 0x09c0, 0x0880, 0xc841,
+  0xd801, 0x18c0, 0x1980, 0xd941, 0x1b00, 0xdbc1, 0xda81, 0x1a40,
+  0x1e00, 0xdec1, 0xdf81, 0x1f40, 0xdd01, 0x1dc0, 0x1c80, 0xdc41,
+  0x1400, 0xd4c1, 0xd581, 0x1540, 0xd701, 0x17c0, 0x1680, 0xd641,
+  0xd201, 0x12c0, 0x1380, 0xd341, 0x1100, 0xd1c1, 0xd081, 0x1040,
+  0xf001, 0x30c0, 0x3180, 0xf141, 0x3300, 0xf3c1, 0xf281, 0x3240,
+  0x3600, 0xf6c1, 0xf781, 0x3740, 0xf501, 0x35c0, 0x3480, 0xf441,
+  0x3c00, 0xfcc1, 0xfd81, 0x3d40, 0xff01, 0x3fc0, 0x3e80, 0xfe41,
+  0xfa01, 0x3ac0, 0x3b80, 0xfb41, 0x3900, 0xf9c1, 0xf881, 0x3840,
+  0x2800, 0xe8c1, 0xe981, 0x2940, 0xeb01, 0x2bc0, 0x2a80, 0xea41,
+  0xee01, 0x2ec0, 0x2f80, 0xef41, 0x2d00, 0xedc1, 0xec81, 0x2c40,
+  0xe401, 0x24c0, 0x2580, 0xe541, 0x2700, 0xe7c1, 0xe681, 0x2640,
+  0x2200, 0xe2c1, 0xe381, 0x2340, 0xe101, 0x21c0, 0x2080, 0xe041,
+  0xa001, 0x60c0, 0x6180, 0xa141, 0x6300, 0xa3c1, 0xa281, 0x6240,
+  0x6600, 0xa6c1, 0xa781, 0x6740, 0xa501, 0x65c0, 0x6480, 0xa441,
+  0x6c00, 0xacc1, 0xad81, 0x6d40, 0xaf01, 0x6fc0, 0x6e80, 0xae41,
+  0xaa01, 0x6ac0, 0x6b80, 0xab41, 0x6900, 0xa9c1, 0xa881, 0x6840,
+  0x7800, 0xb8c1, 0xb981, 0x7940, 0xbb01, 0x7bc0, 0x7a80, 0xba41,
+  0xbe01, 0x7ec0, 0x7f80, 0xbf41, 0x7d00, 0xbdc1, 0xbc81, 0x7c40,
+  0xb401, 0x74c0, 0x7580, 0xb541, 0x7700, 0xb7c1, 0xb681, 0x7640,
+  0x7200, 0xb2c1, 0xb381, 0x7340, 0xb101, 0x71c0, 0x7080, 0xb041,
+  0x5000, 0x90c1, 0x9181, 0x5140, 0x9301, 0x53c0, 0x5280, 0x9241,
+  0x9601, 0x56c0, 0x5780, 0x9741, 0x5500, 0x95c1, 0x9481, 0x5440,
+  0x9c01, 0x5cc0, 0x5d80, 0x9d41, 0x5f00, 0x9fc1, 0x9e81, 0x5e40,
+  0x5a00, 0x9ac1, 0x9b81, 0x5b40, 0x9901, 0x59c0, 0x5880, 0x9841,
+  0x8801, 0x48c0, 0x4980, 0x8941, 0x4b00, 0x8bc1, 0x8a81, 0x4a40,
+  0x4e00, 0x8ec1, 0x8f81, 0x4f40, 0x8d01, 0x4dc0, 0x4c80, 0x8c41,
+  0x4400, 0x84c1, 0x8581, 0x4540, 0x8701, 0x47c0, 0x4680, 0x8641,
+  0x8201, 0x42c0, 0x4380, 0x8341, 0x4100, 0x81c1, 0x8081, 0x4040
+};
+
+#if SLICES > 1
+static unsigned short ccitt_slices[SLICES - 1][256];
+static unsigned short modbus_slices[SLICES - 1][256];
+static unsigned char slices_ready;
+
+/*---------------------------------------------------------------------------*/
+static void
+build_slices(const unsigned short *table, unsigned short (*slices)[256])
+{
+  int i, k;
+  unsigned short prev;
+
+  for(i = 0; i < 256; i++) {
+    prev = TABLE_READ(table, i);
+    for(k = 0; k < SLICES - 1; k++) {
+      prev = (prev >> 8) ^ TABLE_READ(table, prev & 0xff);
+      slices[k][i] = prev;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+init_slices(void)
+{
+  build_slices(ccitt_table, ccitt_slices);
+  build_slices(modbus_table, modbus_slices);
+  slices_ready = 1;
+}
+#endif /* SLICES > 1 */
+
+#define TABLE_ADD(table, b, acc) \
+  (((acc) >> 8) ^ TABLE_READ(table, ((acc) ^ (b)) & 0xff))
+
+/*---------------------------------------------------------------------------*/
+static unsigned short
+table_data(const unsigned short *table, unsigned short (*slices)[256],
+           const unsigned char *data, int len, unsigned short acc)
+{
+#if SLICES > 1
+  if(!slices_ready) {
+    init_slices();
+  }
+  while(len >= SLICES) {
+    acc ^= data[0] | (data[1] << 8);
+#if SLICES == 8
+    acc = slices[6][acc & 0xff] ^ slices[5][acc >> 8] ^
+      slices[4][data[2]] ^ slices[3][data[3]] ^
+      slices[2][data[4]] ^ slices[1][data[5]] ^
+      slices[0][data[6]] ^ TABLE_READ(table, data[7]);
+#else /* SLICES == 8 */
+    acc = slices[2][acc & 0xff] ^ slices[1][acc >> 8] ^
+      slices[0][data[2]] ^ TABLE_READ(table, data[3]);
+#endif /* SLICES == 8 */
+    data += SLICES;
+    len -= SLICES;
+  }
+#endif /* SLICES > 1 */
+  while(len-- > 0) {
+    acc = TABLE_ADD(table, *data++, acc);
+  }
+  return acc;
+}
+#endif /* CRC16_METHOD != CRC16_METHOD_BITWISE */
 /*---------------------------------------------------------------------------*/
 unsigned short
 crc16_add(unsigned char b, unsigned short acc)
 {
+#if CRC16_METHOD != CRC16_METHOD_BITWISE
+  return TABLE_ADD(ccitt_table, b, acc);
+#else /* CRC16_METHOD != CRC16_METHOD_BITWISE */
+  /* CITT CRC16 polynomial ^16 + ^12 + ^5 + 1 */
   /*
     acc  = (unsigned char)(acc >> 8) | (acc << 8);
     acc ^= b;
@@ -60,11 +227,19 @@ crc16_add(unsigned char b, unsigned short acc)
   acc ^= (acc >> 8) >> 4;
   acc ^= (acc & 0xff00) >> 5;
   return acc;
+#endif /* CRC16_METHOD != CRC16_METHOD_BITWISE */
 }
 /*---------------------------------------------------------------------------*/
 unsigned short
 crc16_data(const unsigned char *data, int len, unsigned short acc)
 {
+#if CRC16_METHOD != CRC16_METHOD_BITWISE
+#if SLICES > 1
+  return table_data(ccitt_table, ccitt_slices, data, len, acc);
+#else /* SLICES > 1 */
+  return table_data(ccitt_table, NULL, data, len, acc);
+#endif /* SLICES > 1 */
+#else /* CRC16_METHOD != CRC16_METHOD_BITWISE */
   int i;
   
   for(i = 0; i < len; ++i) {
@@ -72,6 +247,44 @@ crc16_data(const unsigned char *data, int len, unsigned short acc)
     ++data;
   }
   return acc;
+#endif /* CRC16_METHOD != CRC16_METHOD_BITWISE */
+}
+/*---------------------------------------------------------------------------*/
+unsigned short
+crc16_modbus_add(unsigned char b, unsigned short acc)
+{
+#if CRC16_METHOD != CRC16_METHOD_BITWISE
+  return TABLE_ADD(modbus_table, b, acc);
+#else /* CRC16_METHOD != CRC16_METHOD_BITWISE */
+  unsigned char i;
+
+  acc ^= b;
+  for(i = 0; i < 8; ++i) {
+    if(acc & 1) {
+      acc = (acc >> 1) ^ 0xa001;
+    } else {
+      acc = acc >> 1;
+    }
+  }
+  return acc;
+#endif /* CRC16_METHOD != CRC16_METHOD_BITWISE */
+}
+/*---------------------------------------------------------------------------*/
+unsigned short
+crc16_modbus_data(const unsigned char *data, int len, unsigned short acc)
+{
+#if CRC16_METHOD != CRC16_METHOD_BITWISE
+#if SLICES > 1
+  return table_data(modbus_table, modbus_slices, data, len, acc);
+#else /* SLICES > 1 */
+  return table_data(modbus_table, NULL, data, len, acc);
+#endif /* SLICES > 1 */
+#else /* CRC16_METHOD != CRC16_METHOD_BITWISE */
+  while(len-- > 0) {
+    acc = crc16_modbus_add(*data++, acc);
+  }
+  return acc;
+#endif /* CRC16_METHOD != CRC16_METHOD_BITWISE */
 }
 /*---------------------------------------------------------------------------*/
 
@@ -55,6 +55,33 @@
 #ifndef CRC16_H_
 #define CRC16_H_
 
+/**
+ * \name CRC16 calculation methods
+ *
+ * CRC16_CONF_METHOD selects how blocks of data are checksummed. The
+ * bitwise method needs no tables and suits the smallest targets. The
+ * table method uses one 512-byte table per polynomial, kept in ROM.
+ * The slice-by-4 and slice-by-8 methods process four or eight bytes
+ * per step and additionally build 3 or 7 tables per polynomial in RAM
+ * on first use. They are meant for 32-bit targets and native gateways.
+ *
+ * On targets where constant data is not read from ROM by default, the
+ * platform can define CRC16_CONF_TABLE_ATTR (e.g. PROGMEM) and
+ * CRC16_CONF_TABLE_READ(table, i) to keep the tables in flash.
+ * @{
+ */
+#define CRC16_METHOD_BITWISE 0
+#define CRC16_METHOD_TABLE   1
+#define CRC16_METHOD_SLICE4  4
+#define CRC16_METHOD_SLICE8  8
+
+#ifdef CRC16_CONF_METHOD
+#define CRC16_METHOD CRC16_CONF_METHOD
+#else /* CRC16_CONF_METHOD */
+#define CRC16_METHOD CRC16_METHOD_BITWISE
+#endif /* CRC16_CONF_METHOD */
+/** @} */
+
 /**
  * \brief      Update an accumulated CRC16 checksum with one byte.
  * \param b    The byte to be added to the checksum
@@ -65,10 +92,10 @@
  *             with one byte. It can be used as a running checksum, or
  *             to checksum an entire data block.
  *
- *             \note The algorithm used in this implementation is
- *             tailored for a running checksum and does not perform as
- *             well as a table-driven algorithm when checksumming an
- *             entire data block.
+ *             \note With the bitwise method, the algorithm is tailored
+ *             for a running checksum and does not perform as well as
+ *             the table-driven methods when checksumming an entire
+ *             data block.
  *
  */
 unsigned short crc16_add(unsigned char b, unsigned short crc);
@@ -82,14 +109,33 @@ unsigned short crc16_add(unsigned char b, unsigned short crc);
  *
  *             This function calculates the CRC16 checksum of a data area.
  *
- *             \note The algorithm used in this implementation is
- *             tailored for a running checksum and does not perform as
- *             well as a table-driven algorithm when checksumming an
- *             entire data block.
+ *             \note See CRC16_CONF_METHOD for faster methods.
  */
 unsigned short crc16_data(const unsigned char *data, int datalen,
 			  unsigned short acc);
 
+/**
+ * \brief      Update an accumulated Modbus CRC16 checksum with one byte.
+ * \param b    The byte to be added to the checksum
+ * \param crc  The accumulated CRC that is to be updated.
+ * \return     The updated CRC checksum.
+ *
+ *             The Modbus CRC16 uses the polynomial x^16 + x^15 + x^2
+ *             + 1 and is normally started with 0xffff. It protects
+ *             the messages exchanged with the AVR sensor boards.
+ */
+unsigned short crc16_modbus_add(unsigned char b, unsigned short crc);
+
+/**
+ * \brief      Calculate the Modbus CRC16 over a data area
+ * \param data Pointer to the data
+ * \param datalen The length of the data
+ * \param acc  The accumulated CRC that is to be updated (or 0xffff).
+ * \return     The CRC16 checksum.
+ */
+unsigned short crc16_modbus_data(const unsigned char *data, int datalen,
+                                 unsigned short acc);
+
 #endif /* CRC16_H_ */
 
 /** @} */
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Header file for the erasure code
+ */
+
+/** \addtogroup lib
+ * @{ */
+
+/**
+ * \defgroup erasure-code Systematic Reed-Solomon erasure code
+ *
+ * A block of k source symbols, all of the same length, is turned into
+ * up to 256 coded symbols, numbered by their index. Symbols 0 to k - 1
+ * are the source symbols themselves, and the others are repair symbols,
+ * linear combinations of the source symbols over GF(2^8) with the
+ * coefficients of a Cauchy matrix. Any k distinct symbols are enough
+ * to recover the block, whichever ones they are.
+ *
+ * The decoder takes symbols one at a time, as they arrive, and keeps
+ * the block in reduced form, so that nothing is left to do once it
+ * has k useful symbols.
+ *
+ * @{
+ */
+
+#ifndef ERASURE_CODE_H_
+#define ERASURE_CODE_H_
+
+#include "contiki-conf.h"
+
+/**
+ * The largest number of source symbols in a block. The decoder keeps
+ * a k * k matrix of coefficients. The default fits the pages of rudolph3.
+ */
+#ifdef ERASURE_CODE_CONF_MAX_K
+#define ERASURE_CODE_MAX_K ERASURE_CODE_CONF_MAX_K
+#else
+#define ERASURE_CODE_MAX_K 8
+#endif
+
+/** The number of distinct symbols of a block */
+#define ERASURE_CODE_SYMBOLS 256
+
+struct erasure_decoder {
+  uint8_t *block;
+  uint16_t symbol_len;
+  uint8_t k;
+  uint8_t rank;
+  /* row i, if used, has its pivot in column i */
+  uint8_t rows[ERASURE_CODE_MAX_K][ERASURE_CODE_MAX_K];
+};
+
+/**
+ * \brief      Coefficient of a source symbol in a coded symbol
+ * \param k    The number of source symbols of the block
+ * \param index The index of the coded symbol
+ * \param i    The index of the source symbol
+ */
+uint8_t erasure_code_coeff(uint8_t k, uint8_t index, uint8_t i);
+
+/**
+ * \brief      Add a multiple of a symbol to another one
+ * \param dst  The symbol to add to
+ * \param src  The symbol to add
+ * \param coeff The multiplier of src
+ * \param len  The length of the symbols
+ *
+ *             A repair symbol can be built one source symbol at a
+ *             time, by adding each one with erasure_code_coeff() to a
+ *             zeroed buffer, without holding the whole block in RAM.
+ */
+void erasure_code_mul_add(uint8_t *dst, const uint8_t *src, uint8_t coeff,
+                          uint16_t len);
+
+/**
+ * \brief      Build a coded symbol of a block held in RAM
+ * \param k    The number of source symbols of the block
+ * \param index The index of the coded symbol
+ * \param block The source symbols, one after the other
+ * \param symbol_len The length of the symbols
+ * \param symbol The buffer for the coded symbol
+ */
+void erasure_code_encode(uint8_t k, uint8_t index, const uint8_t *block,
+                         uint16_t symbol_len, uint8_t *symbol);
+
+/**
+ * \brief      Start decoding a block
+ * \param d    The decoder
+ * \param k    The number of source symbols of the block
+ * \param block Room for the k source symbols, one after the other
+ * \param symbol_len The length of the symbols
+ */
+void erasure_decoder_init(struct erasure_decoder *d, uint8_t k,
+                          uint8_t *block, uint16_t symbol_len);
+
+/**
+ * \brief      Give a coded symbol to the decoder
+ * \param d    The decoder
+ * \param index The index of the symbol
+ * \param symbol The symbol, which is overwritten
+ * \retval 1   The symbol brought new information
+ * \retval 0   The symbol was already known, or the block is complete
+ */
+int erasure_decoder_add(struct erasure_decoder *d, uint8_t index,
+                        uint8_t *symbol);
+
+/** The number of useful symbols still missing from a block */
+#define erasure_decoder_missing(d) ((d)->k - (d)->rank)
+
+#endif /* ERASURE_CODE_H_ */
+
+/** @} */
+/** @} */
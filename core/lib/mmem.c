@@ -139,6 +139,45 @@ mmem_free(struct mmem *m)
   list_remove(mmemlist, m);
 }
 /*---------------------------------------------------------------------------*/
+/**
+ * \brief      Change the size of a managed memory block
+ * \param m    A pointer to the managed memory block
+ * \param size The new size of the memory block
+ * \return     Non-zero if the memory could be resized, zero if memory
+ *             was not available.
+ *
+ *             This function grows or shrinks a memory block that
+ *             previously has been allocated with mmem_alloc(). The
+ *             contents are kept, up to the smaller of the two sizes,
+ *             and the blocks after it are moved to make room or to
+ *             close the gap.
+ *
+ */
+int
+mmem_realloc(struct mmem *m, unsigned int size)
+{
+  struct mmem *n;
+  int diff = (int)size - (int)m->size;
+
+  if(diff > 0 && avail_memory < (unsigned int)diff) {
+    return 0;
+  }
+
+  if(m->next != NULL) {
+    memmove((char *)m->next->ptr + diff, m->next->ptr,
+            &memory[MMEM_SIZE - avail_memory] - (char *)m->next->ptr);
+
+    for(n = m->next; n != NULL; n = n->next) {
+      n->ptr = (void *)((char *)n->ptr + diff);
+    }
+  }
+
+  avail_memory -= diff;
+  m->size = size;
+
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
 /**
  * \brief      Initialize the managed memory module
  * \author     Adam Dunkels
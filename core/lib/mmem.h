@@ -85,6 +85,7 @@ struct mmem {
 
 int  mmem_alloc(struct mmem *m, unsigned int size);
 void mmem_free(struct mmem *);
+int  mmem_realloc(struct mmem *m, unsigned int size);
 void mmem_init(void);
 
 #endif /* MMEM_H_ */
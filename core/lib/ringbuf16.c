@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Single producer, single consumer ring buffer implementation
+ */
+
+#include "lib/ringbuf16.h"
+#include <sys/cc.h>
+#include <string.h>
+
+/*
+ * The data is copied with memcpy(), which the compiler may reorder
+ * with the volatile store of the index that hands it over to the
+ * other side. The barrier keeps the copy on the right side of it.
+ */
+#ifdef __GNUC__
+#define BARRIER() __asm__ __volatile__("" : : : "memory")
+#else
+#define BARRIER()
+#endif
+/*---------------------------------------------------------------------------*/
+void
+ringbuf16_init(struct ringbuf16 *r, uint8_t *data, uint16_t size)
+{
+  r->data = data;
+  r->size = size;
+  r->put_ptr = 0;
+  r->get_ptr = 0;
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+elements(struct ringbuf16 *r, uint16_t put_ptr, uint16_t get_ptr)
+{
+  return put_ptr >= get_ptr ? put_ptr - get_ptr : r->size - get_ptr + put_ptr;
+}
+/*---------------------------------------------------------------------------*/
+int
+ringbuf16_put(struct ringbuf16 *r, uint8_t c)
+{
+  uint16_t next;
+
+  next = r->put_ptr + 1;
+  if(next == r->size) {
+    next = 0;
+  }
+  if(next == CC_ACCESS_NOW(uint16_t, r->get_ptr)) {
+    return 0;
+  }
+  CC_ACCESS_NOW(uint8_t, r->data[r->put_ptr]) = c;
+  CC_ACCESS_NOW(uint16_t, r->put_ptr) = next;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+int
+ringbuf16_get(struct ringbuf16 *r)
+{
+  uint8_t c;
+  uint16_t next;
+
+  if(r->get_ptr == CC_ACCESS_NOW(uint16_t, r->put_ptr)) {
+    return -1;
+  }
+  c = CC_ACCESS_NOW(uint8_t, r->data[r->get_ptr]);
+  next = r->get_ptr + 1;
+  if(next == r->size) {
+    next = 0;
+  }
+  CC_ACCESS_NOW(uint16_t, r->get_ptr) = next;
+  return c;
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+ringbuf16_write(struct ringbuf16 *r, const uint8_t *data, uint16_t len)
+{
+  uint16_t put_ptr, space, n;
+
+  put_ptr = r->put_ptr;
+  space = r->size - 1 - elements(r, put_ptr, CC_ACCESS_NOW(uint16_t, r->get_ptr));
+  if(len > space) {
+    len = space;
+  }
+  BARRIER();
+
+  /* Up to the end of the array, then from its start. */
+  n = r->size - put_ptr;
+  if(n > len) {
+    n = len;
+  }
+  memcpy(r->data + put_ptr, data, n);
+  memcpy(r->data, data + n, len - n);
+
+  put_ptr += len;
+  if(put_ptr >= r->size) {
+    put_ptr -= r->size;
+  }
+  BARRIER();
+  CC_ACCESS_NOW(uint16_t, r->put_ptr) = put_ptr;
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+ringbuf16_read(struct ringbuf16 *r, uint8_t *data, uint16_t len)
+{
+  uint8_t *span;
+  uint16_t n, total;
+
+  /* At most two spans, before and after the end of the array. */
+  total = 0;
+  while(total < len && (n = ringbuf16_peek(r, &span)) > 0) {
+    if(n > len - total) {
+      n = len - total;
+    }
+    memcpy(data + total, span, n);
+    ringbuf16_consume(r, n);
+    total += n;
+  }
+  return total;
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+ringbuf16_peek(struct ringbuf16 *r, uint8_t **span)
+{
+  uint16_t put_ptr;
+
+  put_ptr = CC_ACCESS_NOW(uint16_t, r->put_ptr);
+  BARRIER();
+  *span = r->data + r->get_ptr;
+  return put_ptr >= r->get_ptr ? put_ptr - r->get_ptr : r->size - r->get_ptr;
+}
+/*---------------------------------------------------------------------------*/
+void
+ringbuf16_consume(struct ringbuf16 *r, uint16_t len)
+{
+  uint16_t get_ptr;
+
+  get_ptr = r->get_ptr + len;
+  if(get_ptr >= r->size) {
+    get_ptr -= r->size;
+  }
+  BARRIER();
+  CC_ACCESS_NOW(uint16_t, r->get_ptr) = get_ptr;
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+ringbuf16_elements(struct ringbuf16 *r)
+{
+  return elements(r, CC_ACCESS_NOW(uint16_t, r->put_ptr),
+                  CC_ACCESS_NOW(uint16_t, r->get_ptr));
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+ringbuf16_space(struct ringbuf16 *r)
+{
+  return r->size - 1 - ringbuf16_elements(r);
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Header file for the single producer, single consumer ring buffer
+ */
+
+/** \addtogroup lib
+ * @{ */
+
+/**
+ * \defgroup ringbuf16 Bulk ring buffer library
+ * @{
+ * The bulk ring buffer is a ring buffer of bytes for one producer
+ * and one consumer, typically a UART interrupt handler and the
+ * process that parses its input, with 16-bit sizes.
+ *
+ * Unlike \ref ringbuf it has no restriction on the size, and it can
+ * be written and read in blocks with memcpy(). The consumer can also
+ * work directly on the data in the buffer with ringbuf16_peek() and
+ * ringbuf16_consume().
+ *
+ * Each side only writes its own index, and reads the other one, so
+ * neither side has to disable interrupts. This relies on 16-bit loads
+ * and stores being atomic, as on the MSP430 and ARM. On 8-bit CPUs,
+ * buffers shared with an interrupt handler must be smaller than 256
+ * bytes, so that the high byte of the indices never changes.
+ */
+
+#ifndef RINGBUF16_H_
+#define RINGBUF16_H_
+
+#include "contiki-conf.h"
+
+/**
+ * \brief      Structure that holds the state of a ring buffer.
+ *
+ *             The data is stored in a separate array. One byte of
+ *             it is always left free, so that a full buffer can be
+ *             told from an empty one.
+ */
+struct ringbuf16 {
+  uint8_t *data;
+  uint16_t size;
+
+  /* Written by the producer and the consumer respectively. */
+  uint16_t put_ptr, get_ptr;
+};
+
+/**
+ * \brief      Initialize a ring buffer
+ * \param r    A pointer to a struct ringbuf16 to hold the state of the ring buffer
+ * \param data A pointer to an array to hold the data in the buffer
+ * \param size The size of the array, at least 2 bytes
+ *
+ *             The buffer holds up to size - 1 bytes.
+ */
+void     ringbuf16_init(struct ringbuf16 *r, uint8_t *data, uint16_t size);
+
+/**
+ * \brief      Insert a byte into the ring buffer
+ * \param r    A pointer to a struct ringbuf16
+ * \param c    The byte to be written to the buffer
+ * \return     Non-zero if the byte could be written, or zero if the buffer was full.
+ */
+int      ringbuf16_put(struct ringbuf16 *r, uint8_t c);
+
+/**
+ * \brief      Get a byte from the ring buffer
+ * \param r    A pointer to a struct ringbuf16
+ * \return     The byte, or -1 if the buffer was empty
+ */
+int      ringbuf16_get(struct ringbuf16 *r);
+
+/**
+ * \brief      Insert a block of bytes into the ring buffer
+ * \param r    A pointer to a struct ringbuf16
+ * \param data The bytes to be written
+ * \param len  The number of bytes to be written
+ * \return     The number of bytes written, less than len if the buffer is full.
+ *
+ *             The bytes become visible to the consumer all at once.
+ */
+uint16_t ringbuf16_write(struct ringbuf16 *r, const uint8_t *data, uint16_t len);
+
+/**
+ * \brief      Get a block of bytes from the ring buffer
+ * \param r    A pointer to a struct ringbuf16
+ * \param data The buffer to copy the bytes to
+ * \param len  The maximum number of bytes to get
+ * \return     The number of bytes copied to data.
+ */
+uint16_t ringbuf16_read(struct ringbuf16 *r, uint8_t *data, uint16_t len);
+
+/**
+ * \brief      Get the contiguous bytes at the head of the ring buffer, without removing them
+ * \param r    A pointer to a struct ringbuf16
+ * \param span Set to the first byte in the buffer
+ * \return     The number of contiguous bytes at *span, zero if the buffer is empty.
+ *
+ *             When the data wraps around the end of the array, only
+ *             the bytes up to the end are returned, and the rest is
+ *             returned by the next call after ringbuf16_consume().
+ */
+uint16_t ringbuf16_peek(struct ringbuf16 *r, uint8_t **span);
+
+/**
+ * \brief      Remove bytes from the head of the ring buffer
+ * \param r    A pointer to a struct ringbuf16
+ * \param len  The number of bytes to remove, at most the number of bytes in the buffer
+ */
+void     ringbuf16_consume(struct ringbuf16 *r, uint16_t len);
+
+/**
+ * \brief      Get the number of bytes currently in the ring buffer
+ * \param r    A pointer to a struct ringbuf16
+ * \return     The number of bytes in the buffer.
+ */
+uint16_t ringbuf16_elements(struct ringbuf16 *r);
+
+/**
+ * \brief      Get the number of bytes that can be written to the ring buffer
+ * \param r    A pointer to a struct ringbuf16
+ * \return     The free space in the buffer.
+ */
+uint16_t ringbuf16_space(struct ringbuf16 *r);
+
+#endif /* RINGBUF16_H_ */
+
+/** @}*/
+/** @}*/
@@ -50,6 +50,28 @@
 #define PRINTF(...) do {} while (0)
 #endif
 
+/* seek_read() buffers the file in a few windows, as the relocator
+   reads from several places in turn: the relocation entries, the
+   symbols, their names and the addends. A window holds a symbol name. */
+#ifdef ELFLOADER_CONF_READ_CACHE_SIZE
+#define READ_CACHE_SIZE ELFLOADER_CONF_READ_CACHE_SIZE
+#else
+#define READ_CACHE_SIZE 32
+#endif
+
+#ifdef ELFLOADER_CONF_READ_CACHE_WINDOWS
+#define READ_CACHE_WINDOWS ELFLOADER_CONF_READ_CACHE_WINDOWS
+#else
+#define READ_CACHE_WINDOWS 4
+#endif
+
+/* Number of resolved symbol addresses remembered while relocating. */
+#ifdef ELFLOADER_CONF_SYMBOL_CACHE_SIZE
+#define SYMBOL_CACHE_SIZE ELFLOADER_CONF_SYMBOL_CACHE_SIZE
+#else
+#define SYMBOL_CACHE_SIZE 16
+#endif
+
 #define EI_NIDENT 16
 
 
@@ -137,6 +159,23 @@ struct process * const * elfloader_autostart_processes;
 
 static struct relevant_section bss, data, rodata, text;
 
+#if READ_CACHE_SIZE > 0
+static struct {
+  unsigned int offset;
+  int len;
+  unsigned char used;
+  char buf[READ_CACHE_SIZE];
+} read_cache[READ_CACHE_WINDOWS];
+static unsigned char read_cache_clock;
+#endif /* READ_CACHE_SIZE > 0 */
+
+/* Direct mapped on the symbol index. Index 0 is the undefined symbol,
+   which is never cached. */
+static struct {
+  unsigned int index;
+  char *address;
+} symbol_cache[SYMBOL_CACHE_SIZE];
+
 static const unsigned char elf_magic_header[] =
   {0x7f, 0x45, 0x4c, 0x46,  /* 0x7f, 'E', 'L', 'F' */
    0x01,                    /* Only 32-bit objects. */
@@ -148,8 +187,49 @@ static const unsigned char elf_magic_header[] =
 static void
 seek_read(int fd, unsigned int offset, char *buf, int len)
 {
-  cfs_seek(fd, offset, CFS_SEEK_SET);
-  cfs_read(fd, buf, len);
+#if READ_CACHE_SIZE > 0
+  int i, w, n;
+
+  if(len <= READ_CACHE_SIZE) {
+    /* Look for the window holding the range, or else the least
+       recently used one to refill. */
+    w = 0;
+    for(i = 0; i < READ_CACHE_WINDOWS; i++) {
+      if(offset >= read_cache[i].offset &&
+	 offset + len <= read_cache[i].offset + read_cache[i].len) {
+	w = i;
+	break;
+      }
+      if((unsigned char)(read_cache_clock - read_cache[i].used) >
+	 (unsigned char)(read_cache_clock - read_cache[w].used)) {
+	w = i;
+      }
+    }
+    if(i == READ_CACHE_WINDOWS) {
+      cfs_seek(fd, offset, CFS_SEEK_SET);
+      read_cache[w].len = cfs_read(fd, read_cache[w].buf, READ_CACHE_SIZE);
+      read_cache[w].offset = offset;
+      if(read_cache[w].len < 0) {
+	read_cache[w].len = 0;
+      }
+    }
+    read_cache[w].used = ++read_cache_clock;
+
+    /* Near the end of the file, only what is there is copied, as
+       cfs_read() would do. */
+    n = read_cache[w].offset + read_cache[w].len - offset;
+    if(n > len) {
+      n = len;
+    }
+    if(n > 0) {
+      memcpy(buf, &read_cache[w].buf[offset - read_cache[w].offset], n);
+    }
+  } else
+#endif /* READ_CACHE_SIZE > 0 */
+  {
+    cfs_seek(fd, offset, CFS_SEEK_SET);
+    cfs_read(fd, buf, len);
+  }
 #if DEBUG
   {
     int i;
@@ -163,6 +243,34 @@ seek_read(int fd, unsigned int offset, char *buf, int len)
 #endif /* DEBUG */
 }
 /*---------------------------------------------------------------------------*/
+static void
+invalidate_read(unsigned int offset, int len)
+{
+#if READ_CACHE_SIZE > 0
+  unsigned int end;
+  int i;
+
+  /* Relocations come in the order of their offsets, so the part of a
+     window past the written bytes is kept for the next addends. */
+  for(i = 0; i < READ_CACHE_WINDOWS; i++) {
+    end = read_cache[i].offset + read_cache[i].len;
+    if(offset < end && offset + len > read_cache[i].offset) {
+      if(offset + len < end) {
+	memmove(read_cache[i].buf,
+		&read_cache[i].buf[offset + len - read_cache[i].offset],
+		end - (offset + len));
+	read_cache[i].offset = offset + len;
+	read_cache[i].len = end - (offset + len);
+      } else if(offset > read_cache[i].offset) {
+	read_cache[i].len = offset - read_cache[i].offset;
+      } else {
+	read_cache[i].len = 0;
+      }
+    }
+  }
+#endif /* READ_CACHE_SIZE > 0 */
+}
+/*---------------------------------------------------------------------------*/
 /*
 static void
 seek_write(int fd, unsigned int offset, char *buf, int len)
@@ -172,6 +280,21 @@ seek_write(int fd, unsigned int offset, char *buf, int len)
 }
 */
 /*---------------------------------------------------------------------------*/
+static struct relevant_section *
+find_section(unsigned short shndx)
+{
+  if(shndx == bss.number) {
+    return &bss;
+  } else if(shndx == data.number) {
+    return &data;
+  } else if(shndx == rodata.number) {
+    return &rodata;
+  } else if(shndx == text.number) {
+    return &text;
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
 static void *
 find_local_symbol(int fd, const char *symbol,
 		  unsigned int symtab, unsigned short symtabsize,
@@ -188,15 +311,8 @@ find_local_symbol(int fd, const char *symbol,
     if(s.st_name != 0) {
       seek_read(fd, strtab + s.st_name, name, sizeof(name));
       if(strcmp(name, symbol) == 0) {
-	if(s.st_shndx == bss.number) {
-	  sect = &bss;
-	} else if(s.st_shndx == data.number) {
-	  sect = &data;
-  } else if(s.st_shndx == rodata.number) {
-    sect = &rodata;
-	} else if(s.st_shndx == text.number) {
-	  sect = &text;
-	} else {
+	sect = find_section(s.st_shndx);
+	if(sect == NULL) {
 	  return NULL;
 	}
 	return &(sect->address[s.st_value]);
@@ -213,7 +329,7 @@ relocate_section(int fd,
 		 char *sectionbase,
 		 unsigned int strs,
 		 unsigned int strtab,
-		 unsigned int symtab, unsigned short symtabsize,
+		 unsigned int symtab,
 		 unsigned char using_relas)
 {
   /* sectionbase added; runtime start address of current section */
@@ -221,6 +337,7 @@ relocate_section(int fd,
   int rel_size = 0;
   struct elf32_sym s;
   unsigned int a;
+  unsigned int symbol;
   char name[30];
   char *addr;
   struct relevant_section *sect;
@@ -234,50 +351,43 @@ relocate_section(int fd,
   
   for(a = section; a < section + size; a += rel_size) {
     seek_read(fd, a, (char *)&rela, rel_size);
-    seek_read(fd,
-	      symtab + sizeof(struct elf32_sym) * ELF32_R_SYM(rela.r_info),
-	      (char *)&s, sizeof(s));
-    if(s.st_name != 0) {
-      seek_read(fd, strtab + s.st_name, name, sizeof(name));
-      PRINTF("name: %s\n", name);
-      addr = (char *)symtab_lookup(name);
-      /* ADDED */
-      if(addr == NULL) {
-	PRINTF("name not found in global: %s\n", name);
-	addr = find_local_symbol(fd, name, symtab, symtabsize, strtab);
-	PRINTF("found address %p\n", addr);
-      }
-      if(addr == NULL) {
-	if(s.st_shndx == bss.number) {
-	  sect = &bss;
-	} else if(s.st_shndx == data.number) {
-	  sect = &data;
-	} else if(s.st_shndx == rodata.number) {
-	  sect = &rodata;
-	} else if(s.st_shndx == text.number) {
-	  sect = &text;
-	} else {
-	  PRINTF("elfloader unknown name: '%30s'\n", name);
-	  memcpy(elfloader_unknown, name, sizeof(elfloader_unknown));
-	  elfloader_unknown[sizeof(elfloader_unknown) - 1] = 0;
-	  return ELFLOADER_SYMBOL_NOT_FOUND;
+    symbol = ELF32_R_SYM(rela.r_info);
+
+    if(symbol != 0 &&
+       symbol_cache[symbol % SYMBOL_CACHE_SIZE].index == symbol) {
+      addr = symbol_cache[symbol % SYMBOL_CACHE_SIZE].address;
+    } else {
+      seek_read(fd, symtab + sizeof(struct elf32_sym) * symbol,
+		(char *)&s, sizeof(s));
+      sect = find_section(s.st_shndx);
+      if(s.st_name != 0) {
+	seek_read(fd, strtab + s.st_name, name, sizeof(name));
+	PRINTF("name: %s\n", name);
+	addr = (char *)symtab_lookup(name);
+	if(addr == NULL) {
+	  PRINTF("name not found in global: %s\n", name);
+	  if(sect == NULL) {
+	    PRINTF("elfloader unknown name: '%30s'\n", name);
+	    memcpy(elfloader_unknown, name, sizeof(elfloader_unknown));
+	    elfloader_unknown[sizeof(elfloader_unknown) - 1] = 0;
+	    return ELFLOADER_SYMBOL_NOT_FOUND;
+	  }
+	  /* A symbol defined in the module: its entry already tells
+	     where it is, no need to search the symbol table by name. */
+	  addr = &sect->address[s.st_value];
+	  PRINTF("found address %p\n", addr);
+	}
+      } else {
+	if(sect == NULL) {
+	  return ELFLOADER_SEGMENT_NOT_FOUND;
 	}
 	addr = sect->address;
       }
-    } else {
-      if(s.st_shndx == bss.number) {
-	sect = &bss;
-      } else if(s.st_shndx == data.number) {
-	sect = &data;
-      } else if(s.st_shndx == rodata.number) {
-	sect = &rodata;
-      } else if(s.st_shndx == text.number) {
-	sect = &text;
-      } else {
-	return ELFLOADER_SEGMENT_NOT_FOUND;
+
+      if(symbol != 0) {
+	symbol_cache[symbol % SYMBOL_CACHE_SIZE].index = symbol;
+	symbol_cache[symbol % SYMBOL_CACHE_SIZE].address = addr;
       }
-      
-      addr = sect->address;
     }
 
     if(!using_relas) {
@@ -286,6 +396,8 @@ relocate_section(int fd,
     }
 
     elfloader_arch_relocate(fd, sectionaddr, sectionbase, &rela, addr);
+    /* Some architectures write the relocated address back to the file. */
+    invalidate_read(sectionaddr + rela.r_offset, 4);
   }
   return ELFLOADER_OK;
 }
@@ -362,6 +474,11 @@ elfloader_load(int fd)
 
   elfloader_unknown[0] = 0;
 
+#if READ_CACHE_SIZE > 0
+  memset(read_cache, 0, sizeof(read_cache));
+#endif /* READ_CACHE_SIZE > 0 */
+  memset(symbol_cache, 0, sizeof(symbol_cache));
+
   /* The ELF header is located at the start of the buffer. */
   seek_read(fd, 0, (char *)&ehdr, sizeof(ehdr));
 
@@ -438,7 +555,10 @@ elfloader_load(int fd)
       PRINTF("symtab\n");
       symtaboff = shdr.sh_offset;
       symtabsize = shdr.sh_size;
-    } else if(shdr.sh_type == SHT_STRTAB/*strncmp(name, ".strtab", 7) == 0*/) {
+    } else if(shdr.sh_type == SHT_STRTAB/*strncmp(name, ".strtab", 7) == 0*/ &&
+	      i != ehdr.e_shstrndx) {
+      /* Newer linkers put the section name table last, so it must not
+	 be mistaken for the symbol name table. */
       PRINTF("strtab\n");
       strtaboff = shdr.sh_offset;
       strtabsize = shdr.sh_size;
@@ -527,7 +647,7 @@ elfloader_load(int fd)
 			   text.address,
 			   strs,
 			   strtaboff,
-			   symtaboff, symtabsize, using_relas);
+			   symtaboff, using_relas);
     if(ret != ELFLOADER_OK) {
       return ret;
     }
@@ -542,7 +662,7 @@ elfloader_load(int fd)
 			   rodata.address,
 			   strs,
 			   strtaboff,
-			   symtaboff, symtabsize, using_relas);
+			   symtaboff, using_relas);
     if(ret != ELFLOADER_OK) {
       PRINTF("elfloader: data failed\n");
       return ret;
@@ -558,7 +678,7 @@ elfloader_load(int fd)
 			   data.address,
 			   strs,
 			   strtaboff,
-			   symtaboff, symtabsize, using_relas);
+			   symtaboff, using_relas);
     if(ret != ELFLOADER_OK) {
       PRINTF("elfloader: data failed\n");
       return ret;
@@ -37,10 +37,35 @@
 
 #define MAX_PATHLEN 80
 #define MAX_HOSTLEN 40
+
+/* States of a socket */
+#define STATE_CLOSED  0 /* no connection to reuse */
+#define STATE_REQUEST 1 /* waiting for the response header */
+#define STATE_BODY    2
+#define STATE_IDLE    3 /* response done, connection kept open */
+#define STATE_RETRY   4 /* waiting to reconnect after a drop */
+
+/* Flags of the current response */
+#define FLAG_CHUNKED   0x01
+#define FLAG_KEEPALIVE 0x02
+#define FLAG_CHANGED   0x04 /* ETag differs from the first response */
+#define FLAG_EXTRA     0x08 /* bytes after the end of the body */
+#define FLAG_RESUMING  0x10 /* the first response has been received */
+#define FLAG_NORESUME  0x20 /* its ETag can not be used to resume */
+
+/* States of the chunked transfer-coding decoder */
+#define CHUNK_SIZE     0
+#define CHUNK_EXT      1
+#define CHUNK_DATA     2
+#define CHUNK_DATA_END 3
+#define CHUNK_TRAILER  4
+#define CHUNK_DONE     5
+
 PROCESS(http_socket_process, "HTTP socket process");
 LIST(socketlist);
 
 static void removesocket(struct http_socket *s);
+static void dropped(struct http_socket *s, http_socket_event_t e);
 /*---------------------------------------------------------------------------*/
 static void
 call_callback(struct http_socket *s, http_socket_event_t e,
@@ -58,15 +83,52 @@ parse_header_init(struct http_socket *s)
   PT_INIT(&s->headerpt);
 }
 /*---------------------------------------------------------------------------*/
+static void
+parse_header_value(struct http_socket *s)
+{
+  if(!strcmp(s->header_field, "etag")) {
+    if(!(s->flags & FLAG_RESUMING)) {
+      /* A weak ETag can not be used in If-Range, and a long one can not
+         be compared. Resuming without either could join the rest of a
+         changed resource to what has been received. */
+      if(s->header_chars > HTTP_SOCKET_ETAGLEN || s->header_value[0] == 'W') {
+        s->flags |= FLAG_NORESUME;
+      } else {
+        strcpy(s->etag, s->header_value);
+      }
+    } else if(s->header_chars > HTTP_SOCKET_ETAGLEN ||
+              strcmp(s->etag, s->header_value) != 0) {
+      s->flags |= FLAG_CHANGED;
+    }
+  } else if(!strcmp(s->header_field, "transfer-encoding")) {
+    if(!strcmp(s->header_value, "chunked")) {
+      s->flags |= FLAG_CHUNKED;
+    }
+  } else if(!strcmp(s->header_field, "connection")) {
+    if(!strcmp(s->header_value, "close")) {
+      s->flags &= ~FLAG_KEEPALIVE;
+    } else if(!strcmp(s->header_value, "keep-alive")) {
+      s->flags |= FLAG_KEEPALIVE;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
 static int
 parse_header_byte(struct http_socket *s, char c)
 {
   PT_BEGIN(&s->headerpt);
 
   memset(&s->header, -1, sizeof(s->header));
+  s->flags &= FLAG_RESUMING | FLAG_NORESUME;
 
-  /* Skip the HTTP response */
+  /* Skip the HTTP response. HTTP/1.1 servers keep the connection open
+     unless they say otherwise. */
   while(c != ' ') {
+    if(c == '1') {
+      s->flags |= FLAG_KEEPALIVE;
+    } else {
+      s->flags &= ~FLAG_KEEPALIVE;
+    }
     PT_YIELD(&s->headerpt);
   }
 
@@ -79,201 +141,343 @@ parse_header_byte(struct http_socket *s, char c)
     PT_YIELD(&s->headerpt);
   }
 
-  if(s->header.status_code == 0x200 || s->header.status_code == 0x206) {
-    /* Read headers until data */
-
-    while(1) {
-      /* Skip characters until end of line */
-      do {
-        while(c != '\r') {
-          s->header_chars++;
-          PT_YIELD(&s->headerpt);
-        }
-        s->header_chars++;
-        PT_YIELD(&s->headerpt);
-      } while(c != '\n');
-      s->header_chars--;
+  /* Read headers until data */
+  while(1) {
+    /* Skip characters until end of line */
+    while(c != '\n') {
       PT_YIELD(&s->headerpt);
+    }
+    PT_YIELD(&s->headerpt);
 
-      if(s->header_chars == 0) {
-        /* This was an empty line, i.e. the end of headers */
-        break;
+    if(c == '\r' || c == '\n') {
+      /* This is an empty line, i.e. the end of headers. The body
+         starts after its '\n'. */
+      while(c != '\n') {
+        PT_YIELD(&s->headerpt);
       }
+      break;
+    }
 
-      /* Start of line */
-      s->header_chars = 0;
-
-      /* Read header field */
-      while(c != ' ' && c != '\t' && c != ':' && c != '\r' &&
-            s->header_chars < sizeof(s->header_field) - 1) {
-        s->header_field[s->header_chars++] = c;
-        PT_YIELD(&s->headerpt);
+    /* Read header field, field names are case-insensitive */
+    s->header_chars = 0;
+    while(c != ' ' && c != '\t' && c != ':' && c != '\r' && c != '\n') {
+      if(s->header_chars < sizeof(s->header_field) - 1) {
+        s->header_field[s->header_chars] = tolower((int)c);
       }
-      s->header_field[s->header_chars] = '\0';
+      s->header_chars++;
+      PT_YIELD(&s->headerpt);
+    }
+    /* Ignore fields too long for the buffer */
+    s->header_field[s->header_chars < sizeof(s->header_field) ?
+                    s->header_chars : 0] = '\0';
+    /* Skip linear white spaces */
+    while(c == ' ' || c == '\t') {
+      PT_YIELD(&s->headerpt);
+    }
+    if(c == ':') {
+      /* Skip the colon */
+      PT_YIELD(&s->headerpt);
       /* Skip linear white spaces */
       while(c == ' ' || c == '\t') {
-        s->header_chars++;
         PT_YIELD(&s->headerpt);
       }
-      if(c == ':') {
-        /* Skip the colon */
-        s->header_chars++;
-        PT_YIELD(&s->headerpt);
+      if(!strcmp(s->header_field, "content-length")) {
+        s->header.content_length = 0;
+        while(isdigit((int)c)) {
+          s->header.content_length = s->header.content_length * 10 + c - '0';
+          PT_YIELD(&s->headerpt);
+        }
+      } else if(!strcmp(s->header_field, "content-range")) {
+        /* Skip the bytes-unit token */
+        while(c != ' ' && c != '\t' && c != '\r' && c != '\n') {
+          PT_YIELD(&s->headerpt);
+        }
         /* Skip linear white spaces */
         while(c == ' ' || c == '\t') {
-          s->header_chars++;
           PT_YIELD(&s->headerpt);
         }
-        if(!strcmp(s->header_field, "Content-Length")) {
-          s->header.content_length = 0;
-          while(isdigit((int)c)) {
-            s->header.content_length = s->header.content_length * 10 + c - '0';
-            s->header_chars++;
-            PT_YIELD(&s->headerpt);
-          }
-        } else if(!strcmp(s->header_field, "Content-Range")) {
-          /* Skip the bytes-unit token */
-          while(c != ' ' && c != '\t') {
-            s->header_chars++;
-            PT_YIELD(&s->headerpt);
-          }
+        s->header.content_range.first_byte_pos = 0;
+        while(isdigit((int)c)) {
+          s->header.content_range.first_byte_pos =
+            s->header.content_range.first_byte_pos * 10 + c - '0';
+          PT_YIELD(&s->headerpt);
+        }
+        /* Skip linear white spaces */
+        while(c == ' ' || c == '\t') {
+          PT_YIELD(&s->headerpt);
+        }
+        if(c == '-') {
+          /* Skip the dash */
+          PT_YIELD(&s->headerpt);
           /* Skip linear white spaces */
           while(c == ' ' || c == '\t') {
-            s->header_chars++;
             PT_YIELD(&s->headerpt);
           }
-          s->header.content_range.first_byte_pos = 0;
+          s->header.content_range.last_byte_pos = 0;
           while(isdigit((int)c)) {
-            s->header.content_range.first_byte_pos =
-              s->header.content_range.first_byte_pos * 10 + c - '0';
-            s->header_chars++;
+            s->header.content_range.last_byte_pos =
+              s->header.content_range.last_byte_pos * 10 + c - '0';
             PT_YIELD(&s->headerpt);
           }
           /* Skip linear white spaces */
           while(c == ' ' || c == '\t') {
-            s->header_chars++;
             PT_YIELD(&s->headerpt);
           }
-          if(c == '-') {
-            /* Skip the dash */
-            s->header_chars++;
+          if(c == '/') {
+            /* Skip the slash */
             PT_YIELD(&s->headerpt);
             /* Skip linear white spaces */
             while(c == ' ' || c == '\t') {
-              s->header_chars++;
-              PT_YIELD(&s->headerpt);
-            }
-            s->header.content_range.last_byte_pos = 0;
-            while(isdigit((int)c)) {
-              s->header.content_range.last_byte_pos =
-                s->header.content_range.last_byte_pos * 10 + c - '0';
-              s->header_chars++;
-              PT_YIELD(&s->headerpt);
-            }
-            /* Skip linear white spaces */
-            while(c == ' ' || c == '\t') {
-              s->header_chars++;
               PT_YIELD(&s->headerpt);
             }
-            if(c == '/') {
-              /* Skip the slash */
-              s->header_chars++;
-              PT_YIELD(&s->headerpt);
-              /* Skip linear white spaces */
-              while(c == ' ' || c == '\t') {
-                s->header_chars++;
+            if(c != '*') {
+              s->header.content_range.instance_length = 0;
+              while(isdigit((int)c)) {
+                s->header.content_range.instance_length =
+                  s->header.content_range.instance_length * 10 + c - '0';
                 PT_YIELD(&s->headerpt);
               }
-              if(c != '*') {
-                s->header.content_range.instance_length = 0;
-                while(isdigit((int)c)) {
-                  s->header.content_range.instance_length =
-                    s->header.content_range.instance_length * 10 + c - '0';
-                  s->header_chars++;
-                  PT_YIELD(&s->headerpt);
-                }
-              }
             }
           }
         }
+      } else if(!strcmp(s->header_field, "etag") ||
+                !strcmp(s->header_field, "transfer-encoding") ||
+                !strcmp(s->header_field, "connection")) {
+        /* ETags are compared as they are, the other values are
+           case-insensitive */
+        s->header_chars = 0;
+        while(c != '\r' && c != '\n') {
+          if(s->header_chars < sizeof(s->header_value) - 1) {
+            s->header_value[s->header_chars] =
+              s->header_field[0] == 'e' ? c : tolower((int)c);
+          }
+          s->header_chars++;
+          PT_YIELD(&s->headerpt);
+        }
+        s->header_value[s->header_chars < sizeof(s->header_value) ?
+                        s->header_chars : 0] = '\0';
+        /* header_chars tells parse_header_value() if it was too long */
+        parse_header_value(s);
       }
     }
+  }
 
-    /* All headers read, now read data */
-    call_callback(s, HTTP_SOCKET_HEADER, (void *)&s->header, sizeof(s->header));
+  PT_END(&s->headerpt);
+}
+/*---------------------------------------------------------------------------*/
+static void
+start_timer(struct http_socket *s, clock_time_t interval)
+{
+  PROCESS_CONTEXT_BEGIN(&http_socket_process);
+  etimer_set(&s->timeout_timer, interval);
+  PROCESS_CONTEXT_END(&http_socket_process);
+  s->timeout_timer_started = 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+fail(struct http_socket *s, http_socket_event_t e)
+{
+  s->state = STATE_CLOSED;
+  tcp_socket_close(&s->s);
+  removesocket(s);
+  call_callback(s, e, (void *)&s->header, sizeof(s->header));
+}
+/*---------------------------------------------------------------------------*/
+static int
+start_body(struct http_socket *s)
+{
+  int64_t start;
 
-    /* Should exit the pt here to indicate that all headers have been
-       read */
-    PT_EXIT(&s->headerpt);
-  } else {
+  if(s->header.status_code != 0x200 && s->header.status_code != 0x206) {
     if(s->header.status_code == 0x404) {
       printf("File not found\n");
     } else if(s->header.status_code == 0x301 || s->header.status_code == 0x302) {
       printf("File moved (not handled)\n");
     }
+    fail(s, HTTP_SOCKET_ERR);
+    return 0;
+  }
 
-    call_callback(s, HTTP_SOCKET_ERR, (void *)&s->header, sizeof(s->header));
-    tcp_socket_close(&s->s);
-    removesocket(s);
-    PT_EXIT(&s->headerpt);
+  if(!(s->flags & FLAG_RESUMING)) {
+    /* Remember what part of the resource the body is, to ask for the
+       rest of it if the connection drops */
+    s->flags |= FLAG_RESUMING;
+    if(s->header.status_code == 0x206) {
+      s->range_start = s->header.content_range.first_byte_pos;
+      s->range_end = s->header.content_range.last_byte_pos;
+    } else {
+      s->range_start = 0;
+      s->range_end = -1;
+    }
+    s->total = s->header.content_length;
+    call_callback(s, HTTP_SOCKET_HEADER, (void *)&s->header, sizeof(s->header));
+  } else {
+    /* A resumed request, skip what the callback has already got */
+    start = s->range_start + s->received;
+    if(s->flags & FLAG_CHANGED) {
+      printf("Resource changed, not resumed\n");
+      fail(s, HTTP_SOCKET_ERR);
+      return 0;
+    } else if(s->header.status_code == 0x200) {
+      s->skip = start;
+    } else if(s->header.content_range.first_byte_pos >= 0 &&
+              s->header.content_range.first_byte_pos <= start) {
+      s->skip = start - s->header.content_range.first_byte_pos;
+    } else {
+      fail(s, HTTP_SOCKET_ERR);
+      return 0;
+    }
   }
 
+  s->state = STATE_BODY;
+  s->bodylen = 0;
+  s->chunk_state = CHUNK_SIZE;
+  s->chunk_left = 0;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+body_data(struct http_socket *s, const uint8_t *data, int len)
+{
+  int n;
 
-  PT_END(&s->headerpt);
+  s->bodylen += len;
+  if(s->skip > 0) {
+    n = s->skip < len ? s->skip : len;
+    data += n;
+    len -= n;
+    s->skip -= n;
+  }
+  if(s->total >= 0 && s->received + len > s->total) {
+    len = s->total - s->received;
+  }
+  if(len > 0) {
+    s->received += len;
+    s->retries = 0;
+    call_callback(s, HTTP_SOCKET_DATA, data, len);
+  }
 }
 /*---------------------------------------------------------------------------*/
 static int
-input_pt(struct http_socket *s,
-         const uint8_t *inputptr, int inputdatalen)
+hexdigit(char c)
 {
-  int i;
-  PT_BEGIN(&s->pt);
-
-  /* Parse the header */
-  s->header_received = 0;
-  do {
-    for(i = 0; i < inputdatalen; i++) {
-      if(!PT_SCHEDULE(parse_header_byte(s, inputptr[i]))) {
-        s->header_received = 1;
-        break;
-      }
-    }
-    inputdatalen -= i;
-    inputptr += i;
+  if(c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  c = tolower((int)c);
+  if(c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  return -1;
+}
+/*---------------------------------------------------------------------------*/
+/* Decode the chunked transfer-coding, passing the chunk data on */
+static void
+chunk_input(struct http_socket *s, const uint8_t *data, int len)
+{
+  int i, n;
+  char c;
 
-    if(s->header_received == 0) {
-      /* If we have not yet received the full header, we wait for the
-         next packet to arrive. */
-      PT_YIELD(&s->pt);
+  for(i = 0; i < len;) {
+    if(s->chunk_state == CHUNK_DATA) {
+      n = len - i < s->chunk_left ? len - i : s->chunk_left;
+      body_data(s, &data[i], n);
+      i += n;
+      s->chunk_left -= n;
+      if(s->chunk_left == 0) {
+        s->chunk_state = CHUNK_DATA_END;
+      }
+      continue;
     }
-  } while(s->header_received == 0);
 
-  s->bodylen = 0;
-  do {
-    /* Receive the data */
-    call_callback(s, HTTP_SOCKET_DATA, inputptr, inputdatalen);
-
-    /* Close the connection if the expected content length has been received */
-    if(s->header.content_length >= 0 && s->bodylen < s->header.content_length) {
-      s->bodylen += inputdatalen;
-      if(s->bodylen >= s->header.content_length) {
-        tcp_socket_close(&s->s);
+    c = data[i++];
+    switch(s->chunk_state) {
+    case CHUNK_SIZE:
+      if(hexdigit(c) >= 0) {
+        s->chunk_left = s->chunk_left << 4 | hexdigit(c);
+        break;
+      }
+      s->chunk_state = CHUNK_EXT;
+      /* Fall through */
+    case CHUNK_EXT:
+      /* Skip chunk extensions until the end of the size line */
+      if(c == '\n') {
+        s->chunk_state = s->chunk_left > 0 ? CHUNK_DATA : CHUNK_TRAILER;
+        s->header_chars = 0;
+      }
+      break;
+    case CHUNK_DATA_END:
+      if(c == '\n') {
+        s->chunk_state = CHUNK_SIZE;
+      }
+      break;
+    case CHUNK_TRAILER:
+      /* Skip trailer fields until an empty line */
+      if(c == '\n') {
+        if(s->header_chars == 0) {
+          s->chunk_state = CHUNK_DONE;
+        }
+        s->header_chars = 0;
+      } else if(c != '\r') {
+        s->header_chars++;
       }
+      break;
+    default:
+      s->flags |= FLAG_EXTRA;
+      return;
     }
-
-    PT_YIELD(&s->pt);
-  } while(inputdatalen > 0);
-
-  PT_END(&s->pt);
+  }
 }
 /*---------------------------------------------------------------------------*/
 static void
-start_timeout_timer(struct http_socket *s)
+body_input(struct http_socket *s, const uint8_t *data, int len)
 {
-  PROCESS_CONTEXT_BEGIN(&http_socket_process);
-  etimer_set(&s->timeout_timer, HTTP_SOCKET_TIMEOUT);
-  PROCESS_CONTEXT_END(&http_socket_process);
-  s->timeout_timer_started = 1;
+  if(s->flags & FLAG_CHUNKED) {
+    chunk_input(s, data, len);
+  } else {
+    if(s->header.content_length >= 0 &&
+       s->bodylen + len > s->header.content_length) {
+      len = s->header.content_length - s->bodylen;
+      s->flags |= FLAG_EXTRA;
+    }
+    body_data(s, data, len);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+body_complete(struct http_socket *s)
+{
+  if(s->total >= 0) {
+    return s->received >= s->total;
+  } else if(s->flags & FLAG_CHUNKED) {
+    return s->chunk_state == CHUNK_DONE;
+  }
+  return s->header.content_length >= 0 &&
+    s->bodylen >= s->header.content_length;
+}
+/*---------------------------------------------------------------------------*/
+static void
+body_done(struct http_socket *s)
+{
+  int reuse;
+
+  /* The connection can only take another request if the response
+     ended where its framing says it does */
+  reuse = HTTP_SOCKET_KEEPALIVE && (s->flags & FLAG_KEEPALIVE) &&
+    !(s->flags & FLAG_EXTRA) &&
+    ((s->flags & FLAG_CHUNKED) ? s->chunk_state == CHUNK_DONE :
+     s->bodylen == s->header.content_length);
+
+  if(reuse) {
+    s->state = STATE_IDLE;
+    start_timer(s, HTTP_SOCKET_IDLE_TIMEOUT);
+  } else {
+    s->state = STATE_CLOSED;
+    tcp_socket_close(&s->s);
+    removesocket(s);
+  }
+  /* The callback may start the next request */
+  call_callback(s, HTTP_SOCKET_CLOSED, NULL, 0);
 }
 /*---------------------------------------------------------------------------*/
 static int
@@ -281,9 +485,34 @@ input(struct tcp_socket *tcps, void *ptr,
       const uint8_t *inputptr, int inputdatalen)
 {
   struct http_socket *s = ptr;
+  int i, done;
+
+  if(s->state == STATE_REQUEST) {
+    /* Parse the header */
+    done = 0;
+    for(i = 0; i < inputdatalen && !done; i++) {
+      done = !PT_SCHEDULE(parse_header_byte(s, inputptr[i]));
+    }
+    inputptr += i;
+    inputdatalen -= i;
+    if(done && !start_body(s)) {
+      return 0;
+    }
+  }
+
+  if(s->state == STATE_BODY) {
+    if(inputdatalen > 0) {
+      body_input(s, inputptr, inputdatalen);
+    }
+    if(body_complete(s)) {
+      body_done(s);
+      return 0;
+    }
+  }
 
-  input_pt(s, inputptr, inputdatalen);
-  start_timeout_timer(s);
+  if(s->state == STATE_REQUEST || s->state == STATE_BODY) {
+    start_timer(s, HTTP_SOCKET_TIMEOUT);
+  }
 
   return 0; /* all data consumed */
 }
@@ -394,83 +623,132 @@ removesocket(struct http_socket *s)
 }
 /*---------------------------------------------------------------------------*/
 static void
-event(struct tcp_socket *tcps, void *ptr,
-      tcp_socket_event_t e)
+send_request(struct http_socket *s)
 {
-  struct http_socket *s = ptr;
+  struct tcp_socket *tcps = &s->s;
   char host[MAX_HOSTLEN];
   char path[MAX_PATHLEN];
   uint16_t port;
   char str[42];
   int len;
 
-  if(e == TCP_SOCKET_CONNECTED) {
-    printf("Connected\n");
-    if(parse_url(s->url, host, &port, path)) {
-      tcp_socket_send_str(tcps, s->postdata != NULL ? "POST " : "GET ");
-      if(s->proxy_port != 0) {
-        /* If we are configured to route through a proxy, we should
-           provide the full URL as the path. */
-        tcp_socket_send_str(tcps, s->url);
-      } else {
-        tcp_socket_send_str(tcps, path);
-      }
-      tcp_socket_send_str(tcps, " HTTP/1.1\r\n");
+  if(parse_url(s->url, host, &port, path)) {
+    tcp_socket_send_str(tcps, s->postdata != NULL ? "POST " : "GET ");
+    if(s->proxy_port != 0) {
+      /* If we are configured to route through a proxy, we should
+         provide the full URL as the path. */
+      tcp_socket_send_str(tcps, s->url);
+    } else {
+      tcp_socket_send_str(tcps, path);
+    }
+    tcp_socket_send_str(tcps, " HTTP/1.1\r\n");
+    if(!HTTP_SOCKET_KEEPALIVE) {
       tcp_socket_send_str(tcps, "Connection: close\r\n");
-      tcp_socket_send_str(tcps, "Host: ");
-      /* If we have IPv6 host, add the '[' and the ']' characters
-         to the host. As in rfc2732. */
-      if(memchr(host, ':', MAX_HOSTLEN)) {
-        tcp_socket_send_str(tcps, "[");
+    }
+    tcp_socket_send_str(tcps, "Host: ");
+    /* If we have IPv6 host, add the '[' and the ']' characters
+       to the host. As in rfc2732. */
+    if(memchr(host, ':', MAX_HOSTLEN)) {
+      tcp_socket_send_str(tcps, "[");
+    }
+    tcp_socket_send_str(tcps, host);
+    if(memchr(host, ':', MAX_HOSTLEN)) {
+      tcp_socket_send_str(tcps, "]");
+    }
+    tcp_socket_send_str(tcps, "\r\n");
+    if(s->postdata != NULL) {
+      if(s->content_type) {
+        tcp_socket_send_str(tcps, "Content-Type: ");
+        tcp_socket_send_str(tcps, s->content_type);
+        tcp_socket_send_str(tcps, "\r\n");
       }
-      tcp_socket_send_str(tcps, host);
-      if(memchr(host, ':', MAX_HOSTLEN)) {
-        tcp_socket_send_str(tcps, "]");
+      tcp_socket_send_str(tcps, "Content-Length: ");
+      sprintf(str, "%u", s->postdatalen);
+      tcp_socket_send_str(tcps, str);
+      tcp_socket_send_str(tcps, "\r\n");
+    } else if(s->flags & FLAG_RESUMING) {
+      /* Ask for the rest of the part of the resource in the first
+         response, if it is still the same */
+      tcp_socket_send_str(tcps, "Range: bytes=");
+      if(s->range_end >= 0) {
+        sprintf(str, "%llu-%llu",
+                (unsigned long long)(s->range_start + s->received),
+                (unsigned long long)s->range_end);
+      } else {
+        sprintf(str, "%llu-",
+                (unsigned long long)(s->range_start + s->received));
       }
+      tcp_socket_send_str(tcps, str);
       tcp_socket_send_str(tcps, "\r\n");
-      if(s->postdata != NULL) {
-        if(s->content_type) {
-          tcp_socket_send_str(tcps, "Content-Type: ");
-          tcp_socket_send_str(tcps, s->content_type);
-          tcp_socket_send_str(tcps, "\r\n");
-        }
-        tcp_socket_send_str(tcps, "Content-Length: ");
-        sprintf(str, "%u", s->postdatalen);
-        tcp_socket_send_str(tcps, str);
+      if(s->etag[0] != '\0') {
+        tcp_socket_send_str(tcps, "If-Range: ");
+        tcp_socket_send_str(tcps, s->etag);
         tcp_socket_send_str(tcps, "\r\n");
-      } else if(s->length || s->pos > 0) {
-        tcp_socket_send_str(tcps, "Range: bytes=");
-        if(s->length) {
-          if(s->pos >= 0) {
-            sprintf(str, "%llu-%llu", s->pos, s->pos + s->length - 1);
-          } else {
-            sprintf(str, "-%llu", s->length);
-          }
+      }
+    } else if(s->length || s->pos > 0) {
+      tcp_socket_send_str(tcps, "Range: bytes=");
+      if(s->length) {
+        if(s->pos >= 0) {
+          sprintf(str, "%llu-%llu", (unsigned long long)s->pos,
+                  (unsigned long long)(s->pos + s->length - 1));
         } else {
-          sprintf(str, "%llu-", s->pos);
+          sprintf(str, "-%llu", (unsigned long long)s->length);
         }
-        tcp_socket_send_str(tcps, str);
-        tcp_socket_send_str(tcps, "\r\n");
+      } else {
+        sprintf(str, "%llu-", (unsigned long long)s->pos);
       }
+      tcp_socket_send_str(tcps, str);
       tcp_socket_send_str(tcps, "\r\n");
-      if(s->postdata != NULL && s->postdatalen) {
-        len = tcp_socket_send(tcps, s->postdata, s->postdatalen);
-        s->postdata += len;
-        s->postdatalen -= len;
-      }
     }
-    parse_header_init(s);
-  } else if(e == TCP_SOCKET_CLOSED) {
-    call_callback(s, HTTP_SOCKET_CLOSED, NULL, 0);
+    tcp_socket_send_str(tcps, "\r\n");
+    if(s->postdata != NULL && s->postdatalen) {
+      len = tcp_socket_send(tcps, s->postdata, s->postdatalen);
+      s->postdata += len;
+      s->postdatalen -= len;
+    }
+  }
+  parse_header_init(s);
+}
+/*---------------------------------------------------------------------------*/
+static void
+event(struct tcp_socket *tcps, void *ptr,
+      tcp_socket_event_t e)
+{
+  struct http_socket *s = ptr;
+  int len;
+
+  if(e == TCP_SOCKET_CONNECTED) {
+    printf("Connected\n");
+    send_request(s);
+  } else if(s->state == STATE_IDLE &&
+            (e == TCP_SOCKET_CLOSED || e == TCP_SOCKET_TIMEDOUT ||
+             e == TCP_SOCKET_ABORTED)) {
+    /* The server closed the idle connection, the callback has already
+       had the end of the response */
+    s->state = STATE_CLOSED;
     removesocket(s);
+  } else if(s->state != STATE_REQUEST && s->state != STATE_BODY) {
+    /* Events of a connection that is being closed */
+  } else if(e == TCP_SOCKET_CLOSED) {
+    if(s->state == STATE_BODY && !(s->flags & FLAG_CHUNKED) &&
+       s->header.content_length < 0 && s->total < 0) {
+      /* The end of a body without a length is the end of the
+         connection */
+      s->state = STATE_CLOSED;
+      removesocket(s);
+      call_callback(s, HTTP_SOCKET_CLOSED, NULL, 0);
+    } else {
+      dropped(s, HTTP_SOCKET_CLOSED);
+    }
     printf("Closed\n");
   } else if(e == TCP_SOCKET_TIMEDOUT) {
-    call_callback(s, HTTP_SOCKET_TIMEDOUT, NULL, 0);
-    removesocket(s);
+    /* uIP has already let go of the connection */
+    tcps->c = NULL;
+    dropped(s, HTTP_SOCKET_TIMEDOUT);
     printf("Timedout\n");
   } else if(e == TCP_SOCKET_ABORTED) {
-    call_callback(s, HTTP_SOCKET_ABORTED, NULL, 0);
-    removesocket(s);
+    tcps->c = NULL;
+    dropped(s, HTTP_SOCKET_ABORTED);
     printf("Aborted\n");
   } else if(e == TCP_SOCKET_DATA_SENT) {
     if(s->postdata != NULL && s->postdatalen) {
@@ -478,7 +756,7 @@ event(struct tcp_socket *tcps, void *ptr,
       s->postdata += len;
       s->postdatalen -= len;
     } else {
-      start_timeout_timer(s);
+      start_timer(s, HTTP_SOCKET_TIMEOUT);
     }
   }
 }
@@ -534,6 +812,50 @@ start_request(struct http_socket *s)
   }
 }
 /*---------------------------------------------------------------------------*/
+static void
+dropped(struct http_socket *s, http_socket_event_t e)
+{
+  /* Only a GET can be repeated. The rest of the body is asked for on a
+     new connection after a delay, doubled after every attempt that
+     did not get any data. */
+  if((s->flags & FLAG_RESUMING) && (s->flags & FLAG_NORESUME)) {
+    printf("Resource can not be resumed\n");
+    e = HTTP_SOCKET_ERR;
+  } else if(s->postdata == NULL && s->retries < HTTP_SOCKET_RETRIES) {
+    s->state = STATE_RETRY;
+    start_timer(s, HTTP_SOCKET_RETRY_DELAY << s->retries);
+    s->retries++;
+    printf("Retrying\n");
+    return;
+  }
+  s->state = STATE_CLOSED;
+  removesocket(s);
+  call_callback(s, e, NULL, 0);
+}
+/*---------------------------------------------------------------------------*/
+static void
+register_socket(struct http_socket *s)
+{
+  tcp_socket_register(&s->s, s,
+                      s->inputbuf, sizeof(s->inputbuf),
+                      s->outputbuf, sizeof(s->outputbuf),
+                      input, event);
+}
+/*---------------------------------------------------------------------------*/
+static void
+retry_request(struct http_socket *s)
+{
+  s->state = STATE_REQUEST;
+  s->did_tcp_connect = 0;
+  /* Throw away what is left of the dropped connection */
+  register_socket(s);
+  if(start_request(s) == HTTP_SOCKET_ERR) {
+    s->state = STATE_CLOSED;
+    removesocket(s);
+    call_callback(s, HTTP_SOCKET_ERR, NULL, 0);
+  }
+}
+/*---------------------------------------------------------------------------*/
 PROCESS_THREAD(http_socket_process, ev, data)
 {
   PROCESS_BEGIN();
@@ -553,7 +875,7 @@ PROCESS_THREAD(http_socket_process, ev, data)
           s != NULL;
           s = list_item_next(s)) {
         char host[MAX_HOSTLEN];
-        if(s->did_tcp_connect) {
+        if(s->did_tcp_connect || s->state != STATE_REQUEST) {
           /* We already connected, ignored */
         } else if(parse_url(s->url, host, NULL, NULL) &&
             strcmp(name, host) == 0) {
@@ -571,15 +893,26 @@ PROCESS_THREAD(http_socket_process, ev, data)
       struct http_socket *s;
       struct etimer *timeout_timer = data;
       /*
-       * A socket time-out has occurred. We need to go through the list of HTTP
-       * sockets and figure out to which socket this timer event corresponds,
-       * then close this socket.
+       * A socket timer has expired. We need to go through the list of
+       * HTTP sockets and figure out to which socket this timer event
+       * corresponds, then reconnect, close an idle connection, or give
+       * up on a connection that has stopped sending.
        */
       for(s = list_head(socketlist);
           s != NULL;
           s = list_item_next(s)) {
         if(timeout_timer == &s->timeout_timer && s->timeout_timer_started) {
-          tcp_socket_close(&s->s);
+          s->timeout_timer_started = 0;
+          if(s->state == STATE_RETRY) {
+            retry_request(s);
+          } else if(s->state == STATE_IDLE) {
+            s->state = STATE_CLOSED;
+            tcp_socket_close(&s->s);
+            removesocket(s);
+          } else {
+            tcp_socket_close(&s->s);
+            dropped(s, HTTP_SOCKET_TIMEDOUT);
+          }
           break;
         }
       }
@@ -616,11 +949,42 @@ initialize_socket(struct http_socket *s)
   s->postdata = NULL;
   s->postdatalen = 0;
   s->timeout_timer_started = 0;
-  PT_INIT(&s->pt);
-  tcp_socket_register(&s->s, s,
-                      s->inputbuf, sizeof(s->inputbuf),
-                      s->outputbuf, sizeof(s->outputbuf),
-                      input, event);
+  s->state = STATE_REQUEST;
+  s->flags = 0;
+  s->retries = 0;
+  s->received = 0;
+  s->skip = 0;
+  s->etag[0] = '\0';
+  register_socket(s);
+}
+/*---------------------------------------------------------------------------*/
+/* Is the socket connected to the server of url, and idle */
+static int
+can_reuse(struct http_socket *s, const char *url)
+{
+  char host[MAX_HOSTLEN], newhost[MAX_HOSTLEN];
+  uint16_t port, newport;
+
+  return s->state == STATE_IDLE && s->s.c != NULL &&
+    parse_url(s->url, host, &port, NULL) &&
+    parse_url(url, newhost, &newport, NULL) &&
+    port == newport && strcmp(host, newhost) == 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+send_or_start_request(struct http_socket *s, int reuse)
+{
+  s->did_tcp_connect = 0;
+
+  list_add(socketlist, s);
+
+  if(reuse) {
+    send_request(s);
+    tcpip_poll_tcp(s->s.c);
+    start_timer(s, HTTP_SOCKET_TIMEOUT);
+    return HTTP_SOCKET_OK;
+  }
+  return start_request(s);
 }
 /*---------------------------------------------------------------------------*/
 int
@@ -631,6 +995,8 @@ http_socket_get(struct http_socket *s,
                 http_socket_callback_t callback,
                 void *callbackptr)
 {
+  int reuse = can_reuse(s, url);
+
   initialize_socket(s);
   strncpy(s->url, url, sizeof(s->url));
   s->pos = pos;
@@ -638,11 +1004,7 @@ http_socket_get(struct http_socket *s,
   s->callback = callback;
   s->callbackptr = callbackptr;
 
-  s->did_tcp_connect = 0;
-
-  list_add(socketlist, s);
-
-  return start_request(s);
+  return send_or_start_request(s, reuse);
 }
 /*---------------------------------------------------------------------------*/
 int
@@ -654,6 +1016,8 @@ http_socket_post(struct http_socket *s,
                  http_socket_callback_t callback,
                  void *callbackptr)
 {
+  int reuse = can_reuse(s, url);
+
   initialize_socket(s);
   strncpy(s->url, url, sizeof(s->url));
   s->postdata = postdata;
@@ -663,11 +1027,7 @@ http_socket_post(struct http_socket *s,
   s->callback = callback;
   s->callbackptr = callbackptr;
 
-  s->did_tcp_connect = 0;
-
-  list_add(socketlist, s);
-
-  return start_request(s);
+  return send_or_start_request(s, reuse);
 }
 /*---------------------------------------------------------------------------*/
 int
@@ -678,6 +1038,7 @@ http_socket_close(struct http_socket *socket)
       s != NULL;
       s = list_item_next(s)) {
     if(s == socket) {
+      s->state = STATE_CLOSED;
       tcp_socket_close(&s->s);
       removesocket(s);
       return 1;
@@ -71,6 +71,43 @@ typedef void (* http_socket_callback_t)(struct http_socket *s,
 
 #define HTTP_SOCKET_TIMEOUT       ((2 * 60 + 30) * CLOCK_SECOND)
 
+/* Attempts to resume a GET after the connection drops, without
+   receiving any data in between */
+#ifdef HTTP_SOCKET_CONF_RETRIES
+#define HTTP_SOCKET_RETRIES HTTP_SOCKET_CONF_RETRIES
+#else
+#define HTTP_SOCKET_RETRIES 4
+#endif
+
+/* Delay before the first attempt, doubled for every further one */
+#ifdef HTTP_SOCKET_CONF_RETRY_DELAY
+#define HTTP_SOCKET_RETRY_DELAY HTTP_SOCKET_CONF_RETRY_DELAY
+#else
+#define HTTP_SOCKET_RETRY_DELAY CLOCK_SECOND
+#endif
+
+/* Keep the connection open after a response, for the next request to
+   the same server */
+#ifdef HTTP_SOCKET_CONF_KEEPALIVE
+#define HTTP_SOCKET_KEEPALIVE HTTP_SOCKET_CONF_KEEPALIVE
+#else
+#define HTTP_SOCKET_KEEPALIVE 1
+#endif
+
+#ifdef HTTP_SOCKET_CONF_IDLE_TIMEOUT
+#define HTTP_SOCKET_IDLE_TIMEOUT HTTP_SOCKET_CONF_IDLE_TIMEOUT
+#else
+#define HTTP_SOCKET_IDLE_TIMEOUT (10 * CLOCK_SECOND)
+#endif
+
+/* Longest ETag that is kept to resume a GET with If-Range, with the
+   quotes. A download with a longer or a weak ETag is not resumed. */
+#ifdef HTTP_SOCKET_CONF_ETAGLEN
+#define HTTP_SOCKET_ETAGLEN HTTP_SOCKET_CONF_ETAGLEN
+#else
+#define HTTP_SOCKET_ETAGLEN 64
+#endif
+
 struct http_socket {
   struct http_socket *next;
   struct tcp_socket s;
@@ -89,17 +126,46 @@ struct http_socket {
 
   struct etimer timeout_timer;
   uint8_t timeout_timer_started;
-  struct pt pt, headerpt;
+  struct pt headerpt;
   int header_chars;
-  char header_field[15];
+  char header_field[18];
+  char header_value[HTTP_SOCKET_ETAGLEN + 1];
   struct http_socket_header header;
-  uint8_t header_received;
   uint64_t bodylen;
   const char *content_type;
+
+  uint8_t state;
+  uint8_t flags;
+  uint8_t retries;
+  uint8_t chunk_state;
+  uint32_t chunk_left;
+  /* the part of the resource the first response holds, for resuming */
+  int64_t range_start;
+  int64_t range_end;
+  int64_t total;
+  /* body bytes passed to the callback, and to skip in the response */
+  uint64_t received;
+  uint64_t skip;
+  char etag[HTTP_SOCKET_ETAGLEN + 1];
 };
 
 void http_socket_init(struct http_socket *s);
 
+/*
+ * GET the length bytes of url from pos, or the whole resource if
+ * length is 0. A negative pos asks for the last length bytes.
+ *
+ * If the connection drops, the rest of the body is asked for with a
+ * Range request on a new connection, and the callback sees a single
+ * HTTP_SOCKET_HEADER and an unbroken stream of HTTP_SOCKET_DATA. The
+ * end of the body is signalled with HTTP_SOCKET_CLOSED. A request to
+ * the same server issued after that, even from the callback, reuses
+ * the connection if the server keeps it open.
+ *
+ * A resource whose ETag is weak or longer than HTTP_SOCKET_ETAGLEN can
+ * not be checked for changes, so a drop in its body ends the download
+ * with HTTP_SOCKET_ERR, and the caller has to start over from pos.
+ */
 int http_socket_get(struct http_socket *s, const char *url,
                     int64_t pos, uint64_t length,
                     http_socket_callback_t callback,
@@ -55,6 +55,37 @@ call_event(struct tcp_socket *s, tcp_socket_event_t event)
   }
 }
 /*---------------------------------------------------------------------------*/
+#if UIP_TCP_SEND_WINDOW > 1
+/* With a send window, uIP keeps its own copy of the data in flight, so
+   each call sends the next unsent part of the output buffer. */
+static void
+senddata(struct tcp_socket *s)
+{
+  int len = MIN(s->output_data_max_seg, uip_sendable());
+
+  if(s->output_senddata_len > s->output_data_send_nxt && len > 0) {
+    len = MIN(s->output_senddata_len - s->output_data_send_nxt, len);
+    uip_send(&s->output_data_ptr[s->output_data_send_nxt], len);
+    s->output_data_send_nxt += len;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+acked(struct tcp_socket *s)
+{
+  uint16_t len = MIN(uip_acked_len(), s->output_data_send_nxt);
+
+  if(len > 0) {
+    memmove(&s->output_data_ptr[0], &s->output_data_ptr[len],
+            s->output_data_len - len);
+    s->output_data_len -= len;
+    s->output_senddata_len = s->output_data_len;
+    s->output_data_send_nxt -= len;
+
+    call_event(s, TCP_SOCKET_DATA_SENT);
+  }
+}
+#else /* UIP_TCP_SEND_WINDOW > 1 */
 static void
 senddata(struct tcp_socket *s)
 {
@@ -96,6 +127,7 @@ acked(struct tcp_socket *s)
     call_event(s, TCP_SOCKET_DATA_SENT);
   }
 }
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 /*---------------------------------------------------------------------------*/
 static void
 newdata(struct tcp_socket *s)
@@ -175,6 +207,8 @@ appcall(void *state)
     if(s == NULL) {
       uip_abort();
     } else {
+      /* Nothing has been sent on this connection yet */
+      s->output_data_send_nxt = 0;
       if(uip_newdata()) {
         newdata(s);
       }
@@ -352,9 +386,17 @@ tcp_socket_send(struct tcp_socket *s,
   memcpy(&s->output_data_ptr[s->output_data_len], data, len);
   s->output_data_len += len;
 
+#if UIP_TCP_SEND_WINDOW > 1
+  s->output_senddata_len = s->output_data_len;
+  if(s->c != NULL && len > 0) {
+    /* Start filling the send window right away. */
+    tcpip_poll_tcp(s->c);
+  }
+#else /* UIP_TCP_SEND_WINDOW > 1 */
   if(s->output_senddata_len == 0) {
     s->output_senddata_len = s->output_data_len;
   }
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 
   return len;
 }
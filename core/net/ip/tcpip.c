@@ -187,6 +187,24 @@ check_for_tcp_syn(void)
 #endif /* UIP_TCP || UIP_CONF_IP_FORWARD */
 }
 /*---------------------------------------------------------------------------*/
+#if UIP_TCP && UIP_TCP_SEND_WINDOW > 1
+/* uIP sends at most one segment per call, so a connection that just
+   queued a segment is polled again until its send window is full. */
+static void
+poll_send_window(void)
+{
+  if(uip_conn != NULL && uip_conn->queued) {
+    uip_conn->queued = 0;
+    if(uip_tcp_sendable(uip_conn)) {
+      tcpip_poll_tcp(uip_conn);
+    }
+  }
+}
+#define POLL_SEND_WINDOW() poll_send_window()
+#else /* UIP_TCP && UIP_TCP_SEND_WINDOW > 1 */
+#define POLL_SEND_WINDOW()
+#endif /* UIP_TCP && UIP_TCP_SEND_WINDOW > 1 */
+/*---------------------------------------------------------------------------*/
 static void
 packet_input(void)
 {
@@ -214,6 +232,7 @@ packet_input(void)
       tcpip_output();
 #endif /* NETSTACK_CONF_WITH_IPV6 */
 #endif /* UIP_CONF_TCP_SPLIT */
+      POLL_SEND_WINDOW();
     }
   }
 }
@@ -406,7 +425,7 @@ eventhandler(process_event_t ev, process_data_t data)
       for(cptr = &uip_udp_conns[0];
           cptr < &uip_udp_conns[UIP_UDP_CONNS]; ++cptr) {
         if(cptr->appstate.p == p) {
-          cptr->lport = 0;
+          uip_udp_remove(cptr);
         }
       }
     }
@@ -436,6 +455,7 @@ eventhandler(process_event_t ev, process_data_t data)
             PRINTF("tcpip_output after periodic len %d\n", uip_len);
           }
 #endif /* NETSTACK_CONF_WITH_IPV6 */
+          POLL_SEND_WINDOW();
         }
       }
 #endif /* UIP_TCP */
@@ -492,6 +512,7 @@ eventhandler(process_event_t ev, process_data_t data)
         tcpip_output();
       }
 #endif /* NETSTACK_CONF_WITH_IPV6 */
+      POLL_SEND_WINDOW();
       /* Start the periodic polling, if it isn't already active. */
       start_periodic_tcp_timer();
     }
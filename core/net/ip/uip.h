@@ -749,6 +749,37 @@ CCIF void uip_send(const void *data, int len);
  */
 #define uip_acked()   (uip_flags & UIP_ACKDATA)
 
+#if UIP_TCP_SEND_WINDOW > 1
+/**
+ * The number of bytes acknowledged by the incoming segment.
+ *
+ * Only valid when uip_acked() is non-zero. With a send window, an
+ * acknowledgement may cover several segments or only part of one.
+ *
+ * \hideinitializer
+ */
+#define uip_acked_len() (uip_conn->acklen)
+
+/**
+ * The number of bytes the application may send right now.
+ *
+ * With a send window, the application may be polled while data is
+ * still unacknowledged, and should only call uip_send() with new data
+ * when this is non-zero.
+ *
+ * \hideinitializer
+ */
+#define uip_sendable() uip_tcp_sendable(uip_conn)
+
+/**
+ * \internal
+ *
+ * Check how many bytes a connection may send, given its send window,
+ * the window of the peer and the free retransmission buffers.
+ */
+uint16_t uip_tcp_sendable(struct uip_conn *conn);
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
+
 /**
  * Has the connection just been connected?
  *
@@ -874,7 +905,11 @@ struct uip_udp_conn *uip_udp_new(const uip_ipaddr_t *ripaddr, uint16_t rport);
  *
  * \hideinitializer
  */
+#if UIP_DEMUX_HASH_SIZE > 0
+#define uip_udp_remove(conn) uip_udp_bind_port(conn, 0)
+#else /* UIP_DEMUX_HASH_SIZE > 0 */
 #define uip_udp_remove(conn) (conn)->lport = 0
+#endif /* UIP_DEMUX_HASH_SIZE > 0 */
 
 /**
  * Bind a UDP connection to a local port.
@@ -886,7 +921,27 @@ struct uip_udp_conn *uip_udp_new(const uip_ipaddr_t *ripaddr, uint16_t rport);
  *
  * \hideinitializer
  */
+#if UIP_DEMUX_HASH_SIZE > 0
+#define uip_udp_bind(conn, port) uip_udp_bind_port(conn, port)
+#else /* UIP_DEMUX_HASH_SIZE > 0 */
 #define uip_udp_bind(conn, port) (conn)->lport = port
+#endif /* UIP_DEMUX_HASH_SIZE > 0 */
+
+/**
+ * Change the local port of a UDP connection and update the
+ * demultiplexing index.
+ *
+ * Used by uip_udp_bind() and uip_udp_remove() when
+ * UIP_CONF_DEMUX_HASH_SIZE is set. Code that changes the lport field
+ * of a connection must go through these macros.
+ *
+ * \param conn A pointer to the uip_udp_conn structure for the
+ * connection.
+ *
+ * \param port The local port number, in network byte order, or 0 to
+ * free the connection.
+ */
+void uip_udp_bind_port(struct uip_udp_conn *conn, uint16_t port);
 
 /**
  * Send a UDP datagram of length len on the current connection.
@@ -1370,6 +1425,14 @@ struct uip_conn {
   uint8_t timer;         /**< The retransmission timer. */
   uint8_t nrtx;          /**< The number of retransmissions for the last
                               segment sent. */
+#if UIP_TCP_SEND_WINDOW > 1
+  struct uip_tcp_seg *rexmit; /**< Unacknowledged segments, oldest first. */
+  uint16_t sndwnd;       /**< The window last advertised by the peer. */
+  uint16_t acklen;       /**< Bytes acknowledged by the last incoming segment. */
+  uint8_t nsegs;         /**< Number of segments in the retransmission buffer. */
+  uint8_t dupacks;       /**< Number of duplicate ACKs received in a row. */
+  uint8_t queued;        /**< Set when a new segment has been queued. */
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 
   uip_tcp_appstate_t appstate; /** The application state. */
 };
@@ -365,6 +365,29 @@ void uip_log(char *msg);
 #define UIP_UDP_CONNS    10
 #endif /* UIP_CONF_UDP_CONNS */
 
+/**
+ * The number of buckets in the port-keyed index used to demultiplex
+ * incoming UDP datagrams and TCP segments.
+ *
+ * With the default of 0, uIP scans the whole uip_udp_conns[] and
+ * uip_conns[] tables for every packet. A non-zero value lets uIP look
+ * up connections by their local port instead, which pays off on
+ * border routers and gateways with many connections. The index costs
+ * one byte per bucket and two bytes per connection for each protocol.
+ * Only the IPv6 stack supports the index.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_DEMUX_HASH_SIZE
+#define UIP_DEMUX_HASH_SIZE (UIP_CONF_DEMUX_HASH_SIZE)
+#else /* UIP_CONF_DEMUX_HASH_SIZE */
+#define UIP_DEMUX_HASH_SIZE 0
+#endif /* UIP_CONF_DEMUX_HASH_SIZE */
+
+#if UIP_DEMUX_HASH_SIZE > 0 && !NETSTACK_CONF_WITH_IPV6
+#error UIP_CONF_DEMUX_HASH_SIZE is only supported by the IPv6 stack
+#endif /* UIP_DEMUX_HASH_SIZE > 0 && !NETSTACK_CONF_WITH_IPV6 */
+
 /**
  * The name of the function that should be called when UDP datagrams arrive.
  *
@@ -500,6 +523,54 @@ void uip_log(char *msg);
 #define UIP_RECEIVE_WINDOW (UIP_CONF_RECEIVE_WINDOW)
 #endif
 
+/**
+ * The number of TCP segments a connection may have in flight.
+ *
+ * With the default of 1, uIP uses stop-and-wait and asks the
+ * application to regenerate data on retransmissions. With a larger
+ * window, unacknowledged segments are copied into a retransmission
+ * buffer drawn from a pool shared by all connections, and uIP
+ * retransmits them on its own. The application then no longer sees
+ * uip_rexmit() events, and must only send new data when uip_sendable()
+ * is non-zero. Only the IPv6 stack supports send windows.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_SEND_WINDOW
+#define UIP_TCP_SEND_WINDOW (UIP_CONF_TCP_SEND_WINDOW)
+#else /* UIP_CONF_TCP_SEND_WINDOW */
+#define UIP_TCP_SEND_WINDOW 1
+#endif /* UIP_CONF_TCP_SEND_WINDOW */
+
+#if UIP_TCP_SEND_WINDOW > 1 && !NETSTACK_CONF_WITH_IPV6
+#error UIP_CONF_TCP_SEND_WINDOW is only supported by the IPv6 stack
+#endif /* UIP_TCP_SEND_WINDOW > 1 && !NETSTACK_CONF_WITH_IPV6 */
+
+/**
+ * The number of segment buffers shared by all TCP connections for
+ * retransmissions. Each buffer holds UIP_TCP_MSS bytes.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_SEGMENT_POOL
+#define UIP_TCP_SEGMENT_POOL (UIP_CONF_TCP_SEGMENT_POOL)
+#else /* UIP_CONF_TCP_SEGMENT_POOL */
+#define UIP_TCP_SEGMENT_POOL (UIP_TCP_SEND_WINDOW)
+#endif /* UIP_CONF_TCP_SEGMENT_POOL */
+
+/**
+ * The number of duplicate ACKs after which the oldest unacknowledged
+ * segment is retransmitted without waiting for the retransmission
+ * timer.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_DUPACK_THRESHOLD
+#define UIP_TCP_DUPACK_THRESHOLD (UIP_CONF_TCP_DUPACK_THRESHOLD)
+#else /* UIP_CONF_TCP_DUPACK_THRESHOLD */
+#define UIP_TCP_DUPACK_THRESHOLD 3
+#endif /* UIP_CONF_TCP_DUPACK_THRESHOLD */
+
 /**
  * How long a connection should stay in the TIME_WAIT state.
  *
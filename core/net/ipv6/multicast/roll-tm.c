@@ -195,6 +195,8 @@ struct trickle_param {
 /*---------------------------------------------------------------------------*/
 /* Sliding Windows */
 struct sliding_window {
+  struct sliding_window *next;  /* Next window in the same hash bucket */
+  struct mcast_packet *packets; /* Buffered messages of this window */
   seed_id_t seed_id;
   int16_t lower_bound;          /* lolipop */
   int16_t upper_bound;          /* lolipop */
@@ -225,7 +227,6 @@ struct sliding_window {
  * w: pointer to a sliding window
  */
 #define SLIDING_WINDOW_IS_USED_CLR(w) ((w)->flags &= ~SLIDING_WINDOW_U_BIT)
-#define window_free(w) SLIDING_WINDOW_IS_USED_CLR(w)
 
 /**
  * \brief Set 'Is Seen' bit for window w
@@ -266,6 +267,8 @@ struct sliding_window {
 /*---------------------------------------------------------------------------*/
 /* Multicast Packet Buffers */
 struct mcast_packet {
+  struct mcast_packet *next;    /* Next packet in the same hash bucket, or free */
+  struct mcast_packet *sw_next; /* Next packet of the same window */
 #if ROLL_TM_SHORT_SEEDS
   /* Short seeds are stored inside the message */
   seed_id_t seed_id;
@@ -443,6 +446,22 @@ static struct roll_tm_stats stats;
 static struct trickle_param t[2];
 static struct sliding_window windows[ROLL_TM_WINS];
 static struct mcast_packet buffered_msgs[ROLL_TM_BUFF_NUM];
+
+/*
+ * Used windows hashed by Seed ID and M, buffered messages hashed by window
+ * and sequence value, so that the lookups for every incoming datagram and
+ * every advertised sequence value do not scan the whole buffer
+ */
+#if ROLL_TM_HASH_SIZE == 0 || (ROLL_TM_HASH_SIZE & (ROLL_TM_HASH_SIZE - 1))
+#error "ROLL_TM_HASH_SIZE must be a power of two"
+#endif
+#if ROLL_TM_HASH_SIZE > 256
+#error "ROLL_TM_HASH_SIZE must be at most 256"
+#endif
+#define HASH_MASK (ROLL_TM_HASH_SIZE - 1)
+static struct sliding_window *window_table[ROLL_TM_HASH_SIZE];
+static struct mcast_packet *packet_table[ROLL_TM_HASH_SIZE];
+static struct mcast_packet *free_packets;
 /*---------------------------------------------------------------------------*/
 /* Temporary Stores */
 /*---------------------------------------------------------------------------*/
@@ -471,6 +490,8 @@ extern uint16_t uip_slen;
 static void icmp_input(void);
 static void icmp_output(void);
 static void window_update_bounds(void);
+static void window_free(struct sliding_window *);
+static void packet_free(struct mcast_packet *);
 static void reset_trickle_timer(uint8_t);
 static void handle_timer(void *);
 /*---------------------------------------------------------------------------*/
@@ -614,7 +635,7 @@ handle_timer(void *ptr)
           PRINTF("\n");
           window_free(locmpptr->sw);
         }
-        MCAST_PACKET_FREE(locmpptr);
+        packet_free(locmpptr);
       } else if(MCAST_PACKET_TTL(locmpptr) > 0) {
         /* Handle multicast transmissions */
         if(locmpptr->active < TRICKLE_ACTIVE(param) &&
@@ -689,6 +710,7 @@ window_allocate()
       iterswptr--) {
     if(!SLIDING_WINDOW_IS_USED(iterswptr)) {
       iterswptr->count = 0;
+      iterswptr->packets = NULL;
       iterswptr->lower_bound = -1;
       iterswptr->upper_bound = -1;
       iterswptr->min_listed = -1;
@@ -698,11 +720,48 @@ window_allocate()
   return NULL;
 }
 /*---------------------------------------------------------------------------*/
+static uint8_t
+seed_hash(const seed_id_t *s, uint8_t m)
+{
+  const uint8_t *p = (const uint8_t *)s;
+  uint8_t h = m;
+  uint8_t i;
+
+  for(i = 0; i < sizeof(seed_id_t); i++) {
+    h = (uint8_t)((h << 1) | (h >> 7)) ^ p[i];
+  }
+  return h & HASH_MASK;
+}
+/*---------------------------------------------------------------------------*/
+static void
+window_insert(struct sliding_window *w)
+{
+  uint8_t h = seed_hash(&w->seed_id, SLIDING_WINDOW_GET_M(w));
+
+  w->next = window_table[h];
+  window_table[h] = w;
+}
+/*---------------------------------------------------------------------------*/
+static void
+window_free(struct sliding_window *w)
+{
+  struct sliding_window **wp;
+
+  for(wp = &window_table[seed_hash(&w->seed_id, SLIDING_WINDOW_GET_M(w))];
+      *wp != NULL; wp = &(*wp)->next) {
+    if(*wp == w) {
+      *wp = w->next;
+      break;
+    }
+  }
+  SLIDING_WINDOW_IS_USED_CLR(w);
+}
+/*---------------------------------------------------------------------------*/
 static struct sliding_window *
 window_lookup(seed_id_t *s, uint8_t m)
 {
-  for(iterswptr = &windows[ROLL_TM_WINS - 1]; iterswptr >= windows;
-      iterswptr--) {
+  for(iterswptr = window_table[seed_hash(s, m)]; iterswptr != NULL;
+      iterswptr = iterswptr->next) {
     VERBOSE_PRINTF("ROLL TM: M=%u (%u) ", SLIDING_WINDOW_GET_M(iterswptr), m);
     VERBOSE_PRINT_SEED(&iterswptr->seed_id);
     VERBOSE_PRINTF("\n");
@@ -714,31 +773,94 @@ window_lookup(seed_id_t *s, uint8_t m)
   return NULL;
 }
 /*---------------------------------------------------------------------------*/
+#define packet_hash(w, seq) \
+  ((uint8_t)(((w) - windows) * 7 + (seq)) & HASH_MASK)
+
+static struct mcast_packet *
+packet_lookup(struct sliding_window *w, uint16_t seq_val)
+{
+  struct mcast_packet *p;
+
+  for(p = packet_table[packet_hash(w, seq_val)]; p != NULL; p = p->next) {
+    if(p->sw == w && SEQ_VAL_IS_EQ(p->seq_val, seq_val)) {
+      return p;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+packet_insert(struct mcast_packet *p)
+{
+  uint8_t h = packet_hash(p->sw, p->seq_val);
+
+  p->next = packet_table[h];
+  packet_table[h] = p;
+  p->sw_next = p->sw->packets;
+  p->sw->packets = p;
+}
+/*---------------------------------------------------------------------------*/
+static void
+packet_free(struct mcast_packet *p)
+{
+  struct mcast_packet **pp;
+
+  for(pp = &packet_table[packet_hash(p->sw, p->seq_val)]; *pp != NULL;
+      pp = &(*pp)->next) {
+    if(*pp == p) {
+      *pp = p->next;
+      break;
+    }
+  }
+  for(pp = &p->sw->packets; *pp != NULL; pp = &(*pp)->sw_next) {
+    if(*pp == p) {
+      *pp = p->sw_next;
+      break;
+    }
+  }
+
+  MCAST_PACKET_FREE(p);
+  p->next = free_packets;
+  free_packets = p;
+}
+/*---------------------------------------------------------------------------*/
+static void
+window_bounds(struct sliding_window *w)
+{
+  w->lower_bound = -1;
+
+  for(locmpptr = w->packets; locmpptr != NULL; locmpptr = locmpptr->sw_next) {
+    VERBOSE_PRINTF("ROLL TM: Update Bounds: [%d - %d] vs %u\n",
+                   w->lower_bound, w->upper_bound, locmpptr->seq_val);
+    if(w->lower_bound < 0
+       || SEQ_VAL_IS_LT(locmpptr->seq_val, w->lower_bound)) {
+      w->lower_bound = locmpptr->seq_val;
+    }
+    if(w->upper_bound < 0 ||
+       SEQ_VAL_IS_GT(locmpptr->seq_val, w->upper_bound)) {
+      w->upper_bound = locmpptr->seq_val;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
 static void
 window_update_bounds()
 {
   for(iterswptr = &windows[ROLL_TM_WINS - 1]; iterswptr >= windows;
       iterswptr--) {
-    iterswptr->lower_bound = -1;
+    window_bounds(iterswptr);
   }
+}
+/*---------------------------------------------------------------------------*/
+static struct mcast_packet *
+buffer_allocate()
+{
+  struct mcast_packet *p = free_packets;
 
-  for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-      locmpptr >= buffered_msgs; locmpptr--) {
-    if(MCAST_PACKET_IS_USED(locmpptr)) {
-      iterswptr = locmpptr->sw;
-      VERBOSE_PRINTF("ROLL TM: Update Bounds: [%d - %d] vs %u\n",
-                     iterswptr->lower_bound, iterswptr->upper_bound,
-                     locmpptr->seq_val);
-      if(iterswptr->lower_bound < 0
-         || SEQ_VAL_IS_LT(locmpptr->seq_val, iterswptr->lower_bound)) {
-        iterswptr->lower_bound = locmpptr->seq_val;
-      }
-      if(iterswptr->upper_bound < 0 ||
-         SEQ_VAL_IS_GT(locmpptr->seq_val, iterswptr->upper_bound)) {
-        iterswptr->upper_bound = locmpptr->seq_val;
-      }
-    }
+  if(p != NULL) {
+    free_packets = p->next;
   }
+  return p;
 }
 /*---------------------------------------------------------------------------*/
 static struct mcast_packet *
@@ -764,35 +886,20 @@ buffer_reclaim()
   PRINTF(" M=%u, count was %u\n",
          SLIDING_WINDOW_GET_M(largest), largest->count);
   /* Find the packet at the lowest bound for the largest window */
-  for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-      locmpptr >= buffered_msgs; locmpptr--) {
-    if(MCAST_PACKET_IS_USED(locmpptr) && (locmpptr->sw == largest) &&
-       SEQ_VAL_IS_EQ(locmpptr->seq_val, largest->lower_bound)) {
-      rv = locmpptr;
-      PRINTF("ROLL TM: Reclaim seq. val %u\n", locmpptr->seq_val);
-      MCAST_PACKET_FREE(rv);
-      largest->count--;
-      window_update_bounds();
-      VERBOSE_PRINTF("ROLL TM: Reclaim - new bounds [%u , %u]\n",
-                     largest->lower_bound, largest->upper_bound);
-      return rv;
-    }
+  rv = packet_lookup(largest, largest->lower_bound);
+  if(rv == NULL) {
+    /* oops */
+    return NULL;
   }
 
-  /* oops */
-  return NULL;
-}
-/*---------------------------------------------------------------------------*/
-static struct mcast_packet *
-buffer_allocate()
-{
-  for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-      locmpptr >= buffered_msgs; locmpptr--) {
-    if(!MCAST_PACKET_IS_USED(locmpptr)) {
-      return locmpptr;
-    }
-  }
-  return NULL;
+  PRINTF("ROLL TM: Reclaim seq. val %u\n", rv->seq_val);
+  packet_free(rv);
+  largest->count--;
+  window_bounds(largest);
+  VERBOSE_PRINTF("ROLL TM: Reclaim - new bounds [%u , %u]\n",
+                 largest->lower_bound, largest->upper_bound);
+  ROLL_TM_STATS_ADD(buff_reclaim);
+  return buffer_allocate();
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -832,18 +939,15 @@ icmp_output()
 
       buffer = (uint8_t *)sl + sizeof(struct sequence_list_header);
 
-      for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-          locmpptr >= buffered_msgs; locmpptr--) {
-        if(MCAST_PACKET_IS_USED(locmpptr) &&
-           locmpptr->active < TRICKLE_ACTIVE((&t[SLIDING_WINDOW_GET_M(iterswptr)]))) {
-          if(locmpptr->sw == iterswptr) {
-            sl->seq_len++;
-            PRINTF(", %u", locmpptr->seq_val);
-            *buffer = (uint8_t)(locmpptr->seq_val >> 8);
-            buffer++;
-            *buffer = (uint8_t)(locmpptr->seq_val & 0xFF);
-            buffer++;
-          }
+      for(locmpptr = iterswptr->packets; locmpptr != NULL;
+          locmpptr = locmpptr->sw_next) {
+        if(locmpptr->active < TRICKLE_ACTIVE((&t[SLIDING_WINDOW_GET_M(iterswptr)]))) {
+          sl->seq_len++;
+          PRINTF(", %u", locmpptr->seq_val);
+          *buffer = (uint8_t)(locmpptr->seq_val >> 8);
+          buffer++;
+          *buffer = (uint8_t)(locmpptr->seq_val & 0xFF);
+          buffer++;
         }
       }
       PRINTF(", Len=%u\n", sl->seq_len);
@@ -975,20 +1079,16 @@ accept(uint8_t in)
     if(SEQ_VAL_IS_LT(seq_val, locswptr->lower_bound)) {
       /* Too old, drop */
       PRINTF("ROLL TM: Too old\n");
+      UIP_MCAST6_STATS_ADD(mcast_dup);
       UIP_MCAST6_STATS_ADD(mcast_dropped);
       return UIP_MCAST6_DROP;
     }
-    for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-        locmpptr >= buffered_msgs; locmpptr--) {
-      if(MCAST_PACKET_IS_USED(locmpptr) &&
-         locmpptr->sw == locswptr &&
-         SLIDING_WINDOW_GET_M(locmpptr->sw) == m &&
-         SEQ_VAL_IS_EQ(seq_val, locmpptr->seq_val)) {
-        /* Seen before , drop */
-        PRINTF("ROLL TM: Seen before\n");
-        UIP_MCAST6_STATS_ADD(mcast_dropped);
-        return UIP_MCAST6_DROP;
-      }
+    if(packet_lookup(locswptr, seq_val) != NULL) {
+      /* Seen before , drop */
+      PRINTF("ROLL TM: Seen before\n");
+      UIP_MCAST6_STATS_ADD(mcast_dup);
+      UIP_MCAST6_STATS_ADD(mcast_dropped);
+      return UIP_MCAST6_DROP;
     }
   }
 
@@ -1020,9 +1120,9 @@ accept(uint8_t in)
     PRINTF("ROLL TM: Buffer reclaim failed\n");
     if(locswptr->count == 0) {
       window_free(locswptr);
-      UIP_MCAST6_STATS_ADD(mcast_dropped);
-      return UIP_MCAST6_DROP;
     }
+    UIP_MCAST6_STATS_ADD(mcast_dropped);
+    return UIP_MCAST6_DROP;
   }
 #if UIP_MCAST6_STATS
   if(in == ROLL_TM_DGRAM_IN) {
@@ -1031,13 +1131,16 @@ accept(uint8_t in)
 #endif
 
   /* We have a window and we have a buffer. Accept this message */
-  /* Set the seed ID and correct M for this window */
-  SLIDING_WINDOW_M_CLR(locswptr);
-  if(m) {
-    SLIDING_WINDOW_M_SET(locswptr);
+  /* Set the seed ID and correct M for a new window */
+  if(!SLIDING_WINDOW_IS_USED(locswptr)) {
+    SLIDING_WINDOW_M_CLR(locswptr);
+    if(m) {
+      SLIDING_WINDOW_M_SET(locswptr);
+    }
+    SLIDING_WINDOW_IS_USED_SET(locswptr);
+    seed_id_cpy(&locswptr->seed_id, seed_ptr);
+    window_insert(locswptr);
   }
-  SLIDING_WINDOW_IS_USED_SET(locswptr);
-  seed_id_cpy(&locswptr->seed_id, seed_ptr);
   PRINTF("ROLL TM: Window for seed ");
   PRINT_SEED(&locswptr->seed_id);
   PRINTF(" M=%u, count=%u\n",
@@ -1063,6 +1166,7 @@ accept(uint8_t in)
   locmpptr->buff_len = uip_len;
   locmpptr->seq_val = seq_val;
   MCAST_PACKET_USED_SET(locmpptr);
+  packet_insert(locmpptr);
 
   PRINTF("ROLL TM: Window for seed ");
   PRINT_SEED(&locswptr->seed_id);
@@ -1222,23 +1326,17 @@ icmp_input()
 
           inconsistency = 1;
           /* Check if the advertised sequence is in our buffer */
-          for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
-              locmpptr >= buffered_msgs; locmpptr--) {
-            if(MCAST_PACKET_IS_USED(locmpptr) && locmpptr->sw == locswptr) {
-              if(SEQ_VAL_IS_EQ(locmpptr->seq_val, val)) {
-
-                inconsistency = 0;
-                MCAST_PACKET_LISTED_SET(locmpptr);
-                PRINTF("ROLL TM: ICMPv6 In, %u listed\n", locmpptr->seq_val);
-
-                /* Update lowest seq. num listed for this window
-                 * We need this to check for "we have new" */
-                if(locswptr->min_listed == -1 ||
-                   SEQ_VAL_IS_LT(val, locswptr->min_listed)) {
-                  locswptr->min_listed = val;
-                }
-                break;
-              }
+          locmpptr = packet_lookup(locswptr, val);
+          if(locmpptr != NULL) {
+            inconsistency = 0;
+            MCAST_PACKET_LISTED_SET(locmpptr);
+            PRINTF("ROLL TM: ICMPv6 In, %u listed\n", locmpptr->seq_val);
+
+            /* Update lowest seq. num listed for this window
+             * We need this to check for "we have new" */
+            if(locswptr->min_listed == -1 ||
+               SEQ_VAL_IS_LT(val, locswptr->min_listed)) {
+              locswptr->min_listed = val;
             }
           }
           if(inconsistency) {
@@ -1416,6 +1514,15 @@ init()
   memset(windows, 0, sizeof(windows));
   memset(buffered_msgs, 0, sizeof(buffered_msgs));
   memset(t, 0, sizeof(t));
+  memset(window_table, 0, sizeof(window_table));
+  memset(packet_table, 0, sizeof(packet_table));
+
+  free_packets = NULL;
+  for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
+      locmpptr >= buffered_msgs; locmpptr--) {
+    locmpptr->next = free_packets;
+    free_packets = locmpptr;
+  }
 
   ROLL_TM_STATS_INIT();
   UIP_MCAST6_STATS_INIT(&stats);
@@ -187,6 +187,19 @@
 #define ROLL_TM_BUFF_NUM 6
 #endif
 /*---------------------------------------------------------------------------*/
+/**
+ * Number of hash buckets used to look up Sliding Windows by Seed ID and
+ * buffered messages by sequence value. Must be a power of two, at most 256.
+ * Lookups are performed for every incoming datagram and for every sequence
+ * value advertised by our neighbours, so with many buffered messages this
+ * should be close to ROLL_TM_BUFF_NUM
+ */
+#ifdef ROLL_TM_CONF_HASH_SIZE
+#define ROLL_TM_HASH_SIZE ROLL_TM_CONF_HASH_SIZE
+#else
+#define ROLL_TM_HASH_SIZE 8
+#endif
+/*---------------------------------------------------------------------------*/
 /**
  * Use Short Seed IDs [short: 2, long: 16 (default)]
  * It can be argued that we should (and it would be easy to) support both at
@@ -236,6 +249,9 @@ struct roll_tm_stats {
 
   /** Number of malformed ICMP datagrams seen by us */
   UIP_MCAST6_STATS_DATATYPE icmp_bad;
+
+  /** Number of buffered messages dropped early to make room for new ones */
+  UIP_MCAST6_STATS_DATATYPE buff_reclaim;
 };
 /*---------------------------------------------------------------------------*/
 #endif /* ROLL_TM_H_ */
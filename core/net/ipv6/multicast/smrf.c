@@ -49,6 +49,7 @@
 #include "net/ipv6/multicast/smrf.h"
 #include "net/rpl/rpl.h"
 #include "net/netstack.h"
+#include "lib/crc16.h"
 #include <string.h>
 
 #define DEBUG DEBUG_NONE
@@ -64,11 +65,28 @@
 /*---------------------------------------------------------------------------*/
 /* Internal Data */
 /*---------------------------------------------------------------------------*/
-static struct ctimer mcast_periodic;
-static uint8_t mcast_len;
-static uip_buf_t mcast_buf;
+struct fwd_buf {
+  struct ctimer ct;
+  uint16_t len;
+  uip_buf_t buf;
+};
+
+static struct fwd_buf fwd_bufs[SMRF_FWD_BUFF_NUM];
 static uint8_t fwd_delay;
 static uint8_t fwd_spread;
+
+#if SMRF_DUP_CACHE
+#if SMRF_DUP_CACHE & (SMRF_DUP_CACHE - 1)
+#error "SMRF_DUP_CACHE must be 0 or a power of two"
+#endif
+/* Direct mapped on the fingerprint of each datagram */
+struct dup_entry {
+  uint16_t fingerprint;
+  clock_time_t seen;
+};
+
+static struct dup_entry dups[SMRF_DUP_CACHE];
+#endif
 /*---------------------------------------------------------------------------*/
 /* uIPv6 Pointers */
 /*---------------------------------------------------------------------------*/
@@ -77,19 +95,60 @@ static uint8_t fwd_spread;
 static void
 mcast_fwd(void *p)
 {
-  memcpy(uip_buf, &mcast_buf, mcast_len);
-  uip_len = mcast_len;
+  struct fwd_buf *fb = p;
+
+  memcpy(uip_buf, &fb->buf, fb->len);
+  uip_len = fb->len;
+  fb->len = 0;
   UIP_IP_BUF->ttl--;
   tcpip_output(NULL);
   uip_clear_buf();
 }
 /*---------------------------------------------------------------------------*/
+static struct fwd_buf *
+fwd_buf_allocate(void)
+{
+  struct fwd_buf *fb;
+
+  for(fb = fwd_bufs; fb < &fwd_bufs[SMRF_FWD_BUFF_NUM]; fb++) {
+    if(fb->len == 0) {
+      return fb;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+#if SMRF_DUP_CACHE
+/* Returns 1 if the datagram in uip_buf was seen recently, records it if not */
+static uint8_t
+is_dup(void)
+{
+  struct dup_entry *e;
+  uint16_t fingerprint;
+
+  /* Everything after the hop limit, which changes along the way */
+  fingerprint = crc16_data((uint8_t *)&UIP_IP_BUF->srcipaddr,
+                           uip_len - ((uint8_t *)&UIP_IP_BUF->srcipaddr -
+                                      (uint8_t *)UIP_IP_BUF), 0);
+  e = &dups[fingerprint & (SMRF_DUP_CACHE - 1)];
+
+  if(e->fingerprint == fingerprint &&
+     clock_time() - e->seen < SMRF_DUP_LIFETIME) {
+    return 1;
+  }
+  e->fingerprint = fingerprint;
+  e->seen = clock_time();
+  return 0;
+}
+#endif
+/*---------------------------------------------------------------------------*/
 static uint8_t
 in()
 {
   rpl_dag_t *d;                 /* Our DODAG */
   uip_ipaddr_t *parent_ipaddr;  /* Our pref. parent's IPv6 address */
   const uip_lladdr_t *parent_lladdr;  /* Our pref. parent's LL address */
+  struct fwd_buf *fb;
 
   /*
    * Fetch a pointer to the LL address of our preferred parent
@@ -131,14 +190,21 @@ in()
   }
 
   UIP_MCAST6_STATS_ADD(mcast_in_all);
+
+#if SMRF_DUP_CACHE
+  if(is_dup()) {
+    PRINTF("SMRF: Seen before\n");
+    UIP_MCAST6_STATS_ADD(mcast_dup);
+    UIP_MCAST6_STATS_ADD(mcast_dropped);
+    return UIP_MCAST6_DROP;
+  }
+#endif
+
   UIP_MCAST6_STATS_ADD(mcast_in_unique);
 
   /* If we have an entry in the mcast routing table, something with
    * a higher RPL rank (somewhere down the tree) is a group member */
   if(uip_mcast6_route_lookup(&UIP_IP_BUF->destipaddr)) {
-    /* If we enter here, we will definitely forward */
-    UIP_MCAST6_STATS_ADD(mcast_fwd);
-
     /*
      * Add a delay (D) of at least SMRF_FWD_DELAY() to compensate for how
      * contikimac handles broadcasts. We can't start our TX before the sender
@@ -155,6 +221,7 @@ in()
 
     if(fwd_delay == 0) {
       /* No delay required, send it, do it now, why wait? */
+      UIP_MCAST6_STATS_ADD(mcast_fwd);
       UIP_IP_BUF->ttl--;
       tcpip_output(NULL);
       UIP_IP_BUF->ttl++;        /* Restore before potential upstack delivery */
@@ -168,9 +235,17 @@ in()
         fwd_delay = fwd_delay * (1 + ((random_rand() >> 11) % fwd_spread));
       }
 
-      memcpy(&mcast_buf, uip_buf, uip_len);
-      mcast_len = uip_len;
-      ctimer_set(&mcast_periodic, fwd_delay, mcast_fwd, NULL);
+      fb = fwd_buf_allocate();
+      if(fb == NULL) {
+        /* Still deliver it to ourselves if we are a member */
+        PRINTF("SMRF: No forwarding buffer\n");
+        UIP_MCAST6_STATS_ADD(mcast_fwd_dropped);
+      } else {
+        UIP_MCAST6_STATS_ADD(mcast_fwd);
+        memcpy(&fb->buf, uip_buf, uip_len);
+        fb->len = uip_len;
+        ctimer_set(&fb->ct, fwd_delay, mcast_fwd, fb);
+      }
     }
     PRINTF("SMRF: %u bytes: fwd in %u [%u]\n",
            uip_len, fwd_delay, fwd_spread);
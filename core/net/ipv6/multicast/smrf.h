@@ -69,6 +69,36 @@
 #else
 #define SMRF_MAX_SPREAD 4
 #endif
+
+/*
+ * Number of datagrams that can wait for their forwarding delay at the same
+ * time. When all are taken, datagrams are delivered but not forwarded
+ */
+#ifdef SMRF_CONF_FWD_BUFF_NUM
+#define SMRF_FWD_BUFF_NUM SMRF_CONF_FWD_BUFF_NUM
+#else
+#define SMRF_FWD_BUFF_NUM 1
+#endif
+
+/*
+ * Number of entries (a power of two, 0 to disable) of the duplicate filter.
+ * SMRF only accepts datagrams from the preferred parent, but after a parent
+ * switch the new parent may well forward something we got from the old one.
+ * Datagrams are identified by a CRC of their source, destination and payload,
+ * so an application repeating the same datagram within SMRF_DUP_LIFETIME will
+ * also see its repeats dropped
+ */
+#ifdef SMRF_CONF_DUP_CACHE
+#define SMRF_DUP_CACHE SMRF_CONF_DUP_CACHE
+#else
+#define SMRF_DUP_CACHE 0
+#endif
+
+#ifdef SMRF_CONF_DUP_LIFETIME
+#define SMRF_DUP_LIFETIME SMRF_CONF_DUP_LIFETIME
+#else
+#define SMRF_DUP_LIFETIME (CLOCK_SECOND * 2)
+#endif
 /*---------------------------------------------------------------------------*/
 /* Stats datatype */
 /*---------------------------------------------------------------------------*/
@@ -87,6 +87,12 @@ typedef struct uip_mcast6_stats {
   /** Count of multicast datagrams correclty formed but dropped by us */
   UIP_MCAST6_STATS_DATATYPE mcast_dropped;
 
+  /** Count of datagrams dropped because we had already seen them */
+  UIP_MCAST6_STATS_DATATYPE mcast_dup;
+
+  /** Count of datagrams we would have forwarded but had no buffer for */
+  UIP_MCAST6_STATS_DATATYPE mcast_fwd_dropped;
+
   /** Opaque pointer to an engine's additional stats */
   void *engine_stats;
 } uip_mcast6_stats_t;
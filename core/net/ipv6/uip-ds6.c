@@ -88,6 +88,95 @@ static uip_ds6_aaddr_t *locaaddr;
 #endif /* UIP_DS6_AADDR_NB */
 static uip_ds6_prefix_t *locprefix;
 
+#if UIP_DS6_ADDR_HASH_SIZE > 0
+/*
+ * Own addresses are chained into hash buckets, so that classifying the
+ * destination of a packet does not scan the address lists. Slots
+ * number the entries of the unicast, multicast and anycast lists in
+ * that order.
+ */
+#define ADDR_SET_NONE   0xff
+#define ADDR_SET_MADDR  (UIP_DS6_ADDR_NB)
+#define ADDR_SET_AADDR  (ADDR_SET_MADDR + (UIP_DS6_MADDR_NB))
+#define ADDR_SET_SLOTS  (ADDR_SET_AADDR + (UIP_DS6_AADDR_NB))
+
+#if ADDR_SET_SLOTS >= ADDR_SET_NONE
+#error UIP_DS6_CONF_ADDR_HASH_SIZE supports at most 254 addresses
+#endif
+
+static uint8_t addr_set_head[UIP_DS6_ADDR_HASH_SIZE];
+static uint8_t addr_set_next[ADDR_SET_SLOTS];
+#endif /* UIP_DS6_ADDR_HASH_SIZE > 0 */
+
+/*---------------------------------------------------------------------------*/
+#if UIP_DS6_ADDR_HASH_SIZE > 0
+static uint8_t
+addr_set_hash(const uip_ipaddr_t *ipaddr)
+{
+  uint16_t h;
+  uint8_t i;
+
+  h = 0;
+  for(i = 0; i < 8; i++) {
+    h ^= ipaddr->u16[i];
+  }
+  return (uint8_t)(h ^ (h >> 8)) % UIP_DS6_ADDR_HASH_SIZE;
+}
+/*---------------------------------------------------------------------------*/
+static uip_ipaddr_t *
+addr_set_ipaddr(uint8_t slot)
+{
+  if(slot < ADDR_SET_MADDR) {
+    return &uip_ds6_if.addr_list[slot].ipaddr;
+  }
+#if UIP_DS6_AADDR_NB
+  if(slot >= ADDR_SET_AADDR) {
+    return &uip_ds6_if.aaddr_list[slot - ADDR_SET_AADDR].ipaddr;
+  }
+#endif /* UIP_DS6_AADDR_NB */
+  return &uip_ds6_if.maddr_list[slot - ADDR_SET_MADDR].ipaddr;
+}
+/*---------------------------------------------------------------------------*/
+static void
+addr_set_add(uint8_t slot)
+{
+  uint8_t *head;
+
+  head = &addr_set_head[addr_set_hash(addr_set_ipaddr(slot))];
+  addr_set_next[slot] = *head;
+  *head = slot;
+}
+/*---------------------------------------------------------------------------*/
+static void
+addr_set_rm(uint8_t slot)
+{
+  uint8_t *p;
+
+  for(p = &addr_set_head[addr_set_hash(addr_set_ipaddr(slot))];
+      *p != ADDR_SET_NONE; p = &addr_set_next[*p]) {
+    if(*p == slot) {
+      *p = addr_set_next[slot];
+      return;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Returns the slot in [first, last) that holds ipaddr, or ADDR_SET_NONE */
+static uint8_t
+addr_set_lookup(const uip_ipaddr_t *ipaddr, uint8_t first, uint8_t last)
+{
+  uint8_t slot;
+
+  for(slot = addr_set_head[addr_set_hash(ipaddr)]; slot != ADDR_SET_NONE;
+      slot = addr_set_next[slot]) {
+    if(slot >= first && slot < last &&
+       uip_ipaddr_cmp(addr_set_ipaddr(slot), ipaddr)) {
+      return slot;
+    }
+  }
+  return ADDR_SET_NONE;
+}
+#endif /* UIP_DS6_ADDR_HASH_SIZE > 0 */
 /*---------------------------------------------------------------------------*/
 void
 uip_ds6_init(void)
@@ -102,6 +191,9 @@ uip_ds6_init(void)
      UIP_DS6_ADDR_NB, UIP_DS6_MADDR_NB, UIP_DS6_AADDR_NB);
   memset(uip_ds6_prefix_list, 0, sizeof(uip_ds6_prefix_list));
   memset(&uip_ds6_if, 0, sizeof(uip_ds6_if));
+#if UIP_DS6_ADDR_HASH_SIZE > 0
+  memset(addr_set_head, ADDR_SET_NONE, sizeof(addr_set_head));
+#endif /* UIP_DS6_ADDR_HASH_SIZE > 0 */
   uip_ds6_addr_size = sizeof(struct uip_ds6_addr);
   uip_ds6_netif_addr_list_offset = offsetof(struct uip_ds6_netif, addr_list);
 
@@ -331,6 +423,9 @@ uip_ds6_addr_add(uip_ipaddr_t *ipaddr, unsigned long vlifetime, uint8_t type)
       (uip_ds6_element_t **)&locaddr) == FREESPACE) {
     locaddr->isused = 1;
     uip_ipaddr_copy(&locaddr->ipaddr, ipaddr);
+#if UIP_DS6_ADDR_HASH_SIZE > 0
+    addr_set_add(locaddr - uip_ds6_if.addr_list);
+#endif /* UIP_DS6_ADDR_HASH_SIZE > 0 */
     locaddr->type = type;
     if(vlifetime == 0) {
       locaddr->isinfinite = 1;
@@ -363,6 +458,11 @@ uip_ds6_addr_rm(uip_ds6_addr_t *addr)
     if((locmaddr = uip_ds6_maddr_lookup(&loc_fipaddr)) != NULL) {
       uip_ds6_maddr_rm(locmaddr);
     }
+#if UIP_DS6_ADDR_HASH_SIZE > 0
+    if(addr->isused) {
+      addr_set_rm(addr - uip_ds6_if.addr_list);
+    }
+#endif /* UIP_DS6_ADDR_HASH_SIZE > 0 */
     addr->isused = 0;
   }
   return;
@@ -372,12 +472,22 @@ uip_ds6_addr_rm(uip_ds6_addr_t *addr)
 uip_ds6_addr_t *
 uip_ds6_addr_lookup(uip_ipaddr_t *ipaddr)
 {
+#if UIP_DS6_ADDR_HASH_SIZE > 0
+  uint8_t slot;
+
+  slot = addr_set_lookup(ipaddr, 0, ADDR_SET_MADDR);
+  if(slot != ADDR_SET_NONE) {
+    locaddr = &uip_ds6_if.addr_list[slot];
+    return locaddr;
+  }
+#else /* UIP_DS6_ADDR_HASH_SIZE > 0 */
   if(uip_ds6_list_loop
      ((uip_ds6_element_t *)uip_ds6_if.addr_list, UIP_DS6_ADDR_NB,
       sizeof(uip_ds6_addr_t), ipaddr, 128,
       (uip_ds6_element_t **)&locaddr) == FOUND) {
     return locaddr;
   }
+#endif /* UIP_DS6_ADDR_HASH_SIZE > 0 */
   return NULL;
 }
 
@@ -429,6 +539,9 @@ uip_ds6_maddr_add(const uip_ipaddr_t *ipaddr)
       (uip_ds6_element_t **)&locmaddr) == FREESPACE) {
     locmaddr->isused = 1;
     uip_ipaddr_copy(&locmaddr->ipaddr, ipaddr);
+#if UIP_DS6_ADDR_HASH_SIZE > 0
+    addr_set_add(ADDR_SET_MADDR + (locmaddr - uip_ds6_if.maddr_list));
+#endif /* UIP_DS6_ADDR_HASH_SIZE > 0 */
     return locmaddr;
   }
   return NULL;
@@ -439,6 +552,11 @@ void
 uip_ds6_maddr_rm(uip_ds6_maddr_t *maddr)
 {
   if(maddr != NULL) {
+#if UIP_DS6_ADDR_HASH_SIZE > 0
+    if(maddr->isused) {
+      addr_set_rm(ADDR_SET_MADDR + (maddr - uip_ds6_if.maddr_list));
+    }
+#endif /* UIP_DS6_ADDR_HASH_SIZE > 0 */
     maddr->isused = 0;
   }
   return;
@@ -448,12 +566,22 @@ uip_ds6_maddr_rm(uip_ds6_maddr_t *maddr)
 uip_ds6_maddr_t *
 uip_ds6_maddr_lookup(const uip_ipaddr_t *ipaddr)
 {
+#if UIP_DS6_ADDR_HASH_SIZE > 0
+  uint8_t slot;
+
+  slot = addr_set_lookup(ipaddr, ADDR_SET_MADDR, ADDR_SET_AADDR);
+  if(slot != ADDR_SET_NONE) {
+    locmaddr = &uip_ds6_if.maddr_list[slot - ADDR_SET_MADDR];
+    return locmaddr;
+  }
+#else /* UIP_DS6_ADDR_HASH_SIZE > 0 */
   if(uip_ds6_list_loop
      ((uip_ds6_element_t *)uip_ds6_if.maddr_list, UIP_DS6_MADDR_NB,
       sizeof(uip_ds6_maddr_t), (void*)ipaddr, 128,
       (uip_ds6_element_t **)&locmaddr) == FOUND) {
     return locmaddr;
   }
+#endif /* UIP_DS6_ADDR_HASH_SIZE > 0 */
   return NULL;
 }
 
@@ -469,6 +597,9 @@ uip_ds6_aaddr_add(uip_ipaddr_t *ipaddr)
       (uip_ds6_element_t **)&locaaddr) == FREESPACE) {
     locaaddr->isused = 1;
     uip_ipaddr_copy(&locaaddr->ipaddr, ipaddr);
+#if UIP_DS6_ADDR_HASH_SIZE > 0
+    addr_set_add(ADDR_SET_AADDR + (locaaddr - uip_ds6_if.aaddr_list));
+#endif /* UIP_DS6_ADDR_HASH_SIZE > 0 */
     return locaaddr;
   }
 #endif /* UIP_DS6_AADDR_NB */
@@ -480,6 +611,11 @@ void
 uip_ds6_aaddr_rm(uip_ds6_aaddr_t *aaddr)
 {
   if(aaddr != NULL) {
+#if UIP_DS6_ADDR_HASH_SIZE > 0 && UIP_DS6_AADDR_NB
+    if(aaddr->isused) {
+      addr_set_rm(ADDR_SET_AADDR + (aaddr - uip_ds6_if.aaddr_list));
+    }
+#endif /* UIP_DS6_ADDR_HASH_SIZE > 0 && UIP_DS6_AADDR_NB */
     aaddr->isused = 0;
   }
   return;
@@ -490,11 +626,21 @@ uip_ds6_aaddr_t *
 uip_ds6_aaddr_lookup(uip_ipaddr_t *ipaddr)
 {
 #if UIP_DS6_AADDR_NB
+#if UIP_DS6_ADDR_HASH_SIZE > 0
+  uint8_t slot;
+
+  slot = addr_set_lookup(ipaddr, ADDR_SET_AADDR, ADDR_SET_SLOTS);
+  if(slot != ADDR_SET_NONE) {
+    locaaddr = &uip_ds6_if.aaddr_list[slot - ADDR_SET_AADDR];
+    return locaaddr;
+  }
+#else /* UIP_DS6_ADDR_HASH_SIZE > 0 */
   if(uip_ds6_list_loop((uip_ds6_element_t *)uip_ds6_if.aaddr_list,
                        UIP_DS6_AADDR_NB, sizeof(uip_ds6_aaddr_t), ipaddr, 128,
                        (uip_ds6_element_t **)&locaaddr) == FOUND) {
     return locaaddr;
   }
+#endif /* UIP_DS6_ADDR_HASH_SIZE > 0 */
 #endif /* UIP_DS6_AADDR_NB */
   return NULL;
 }
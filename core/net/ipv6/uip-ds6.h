@@ -141,6 +141,14 @@
 #endif
 #define UIP_DS6_AADDR_NB UIP_DS6_AADDR_NBS + UIP_DS6_AADDR_NBU
 
+/* Number of buckets of the hash set that indexes the unicast, multicast
+ * and anycast address lists. 0 looks addresses up by scanning the lists. */
+#ifndef UIP_DS6_CONF_ADDR_HASH_SIZE
+#define UIP_DS6_ADDR_HASH_SIZE 0
+#else
+#define UIP_DS6_ADDR_HASH_SIZE UIP_DS6_CONF_ADDR_HASH_SIZE
+#endif
+
 /*--------------------------------------------------*/
 /* Should we use LinkLayer acks in NUD ?*/
 #ifndef UIP_CONF_DS6_LL_NUD
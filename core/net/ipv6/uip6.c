@@ -78,6 +78,9 @@
 #include "net/ipv6/uip-nd6.h"
 #include "net/ipv6/uip-ds6.h"
 #include "net/ipv6/multicast/uip-mcast6.h"
+#if UIP_TCP && UIP_TCP_SEND_WINDOW > 1
+#include "lib/memb.h"
+#endif /* UIP_TCP && UIP_TCP_SEND_WINDOW > 1 */
 
 #if UIP_CONF_IPV6_RPL
 #include "rpl/rpl.h"
@@ -267,6 +270,110 @@ struct uip_udp_conn uip_udp_conns[UIP_UDP_CONNS];
 #endif /* UIP_UDP */
 /** @} */
 
+/*---------------------------------------------------------------------------*/
+/**
+ * \name Demultiplexing index
+ *
+ * Connections are chained into buckets keyed by their local port. A
+ * chain is kept in table order, so a lookup finds the same connection
+ * as a linear scan of the table would.
+ * @{
+ */
+/*---------------------------------------------------------------------------*/
+#if UIP_DEMUX_HASH_SIZE > 0
+#if UIP_CONNS >= 255 || UIP_UDP_CONNS >= 255
+#error UIP_CONF_DEMUX_HASH_SIZE supports at most 254 connections per protocol
+#endif
+
+#define DEMUX_NONE         0xff
+#define DEMUX_HASH(port)   (((port) ^ ((port) >> 8)) % UIP_DEMUX_HASH_SIZE)
+
+struct demux_index {
+  uint8_t *head;     /* First connection of each bucket. */
+  uint8_t *next;     /* Next connection in the same bucket. */
+  uint8_t *bucket;   /* Bucket of each connection, or DEMUX_NONE. */
+};
+
+/*---------------------------------------------------------------------------*/
+static void
+demux_init(const struct demux_index *index, uint8_t conns)
+{
+  memset(index->head, DEMUX_NONE, UIP_DEMUX_HASH_SIZE);
+  memset(index->bucket, DEMUX_NONE, conns);
+}
+/*---------------------------------------------------------------------------*/
+static void
+demux_unlink(const struct demux_index *index, uint8_t c)
+{
+  uint8_t *p;
+
+  if(index->bucket[c] == DEMUX_NONE) {
+    return;
+  }
+  for(p = &index->head[index->bucket[c]]; *p != DEMUX_NONE;
+      p = &index->next[*p]) {
+    if(*p == c) {
+      *p = index->next[c];
+      break;
+    }
+  }
+  index->bucket[c] = DEMUX_NONE;
+}
+/*---------------------------------------------------------------------------*/
+static void
+demux_link(const struct demux_index *index, uint8_t c, uint16_t port)
+{
+  uint8_t *p;
+
+  demux_unlink(index, c);
+  if(port == 0) {
+    return;
+  }
+  index->bucket[c] = DEMUX_HASH(port);
+  for(p = &index->head[index->bucket[c]]; *p != DEMUX_NONE && *p < c;
+      p = &index->next[*p]);
+  index->next[c] = *p;
+  *p = c;
+}
+/*---------------------------------------------------------------------------*/
+#if UIP_TCP
+static uint8_t tcp_demux_head[UIP_DEMUX_HASH_SIZE];
+static uint8_t tcp_demux_next[UIP_CONNS];
+static uint8_t tcp_demux_bucket[UIP_CONNS];
+static const struct demux_index tcp_demux = {
+  tcp_demux_head, tcp_demux_next, tcp_demux_bucket
+};
+
+#define TCP_DEMUX_FIRST(port) tcp_demux_head[DEMUX_HASH(port)]
+#define TCP_DEMUX_NEXT(c)     tcp_demux_next[c]
+#define TCP_DEMUX_LINK(conn) \
+  demux_link(&tcp_demux, (conn) - uip_conns, (conn)->lport)
+#endif /* UIP_TCP */
+
+#if UIP_UDP
+static uint8_t udp_demux_head[UIP_DEMUX_HASH_SIZE];
+static uint8_t udp_demux_next[UIP_UDP_CONNS];
+static uint8_t udp_demux_bucket[UIP_UDP_CONNS];
+static const struct demux_index udp_demux = {
+  udp_demux_head, udp_demux_next, udp_demux_bucket
+};
+
+#define UDP_DEMUX_FIRST(port) udp_demux_head[DEMUX_HASH(port)]
+#define UDP_DEMUX_NEXT(c)     udp_demux_next[c]
+
+/*---------------------------------------------------------------------------*/
+void
+uip_udp_bind_port(struct uip_udp_conn *conn, uint16_t port)
+{
+  conn->lport = port;
+  demux_link(&udp_demux, conn - uip_udp_conns, port);
+}
+#endif /* UIP_UDP */
+#else /* UIP_DEMUX_HASH_SIZE > 0 */
+#define TCP_DEMUX_LINK(conn)
+#endif /* UIP_DEMUX_HASH_SIZE > 0 */
+/** @} */
+
 /*---------------------------------------------------------------------------*/
 /**
  * \name ICMPv6 variables
@@ -423,6 +530,112 @@ uip_udpchksum(void)
 #endif /* UIP_UDP && UIP_UDP_CHECKSUMS */
 #endif /* UIP_ARCH_CHKSUM */
 /*---------------------------------------------------------------------------*/
+#if UIP_TCP && UIP_TCP_SEND_WINDOW > 1
+/* A copy of an unacknowledged segment, kept for retransmissions */
+struct uip_tcp_seg {
+  struct uip_tcp_seg *next;
+  uint16_t len;
+  uint8_t data[UIP_TCP_MSS];
+};
+
+MEMB(tcp_seg_memb, struct uip_tcp_seg, UIP_TCP_SEGMENT_POOL);
+
+static void
+tcp_seg_free_all(struct uip_conn *conn)
+{
+  struct uip_tcp_seg *seg;
+
+  while(conn->rexmit != NULL) {
+    seg = conn->rexmit;
+    conn->rexmit = seg->next;
+    memb_free(&tcp_seg_memb, seg);
+  }
+  conn->nsegs = 0;
+  conn->dupacks = 0;
+  conn->queued = 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+tcp_seg_queue(struct uip_conn *conn, const uint8_t *data, uint16_t len)
+{
+  struct uip_tcp_seg *seg;
+  struct uip_tcp_seg **tail;
+
+  seg = memb_alloc(&tcp_seg_memb);
+  if(seg == NULL) {
+    return 0;
+  }
+  memcpy(seg->data, data, len);
+  seg->len = len;
+  seg->next = NULL;
+  for(tail = &conn->rexmit; *tail != NULL; tail = &(*tail)->next);
+  *tail = seg;
+  conn->nsegs++;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Drop acknowledged bytes from the head of the retransmission buffer */
+static void
+tcp_seg_release(struct uip_conn *conn, uint16_t acked)
+{
+  struct uip_tcp_seg *seg;
+
+  while(acked > 0 && conn->rexmit != NULL) {
+    seg = conn->rexmit;
+    if(seg->len <= acked) {
+      acked -= seg->len;
+      conn->rexmit = seg->next;
+      conn->nsegs--;
+      memb_free(&tcp_seg_memb, seg);
+    } else {
+      memmove(seg->data, seg->data + acked, seg->len - acked);
+      seg->len -= acked;
+      acked = 0;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* The number of bytes between snd_nxt and the acknowledgment number */
+static uint32_t
+tcp_ack_distance(const struct uip_conn *conn)
+{
+  uint32_t ackno;
+  uint32_t una;
+
+  ackno = ((uint32_t)UIP_TCP_BUF->ackno[0] << 24) |
+    ((uint32_t)UIP_TCP_BUF->ackno[1] << 16) |
+    ((uint32_t)UIP_TCP_BUF->ackno[2] << 8) | UIP_TCP_BUF->ackno[3];
+  una = ((uint32_t)conn->snd_nxt[0] << 24) |
+    ((uint32_t)conn->snd_nxt[1] << 16) |
+    ((uint32_t)conn->snd_nxt[2] << 8) | conn->snd_nxt[3];
+  return ackno - una;
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+uip_tcp_sendable(struct uip_conn *conn)
+{
+  uint32_t limit;
+
+  if((conn->tcpstateflags & UIP_TS_MASK) != UIP_ESTABLISHED ||
+     conn->nsegs >= UIP_TCP_SEND_WINDOW ||
+     memb_numfree(&tcp_seg_memb) == 0) {
+    return 0;
+  }
+  if(conn->len == 0) {
+    /* Always allow one segment, which doubles as a zero window probe. */
+    return conn->mss;
+  }
+  limit = (uint32_t)UIP_TCP_SEND_WINDOW * conn->initialmss;
+  if(limit > conn->sndwnd) {
+    limit = conn->sndwnd;
+  }
+  if(limit <= conn->len) {
+    return 0;
+  }
+  return MIN(limit - conn->len, conn->mss);
+}
+#endif /* UIP_TCP && UIP_TCP_SEND_WINDOW > 1 */
+/*---------------------------------------------------------------------------*/
 void
 uip_init(void)
 {
@@ -438,7 +651,17 @@ uip_init(void)
   }
   for(c = 0; c < UIP_CONNS; ++c) {
     uip_conns[c].tcpstateflags = UIP_CLOSED;
+#if UIP_TCP_SEND_WINDOW > 1
+    uip_conns[c].rexmit = NULL;
+    tcp_seg_free_all(&uip_conns[c]);
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
   }
+#if UIP_TCP_SEND_WINDOW > 1
+  memb_init(&tcp_seg_memb);
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
+#if UIP_DEMUX_HASH_SIZE > 0
+  demux_init(&tcp_demux, UIP_CONNS);
+#endif /* UIP_DEMUX_HASH_SIZE > 0 */
 #endif /* UIP_TCP */
 
 #if UIP_ACTIVE_OPEN || UIP_UDP
@@ -449,6 +672,9 @@ uip_init(void)
   for(c = 0; c < UIP_UDP_CONNS; ++c) {
     uip_udp_conns[c].lport = 0;
   }
+#if UIP_DEMUX_HASH_SIZE > 0
+  demux_init(&udp_demux, UIP_UDP_CONNS);
+#endif /* UIP_DEMUX_HASH_SIZE > 0 */
 #endif /* UIP_UDP */
 
 #if UIP_CONF_IPV6_MULTICAST
@@ -473,7 +699,12 @@ uip_connect(const uip_ipaddr_t *ripaddr, uint16_t rport)
 
   /* Check if this port is already in use, and if so try to find
      another one. */
+#if UIP_DEMUX_HASH_SIZE > 0
+  for(c = TCP_DEMUX_FIRST(uip_htons(lastport)); c != DEMUX_NONE;
+      c = TCP_DEMUX_NEXT(c)) {
+#else /* UIP_DEMUX_HASH_SIZE > 0 */
   for(c = 0; c < UIP_CONNS; ++c) {
+#endif /* UIP_DEMUX_HASH_SIZE > 0 */
     conn = &uip_conns[c];
     if(conn->tcpstateflags != UIP_CLOSED &&
        conn->lport == uip_htons(lastport)) {
@@ -501,6 +732,9 @@ uip_connect(const uip_ipaddr_t *ripaddr, uint16_t rport)
   }
 
   conn->tcpstateflags = UIP_SYN_SENT;
+#if UIP_TCP_SEND_WINDOW > 1
+  tcp_seg_free_all(conn);
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 
   conn->snd_nxt[0] = iss[0];
   conn->snd_nxt[1] = iss[1];
@@ -521,6 +755,7 @@ uip_connect(const uip_ipaddr_t *ripaddr, uint16_t rport)
   conn->sa = 0;
   conn->sv = 16;   /* Initial value of the RTT variance. */
   conn->lport = uip_htons(lastport);
+  TCP_DEMUX_LINK(conn);
   conn->rport = rport;
   uip_ipaddr_copy(&conn->ripaddr, ripaddr);
 
@@ -567,7 +802,12 @@ uip_udp_new(const uip_ipaddr_t *ripaddr, uint16_t rport)
     lastport = 4096;
   }
 
+#if UIP_DEMUX_HASH_SIZE > 0
+  for(c = UDP_DEMUX_FIRST(uip_htons(lastport)); c != DEMUX_NONE;
+      c = UDP_DEMUX_NEXT(c)) {
+#else /* UIP_DEMUX_HASH_SIZE > 0 */
   for(c = 0; c < UIP_UDP_CONNS; ++c) {
+#endif /* UIP_DEMUX_HASH_SIZE > 0 */
     if(uip_udp_conns[c].lport == uip_htons(lastport)) {
       goto again;
     }
@@ -585,7 +825,7 @@ uip_udp_new(const uip_ipaddr_t *ripaddr, uint16_t rport)
     return 0;
   }
 
-  conn->lport = UIP_HTONS(lastport);
+  uip_udp_bind(conn, UIP_HTONS(lastport));
   conn->rport = rport;
   if(ripaddr == NULL) {
     memset(&conn->ripaddr, 0, sizeof(uip_ipaddr_t));
@@ -944,6 +1184,10 @@ uip_process(uint8_t flag)
   uint16_t tmp16;
   uint8_t opt;
   register struct uip_conn *uip_connr = uip_conn;
+#if UIP_TCP_SEND_WINDOW > 1
+  uint32_t ackdist;
+  uint16_t snd_off = 0;
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 #endif /* UIP_TCP */
 #if UIP_UDP
   if(flag == UIP_UDP_SEND_CONN) {
@@ -956,8 +1200,12 @@ uip_process(uint8_t flag)
      particular connection. */
   if(flag == UIP_POLL_REQUEST) {
 #if UIP_TCP
+#if UIP_TCP_SEND_WINDOW > 1
+    if(uip_tcp_sendable(uip_connr)) {
+#else /* UIP_TCP_SEND_WINDOW > 1 */
     if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED &&
        !uip_outstanding(uip_connr)) {
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
       uip_flags = UIP_POLL;
       UIP_APPCALL();
       goto appsend;
@@ -1011,6 +1259,9 @@ uip_process(uint8_t flag)
                uip_connr->tcpstateflags == UIP_SYN_RCVD) &&
               uip_connr->nrtx == UIP_MAXSYNRTX)) {
             uip_connr->tcpstateflags = UIP_CLOSED;
+#if UIP_TCP_SEND_WINDOW > 1
+            tcp_seg_free_all(uip_connr);
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 
             /*
              * We call UIP_APPCALL() with uip_flags set to
@@ -1053,6 +1304,13 @@ uip_process(uint8_t flag)
 #endif /* UIP_ACTIVE_OPEN */
 
           case UIP_ESTABLISHED:
+#if UIP_TCP_SEND_WINDOW > 1
+            /*
+             * With a send window, the unacknowledged data is kept in
+             * the retransmission buffer, so we resend it ourselves.
+             */
+            goto tcp_rexmit_seg;
+#else /* UIP_TCP_SEND_WINDOW > 1 */
             /*
              * In the ESTABLISHED state, we call upon the application
              * to do the actual retransmit after which we jump into
@@ -1062,6 +1320,7 @@ uip_process(uint8_t flag)
             uip_flags = UIP_REXMIT;
             UIP_APPCALL();
             goto apprexmit;
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 
           case UIP_FIN_WAIT_1:
           case UIP_CLOSING:
@@ -1070,6 +1329,14 @@ uip_process(uint8_t flag)
             goto tcp_send_finack;
           }
         }
+#if UIP_TCP_SEND_WINDOW > 1
+        /* Let the application fill the rest of the send window. */
+        if(uip_tcp_sendable(uip_connr)) {
+          uip_flags = UIP_POLL;
+          UIP_APPCALL();
+          goto appsend;
+        }
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
       } else if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED) {
         /*
          * If there was no need for a retransmission, we poll the
@@ -1510,9 +1777,15 @@ uip_process(uint8_t flag)
   }
 
   /* Demultiplex this UDP packet between the UDP "connections". */
+#if UIP_DEMUX_HASH_SIZE > 0
+  for(c = UDP_DEMUX_FIRST(UIP_UDP_BUF->destport); c != DEMUX_NONE;
+      c = UDP_DEMUX_NEXT(c)) {
+    uip_udp_conn = &uip_udp_conns[c];
+#else /* UIP_DEMUX_HASH_SIZE > 0 */
   for(uip_udp_conn = &uip_udp_conns[0];
       uip_udp_conn < &uip_udp_conns[UIP_UDP_CONNS];
       ++uip_udp_conn) {
+#endif /* UIP_DEMUX_HASH_SIZE > 0 */
     /* If the local UDP port is non-zero, the connection is considered
        to be used. If so, the local port number is checked against the
        destination port number in the received packet. If the two port
@@ -1618,8 +1891,14 @@ uip_process(uint8_t flag)
 
   /* Demultiplex this segment. */
   /* First check any active connections. */
+#if UIP_DEMUX_HASH_SIZE > 0
+  for(c = TCP_DEMUX_FIRST(UIP_TCP_BUF->destport); c != DEMUX_NONE;
+      c = TCP_DEMUX_NEXT(c)) {
+    uip_connr = &uip_conns[c];
+#else /* UIP_DEMUX_HASH_SIZE > 0 */
   for(uip_connr = &uip_conns[0]; uip_connr <= &uip_conns[UIP_CONNS - 1];
       ++uip_connr) {
+#endif /* UIP_DEMUX_HASH_SIZE > 0 */
     if(uip_connr->tcpstateflags != UIP_CLOSED &&
        UIP_TCP_BUF->destport == uip_connr->lport &&
        UIP_TCP_BUF->srcport == uip_connr->rport &&
@@ -1740,9 +2019,13 @@ uip_process(uint8_t flag)
   uip_connr->sv = 4;
   uip_connr->nrtx = 0;
   uip_connr->lport = UIP_TCP_BUF->destport;
+  TCP_DEMUX_LINK(uip_connr);
   uip_connr->rport = UIP_TCP_BUF->srcport;
   uip_ipaddr_copy(&uip_connr->ripaddr, &UIP_IP_BUF->srcipaddr);
   uip_connr->tcpstateflags = UIP_SYN_RCVD;
+#if UIP_TCP_SEND_WINDOW > 1
+  tcp_seg_free_all(uip_connr);
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 
   uip_connr->snd_nxt[0] = iss[0];
   uip_connr->snd_nxt[1] = iss[1];
@@ -1823,6 +2106,9 @@ uip_process(uint8_t flag)
      before we accept the reset. */
   if(UIP_TCP_BUF->flags & TCP_RST) {
     uip_connr->tcpstateflags = UIP_CLOSED;
+#if UIP_TCP_SEND_WINDOW > 1
+    tcp_seg_free_all(uip_connr);
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
     UIP_LOG("tcp: got reset, aborting connection.");
     uip_flags = UIP_ABORT;
     UIP_APPCALL();
@@ -1866,6 +2152,27 @@ uip_process(uint8_t flag)
      data. If so, we update the sequence number, reset the length of
      the outstanding data, calculate RTT estimations, and reset the
      retransmission timer. */
+#if UIP_TCP_SEND_WINDOW > 1
+  /* With a send window, the incoming segment may acknowledge any
+     prefix of the outstanding data. */
+  if(UIP_TCP_BUF->flags & TCP_ACK) {
+    uip_connr->sndwnd = ((uint16_t)UIP_TCP_BUF->wnd[0] << 8) +
+      (uint16_t)UIP_TCP_BUF->wnd[1];
+  }
+  if((UIP_TCP_BUF->flags & TCP_ACK) && uip_outstanding(uip_connr)) {
+    ackdist = tcp_ack_distance(uip_connr);
+    if(ackdist == 0) {
+      /* Duplicate ACKs signal a lost segment, so we retransmit it
+         without waiting for the retransmission timer. */
+      if(uip_len == 0 && uip_connr->rexmit != NULL &&
+         (UIP_TCP_BUF->flags & (TCP_SYN | TCP_FIN)) == 0 &&
+         ++uip_connr->dupacks == UIP_TCP_DUPACK_THRESHOLD) {
+        UIP_STAT(++uip_stat.tcp.rexmit);
+        goto tcp_rexmit_seg;
+      }
+    } else if(ackdist <= uip_connr->len) {
+      uip_add32(uip_connr->snd_nxt, (uint16_t)ackdist);
+#else /* UIP_TCP_SEND_WINDOW > 1 */
   if((UIP_TCP_BUF->flags & TCP_ACK) && uip_outstanding(uip_connr)) {
     uip_add32(uip_connr->snd_nxt, uip_connr->len);
 
@@ -1873,6 +2180,7 @@ uip_process(uint8_t flag)
        UIP_TCP_BUF->ackno[1] == uip_acc32[1] &&
        UIP_TCP_BUF->ackno[2] == uip_acc32[2] &&
        UIP_TCP_BUF->ackno[3] == uip_acc32[3]) {
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
       /* Update sequence number. */
       uip_connr->snd_nxt[0] = uip_acc32[0];
       uip_connr->snd_nxt[1] = uip_acc32[1];
@@ -1899,8 +2207,17 @@ uip_process(uint8_t flag)
       /* Reset the retransmission timer. */
       uip_connr->timer = uip_connr->rto;
 
+#if UIP_TCP_SEND_WINDOW > 1
+      /* Release the acknowledged part of the outstanding data. */
+      tcp_seg_release(uip_connr, (uint16_t)ackdist);
+      uip_connr->len -= (uint16_t)ackdist;
+      uip_connr->acklen = (uint16_t)ackdist;
+      uip_connr->dupacks = 0;
+      uip_connr->nrtx = 0;
+#else /* UIP_TCP_SEND_WINDOW > 1 */
       /* Reset length of outstanding data. */
       uip_connr->len = 0;
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
     }
 
   }
@@ -2100,12 +2417,19 @@ uip_process(uint8_t flag)
       if(uip_flags & UIP_ABORT) {
         uip_slen = 0;
         uip_connr->tcpstateflags = UIP_CLOSED;
+#if UIP_TCP_SEND_WINDOW > 1
+        tcp_seg_free_all(uip_connr);
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
         UIP_TCP_BUF->flags = TCP_RST | TCP_ACK;
         goto tcp_send_nodata;
       }
 
       if(uip_flags & UIP_CLOSE) {
         uip_slen = 0;
+#if UIP_TCP_SEND_WINDOW > 1
+        /* As without a send window, data still in flight is given up. */
+        tcp_seg_free_all(uip_connr);
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
         uip_connr->len = 1;
         uip_connr->tcpstateflags = UIP_FIN_WAIT_1;
         uip_connr->nrtx = 0;
@@ -2115,6 +2439,27 @@ uip_process(uint8_t flag)
 
       /* If uip_slen > 0, the application has data to be sent. */
       if(uip_slen > 0) {
+#if UIP_TCP_SEND_WINDOW > 1
+        /* The new segment goes after the data already in flight, and
+             is copied into the retransmission buffer. The application
+             is expected to check uip_sendable() before sending. */
+        tmp16 = uip_tcp_sendable(uip_connr);
+        if(uip_slen > tmp16) {
+          uip_slen = tmp16;
+        }
+        if(uip_slen > 0 &&
+           tcp_seg_queue(uip_connr, uip_sappdata, uip_slen)) {
+          if(uip_connr->len == 0) {
+            uip_connr->timer = uip_connr->rto;
+          }
+          snd_off = uip_connr->len;
+          uip_connr->len += uip_slen;
+          uip_connr->queued = 1;
+        } else {
+          uip_slen = 0;
+        }
+      }
+#else /* UIP_TCP_SEND_WINDOW > 1 */
 
         /* If the connection has acknowledged data, the contents of
              the ->len variable should be discarded. */
@@ -2147,13 +2492,18 @@ uip_process(uint8_t flag)
       }
       uip_connr->nrtx = 0;
       apprexmit:
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
       uip_appdata = uip_sappdata;
 
       /* If the application has data to be sent, or if the incoming
            packet had new data in it, we must send out a packet. */
       if(uip_slen > 0 && uip_connr->len > 0) {
         /* Add the length of the IP and TCP headers. */
+#if UIP_TCP_SEND_WINDOW > 1
+        uip_len = uip_slen + UIP_TCPIP_HLEN;
+#else /* UIP_TCP_SEND_WINDOW > 1 */
         uip_len = uip_connr->len + UIP_TCPIP_HLEN;
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
         /* We always set the ACK flag in response packets. */
         UIP_TCP_BUF->flags = TCP_ACK | TCP_PSH;
         /* Send the packet. */
@@ -2235,6 +2585,20 @@ uip_process(uint8_t flag)
   }
   goto drop;
 
+#if UIP_TCP_SEND_WINDOW > 1
+  /* Resend the oldest unacknowledged segment from the retransmission
+     buffer. Its sequence number is snd_nxt. */
+  tcp_rexmit_seg:
+  if(uip_connr->rexmit == NULL) {
+    goto drop;
+  }
+  uip_connr->dupacks = 0;
+  memcpy(uip_sappdata, uip_connr->rexmit->data, uip_connr->rexmit->len);
+  uip_len = uip_connr->rexmit->len + UIP_TCPIP_HLEN;
+  UIP_TCP_BUF->flags = TCP_ACK | TCP_PSH;
+  goto tcp_send_noopts;
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
+
   /* We jump here when we are ready to send the packet, and just want
      to set the appropriate TCP sequence numbers in the TCP header. */
   tcp_send_ack:
@@ -2262,6 +2626,16 @@ uip_process(uint8_t flag)
   UIP_TCP_BUF->seqno[1] = uip_connr->snd_nxt[1];
   UIP_TCP_BUF->seqno[2] = uip_connr->snd_nxt[2];
   UIP_TCP_BUF->seqno[3] = uip_connr->snd_nxt[3];
+#if UIP_TCP_SEND_WINDOW > 1
+  if(snd_off > 0) {
+    /* New data is sent after the data that is already in flight. */
+    uip_add32(UIP_TCP_BUF->seqno, snd_off);
+    UIP_TCP_BUF->seqno[0] = uip_acc32[0];
+    UIP_TCP_BUF->seqno[1] = uip_acc32[1];
+    UIP_TCP_BUF->seqno[2] = uip_acc32[2];
+    UIP_TCP_BUF->seqno[3] = uip_acc32[3];
+  }
+#endif /* UIP_TCP_SEND_WINDOW > 1 */
 
   UIP_TCP_BUF->srcport  = uip_connr->lport;
   UIP_TCP_BUF->destport = uip_connr->rport;
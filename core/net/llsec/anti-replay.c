@@ -46,23 +46,129 @@
 #include "net/llsec/anti-replay.h"
 #include "net/packetbuf.h"
 #include "net/llsec/llsec802154.h"
+#include "lib/memb.h"
+#include <string.h>
+#if ANTI_REPLAY_WITH_PERSISTENCE
+#include "cfs/cfs.h"
+#endif /* ANTI_REPLAY_WITH_PERSISTENCE */
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else /* DEBUG */
+#define PRINTF(...)
+#endif /* DEBUG */
 
 #if LLSEC802154_USES_FRAME_COUNTER
 
+struct anti_replay_entry {
+  struct anti_replay_entry *next;
+  linkaddr_t addr;
+  struct anti_replay_info info;
+};
+
 /* This node's current frame counter value */
 static uint32_t counter;
 
+MEMB(entries_memb, struct anti_replay_entry, ANTI_REPLAY_MAX_NEIGHBORS);
+static struct anti_replay_entry *buckets[ANTI_REPLAY_HASH_SIZE];
+
+#if ANTI_REPLAY_WITH_PERSISTENCE
+/* First counter value that has not been reserved in CFS yet */
+static uint32_t reserved;
+static int fd = -1;
+#endif /* ANTI_REPLAY_WITH_PERSISTENCE */
+
+/*---------------------------------------------------------------------------*/
+#if ANTI_REPLAY_WITH_PERSISTENCE
+/*
+ * Reservations are written to consecutive slots, so that a flash page is
+ * not rewritten on every reservation. The slot holding the highest value
+ * is the most recent one. The file stays open, as some CFS backends
+ * truncate files that are opened for writing.
+ */
+static int
+write_reservation(uint32_t value)
+{
+  if(fd < 0) {
+    fd = cfs_open(ANTI_REPLAY_FILENAME, CFS_WRITE | CFS_READ);
+    if(fd < 0) {
+      return 0;
+    }
+  }
+  return cfs_seek(fd,
+      ((value / ANTI_REPLAY_COUNTER_RESERVE) % ANTI_REPLAY_PERSISTENCE_SLOTS)
+      * sizeof(value), CFS_SEEK_SET) >= 0
+      && cfs_write(fd, &value, sizeof(value)) == sizeof(value);
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t
+read_reservation(void)
+{
+  int rfd;
+  uint32_t value;
+  uint32_t highest;
+  
+  highest = 0;
+  rfd = cfs_open(ANTI_REPLAY_FILENAME, CFS_READ);
+  if(rfd < 0) {
+    return highest;
+  }
+  while(cfs_read(rfd, &value, sizeof(value)) == sizeof(value)) {
+    /* erased flash reads as all ones */
+    if(value != 0xFFFFFFFF && value > highest) {
+      highest = value;
+    }
+  }
+  cfs_close(rfd);
+  return highest;
+}
+/*---------------------------------------------------------------------------*/
+static int
+reserve_counters(void)
+{
+  if(!write_reservation(reserved + ANTI_REPLAY_COUNTER_RESERVE)) {
+    PRINTF("anti-replay: could not persist frame counter\n");
+    return 0;
+  }
+  reserved += ANTI_REPLAY_COUNTER_RESERVE;
+  return 1;
+}
+#endif /* ANTI_REPLAY_WITH_PERSISTENCE */
 /*---------------------------------------------------------------------------*/
 void
+anti_replay_init(void)
+{
+  memb_init(&entries_memb);
+  memset(buckets, 0, sizeof(buckets));
+  
+#if ANTI_REPLAY_WITH_PERSISTENCE
+  /* counters up to the last reservation may have been used before reboot */
+  reserved = read_reservation();
+  counter = reserved;
+  reserve_counters();
+  PRINTF("anti-replay: resuming at frame counter %"PRIu32"\n", counter);
+#endif /* ANTI_REPLAY_WITH_PERSISTENCE */
+}
+/*---------------------------------------------------------------------------*/
+int
 anti_replay_set_counter(void)
 {
   frame802154_frame_counter_t reordered_counter;
   
+#if ANTI_REPLAY_WITH_PERSISTENCE
+  /* a counter value that is not reserved could be reused after a reboot */
+  if(counter + 1 >= reserved && !reserve_counters()) {
+    return 0;
+  }
+#endif /* ANTI_REPLAY_WITH_PERSISTENCE */
   ++counter;
   reordered_counter.u32 = LLSEC802154_HTONL(counter);
   
   packetbuf_set_attr(PACKETBUF_ATTR_FRAME_COUNTER_BYTES_0_1, reordered_counter.u16[0]);
   packetbuf_set_attr(PACKETBUF_ATTR_FRAME_COUNTER_BYTES_2_3, reordered_counter.u16[1]);
+  return 1;
 }
 /*---------------------------------------------------------------------------*/
 uint32_t
@@ -110,6 +216,58 @@ anti_replay_was_replayed(struct anti_replay_info *info)
   }
 }
 /*---------------------------------------------------------------------------*/
+static struct anti_replay_entry **
+bucket_of(const linkaddr_t *addr)
+{
+  return &buckets[(addr->u8[LINKADDR_SIZE - 1]
+      ^ (addr->u8[LINKADDR_SIZE - 2] << 1)) & (ANTI_REPLAY_HASH_SIZE - 1)];
+}
+/*---------------------------------------------------------------------------*/
+struct anti_replay_info *
+anti_replay_lookup(const linkaddr_t *addr)
+{
+  struct anti_replay_entry *e;
+  
+  for(e = *bucket_of(addr); e != NULL; e = e->next) {
+    if(linkaddr_cmp(&e->addr, addr)) {
+      return &e->info;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+struct anti_replay_info *
+anti_replay_add(const linkaddr_t *addr)
+{
+  struct anti_replay_entry **bucket;
+  struct anti_replay_entry *e;
+  
+  e = memb_alloc(&entries_memb);
+  if(e == NULL) {
+    return NULL;
+  }
+  linkaddr_copy(&e->addr, addr);
+  bucket = bucket_of(addr);
+  e->next = *bucket;
+  *bucket = e;
+  return &e->info;
+}
+/*---------------------------------------------------------------------------*/
+void
+anti_replay_remove(const linkaddr_t *addr)
+{
+  struct anti_replay_entry **prev;
+  struct anti_replay_entry *e;
+  
+  for(prev = bucket_of(addr); (e = *prev) != NULL; prev = &e->next) {
+    if(linkaddr_cmp(&e->addr, addr)) {
+      *prev = e->next;
+      memb_free(&entries_memb, e);
+      return;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
 #endif /* LLSEC802154_USES_FRAME_COUNTER */
 
 /** @} */
@@ -46,6 +46,51 @@
 #define ANTI_REPLAY_H
 
 #include "contiki.h"
+#include "net/linkaddr.h"
+#include "net/nbr-table.h"
+
+#ifdef ANTI_REPLAY_CONF_MAX_NEIGHBORS
+#define ANTI_REPLAY_MAX_NEIGHBORS ANTI_REPLAY_CONF_MAX_NEIGHBORS
+#else /* ANTI_REPLAY_CONF_MAX_NEIGHBORS */
+#define ANTI_REPLAY_MAX_NEIGHBORS NBR_TABLE_MAX_NEIGHBORS
+#endif /* ANTI_REPLAY_CONF_MAX_NEIGHBORS */
+
+/* Number of hash buckets for neighbor lookups, must be a power of two */
+#ifdef ANTI_REPLAY_CONF_HASH_SIZE
+#define ANTI_REPLAY_HASH_SIZE ANTI_REPLAY_CONF_HASH_SIZE
+#else /* ANTI_REPLAY_CONF_HASH_SIZE */
+#define ANTI_REPLAY_HASH_SIZE 8
+#endif /* ANTI_REPLAY_CONF_HASH_SIZE */
+
+/*
+ * When enabled, the outgoing frame counter survives reboots. Blocks of
+ * ANTI_REPLAY_COUNTER_RESERVE counter values are reserved in CFS ahead of
+ * use, so that flash is only written once per block. The reservations
+ * rotate through ANTI_REPLAY_PERSISTENCE_SLOTS records to spread wear.
+ */
+#ifdef ANTI_REPLAY_CONF_WITH_PERSISTENCE
+#define ANTI_REPLAY_WITH_PERSISTENCE ANTI_REPLAY_CONF_WITH_PERSISTENCE
+#else /* ANTI_REPLAY_CONF_WITH_PERSISTENCE */
+#define ANTI_REPLAY_WITH_PERSISTENCE 0
+#endif /* ANTI_REPLAY_CONF_WITH_PERSISTENCE */
+
+#ifdef ANTI_REPLAY_CONF_COUNTER_RESERVE
+#define ANTI_REPLAY_COUNTER_RESERVE ANTI_REPLAY_CONF_COUNTER_RESERVE
+#else /* ANTI_REPLAY_CONF_COUNTER_RESERVE */
+#define ANTI_REPLAY_COUNTER_RESERVE 1024
+#endif /* ANTI_REPLAY_CONF_COUNTER_RESERVE */
+
+#ifdef ANTI_REPLAY_CONF_PERSISTENCE_SLOTS
+#define ANTI_REPLAY_PERSISTENCE_SLOTS ANTI_REPLAY_CONF_PERSISTENCE_SLOTS
+#else /* ANTI_REPLAY_CONF_PERSISTENCE_SLOTS */
+#define ANTI_REPLAY_PERSISTENCE_SLOTS 8
+#endif /* ANTI_REPLAY_CONF_PERSISTENCE_SLOTS */
+
+#ifdef ANTI_REPLAY_CONF_FILENAME
+#define ANTI_REPLAY_FILENAME ANTI_REPLAY_CONF_FILENAME
+#else /* ANTI_REPLAY_CONF_FILENAME */
+#define ANTI_REPLAY_FILENAME "llsec-fc"
+#endif /* ANTI_REPLAY_CONF_FILENAME */
 
 struct anti_replay_info {
   uint32_t last_broadcast_counter;
@@ -53,9 +98,17 @@ struct anti_replay_info {
 };
 
 /**
- * \brief Sets the frame counter packetbuf attributes.
+ * \brief Initializes the frame counter and the neighbor table. Restores
+ *        the outgoing frame counter from CFS if persistence is enabled.
+ */
+void anti_replay_init(void);
+
+/**
+ * \brief         Sets the frame counter packetbuf attributes.
+ * \retval 0      <-> no frame counter could be reserved in CFS, so the
+ *                frame must not be sent. Later calls retry the reservation.
  */
-void anti_replay_set_counter(void);
+int anti_replay_set_counter(void);
 
 /**
  * \brief Gets the frame counter from packetbuf.
@@ -75,6 +128,26 @@ void anti_replay_init_info(struct anti_replay_info *info);
  */
 int anti_replay_was_replayed(struct anti_replay_info *info);
 
+/**
+ * \brief         Looks up the anti-replay information of a neighbor
+ * \param addr    Link-layer address of the neighbor
+ * \return        The information, or NULL if the neighbor is unknown
+ */
+struct anti_replay_info *anti_replay_lookup(const linkaddr_t *addr);
+
+/**
+ * \brief         Allocates anti-replay information for a new neighbor
+ * \param addr    Link-layer address of the neighbor
+ * \return        The uninitialized information, or NULL if the table is full
+ */
+struct anti_replay_info *anti_replay_add(const linkaddr_t *addr);
+
+/**
+ * \brief         Forgets the anti-replay information of a neighbor
+ * \param addr    Link-layer address of the neighbor
+ */
+void anti_replay_remove(const linkaddr_t *addr);
+
 #endif /* ANTI_REPLAY_H */
 
 /** @} */
@@ -49,7 +49,6 @@
 #include "net/mac/frame802154.h"
 #include "net/netstack.h"
 #include "net/packetbuf.h"
-#include "net/nbr-table.h"
 #include "net/linkaddr.h"
 #include "lib/ccm-star.h"
 #include <string.h>
@@ -94,7 +93,6 @@ extern const struct framer DECORATED_FRAMER;
 
 /* network-wide CCM* key */
 static uint8_t key[16] = NONCORESEC_KEY;
-NBR_TABLE(struct anti_replay_info, anti_replay_table);
 
 /*---------------------------------------------------------------------------*/
 static int
@@ -151,7 +149,11 @@ static void
 send(mac_callback_t sent, void *ptr)
 {
   add_security_header();
-  anti_replay_set_counter();
+  if(!anti_replay_set_counter()) {
+    PRINTF("noncoresec: no frame counter available\n");
+    mac_call_sent_callback(sent, ptr, MAC_TX_ERR_FATAL, 0);
+    return;
+  }
   NETSTACK_MAC.send(sent, ptr);
 }
 /*---------------------------------------------------------------------------*/
@@ -200,28 +202,20 @@ parse(void)
     return FRAMER_FAILED;
   }
   
-  info = nbr_table_get_from_lladdr(anti_replay_table, sender);
+  info = anti_replay_lookup(sender);
   if(!info) {
-    info = nbr_table_add_lladdr(anti_replay_table, sender, NBR_TABLE_REASON_LLSEC, NULL);
-    if(!info) {
-      PRINTF("noncoresec: could not get nbr_table_item\n");
-      return FRAMER_FAILED;
-    }
-    
     /*
-     * Locking avoids replay attacks due to removed neighbor table items.
-     * Unfortunately, an attacker can mount a memory-based DoS attack
-     * on this by replaying broadcast frames from other network parts.
-     * However, this is not an issue as long as the network size does not
-     * exceed NBR_TABLE_MAX_NEIGHBORS.
-     *  
-     * To avoid locking, we could swap anti-replay information
-     * to external flash. Locking is also unnecessary when using
-     * pairwise session keys, as done in coresec.
+     * Anti-replay information is kept apart from the neighbor tables, so
+     * that entries are never evicted by other layers. Unfortunately, an
+     * attacker can mount a memory-based DoS attack on this by replaying
+     * broadcast frames from other network parts. However, this is not an
+     * issue as long as the network size does not exceed
+     * ANTI_REPLAY_MAX_NEIGHBORS. Pairwise session keys, as used in coresec,
+     * avoid this problem.
      */
-    if(!nbr_table_lock(anti_replay_table, info)) {
-      nbr_table_remove(anti_replay_table, info);
-      PRINTF("noncoresec: could not lock\n");
+    info = anti_replay_add(sender);
+    if(!info) {
+      PRINTF("noncoresec: could not allocate anti-replay information\n");
       return FRAMER_FAILED;
     }
     
@@ -254,7 +248,7 @@ static void
 init(void)
 {
   CCM_STAR.set_key(key);
-  nbr_table_register(anti_replay_table, NULL);
+  anti_replay_init();
 }
 /*---------------------------------------------------------------------------*/
 const struct llsec_driver noncoresec_driver = {
@@ -93,20 +93,74 @@
 #define CSMA_MAX_MAX_FRAME_RETRIES 7
 #endif
 
+/* Serve neighbor queues one at a time in deficit round-robin order,
+   dropping the oldest packet of the longest queue when the global queue
+   budget is exhausted. Without it, every neighbor queue is scheduled
+   independently. */
+#ifdef CSMA_CONF_FAIR_QUEUING
+#define CSMA_FAIR_QUEUING CSMA_CONF_FAIR_QUEUING
+#else
+#define CSMA_FAIR_QUEUING 0
+#endif
+
+/* Bytes credited to a neighbor queue per round. Should be at least the
+   maximum frame size, so that every round sends at least one frame. */
+#ifdef CSMA_CONF_DRR_QUANTUM
+#define CSMA_DRR_QUANTUM CSMA_CONF_DRR_QUANTUM
+#else
+#define CSMA_DRR_QUANTUM 127
+#endif
+
+/* A queue only sends one frame per turn, so the credit it has left is
+   capped at what its next turn could need */
+#define DRR_MAX_DEFICIT (CSMA_DRR_QUANTUM + PACKETBUF_SIZE)
+
+/* Packets that waited longer than this many clock ticks are dropped before
+   their first transmission (fair queuing only). 0 disables the limit. */
+#ifdef CSMA_CONF_MAX_SOJOURN_TIME
+#define CSMA_MAX_SOJOURN_TIME CSMA_CONF_MAX_SOJOURN_TIME
+#else
+#define CSMA_MAX_SOJOURN_TIME 0
+#endif
+
+/* Number of buckets of the neighbor queue hash (power of two, at most 256) */
+#ifdef CSMA_CONF_NEIGHBOR_HASH_SIZE
+#define CSMA_NEIGHBOR_HASH_SIZE CSMA_CONF_NEIGHBOR_HASH_SIZE
+#else
+#define CSMA_NEIGHBOR_HASH_SIZE 4
+#endif
+#if CSMA_NEIGHBOR_HASH_SIZE == 0 || \
+    (CSMA_NEIGHBOR_HASH_SIZE & (CSMA_NEIGHBOR_HASH_SIZE - 1))
+#error "CSMA_NEIGHBOR_HASH_SIZE must be a power of two"
+#endif
+#if CSMA_NEIGHBOR_HASH_SIZE > 256
+#error "CSMA_NEIGHBOR_HASH_SIZE must be at most 256"
+#endif
+
+#define CSMA_WITH_TIMESTAMPS (CSMA_WITH_STATS || CSMA_MAX_SOJOURN_TIME)
+
 /* Packet metadata */
 struct qbuf_metadata {
   mac_callback_t sent;
   void *cptr;
   uint8_t max_transmissions;
+#if CSMA_WITH_TIMESTAMPS
+  clock_time_t enqueued;
+#endif
 };
 
 /* Every neighbor has its own packet queue */
 struct neighbor_queue {
   struct neighbor_queue *next;
+  struct neighbor_queue *hash_next;
   linkaddr_t addr;
   struct ctimer transmit_timer;
   uint8_t transmissions;
   uint8_t collisions;
+#if CSMA_FAIR_QUEUING
+  uint8_t ready;
+  int16_t deficit;
+#endif
   LIST_STRUCT(queued_packet_list);
 };
 
@@ -129,23 +183,100 @@ MEMB(neighbor_memb, struct neighbor_queue, CSMA_MAX_NEIGHBOR_QUEUES);
 MEMB(packet_memb, struct rdc_buf_list, MAX_QUEUED_PACKETS);
 MEMB(metadata_memb, struct qbuf_metadata, MAX_QUEUED_PACKETS);
 LIST(neighbor_list);
+static struct neighbor_queue *neighbor_hash[CSMA_NEIGHBOR_HASH_SIZE];
+
+#if CSMA_FAIR_QUEUING
+/* The neighbor whose round it is, and the one currently using the radio */
+static struct neighbor_queue *drr_next;
+static struct neighbor_queue *drr_inflight;
+static uint8_t drr_credited;
+static struct ctimer drr_timer;
+static void drr_schedule(void);
+
+/* Once the RDC is done with a frame of the neighbor that has the radio,
+   let the next queue have its turn. n may have been freed already. */
+#define DRR_RELEASE(n, status) do {                                     \
+    if((status) != MAC_TX_DEFERRED && drr_inflight == (n)) {            \
+      drr_inflight = NULL;                                              \
+      drr_schedule();                                                   \
+    }                                                                   \
+  } while(0)
+#else /* CSMA_FAIR_QUEUING */
+#define DRR_RELEASE(n, status)
+#endif /* CSMA_FAIR_QUEUING */
+
+#if CSMA_WITH_STATS
+static struct csma_stats stats;
+#define STATS_ADD(x, n) stats.x += (n)
+#else
+#define STATS_ADD(x, n)
+#endif
 
 static void packet_sent(void *ptr, int status, int num_transmissions);
 static void transmit_packet_list(void *ptr);
 /*---------------------------------------------------------------------------*/
+static uint8_t
+neighbor_hash_index(const linkaddr_t *addr)
+{
+  uint8_t h = 0;
+  int i;
+
+  for(i = 0; i < LINKADDR_SIZE; i++) {
+    h ^= addr->u8[i];
+  }
+  return h & (CSMA_NEIGHBOR_HASH_SIZE - 1);
+}
+/*---------------------------------------------------------------------------*/
 static struct neighbor_queue *
 neighbor_queue_from_addr(const linkaddr_t *addr)
 {
-  struct neighbor_queue *n = list_head(neighbor_list);
+  struct neighbor_queue *n = neighbor_hash[neighbor_hash_index(addr)];
   while(n != NULL) {
     if(linkaddr_cmp(&n->addr, addr)) {
       return n;
     }
-    n = list_item_next(n);
+    n = n->hash_next;
   }
   return NULL;
 }
 /*---------------------------------------------------------------------------*/
+static void
+neighbor_queue_add(struct neighbor_queue *n)
+{
+  uint8_t h = neighbor_hash_index(&n->addr);
+
+  n->hash_next = neighbor_hash[h];
+  neighbor_hash[h] = n;
+  list_add(neighbor_list, n);
+}
+/*---------------------------------------------------------------------------*/
+static void
+neighbor_queue_free(struct neighbor_queue *n)
+{
+  struct neighbor_queue **p;
+
+  for(p = &neighbor_hash[neighbor_hash_index(&n->addr)]; *p != NULL;
+      p = &(*p)->hash_next) {
+    if(*p == n) {
+      *p = n->hash_next;
+      break;
+    }
+  }
+#if CSMA_FAIR_QUEUING
+  if(drr_next == n) {
+    drr_next = list_item_next(n);
+    drr_credited = 0;
+  }
+  if(drr_inflight == n) {
+    drr_inflight = NULL;
+    drr_schedule();
+  }
+#endif /* CSMA_FAIR_QUEUING */
+  ctimer_stop(&n->transmit_timer);
+  list_remove(neighbor_list, n);
+  memb_free(&neighbor_memb, n);
+}
+/*---------------------------------------------------------------------------*/
 static clock_time_t
 backoff_period(void)
 {
@@ -164,17 +295,29 @@ backoff_period(void)
 }
 /*---------------------------------------------------------------------------*/
 static void
+send_head(struct neighbor_queue *n)
+{
+  struct rdc_buf_list *q = list_head(n->queued_packet_list);
+  if(q != NULL) {
+    PRINTF("csma: preparing number %d %p, queue len %d\n", n->transmissions, q,
+        list_length(n->queued_packet_list));
+    /* Send packets in the neighbor's list */
+    NETSTACK_RDC.send_list(packet_sent, n, q);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
 transmit_packet_list(void *ptr)
 {
   struct neighbor_queue *n = ptr;
   if(n) {
-    struct rdc_buf_list *q = list_head(n->queued_packet_list);
-    if(q != NULL) {
-      PRINTF("csma: preparing number %d %p, queue len %d\n", n->transmissions, q,
-          list_length(n->queued_packet_list));
-      /* Send packets in the neighbor's list */
-      NETSTACK_RDC.send_list(packet_sent, n, q);
-    }
+#if CSMA_FAIR_QUEUING
+    /* Backoff is over, wait for our turn */
+    n->ready = 1;
+    drr_schedule();
+#else /* CSMA_FAIR_QUEUING */
+    send_head(n);
+#endif /* CSMA_FAIR_QUEUING */
   }
 }
 /*---------------------------------------------------------------------------*/
@@ -195,6 +338,9 @@ schedule_transmission(struct neighbor_queue *n)
 
   PRINTF("csma: scheduling transmission in %u ticks, NB=%u, BE=%u\n",
       (unsigned)delay, n->collisions, backoff_exponent);
+#if CSMA_FAIR_QUEUING
+  n->ready = 0;
+#endif
   ctimer_set(&n->transmit_timer, delay, transmit_packet_list, n);
 }
 /*---------------------------------------------------------------------------*/
@@ -205,6 +351,19 @@ free_packet(struct neighbor_queue *n, struct rdc_buf_list *p, int status)
     /* Remove packet from list and deallocate */
     list_remove(n->queued_packet_list, p);
 
+#if CSMA_WITH_STATS
+    {
+      clock_time_t sojourn;
+
+      sojourn = clock_time() - ((struct qbuf_metadata *)p->ptr)->enqueued;
+      stats.sojourn_total += sojourn;
+      if(sojourn > stats.sojourn_max) {
+        stats.sojourn_max = sojourn;
+      }
+      stats.completed++;
+      stats.queued--;
+    }
+#endif /* CSMA_WITH_STATS */
     queuebuf_free(p->buf);
     memb_free(&metadata_memb, p->ptr);
     memb_free(&packet_memb, p);
@@ -218,9 +377,7 @@ free_packet(struct neighbor_queue *n, struct rdc_buf_list *p, int status)
       schedule_transmission(n);
     } else {
       /* This was the last packet in the queue, we free the neighbor */
-      ctimer_stop(&n->transmit_timer);
-      list_remove(neighbor_list, n);
-      memb_free(&neighbor_memb, n);
+      neighbor_queue_free(n);
     }
   }
 }
@@ -231,6 +388,7 @@ tx_done(int status, struct rdc_buf_list *q, struct neighbor_queue *n)
   mac_callback_t sent;
   struct qbuf_metadata *metadata;
   void *cptr;
+  uint8_t num_transmissions;
 
   metadata = (struct qbuf_metadata *)q->ptr;
   sent = metadata->sent;
@@ -244,19 +402,23 @@ tx_done(int status, struct rdc_buf_list *q, struct neighbor_queue *n)
   case MAC_TX_NOACK:
     PRINTF("csma: drop with status %d after %d transmissions, %d collisions\n",
                  status, n->transmissions, n->collisions);
+    STATS_ADD(drops_tx, 1);
     break;
   default:
     PRINTF("csma: rexmit failed %d: %d\n", n->transmissions, status);
     break;
   }
 
+  /* free_packet() may release the neighbor entry */
+  num_transmissions = n->transmissions;
   free_packet(n, q, status);
-  mac_call_sent_callback(sent, cptr, status, n->transmissions);
+  mac_call_sent_callback(sent, cptr, status, num_transmissions);
 }
 /*---------------------------------------------------------------------------*/
 static void
 rexmit(struct rdc_buf_list *q, struct neighbor_queue *n)
 {
+  STATS_ADD(retries, 1);
   schedule_transmission(n);
   /* This is needed to correctly attribute energy that we spent
      transmitting this packet. */
@@ -336,9 +498,11 @@ packet_sent(void *ptr, int status, int num_transmissions)
   if(q == NULL) {
     PRINTF("csma: seqno %d not found\n",
            packetbuf_attr(PACKETBUF_ATTR_MAC_SEQNO));
+    DRR_RELEASE(n, status);
     return;
   } else if(q->ptr == NULL) {
     PRINTF("csma: no metadata\n");
+    DRR_RELEASE(n, status);
     return;
   }
 
@@ -358,8 +522,163 @@ packet_sent(void *ptr, int status, int num_transmissions)
     tx_done(status, q, n);
     break;
   }
+
+  DRR_RELEASE(n, status);
 }
 /*---------------------------------------------------------------------------*/
+#if CSMA_FAIR_QUEUING
+static void
+drop_packet(struct neighbor_queue *n, struct rdc_buf_list *q)
+{
+  struct qbuf_metadata *metadata = (struct qbuf_metadata *)q->ptr;
+  mac_callback_t sent = metadata->sent;
+  void *cptr = metadata->cptr;
+
+  if(q == list_head(n->queued_packet_list)) {
+    /* free_packet() restarts the neighbor with its next packet */
+    free_packet(n, q, MAC_TX_ERR);
+  } else {
+#if CSMA_WITH_STATS
+    stats.queued--;
+    stats.completed++;
+#endif
+    list_remove(n->queued_packet_list, q);
+    queuebuf_free(q->buf);
+    memb_free(&metadata_memb, q->ptr);
+    memb_free(&packet_memb, q);
+  }
+  mac_call_sent_callback(sent, cptr, MAC_TX_ERR, 0);
+}
+/*---------------------------------------------------------------------------*/
+/* Frees room for one packet by dropping the oldest packet of the longest
+   queue, skipping a frame that the radio is currently working on. The
+   queue keep is never emptied, as its neighbor entry is in use. */
+static int
+drop_from_longest_queue(struct neighbor_queue *keep)
+{
+  struct neighbor_queue *n;
+  struct neighbor_queue *longest = NULL;
+  struct rdc_buf_list *q;
+  int len;
+  int longest_len = 0;
+
+  for(n = list_head(neighbor_list); n != NULL; n = list_item_next(n)) {
+    len = list_length(n->queued_packet_list);
+    if(n == drr_inflight || n->transmissions > 0) {
+      /* the head is in flight or being retried */
+      len--;
+    } else if(n == keep && len == 1) {
+      continue;
+    }
+    if(len > longest_len) {
+      longest = n;
+      longest_len = len;
+    }
+  }
+
+  if(longest == NULL) {
+    return 0;
+  }
+
+  q = list_head(longest->queued_packet_list);
+  if(longest == drr_inflight || longest->transmissions > 0) {
+    q = list_item_next(q);
+  }
+  PRINTF("csma: queue budget exhausted, head-dropping %p\n", q);
+  STATS_ADD(drops_full, 1);
+  drop_packet(longest, q);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+#if CSMA_MAX_SOJOURN_TIME
+static void
+drop_stale_packets(struct neighbor_queue *n)
+{
+  struct rdc_buf_list *q;
+  struct rdc_buf_list *next;
+  struct qbuf_metadata *metadata;
+
+  for(q = list_head(n->queued_packet_list); q != NULL; q = next) {
+    next = list_item_next(q);
+    metadata = (struct qbuf_metadata *)q->ptr;
+    if((q != list_head(n->queued_packet_list) || n->transmissions == 0)
+       && clock_time() - metadata->enqueued > CSMA_MAX_SOJOURN_TIME) {
+      PRINTF("csma: dropping stale packet %p\n", q);
+      STATS_ADD(drops_stale, 1);
+      if(list_length(n->queued_packet_list) == 1) {
+        /* n is freed with its last packet */
+        drop_packet(n, q);
+        return;
+      }
+      drop_packet(n, q);
+    }
+  }
+}
+#endif /* CSMA_MAX_SOJOURN_TIME */
+/*---------------------------------------------------------------------------*/
+static void
+drr_service(void *ptr)
+{
+  struct neighbor_queue *n;
+  struct rdc_buf_list *q;
+  int visits;
+  int len;
+
+  /* Two passes: one to credit every ready queue, one to serve it */
+  for(visits = 2 * list_length(neighbor_list); visits > 0; visits--) {
+    if(drr_inflight != NULL) {
+      return;
+    }
+    if(drr_next == NULL) {
+      drr_next = list_head(neighbor_list);
+      drr_credited = 0;
+      if(drr_next == NULL) {
+        return;
+      }
+    }
+    n = drr_next;
+
+#if CSMA_MAX_SOJOURN_TIME
+    if(n->ready) {
+      drop_stale_packets(n);
+      if(drr_next != n) {
+        /* n is gone along with its stale packets */
+        continue;
+      }
+    }
+#endif /* CSMA_MAX_SOJOURN_TIME */
+    if(n->ready) {
+      q = list_head(n->queued_packet_list);
+      len = queuebuf_datalen(q->buf);
+      if(!drr_credited) {
+        n->deficit = MIN(n->deficit + CSMA_DRR_QUANTUM, DRR_MAX_DEFICIT);
+        drr_credited = 1;
+      }
+      if(n->deficit >= len) {
+        n->deficit -= len;
+        drr_inflight = n;
+        send_head(n);
+        return;
+      }
+    }
+
+    /* End of this queue's round */
+    drr_next = list_item_next(n);
+    drr_credited = 0;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+drr_schedule(void)
+{
+  /* Always go through a timer so that transmissions do not nest inside
+     the RDC callbacks */
+  if(drr_inflight == NULL) {
+    ctimer_set(&drr_timer, 0, drr_service, NULL);
+  }
+}
+#endif /* CSMA_FAIR_QUEUING */
+/*---------------------------------------------------------------------------*/
 static void
 send_packet(mac_callback_t sent, void *ptr)
 {
@@ -392,16 +711,25 @@ send_packet(mac_callback_t sent, void *ptr)
       linkaddr_copy(&n->addr, addr);
       n->transmissions = 0;
       n->collisions = CSMA_MIN_BE;
+#if CSMA_FAIR_QUEUING
+      n->ready = 0;
+      n->deficit = 0;
+#endif
       /* Init packet list for this neighbor */
       LIST_STRUCT_INIT(n, queued_packet_list);
       /* Add neighbor to the list */
-      list_add(neighbor_list, n);
+      neighbor_queue_add(n);
     }
   }
 
   if(n != NULL) {
     /* Add packet to the neighbor's queue */
     if(list_length(n->queued_packet_list) < CSMA_MAX_PACKET_PER_NEIGHBOR) {
+#if CSMA_FAIR_QUEUING
+      if(memb_numfree(&packet_memb) == 0) {
+        drop_from_longest_queue(n);
+      }
+#endif /* CSMA_FAIR_QUEUING */
       q = memb_alloc(&packet_memb);
       if(q != NULL) {
         q->ptr = memb_alloc(&metadata_memb);
@@ -419,6 +747,15 @@ send_packet(mac_callback_t sent, void *ptr)
             }
             metadata->sent = sent;
             metadata->cptr = ptr;
+#if CSMA_WITH_TIMESTAMPS
+            metadata->enqueued = clock_time();
+#endif
+#if CSMA_WITH_STATS
+            stats.enqueued++;
+            if(++stats.queued > stats.max_queued) {
+              stats.max_queued = stats.queued;
+            }
+#endif /* CSMA_WITH_STATS */
 #if PACKETBUF_WITH_PACKET_TYPE
             if(packetbuf_attr(PACKETBUF_ATTR_PACKET_TYPE) ==
                PACKETBUF_ATTR_PACKET_TYPE_ACK) {
@@ -445,15 +782,16 @@ send_packet(mac_callback_t sent, void *ptr)
       }
       /* The packet allocation failed. Remove and free neighbor entry if empty. */
       if(list_length(n->queued_packet_list) == 0) {
-        list_remove(neighbor_list, n);
-        memb_free(&neighbor_memb, n);
+        neighbor_queue_free(n);
       }
     } else {
       PRINTF("csma: Neighbor queue full\n");
     }
+    STATS_ADD(drops_full, 1);
     PRINTF("csma: could not allocate packet, dropping packet\n");
   } else {
     PRINTF("csma: could not allocate neighbor, dropping packet\n");
+    STATS_ADD(drops_full, 1);
   }
   mac_call_sent_callback(sent, ptr, MAC_TX_ERR, 1);
 }
@@ -485,6 +823,32 @@ channel_check_interval(void)
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+#if CSMA_WITH_STATS
+const struct csma_stats *
+csma_get_stats(void)
+{
+  return &stats;
+}
+/*---------------------------------------------------------------------------*/
+void
+csma_reset_stats(void)
+{
+  uint16_t queued = stats.queued;
+
+  memset(&stats, 0, sizeof(stats));
+  stats.queued = queued;
+  stats.max_queued = queued;
+}
+#endif /* CSMA_WITH_STATS */
+/*---------------------------------------------------------------------------*/
+int
+csma_neighbor_queue_length(const linkaddr_t *addr)
+{
+  struct neighbor_queue *n = neighbor_queue_from_addr(addr);
+
+  return n != NULL ? list_length(n->queued_packet_list) : 0;
+}
+/*---------------------------------------------------------------------------*/
 static void
 init(void)
 {
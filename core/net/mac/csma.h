@@ -43,9 +43,42 @@
 
 #include "net/mac/mac.h"
 #include "dev/radio.h"
+#include "net/linkaddr.h"
+#include "sys/clock.h"
+
+/* Keep the counters that csma_get_stats() reports */
+#ifdef CSMA_CONF_WITH_STATS
+#define CSMA_WITH_STATS CSMA_CONF_WITH_STATS
+#else
+#define CSMA_WITH_STATS 0
+#endif
+
+/* Counters kept when CSMA_CONF_WITH_STATS is set. Sojourn times are
+   measured in clock ticks from enqueueing until the packet leaves the
+   queue, whatever its fate. */
+struct csma_stats {
+  uint16_t queued;          /* packets currently queued */
+  uint16_t max_queued;      /* high-water mark of queued packets */
+  uint32_t enqueued;        /* packets accepted into a queue */
+  uint32_t completed;       /* packets that left a queue */
+  uint32_t retries;         /* retransmissions after collision or no ACK */
+  uint32_t drops_full;      /* packets dropped for lack of queue space */
+  uint32_t drops_stale;     /* packets dropped after CSMA_CONF_MAX_SOJOURN_TIME */
+  uint32_t drops_tx;        /* packets dropped after exhausting retransmissions */
+  uint32_t sojourn_total;   /* sum of sojourn times of completed packets */
+  clock_time_t sojourn_max; /* longest sojourn time */
+};
 
 extern const struct mac_driver csma_driver;
 
+#if CSMA_WITH_STATS
+const struct csma_stats *csma_get_stats(void);
+void csma_reset_stats(void);
+#endif /* CSMA_WITH_STATS */
+
+/* Number of packets queued for the neighbor addr */
+int csma_neighbor_queue_length(const linkaddr_t *addr);
+
 const struct mac_driver *csma_init(const struct mac_driver *r);
 
 #endif /* CSMA_H_ */
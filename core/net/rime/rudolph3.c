@@ -0,0 +1,447 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Rudolph3: an erasure coded block data flooding protocol
+ */
+
+/**
+ * \addtogroup rudolph3
+ * @{
+ */
+
+#include <string.h>
+
+#include "net/rime/rime.h"
+#include "net/rime/polite.h"
+#include "net/rime/rudolph3.h"
+#include "lib/random.h"
+
+#define SEND_INTERVAL CLOCK_SECOND / 2
+#define STEADY_INTERVAL CLOCK_SECOND * 16
+#define REQ_TIMEOUT CLOCK_SECOND / 4
+/* Silence from upstream, in send intervals, before asking for the rest
+   of a page */
+#define NAK_INTERVALS 3
+/* Unit of the send interval in the header, up to 255 units */
+#define INTERVAL_UNIT (CLOCK_SECOND / 16 > 0 ? CLOCK_SECOND / 16 : 1)
+
+struct rudolph3_hdr {
+  uint8_t type;
+  uint8_t hops_from_base;
+  uint16_t version;
+  uint16_t page;
+  uint16_t pages;
+  uint16_t last_len;
+  /* Index of a data symbol, number of symbols missing in a request */
+  uint8_t index;
+  /* Send interval of a data symbol, in INTERVAL_UNIT */
+  uint8_t interval;
+};
+
+/* Suppress a packet on hearing one of the same type from a node just as
+   far from the base, but not on hearing the nodes of other hops, which
+   pass on other pages at the same time. */
+#define POLITE_HEADER 2
+
+#define HOPS_MAX 64
+
+enum {
+  TYPE_DATA,
+  TYPE_REQ,
+};
+
+#define FLAG_IS_STOPPED 0x01
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+#define LT(a, b) ((signed short)((a) - (b)) < 0)
+
+/*---------------------------------------------------------------------------*/
+static int
+read_data(struct rudolph3_conn *c, uint8_t *to, int offset, int len)
+{
+  int r = 0;
+
+  if(c->cb->read_chunk) {
+    r = c->cb->read_chunk(c, offset, to, len);
+  }
+  if(r < 0) {
+    r = 0;
+  }
+  /* The last page is padded with zeros */
+  memset(to + r, 0, len - r);
+  return r;
+}
+/*---------------------------------------------------------------------------*/
+static void
+format_symbol(struct rudolph3_conn *c, uint8_t *symbol)
+{
+  uint8_t tmp[RUDOLPH3_DATASIZE];
+  int offset = c->snd_page * RUDOLPH3_PAGESIZE;
+  uint8_t i;
+
+  if(c->snd_index < RUDOLPH3_PAGE_SYMBOLS) {
+    read_data(c, symbol, offset + c->snd_index * RUDOLPH3_DATASIZE,
+              RUDOLPH3_DATASIZE);
+    return;
+  }
+
+  /* A repair symbol, one source symbol at a time */
+  memset(symbol, 0, RUDOLPH3_DATASIZE);
+  for(i = 0; i < RUDOLPH3_PAGE_SYMBOLS; i++) {
+    read_data(c, tmp, offset + i * RUDOLPH3_DATASIZE, RUDOLPH3_DATASIZE);
+    erasure_code_mul_add(symbol, tmp,
+                         erasure_code_coeff(RUDOLPH3_PAGE_SYMBOLS,
+                                            c->snd_index, i),
+                         RUDOLPH3_DATASIZE);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_data(struct rudolph3_conn *c, clock_time_t interval)
+{
+  struct rudolph3_hdr *hdr;
+
+  packetbuf_clear();
+  hdr = packetbuf_dataptr();
+  hdr->type = TYPE_DATA;
+  hdr->hops_from_base = c->hops_from_base;
+  hdr->version = c->version;
+  hdr->page = c->snd_page;
+  hdr->pages = c->pages;
+  hdr->last_len = c->last_len;
+  hdr->index = c->snd_index;
+  if(c->send_interval / INTERVAL_UNIT >= 255) {
+    hdr->interval = 255;
+  } else if(c->send_interval < INTERVAL_UNIT) {
+    hdr->interval = 1;
+  } else {
+    hdr->interval = (c->send_interval + INTERVAL_UNIT / 2) / INTERVAL_UNIT;
+  }
+  format_symbol(c, (uint8_t *)hdr + sizeof(struct rudolph3_hdr));
+  packetbuf_set_datalen(sizeof(struct rudolph3_hdr) + RUDOLPH3_DATASIZE);
+
+  PRINTF("%d.%d: send page %d symbol %d\n",
+	 linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1],
+	 c->snd_page, c->snd_index);
+
+  /* Never repeat a symbol, even one that polite suppresses */
+  c->snd_index++;
+  polite_send(&c->c, interval, POLITE_HEADER);
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_req(struct rudolph3_conn *c)
+{
+  struct rudolph3_hdr *hdr;
+
+  packetbuf_clear();
+  packetbuf_hdralloc(sizeof(struct rudolph3_hdr));
+  hdr = packetbuf_hdrptr();
+  memset(hdr, 0, sizeof(struct rudolph3_hdr));
+  hdr->type = TYPE_REQ;
+  hdr->hops_from_base = c->hops_from_base;
+  hdr->version = c->version;
+  hdr->page = c->rcv_page;
+  hdr->index = erasure_decoder_missing(&c->dec);
+
+  PRINTF("%d.%d: request %d symbols of page %d\n",
+	 linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1],
+	 hdr->index, hdr->page);
+  polite_send(&c->c, REQ_TIMEOUT, POLITE_HEADER);
+}
+/*---------------------------------------------------------------------------*/
+static void
+req_timeout(void *ptr)
+{
+  struct rudolph3_conn *c = (struct rudolph3_conn *)ptr;
+
+  if(!(c->flags & FLAG_IS_STOPPED) && LT(c->rcv_page, c->pages)) {
+    send_req(c);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+start_page(struct rudolph3_conn *c, uint16_t page, uint8_t symbols,
+           uint8_t first)
+{
+  c->snd_page = page;
+  c->snd_left = symbols;
+  /* The base first sends a page with the source symbols, which are
+     cheapest to decode. Repeats, and other nodes, start anywhere among
+     the repair symbols, so that a node rarely gets a symbol it has. */
+  if(first && c->hops_from_base == 0) {
+    c->snd_index = 0;
+  } else {
+    c->snd_index = RUDOLPH3_PAGE_SYMBOLS +
+      random_rand() % (ERASURE_CODE_SYMBOLS - RUDOLPH3_PAGE_SYMBOLS);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+timed_send(void *ptr)
+{
+  struct rudolph3_conn *c = (struct rudolph3_conn *)ptr;
+  clock_time_t interval;
+
+  if(c->flags & FLAG_IS_STOPPED) {
+    return;
+  }
+
+  if(c->snd_left == 0 && c->snd_page + 1 < c->rcv_page) {
+    /* Pass the next page on */
+    start_page(c, c->snd_page + 1,
+               RUDOLPH3_PAGE_SYMBOLS + RUDOLPH3_REDUNDANCY, 1);
+  }
+
+  if(c->snd_left > 0) {
+    interval = c->send_interval;
+    send_data(c, interval);
+    c->snd_left--;
+  } else if(c->rcv_page == c->pages) {
+    /* Let late nodes know about the file */
+    interval = STEADY_INTERVAL;
+    send_data(c, interval);
+  } else {
+    /* Nothing to send until the next page is decoded */
+    return;
+  }
+  ctimer_set(&c->t, interval, timed_send, c);
+}
+/*---------------------------------------------------------------------------*/
+/* Call before giving an idle connection something to send */
+static void
+wake(struct rudolph3_conn *c)
+{
+  /* Idle, or waiting for the next steady transmission */
+  if(c->snd_left == 0) {
+    ctimer_set(&c->t, c->send_interval, timed_send, c);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+write_page(struct rudolph3_conn *c)
+{
+  int len = RUDOLPH3_PAGESIZE;
+  int flag = RUDOLPH3_FLAG_NONE;
+
+  if(c->flags & FLAG_IS_STOPPED) {
+    return;
+  }
+
+  if(c->rcv_page == 0) {
+    c->cb->write_chunk(c, 0, RUDOLPH3_FLAG_NEWFILE, c->page, 0);
+  }
+  if(c->rcv_page + 1 == c->pages) {
+    len = c->last_len;
+    flag = RUDOLPH3_FLAG_LASTCHUNK;
+  }
+
+  PRINTF("%d.%d: got page %d\n",
+	 linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1], c->rcv_page);
+  c->cb->write_chunk(c, c->rcv_page * RUDOLPH3_PAGESIZE, flag, c->page, len);
+}
+/*---------------------------------------------------------------------------*/
+static void
+recv_data(struct rudolph3_conn *c, struct rudolph3_hdr *hdr)
+{
+  uint8_t *symbol;
+
+  if(packetbuf_datalen() !=
+     sizeof(struct rudolph3_hdr) + RUDOLPH3_DATASIZE) {
+    return;
+  }
+  symbol = (uint8_t *)hdr + sizeof(struct rudolph3_hdr);
+
+  if(LT(c->version, hdr->version)) {
+    PRINTF("%d.%d: rudolph3 new version %d, %d pages\n",
+	   linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1],
+	   hdr->version, hdr->pages);
+    c->version = hdr->version;
+    c->pages = hdr->pages;
+    c->last_len = hdr->last_len;
+    c->rcv_page = c->snd_page = 0;
+    c->snd_left = 0;
+    ctimer_stop(&c->t);
+    erasure_decoder_init(&c->dec, RUDOLPH3_PAGE_SYMBOLS, c->page,
+                         RUDOLPH3_DATASIZE);
+  } else if(hdr->version != c->version || c->rcv_page == c->pages) {
+    return;
+  }
+
+  /* Pass pages on, and expect them, at the pace set by the base */
+  if(hdr->interval > 0) {
+    c->send_interval = (clock_time_t)hdr->interval * INTERVAL_UNIT;
+  }
+
+  if(hdr->page == c->rcv_page) {
+    erasure_decoder_add(&c->dec, hdr->index, symbol);
+    if(erasure_decoder_missing(&c->dec) == 0) {
+      write_page(c);
+      c->rcv_page++;
+      erasure_decoder_init(&c->dec, RUDOLPH3_PAGE_SYMBOLS, c->page,
+                           RUDOLPH3_DATASIZE);
+      wake(c);
+      if(c->rcv_page == 1) {
+        start_page(c, 0, RUDOLPH3_PAGE_SYMBOLS + RUDOLPH3_REDUNDANCY, 1);
+      }
+    }
+  } else if(LT(c->rcv_page, hdr->page)) {
+    /* We lost the end of our page */
+    send_req(c);
+  }
+
+  /* The end of the last page, or of a page the sender was asked to
+     repeat, is only noticed missing when the sender goes quiet */
+  if(LT(c->rcv_page, c->pages)) {
+    ctimer_set(&c->req_t, NAK_INTERVALS * c->send_interval, req_timeout, c);
+  } else {
+    ctimer_stop(&c->req_t);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+recv_req(struct rudolph3_conn *c, struct rudolph3_hdr *hdr)
+{
+  uint8_t missing;
+
+  if(LT(hdr->version, c->version)) {
+    /* The requester missed the announcement of our version */
+    if(c->rcv_page > 0 && (c->snd_left == 0 || c->snd_page > 0)) {
+      wake(c);
+      start_page(c, 0, RUDOLPH3_PAGE_SYMBOLS + RUDOLPH3_REDUNDANCY, 1);
+    }
+  } else if(hdr->version == c->version && LT(hdr->page, c->rcv_page)) {
+    /* One more, should that one be lost as well */
+    missing = hdr->index + 1;
+    if(c->snd_left == 0 || LT(hdr->page, c->snd_page)) {
+      wake(c);
+      start_page(c, hdr->page, missing, 0);
+    } else if(hdr->page == c->snd_page && c->snd_left < missing) {
+      c->snd_left = missing;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+recv(struct polite_conn *polite)
+{
+  struct rudolph3_conn *c = (struct rudolph3_conn *)polite;
+  struct rudolph3_hdr *hdr = packetbuf_dataptr();
+
+  if(packetbuf_datalen() < sizeof(struct rudolph3_hdr)) {
+    return;
+  }
+
+  /* Only accept requests from nodes that are farther away from the base
+     than us, and data from nodes that are closer. */
+  if(hdr->type == TYPE_REQ && hdr->hops_from_base > c->hops_from_base) {
+    recv_req(c, hdr);
+  } else if(hdr->type == TYPE_DATA &&
+            hdr->hops_from_base < c->hops_from_base) {
+    c->hops_from_base = hdr->hops_from_base + 1;
+    recv_data(c, hdr);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static const struct polite_callbacks polite = { recv, NULL, NULL };
+/*---------------------------------------------------------------------------*/
+void
+rudolph3_open(struct rudolph3_conn *c, uint16_t channel,
+	      const struct rudolph3_callbacks *cb)
+{
+  polite_open(&c->c, channel, &polite);
+  c->cb = cb;
+  c->version = 0;
+  c->pages = c->rcv_page = 0;
+  c->snd_page = c->snd_left = 0;
+  c->flags = 0;
+  c->send_interval = SEND_INTERVAL;
+  c->hops_from_base = HOPS_MAX;
+}
+/*---------------------------------------------------------------------------*/
+void
+rudolph3_close(struct rudolph3_conn *c)
+{
+  ctimer_stop(&c->t);
+  ctimer_stop(&c->req_t);
+  polite_close(&c->c);
+}
+/*---------------------------------------------------------------------------*/
+void
+rudolph3_send(struct rudolph3_conn *c, clock_time_t send_interval)
+{
+  int len;
+
+  c->hops_from_base = 0;
+  c->version++;
+  c->flags = 0;
+  c->send_interval = send_interval;
+
+  /* Find the size of the file */
+  for(c->pages = 0; ; c->pages++) {
+    len = read_data(c, c->page, c->pages * RUDOLPH3_PAGESIZE,
+                    RUDOLPH3_PAGESIZE);
+    if(len < RUDOLPH3_PAGESIZE) {
+      break;
+    }
+  }
+  if(len > 0 || c->pages == 0) {
+    c->last_len = len;
+    c->pages++;
+  } else {
+    c->last_len = RUDOLPH3_PAGESIZE;
+  }
+  c->rcv_page = c->pages;
+
+  start_page(c, 0, RUDOLPH3_PAGE_SYMBOLS + RUDOLPH3_REDUNDANCY, 1);
+  timed_send(c);
+}
+/*---------------------------------------------------------------------------*/
+void
+rudolph3_stop(struct rudolph3_conn *c)
+{
+  polite_cancel(&c->c);
+  ctimer_stop(&c->t);
+  ctimer_stop(&c->req_t);
+  c->flags |= FLAG_IS_STOPPED;
+}
+/*---------------------------------------------------------------------------*/
+/** @} */
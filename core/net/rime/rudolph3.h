@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Header file for the erasure coded bulk data flooding module
+ */
+
+/**
+ * \addtogroup rime
+ * @{
+ */
+
+/**
+ * \defgroup rudolph3 Erasure coded multi-hop bulk data transfer (rudolph3)
+ * @{
+ *
+ * The rudolph3 module floods a file through the network like rudolph2,
+ * but sends each page of the file as symbols of an erasure code
+ * (\ref erasure-code) rather than as a sequence of chunks. A node has
+ * a page once it has received any RUDOLPH3_PAGE_SYMBOLS distinct
+ * symbols of it, so a repair symbol makes up for a different lost
+ * packet at every neighbour that lost one, and repairs ask for a number
+ * of symbols instead of naming the missing chunks.
+ *
+ * A node passes each page on as soon as it has decoded it, and answers
+ * the requests of nodes farther from the base with as many fresh
+ * symbols as they are missing. Data packets carry the send interval
+ * given to rudolph3_send(), which every node uses to pass pages on and
+ * to time its requests.
+ *
+ * \section rudolph3-channels Channels
+ *
+ * The rudolph3 module uses 1 channel, for data symbols and requests.
+ *
+ */
+
+#ifndef RUDOLPH3_H_
+#define RUDOLPH3_H_
+
+#include "net/rime/polite.h"
+#include "sys/ctimer.h"
+#include "lib/erasure-code.h"
+
+struct rudolph3_conn;
+
+enum {
+  RUDOLPH3_FLAG_NONE,
+  RUDOLPH3_FLAG_NEWFILE,
+  RUDOLPH3_FLAG_LASTCHUNK,
+};
+
+struct rudolph3_callbacks {
+  void (* write_chunk)(struct rudolph3_conn *c, int offset, int flag,
+		       uint8_t *data, int len);
+  int (* read_chunk)(struct rudolph3_conn *c, int offset, uint8_t *to,
+		     int maxsize);
+};
+
+/* The length of a symbol, and of the payload of a data packet */
+#ifdef RUDOLPH3_CONF_DATASIZE
+#define RUDOLPH3_DATASIZE RUDOLPH3_CONF_DATASIZE
+#else
+#define RUDOLPH3_DATASIZE 32
+#endif
+
+/* The number of symbols a page is coded from */
+#ifdef RUDOLPH3_CONF_PAGE_SYMBOLS
+#define RUDOLPH3_PAGE_SYMBOLS RUDOLPH3_CONF_PAGE_SYMBOLS
+#else
+#define RUDOLPH3_PAGE_SYMBOLS 8
+#endif
+
+/* Symbols sent on top of RUDOLPH3_PAGE_SYMBOLS when passing a page on */
+#ifdef RUDOLPH3_CONF_REDUNDANCY
+#define RUDOLPH3_REDUNDANCY RUDOLPH3_CONF_REDUNDANCY
+#else
+#define RUDOLPH3_REDUNDANCY 2
+#endif
+
+#define RUDOLPH3_PAGESIZE (RUDOLPH3_PAGE_SYMBOLS * RUDOLPH3_DATASIZE)
+
+/* The decoder of each connection takes ERASURE_CODE_MAX_K squared bytes,
+   so a project with other pages sets ERASURE_CODE_CONF_MAX_K to
+   RUDOLPH3_CONF_PAGE_SYMBOLS */
+#if RUDOLPH3_PAGE_SYMBOLS > ERASURE_CODE_MAX_K
+#error "RUDOLPH3_PAGE_SYMBOLS must not exceed ERASURE_CODE_MAX_K"
+#endif
+
+struct rudolph3_conn {
+  struct polite_conn c;
+  const struct rudolph3_callbacks *cb;
+  struct ctimer t, req_t;
+  clock_time_t send_interval;
+  struct erasure_decoder dec;
+  uint8_t page[RUDOLPH3_PAGESIZE];
+  uint16_t version;
+  uint16_t pages, last_len;
+  uint16_t rcv_page, snd_page;
+  uint8_t snd_left, snd_index;
+  uint8_t hops_from_base;
+  uint8_t flags;
+};
+
+void rudolph3_open(struct rudolph3_conn *c, uint16_t channel,
+		   const struct rudolph3_callbacks *cb);
+void rudolph3_close(struct rudolph3_conn *c);
+void rudolph3_send(struct rudolph3_conn *c, clock_time_t interval);
+void rudolph3_stop(struct rudolph3_conn *c);
+
+#endif /* RUDOLPH3_H_ */
+/** @} */
+/** @} */
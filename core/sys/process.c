@@ -47,6 +47,9 @@
 
 #include "sys/process.h"
 #include "sys/arg.h"
+#if PROCESS_CONF_PROFILE
+#include "sys/rtimer.h"
+#endif
 
 /*
  * Pointer to the currently running process structure.
@@ -74,6 +77,11 @@ process_num_events_t process_maxevents;
 
 static volatile unsigned char poll_requested;
 
+#if PROCESS_CONF_PROFILE
+/* Time spent in processes called by the running one. */
+static rtimer_clock_t profile_nested;
+#endif
+
 #define PROCESS_STATE_NONE        0
 #define PROCESS_STATE_RUNNING     1
 #define PROCESS_STATE_CALLED      2
@@ -175,6 +183,9 @@ static void
 call_process(struct process *p, process_event_t ev, process_data_t data)
 {
   int ret;
+#if PROCESS_CONF_PROFILE
+  rtimer_clock_t start, elapsed, nested, own;
+#endif
 
 #if DEBUG
   if(p->state == PROCESS_STATE_CALLED) {
@@ -187,7 +198,22 @@ call_process(struct process *p, process_event_t ev, process_data_t data)
     PRINTF("process: calling process '%s' with event %d\n", PROCESS_NAME_STRING(p), ev);
     process_current = p;
     p->state = PROCESS_STATE_CALLED;
+#if PROCESS_CONF_PROFILE
+    nested = profile_nested;
+    profile_nested = 0;
+    start = RTIMER_NOW();
+#endif
     ret = p->thread(&p->pt, ev, data);
+#if PROCESS_CONF_PROFILE
+    elapsed = RTIMER_NOW() - start;
+    own = elapsed - profile_nested;
+    profile_nested = nested + elapsed;
+    p->profile.calls++;
+    p->profile.ticks += own;
+    if(own > p->profile.max_ticks) {
+      p->profile.max_ticks = own;
+    }
+#endif
     if(ret == PT_EXITED ||
        ret == PT_ENDED ||
        ev == PROCESS_EVENT_EXIT) {
@@ -312,6 +338,18 @@ process_run(void)
   return nevents + poll_requested;
 }
 /*---------------------------------------------------------------------------*/
+void
+process_profile_reset(void)
+{
+#if PROCESS_CONF_PROFILE
+  struct process *p;
+
+  for(p = process_list; p != NULL; p = p->next) {
+    p->profile.ticks = p->profile.calls = p->profile.max_ticks = 0;
+  }
+#endif
+}
+/*---------------------------------------------------------------------------*/
 int
 process_nevents(void)
 {
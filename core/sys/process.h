@@ -88,6 +88,10 @@ typedef unsigned char process_num_events_t;
 #define PROCESS_CONF_NUMEVENTS 32
 #endif /* PROCESS_CONF_NUMEVENTS */
 
+#ifndef PROCESS_CONF_PROFILE
+#define PROCESS_CONF_PROFILE 0
+#endif /* PROCESS_CONF_PROFILE */
+
 #define PROCESS_EVENT_NONE            0x80
 #define PROCESS_EVENT_INIT            0x81
 #define PROCESS_EVENT_POLL            0x82
@@ -312,6 +316,17 @@ static PT_THREAD(process_thread_##name(struct pt *process_pt,	\
 
 /** @} */
 
+/*
+ * With PROCESS_CONF_PROFILE, call_process() accounts the time every
+ * process runs for, in rtimer ticks. The time of processes called
+ * synchronously by another one is not accounted to the caller.
+ */
+struct process_profile {
+  unsigned long ticks;
+  unsigned long calls;
+  unsigned long max_ticks;
+};
+
 struct process {
   struct process *next;
 #if PROCESS_CONF_NO_PROCESS_NAMES
@@ -323,6 +338,9 @@ struct process {
   PT_THREAD((* thread)(struct pt *, process_event_t, process_data_t));
   struct pt pt;
   unsigned char state, needspoll;
+#if PROCESS_CONF_PROFILE
+  struct process_profile profile;
+#endif
 };
 
 /**
@@ -519,6 +537,13 @@ CCIF int process_is_running(struct process *p);
  */
 int process_nevents(void);
 
+/**
+ * Reset the CPU time accounted to all processes.
+ *
+ * Does nothing unless PROCESS_CONF_PROFILE is set.
+ */
+void process_profile_reset(void);
+
 /** @} */
 
 CCIF extern struct process *process_list;
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      Coffee on a simulated 64 KiB NOR flash in RAM, with sectors of
+ *      16 pages, for coffee-extent-tests.
+ */
+
+#ifndef CFS_COFFEE_ARCH_H
+#define CFS_COFFEE_ARCH_H
+
+#include "contiki-conf.h"
+
+#define COFFEE_SECTOR_SIZE      4096UL
+#define COFFEE_PAGE_SIZE        256UL
+#define COFFEE_START            0
+#define COFFEE_SIZE             (16 * COFFEE_SECTOR_SIZE)
+#define COFFEE_NAME_LENGTH      16
+#define COFFEE_DYN_SIZE         1024
+#define COFFEE_MAX_OPEN_FILES   6
+#define COFFEE_FD_SET_SIZE      8
+#define COFFEE_LOG_SIZE         1024
+#define COFFEE_LOG_TABLE_LIMIT  16
+#define COFFEE_IO_SEMANTICS     1
+
+/* Set by the Makefile */
+#ifndef COFFEE_MICRO_LOGS
+#define COFFEE_MICRO_LOGS       1
+#endif
+
+void flash_write(const void *buf, unsigned size, unsigned long offset);
+void flash_read(void *buf, unsigned size, unsigned long offset);
+void flash_erase(unsigned sector);
+
+#define COFFEE_WRITE(buf, size, offset) \
+  flash_write((buf), (size), COFFEE_START + (offset))
+
+#define COFFEE_READ(buf, size, offset) \
+  flash_read((buf), (size), COFFEE_START + (offset))
+
+#define COFFEE_ERASE(sector) flash_erase(sector)
+
+/* Coffee types. */
+typedef int16_t coffee_page_t;
+
+#endif /* !CFS_COFFEE_ARCH_H */
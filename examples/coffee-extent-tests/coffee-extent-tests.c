@@ -0,0 +1,447 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      Checks Coffee files against a model of their contents through
+ *      random appends, modifications and removals, reserves a large
+ *      file when the free pages are spread over several runs, checks
+ *      that the garbage collector reclaims the extents of a reservation
+ *      cut short by a power failure, and counts the flash accesses of
+ *      growing a log and creating files.
+ *
+ *      The flash is simulated in RAM with the semantics of NOR flash,
+ *      where writes can only clear bits of the stored data, which
+ *      Coffee inverts so that writes set bits of the data.
+ */
+
+#include "contiki.h"
+#include "cfs/cfs.h"
+#include "cfs/cfs-coffee.h"
+#include "cfs-coffee-arch.h"
+#include "lib/random.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define FILES        8
+#define MAX_FILE     6000
+#define STRESS_OPS   4000
+#define FRAG_FILES   30
+#define FRAG_SIZE    1800
+#define LARGE_SIZE   (36 * COFFEE_PAGE_SIZE)
+#define LOG_RECORD   200
+#define LOG_MAX      (24 * 1024L)
+
+static uint8_t flash[COFFEE_SIZE];
+static unsigned long reads, read_bytes, write_bytes, erases;
+/* Writes done before the power fails, or -1 */
+static long writes_left = -1;
+
+static uint8_t model[FILES][MAX_FILE];
+static int model_len[FILES];
+static char model_exists[FILES];
+/* Big enough for the model files and the large file */
+static uint8_t buf[LARGE_SIZE];
+
+/*---------------------------------------------------------------------------*/
+void
+flash_write(const void *data, unsigned size, unsigned long offset)
+{
+  const uint8_t *p = data;
+  unsigned i;
+
+  if(writes_left == 0) {
+    return;
+  } else if(writes_left > 0) {
+    writes_left--;
+  }
+
+  /* Bits can only be programmed, from the erased state */
+  write_bytes += size;
+  for(i = 0; i < size; i++) {
+    flash[offset + i] &= ~p[i];
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+flash_read(void *data, unsigned size, unsigned long offset)
+{
+  uint8_t *p = data;
+  unsigned i;
+
+  reads++;
+  read_bytes += size;
+  for(i = 0; i < size; i++) {
+    p[i] = ~flash[offset + i];
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+flash_erase(unsigned sector)
+{
+  erases++;
+  memset(&flash[sector * COFFEE_SECTOR_SIZE], 0xff, COFFEE_SECTOR_SIZE);
+}
+/*---------------------------------------------------------------------------*/
+static void
+reset_counters(void)
+{
+  reads = read_bytes = write_bytes = erases = 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Coffee takes trailing zeros for unwritten bytes, so data has none */
+static void
+fill(uint8_t *p, int len)
+{
+  int i;
+
+  for(i = 0; i < len; i++) {
+    p[i] = 1 + random_rand() % 255;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+frag_data(int file, uint8_t *p)
+{
+  int i;
+
+  for(i = 0; i < FRAG_SIZE; i++) {
+    p[i] = 1 + (file * 7 + i) % 251;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static char *
+file_name(int i)
+{
+  static char name[COFFEE_NAME_LENGTH];
+
+  snprintf(name, sizeof(name), "file%d", i);
+  return name;
+}
+/*---------------------------------------------------------------------------*/
+/* Returns 0 if the file holds data, and only data */
+static int
+check_file(const char *name, const uint8_t *data, int len)
+{
+  int fd, r;
+
+  fd = cfs_open(name, CFS_READ);
+  if(fd < 0) {
+    return -1;
+  }
+  r = cfs_read(fd, buf, sizeof(buf));
+  if(cfs_seek(fd, 0, CFS_SEEK_END) != len) {
+    r = -1;
+  }
+  cfs_close(fd);
+  return r == len && memcmp(buf, data, len) == 0 ? 0 : -1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+write_file(const char *name, int flags, cfs_offset_t offset,
+           const uint8_t *data, int len)
+{
+  int fd, r;
+
+  fd = cfs_open(name, flags);
+  if(fd < 0) {
+    return -1;
+  }
+  if(!(flags & CFS_APPEND) && cfs_seek(fd, offset, CFS_SEEK_SET) != offset) {
+    cfs_close(fd);
+    return -1;
+  }
+  r = cfs_write(fd, data, len);
+  cfs_close(fd);
+  return r;
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_model(void)
+{
+  struct cfs_dir dir;
+  struct cfs_dirent dirent;
+  unsigned long errors, full, op;
+  int i, n, listed;
+#if COFFEE_MICRO_LOGS
+  int offset;
+#endif
+
+  printf("Testing %u random operations on %u files ... ", STRESS_OPS, FILES);
+  cfs_coffee_format();
+  memset(model_exists, 0, sizeof(model_exists));
+  errors = full = 0;
+
+  for(op = 0; op < STRESS_OPS; op++) {
+    i = random_rand() % FILES;
+    switch(random_rand() % 10) {
+    case 0: case 1: case 2: case 3: case 4:
+      n = 1 + random_rand() % 400;
+      if(model_len[i] + n > MAX_FILE || !model_exists[i]) {
+        if(model_exists[i]) {
+          break;
+        }
+        model_len[i] = 0;
+      }
+      fill(&model[i][model_len[i]], n);
+      if(write_file(file_name(i), CFS_WRITE | CFS_APPEND, 0,
+                    &model[i][model_len[i]], n) != n) {
+        /* Out of space, start the file over */
+        full++;
+        cfs_remove(file_name(i));
+        model_exists[i] = 0;
+        break;
+      }
+      model_exists[i] = 1;
+      model_len[i] += n;
+      break;
+
+#if COFFEE_MICRO_LOGS
+    case 5: case 6:
+      if(!model_exists[i] || model_len[i] == 0) {
+        break;
+      }
+      offset = random_rand() % model_len[i];
+      n = 1 + random_rand() % 100;
+      if(n > model_len[i] - offset) {
+        n = model_len[i] - offset;
+      }
+      fill(&model[i][offset], n);
+      if(write_file(file_name(i), CFS_WRITE, offset,
+                    &model[i][offset], n) != n) {
+        full++;
+        cfs_remove(file_name(i));
+        model_exists[i] = 0;
+      }
+      break;
+#endif /* COFFEE_MICRO_LOGS */
+
+    case 7:
+      if(cfs_remove(file_name(i)) != (model_exists[i] ? 0 : -1)) {
+        errors++;
+      }
+      model_exists[i] = 0;
+      break;
+
+    default:
+      if(model_exists[i] &&
+         check_file(file_name(i), model[i], model_len[i]) < 0) {
+        errors++;
+        /* Report each error once */
+        cfs_remove(file_name(i));
+        model_exists[i] = 0;
+      }
+    }
+  }
+
+  /* Every file, and only those, is listed, and holds its data */
+  listed = 0;
+  if(cfs_opendir(&dir, "/") == 0) {
+    while(cfs_readdir(&dir, &dirent) == 0) {
+      for(i = 0; i < FILES && strcmp(dirent.name, file_name(i)) != 0; i++);
+      if(i == FILES || !model_exists[i] || dirent.size != model_len[i]) {
+        errors++;
+      }
+      listed++;
+    }
+    cfs_closedir(&dir);
+  }
+  for(i = 0; i < FILES; i++) {
+    if(model_exists[i]) {
+      listed--;
+      if(check_file(file_name(i), model[i], model_len[i]) < 0) {
+        errors++;
+      }
+    }
+  }
+  errors += listed != 0;
+
+  if(errors == 0) {
+    printf("Success (%lu writes out of space)\n", full);
+  } else {
+    printf("Failure (%lu errors)\n", errors);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Two files in each sector, then keep one in every other sector */
+static unsigned long
+fragment(void)
+{
+  static uint8_t data[FRAG_SIZE];
+  unsigned long errors;
+  int i;
+
+  cfs_coffee_format();
+  errors = 0;
+  for(i = 0; i < FRAG_FILES; i++) {
+    frag_data(i, data);
+    if(cfs_coffee_reserve(file_name(i), FRAG_SIZE) < 0 ||
+       write_file(file_name(i), CFS_WRITE, 0, data, FRAG_SIZE) != FRAG_SIZE) {
+      errors++;
+    }
+  }
+  for(i = 0; i < FRAG_FILES; i++) {
+    if(i % 4 != 0) {
+      cfs_remove(file_name(i));
+    }
+  }
+  return errors;
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_fragmented(void)
+{
+  static uint8_t large[LARGE_SIZE];
+  static uint8_t data[FRAG_SIZE];
+  unsigned long errors;
+  int i, reserved;
+
+  printf("Testing a %lu page file over fragmented free space ... ",
+         LARGE_SIZE / COFFEE_PAGE_SIZE);
+  errors = fragment();
+
+  fill(large, sizeof(large));
+  reserved = cfs_coffee_reserve("large", sizeof(large)) == 0;
+  if(reserved) {
+    if(write_file("large", CFS_WRITE, 0, large, sizeof(large)) !=
+       sizeof(large) || check_file("large", large, sizeof(large)) < 0) {
+      errors++;
+    }
+  }
+
+  /* The files left are untouched */
+  for(i = 0; i < FRAG_FILES; i += 4) {
+    frag_data(i, data);
+    if(check_file(file_name(i), data, FRAG_SIZE) < 0) {
+      errors++;
+    }
+  }
+  if(errors > 0) {
+    printf("Failure (%lu errors)\n", errors);
+  } else if(reserved) {
+    printf("Success\n");
+  } else {
+    /* The free runs are of 16 pages, the file needs 3 extents */
+    printf("Not reserved%s\n", COFFEE_MAX_EXTENTS > 2 ? ", failure" : "");
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_power_failure(void)
+{
+  unsigned long errors;
+  int i;
+
+  printf("Testing the reclaim of extents after a power failure ... ");
+  errors = fragment();
+
+  /* The power fails after the header of the second extent of the
+     large file, before the header of the first one links to it */
+  writes_left = 1;
+  cfs_coffee_reserve("large", LARGE_SIZE);
+  writes_left = -1;
+
+  /* Once the files are removed, all but one page can be reserved */
+  for(i = 0; i < FRAG_FILES; i += 4) {
+    if(cfs_remove(file_name(i)) < 0) {
+      errors++;
+    }
+  }
+  if(cfs_coffee_reserve("whole", COFFEE_SIZE - 2 * COFFEE_PAGE_SIZE) < 0) {
+    errors++;
+  }
+  if(errors > 0) {
+    printf("Failure (%lu errors)\n", errors);
+  } else {
+    printf("Success\n");
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+bench(void)
+{
+  uint8_t record[LOG_RECORD];
+  unsigned long size, files;
+  int fd, i;
+
+  /* Append to a log until it is LOG_MAX bytes or out of space */
+  cfs_coffee_format();
+  reset_counters();
+  fd = cfs_open("log", CFS_WRITE | CFS_APPEND);
+  for(size = 0; size + LOG_RECORD <= LOG_MAX; size += LOG_RECORD) {
+    fill(record, sizeof(record));
+    if(cfs_write(fd, record, sizeof(record)) != sizeof(record)) {
+      break;
+    }
+  }
+  cfs_close(fd);
+  printf("Appending a %lu byte log: %lu bytes written, %lu read, "
+         "%lu erases\n", size, write_bytes, read_bytes, erases);
+
+  /* Create small files until out of space, with one page free in
+     every sector from the start */
+  cfs_coffee_format();
+  for(i = 0; i < COFFEE_SIZE / COFFEE_SECTOR_SIZE; i++) {
+    fd = cfs_open(file_name(i), CFS_WRITE);
+    cfs_coffee_set_io_semantics(fd, CFS_COFFEE_IO_FIRM_SIZE);
+    cfs_write(fd, record, 1);
+    cfs_close(fd);
+  }
+  reset_counters();
+  for(files = 0; ; files++) {
+    snprintf((char *)record, sizeof(record), "small%lu", files);
+    if(cfs_coffee_reserve((char *)record, 100) < 0) {
+      break;
+    }
+  }
+  printf("Reserving %lu one page files: %lu flash reads\n", files, reads);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(coffee_extent_tests_process, "Coffee extent tests");
+AUTOSTART_PROCESSES(&coffee_extent_tests_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(coffee_extent_tests_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  printf("COFFEE_MAX_EXTENTS %u, COFFEE_FREE_EXTENTS %u, "
+         "COFFEE_MICRO_LOGS %u\n",
+         COFFEE_MAX_EXTENTS, COFFEE_FREE_EXTENTS, COFFEE_MICRO_LOGS);
+  test_model();
+  test_fragmented();
+  test_power_failure();
+  bench();
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      Test and benchmark of the page-wise memory copies of Cooja.
+ *
+ *      The Java side of platform/cooja/contiki-cooja-main.c is played by
+ *      one array per mote, and the library memory by one buffer that
+ *      the motes take turns in. Each round picks a random mote, changes
+ *      its array at random as Cooja interfaces do, sometimes replaces
+ *      the array with a copy as a new Java object, copies the array to
+ *      the library, writes to random pages of the library as a tick
+ *      does, and copies the library back. Both copies have to give
+ *      exactly the expected contents, whichever mote ran last.
+ *
+ *      The time of a round is then measured with the copies of the
+ *      original implementation, and with memory-sync, for different
+ *      numbers of pages written by the tick.
+ */
+
+#include "contiki.h"
+#include "lib/memory-sync.h"
+#include "lib/random.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define MOTES       20
+#define IMAGE_SIZE  (32 * 1024 + 100)
+#define ROUNDS      20000UL
+#define PAGES       ((IMAGE_SIZE + MEMORY_SYNC_PAGE_SIZE - 1) / \
+                     MEMORY_SYNC_PAGE_SIZE)
+
+static char library[IMAGE_SIZE];
+static char arrays[2][MOTES][IMAGE_SIZE];
+/* Which of the two arrays of a mote is the current Java object */
+static int current[MOTES];
+static char expected[IMAGE_SIZE];
+/* The copy made by GetByteArrayElements() in the original setMemory() */
+static char elements[IMAGE_SIZE];
+
+static unsigned long copied;
+
+/*---------------------------------------------------------------------------*/
+static void
+write_random(char *mem, int pages, int bytes_per_page)
+{
+  int i, j, page, offset;
+
+  for(i = 0; i < pages; i++) {
+    page = random_rand() % PAGES;
+    for(j = 0; j < bytes_per_page; j++) {
+      offset = page * MEMORY_SYNC_PAGE_SIZE + random_rand() % MEMORY_SYNC_PAGE_SIZE;
+      if(offset < IMAGE_SIZE) {
+        mem[offset] = random_rand();
+      }
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* The critical array access of contiki-cooja-main.c does not copy */
+static void
+sync_set(char *array)
+{
+  memory_sync_copy(library, array, IMAGE_SIZE);
+}
+/*---------------------------------------------------------------------------*/
+static void
+sync_get(char *array)
+{
+  copied += memory_sync_copy(array, library, IMAGE_SIZE);
+}
+/*---------------------------------------------------------------------------*/
+static void
+original_set(char *array)
+{
+  memcpy(elements, array, IMAGE_SIZE);
+  memcpy(library, elements, IMAGE_SIZE);
+  memcpy(array, elements, IMAGE_SIZE);
+}
+/*---------------------------------------------------------------------------*/
+static void
+original_get(char *array)
+{
+  memcpy(array, library, IMAGE_SIZE);
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+test(void)
+{
+  unsigned long round, errors = 0;
+  char *array;
+  int mote, i;
+
+  for(mote = 0; mote < MOTES; mote++) {
+    for(i = 0; i < IMAGE_SIZE; i++) {
+      arrays[0][mote][i] = random_rand();
+    }
+  }
+
+  for(round = 0; round < ROUNDS; round++) {
+    mote = random_rand() % MOTES;
+    array = arrays[current[mote]][mote];
+
+    /* Interfaces of the mote write to its memory between ticks */
+    if(random_rand() % 4 == 0) {
+      write_random(array, 1 + random_rand() % 4, 1 + random_rand() % 8);
+    }
+    /* A new Java array with the same contents */
+    if(random_rand() % 16 == 0) {
+      current[mote] = !current[mote];
+      memcpy(arrays[current[mote]][mote], array, IMAGE_SIZE);
+      memset(array, 0x55, IMAGE_SIZE);
+      array = arrays[current[mote]][mote];
+    }
+
+    sync_set(array);
+    if(memcmp(library, array, IMAGE_SIZE) != 0) {
+      errors++;
+    }
+
+    /* The tick */
+    write_random(library, random_rand() % 8, 1 + random_rand() % 8);
+    memcpy(expected, library, IMAGE_SIZE);
+
+    sync_get(array);
+    if(memcmp(array, expected, IMAGE_SIZE) != 0) {
+      errors++;
+    }
+  }
+  return errors;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+benchmark(int pages, void (*set)(char *), void (*get)(char *))
+{
+  unsigned long rounds;
+  clock_time_t start;
+  int mote, i;
+
+  start = clock_time();
+  for(rounds = 0; clock_time() - start < CLOCK_SECOND; rounds++) {
+    mote = rounds % MOTES;
+    set(arrays[current[mote]][mote]);
+    for(i = 0; i < pages; i++) {
+      library[(i * 7 + rounds) % PAGES * MEMORY_SYNC_PAGE_SIZE] = rounds;
+    }
+    get(arrays[current[mote]][mote]);
+  }
+  return (unsigned long)(clock_time() - start) * 1000000000UL /
+    CLOCK_SECOND / rounds;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(cooja_memsync_benchmark_process, "Cooja memory sync benchmark");
+AUTOSTART_PROCESSES(&cooja_memsync_benchmark_process);
+
+PROCESS_THREAD(cooja_memsync_benchmark_process, ev, data)
+{
+  static const int pages[] = { 0, 1, 4, 16, 64, PAGES };
+  unsigned long errors;
+  int i;
+
+  PROCESS_BEGIN();
+
+  printf("Testing %lu rounds of %d motes ... ", ROUNDS, MOTES);
+  errors = test();
+  if(errors == 0) {
+    printf("Success (%lu KB copied back)\n", copied / 1024);
+  } else {
+    printf("Failure (%lu errors)\n", errors);
+  }
+
+  printf("%d byte image, %d byte pages\n", IMAGE_SIZE, MEMORY_SYNC_PAGE_SIZE);
+  for(i = 0; i < sizeof(pages) / sizeof(pages[0]); i++) {
+    printf("%3d pages written: original %lu ns, memory-sync %lu ns\n",
+           pages[i], benchmark(pages[i], original_set, original_get),
+           benchmark(pages[i], sync_set, sync_get));
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
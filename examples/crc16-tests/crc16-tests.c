@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      Cross-checks the configured CRC16 method against the bitwise
+ *      algorithms, for both the CCITT and the Modbus polynomial, and
+ *      measures its throughput. Build with METHOD=<0|1|4|8> to select
+ *      the method.
+ */
+
+#include "contiki.h"
+#include "lib/crc16.h"
+#include "lib/random.h"
+
+#include <stdio.h>
+
+#define MAX_LEN     300
+#define BENCH_LEN   1024
+#define BENCH_ROUNDS 20000UL
+
+static unsigned char buf[BENCH_LEN];
+
+/*---------------------------------------------------------------------------*/
+static unsigned short
+ccitt_ref(const unsigned char *data, int len, unsigned short acc)
+{
+  unsigned char i;
+
+  while(len-- > 0) {
+    acc ^= *data++;
+    for(i = 0; i < 8; ++i) {
+      acc = (acc & 1) ? (acc >> 1) ^ 0x8408 : acc >> 1;
+    }
+  }
+  return acc;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned short
+modbus_ref(const unsigned char *data, int len, unsigned short acc)
+{
+  unsigned char i;
+
+  while(len-- > 0) {
+    acc ^= *data++;
+    for(i = 0; i < 8; ++i) {
+      acc = (acc & 1) ? (acc >> 1) ^ 0xa001 : acc >> 1;
+    }
+  }
+  return acc;
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_check_values(void)
+{
+  static const unsigned char check[] = "123456789";
+
+  printf("Testing check values ... ");
+  if(crc16_data(check, 9, 0) == 0x2189 &&
+     crc16_modbus_data(check, 9, 0xffff) == 0x4b37) {
+    printf("Success\n");
+  } else {
+    printf("Failure\n");
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_cross_check(void)
+{
+  int off, len, i;
+  unsigned short acc;
+  unsigned long errors;
+
+  printf("Testing against bitwise reference ... ");
+  errors = 0;
+  for(off = 0; off < 16; off++) {
+    for(len = 0; len <= MAX_LEN; len++) {
+      if(crc16_data(buf + off, len, 0) != ccitt_ref(buf + off, len, 0) ||
+         crc16_modbus_data(buf + off, len, 0xffff) !=
+         modbus_ref(buf + off, len, 0xffff)) {
+        errors++;
+      }
+    }
+  }
+  for(acc = 0, i = 0; i < MAX_LEN; i++) {
+    acc = crc16_add(buf[i], acc);
+  }
+  errors += acc != ccitt_ref(buf, MAX_LEN, 0);
+  for(acc = 0xffff, i = 0; i < MAX_LEN; i++) {
+    acc = crc16_modbus_add(buf[i], acc);
+  }
+  errors += acc != modbus_ref(buf, MAX_LEN, 0xffff);
+
+  if(errors == 0) {
+    printf("Success\n");
+  } else {
+    printf("Failure (%lu mismatches)\n", errors);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+bench(const char *name,
+      unsigned short (*crc)(const unsigned char *, int, unsigned short))
+{
+  unsigned long i;
+  unsigned short acc;
+  clock_time_t start, elapsed;
+
+  acc = 0;
+  start = clock_time();
+  for(i = 0; i < BENCH_ROUNDS; i++) {
+    acc = crc(buf, BENCH_LEN, acc);
+  }
+  elapsed = clock_time() - start;
+  if(elapsed == 0) {
+    elapsed = 1;
+  }
+  printf("%s: %lu KiB/s (0x%04x)\n", name,
+         (unsigned long)((BENCH_ROUNDS * BENCH_LEN / 1024 * CLOCK_SECOND)
+                         / elapsed), acc);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(crc16_tests_process, "CRC16 tests");
+AUTOSTART_PROCESSES(&crc16_tests_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(crc16_tests_process, ev, data)
+{
+  int i;
+
+  PROCESS_BEGIN();
+
+  for(i = 0; i < BENCH_LEN; i++) {
+    buf[i] = random_rand();
+  }
+
+  printf("CRC16 method %u\n", CRC16_METHOD);
+  test_check_values();
+  test_cross_check();
+
+  bench("CCITT bitwise reference", ccitt_ref);
+  bench("CCITT crc16_data", crc16_data);
+  bench("Modbus bitwise reference", modbus_ref);
+  bench("Modbus crc16_modbus_data", crc16_modbus_data);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
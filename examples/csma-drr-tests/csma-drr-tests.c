@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      Keeps two neighbor queues of CSMA with fair queuing backlogged
+ *      for thousands of frames and checks that deficit round-robin
+ *      keeps serving both of them in turn.
+ */
+
+#include "contiki.h"
+#include "net/netstack.h"
+#include "net/packetbuf.h"
+#include "net/queuebuf.h"
+#include "net/mac/csma.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define NEIGHBORS    2
+#define BACKLOG      3
+#define PAYLOAD_LEN  10
+#define TOTAL_FRAMES 3000UL
+#define MAX_GAP      4
+
+static uint8_t queued[NEIGHBORS];
+static unsigned long sent[NEIGHBORS];
+static unsigned long max_gap;
+
+PROCESS(csma_drr_tests_process, "CSMA DRR tests");
+AUTOSTART_PROCESSES(&csma_drr_tests_process);
+/*---------------------------------------------------------------------------*/
+/* An RDC layer that delivers every frame at once */
+static void
+rdc_send_list(mac_callback_t sent_callback, void *ptr,
+              struct rdc_buf_list *list)
+{
+  queuebuf_to_packetbuf(list->buf);
+  mac_call_sent_callback(sent_callback, ptr, MAC_TX_OK, 1);
+}
+/*---------------------------------------------------------------------------*/
+static void
+rdc_send(mac_callback_t sent_callback, void *ptr)
+{
+  mac_call_sent_callback(sent_callback, ptr, MAC_TX_OK, 1);
+}
+/*---------------------------------------------------------------------------*/
+static void
+rdc_init(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+static void
+rdc_input(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+static int
+rdc_on(void)
+{
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+rdc_off(int keep_radio_on)
+{
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned short
+rdc_channel_check_interval(void)
+{
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+const struct rdc_driver instant_rdc_driver = {
+  "instant-rdc",
+  rdc_init,
+  rdc_send,
+  rdc_send_list,
+  rdc_input,
+  rdc_on,
+  rdc_off,
+  rdc_channel_check_interval,
+};
+/*---------------------------------------------------------------------------*/
+static void
+frame_sent(void *ptr, int status, int transmissions)
+{
+  uint8_t i = (uintptr_t)ptr;
+  unsigned long gap;
+
+  queued[i]--;
+  if(status == MAC_TX_OK) {
+    sent[i]++;
+  }
+  gap = sent[0] > sent[1] ? sent[0] - sent[1] : sent[1] - sent[0];
+  if(gap > max_gap) {
+    max_gap = gap;
+  }
+  process_poll(&csma_drr_tests_process);
+}
+/*---------------------------------------------------------------------------*/
+static void
+fill_queues(void)
+{
+  linkaddr_t addr;
+  uint8_t i;
+
+  for(i = 0; i < NEIGHBORS; i++) {
+    while(queued[i] < BACKLOG) {
+      queued[i]++;
+      packetbuf_clear();
+      memset(packetbuf_dataptr(), i, PAYLOAD_LEN);
+      packetbuf_set_datalen(PAYLOAD_LEN);
+      linkaddr_copy(&addr, &linkaddr_null);
+      addr.u8[0] = i + 1;
+      packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &addr);
+      NETSTACK_MAC.send(frame_sent, (void *)(uintptr_t)i);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(csma_drr_tests_process, ev, data)
+{
+  static struct etimer timeout;
+  const struct csma_stats *stats;
+
+  PROCESS_BEGIN();
+
+  printf("Testing %lu frames to %u backlogged neighbors ... ",
+         TOTAL_FRAMES, NEIGHBORS);
+  etimer_set(&timeout, 60 * CLOCK_SECOND);
+  fill_queues();
+  while(sent[0] + sent[1] < TOTAL_FRAMES) {
+    PROCESS_WAIT_EVENT();
+    if(etimer_expired(&timeout)) {
+      break;
+    }
+    fill_queues();
+  }
+
+  stats = csma_get_stats();
+  if(sent[0] + sent[1] >= TOTAL_FRAMES && max_gap <= MAX_GAP &&
+     stats->drops_full == 0) {
+    printf("Success (largest gap %lu frames)\n", max_gap);
+    printf("TEST OK\n");
+  } else {
+    printf("Failure (%lu + %lu frames sent, largest gap %lu, %lu dropped)\n",
+           sent[0], sent[1], max_gap, (unsigned long)stats->drops_full);
+    printf("TEST FAILED\n");
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      Benchmark for the uIP UDP demultiplexer. A sink process binds as
+ *      many UDP connections as uIP allows, after which datagrams for the
+ *      first and the last bound port are fed to uip_input() and the
+ *      number of datagrams delivered per second is printed. Build with
+ *      HASH=0 to compare against the classic table scan.
+ *
+ *      The node also joins as many multicast groups as it has room for,
+ *      and datagrams for the group found last measure the cost of
+ *      classifying the destination address. Build with ADDR_HASH=0 to
+ *      compare against a scan of the address lists.
+ */
+
+#include "contiki-net.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define BASE_PORT   20000
+#define SRC_PORT    5683
+#define PAYLOAD_LEN 32
+#define ROUNDS      500000UL
+
+#define UIP_IP_BUF  ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+#define UIP_UDP_BUF ((struct uip_udp_hdr *)&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN])
+
+static uint8_t datagram[UIP_IPUDPH_LEN + PAYLOAD_LEN];
+static unsigned long delivered;
+
+PROCESS(demux_benchmark_process, "Demux benchmark");
+PROCESS(sink_process, "UDP sink");
+AUTOSTART_PROCESSES(&demux_benchmark_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(sink_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_WAIT_EVENT_UNTIL(ev == tcpip_event);
+    if(uip_newdata()) {
+      delivered++;
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+static void
+build_datagram(const uip_ipaddr_t *dest, uint16_t port)
+{
+  memset(uip_buf, 0, sizeof(datagram) + UIP_LLH_LEN);
+  uip_len = sizeof(datagram);
+
+  UIP_IP_BUF->vtc = 0x60;
+  UIP_IP_BUF->len[0] = (uip_len - UIP_IPH_LEN) >> 8;
+  UIP_IP_BUF->len[1] = (uip_len - UIP_IPH_LEN) & 0xff;
+  UIP_IP_BUF->proto = UIP_PROTO_UDP;
+  UIP_IP_BUF->ttl = 64;
+  uip_ip6addr(&UIP_IP_BUF->srcipaddr, 0xfe80, 0, 0, 0, 0, 0, 0, 1);
+  uip_ipaddr_copy(&UIP_IP_BUF->destipaddr, dest);
+
+  UIP_UDP_BUF->srcport = UIP_HTONS(SRC_PORT);
+  UIP_UDP_BUF->destport = UIP_HTONS(port);
+  UIP_UDP_BUF->udplen = UIP_HTONS(uip_len - UIP_IPH_LEN);
+  UIP_UDP_BUF->udpchksum = ~(uip_udpchksum());
+  if(UIP_UDP_BUF->udpchksum == 0) {
+    UIP_UDP_BUF->udpchksum = 0xffff;
+  }
+
+  memcpy(datagram, &uip_buf[UIP_LLH_LEN], sizeof(datagram));
+}
+/*---------------------------------------------------------------------------*/
+static void
+run(const char *name, const uip_ipaddr_t *dest, uint16_t port)
+{
+  unsigned long i;
+  clock_time_t start, elapsed;
+
+  build_datagram(dest, port);
+  delivered = 0;
+
+  start = clock_time();
+  for(i = 0; i < ROUNDS; i++) {
+    memcpy(&uip_buf[UIP_LLH_LEN], datagram, sizeof(datagram));
+    uip_len = sizeof(datagram);
+    uip_input();
+  }
+  elapsed = clock_time() - start;
+  if(elapsed == 0) {
+    elapsed = 1;
+  }
+
+  printf("%s port %u: %lu datagrams/s, %lu of %lu delivered\n",
+         name, port, (unsigned long)((ROUNDS * CLOCK_SECOND) / elapsed),
+         delivered, ROUNDS);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(demux_benchmark_process, ev, data)
+{
+  static uint16_t conns;
+  static uint16_t groups;
+  static uip_ipaddr_t lladdr;
+  static uip_ipaddr_t group;
+  struct uip_udp_conn *conn;
+
+  PROCESS_BEGIN();
+
+  process_start(&sink_process, NULL);
+
+  /* Bind the connections on behalf of the sink, so that it receives
+     the tcpip_event for every delivered datagram. */
+  PROCESS_CONTEXT_BEGIN(&sink_process);
+  for(conns = 0; (conn = udp_new(NULL, 0, NULL)) != NULL; conns++) {
+    udp_bind(conn, UIP_HTONS(BASE_PORT + conns));
+  }
+  PROCESS_CONTEXT_END(&sink_process);
+
+  for(groups = 0; ; groups++) {
+    uip_ip6addr(&group, 0xff05, 0, 0, 0, 0, 0, 1, groups);
+    if(uip_ds6_maddr_add(&group) == NULL) {
+      break;
+    }
+  }
+  /* uip-ds6 fills its lists from the end, so the first group joined is
+     the last one found by a list scan. */
+  uip_ip6addr(&group, 0xff05, 0, 0, 0, 0, 0, 1, 0);
+
+  printf("%u UDP connections, %u hash buckets\n",
+         conns, UIP_DEMUX_HASH_SIZE);
+  printf("%u multicast groups, %u hash buckets\n",
+         groups, UIP_DS6_ADDR_HASH_SIZE);
+  if(conns == 0 || groups == 0) {
+    PROCESS_EXIT();
+  }
+
+  uip_ipaddr_copy(&lladdr, &uip_ds6_get_link_local(-1)->ipaddr);
+  run("first", &lladdr, BASE_PORT);
+  run("last", &lladdr, BASE_PORT + conns - 1);
+  run("group", &group, BASE_PORT);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
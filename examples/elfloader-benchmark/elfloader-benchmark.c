@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      Benchmark for the ELF loader. module.ce, built for i386 with many
+ *      symbols resolved within the module, is loaded again and again from
+ *      a copy in the CFS, and the number of cfs_read() and cfs_seek()
+ *      calls of a load is printed with the load rate. Build with
+ *      READ_CACHE=0 to read the file directly.
+ *
+ *      The relocations are those of elfloader-x86.c, which writes them to
+ *      the file, but the module is not run: the addresses of a 64-bit
+ *      host do not fit in its 32-bit relocations.
+ */
+
+#include "contiki.h"
+#include "cfs/cfs.h"
+#include "loader/elfloader.h"
+#include "loader/elfloader-arch.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#define MODULE      "module.ce"
+#define MODULE_COPY "module.tmp"
+#define ROUNDS      2000
+
+#define R_386_32    1
+#define R_386_PC32  2
+
+#define ELF32_R_TYPE(info) ((unsigned char)(info))
+
+static char module[0x4000];
+static int module_len;
+
+static char datamemory[0x1000];
+static char textmemory[0x1000];
+
+static unsigned long reads, seeks, bytes;
+
+int __real_cfs_read(int fd, void *buf, unsigned int len);
+cfs_offset_t __real_cfs_seek(int fd, cfs_offset_t offset, int whence);
+
+PROCESS(elfloader_benchmark_process, "Elfloader benchmark");
+AUTOSTART_PROCESSES(&elfloader_benchmark_process);
+/*---------------------------------------------------------------------------*/
+int
+__wrap_cfs_read(int fd, void *buf, unsigned int len)
+{
+  int n;
+
+  n = __real_cfs_read(fd, buf, len);
+  reads++;
+  if(n > 0) {
+    bytes += n;
+  }
+  return n;
+}
+/*---------------------------------------------------------------------------*/
+cfs_offset_t
+__wrap_cfs_seek(int fd, cfs_offset_t offset, int whence)
+{
+  seeks++;
+  return __real_cfs_seek(fd, offset, whence);
+}
+/*---------------------------------------------------------------------------*/
+void *
+elfloader_arch_allocate_ram(int size)
+{
+  return size <= sizeof(datamemory) ? datamemory : NULL;
+}
+/*---------------------------------------------------------------------------*/
+void *
+elfloader_arch_allocate_rom(int size)
+{
+  return size <= sizeof(textmemory) ? textmemory : NULL;
+}
+/*---------------------------------------------------------------------------*/
+void
+elfloader_arch_write_rom(int fd, unsigned short textoff, unsigned int size,
+                         char *mem)
+{
+  cfs_seek(fd, textoff, CFS_SEEK_SET);
+  cfs_read(fd, mem, size);
+}
+/*---------------------------------------------------------------------------*/
+void
+elfloader_arch_relocate(int fd, unsigned int sectionoffset,
+                        char *sectionaddress,
+                        struct elf32_rela *rela, char *addr)
+{
+  uint32_t value;
+
+  switch(ELF32_R_TYPE(rela->r_info)) {
+  case R_386_32:
+    value = (uintptr_t)addr + rela->r_addend;
+    break;
+  case R_386_PC32:
+    value = (uintptr_t)addr - (uintptr_t)(sectionaddress + rela->r_offset) +
+      rela->r_addend;
+    break;
+  default:
+    printf("elfloader-benchmark: unknown relocation type %u\n",
+           (unsigned)ELF32_R_TYPE(rela->r_info));
+    return;
+  }
+
+  cfs_seek(fd, sectionoffset + rela->r_offset, CFS_SEEK_SET);
+  cfs_write(fd, &value, sizeof(value));
+}
+/*---------------------------------------------------------------------------*/
+static int
+load(void)
+{
+  int fd;
+  int ret;
+
+  /* The relocations are written to the file, so each load needs a
+     fresh copy of the module. */
+  fd = cfs_open(MODULE_COPY, CFS_READ | CFS_WRITE);
+  if(fd < 0) {
+    return -1;
+  }
+  cfs_write(fd, module, module_len);
+
+  reads = seeks = bytes = 0;
+  ret = elfloader_load(fd);
+  cfs_close(fd);
+  return ret;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(elfloader_benchmark_process, ev, data)
+{
+  static int i;
+  int fd;
+  int ret;
+  clock_time_t start, elapsed;
+
+  PROCESS_BEGIN();
+
+  fd = cfs_open(MODULE, CFS_READ);
+  if(fd < 0) {
+    printf("elfloader-benchmark: cannot open %s\n", MODULE);
+    PROCESS_EXIT();
+  }
+  module_len = cfs_read(fd, module, sizeof(module));
+  cfs_close(fd);
+
+  elfloader_init();
+  ret = load();
+  printf("load: %d, %lu reads, %lu seeks, %lu bytes read from %d\n",
+         ret, reads, seeks, bytes, module_len);
+  if(ret != ELFLOADER_OK) {
+    if(elfloader_unknown[0] != '\0') {
+      printf("unknown symbol: %s\n", elfloader_unknown);
+    }
+    PROCESS_EXIT();
+  }
+
+  start = clock_time();
+  for(i = 0; i < ROUNDS; i++) {
+    load();
+  }
+  elapsed = clock_time() - start;
+  if(elapsed == 0) {
+    elapsed = 1;
+  }
+
+  printf("%u read cache bytes, %u symbol cache entries: %lu loads/s\n",
+         ELFLOADER_CONF_READ_CACHE_SIZE, ELFLOADER_CONF_SYMBOL_CACHE_SIZE,
+         (unsigned long)((ROUNDS * CLOCK_SECOND) / elapsed));
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      Module loaded by the elfloader benchmark. It has many global
+ *      functions and variables that refer to each other, which the
+ *      loader must resolve within the module as the core symbol table
+ *      does not know them. It includes no headers so that it builds
+ *      for i386 without a 32-bit C library.
+ */
+
+#define FUNCTION(n) \
+  int variable##n = n; \
+  int function##n(int x) { return x + variable##n; }
+
+#define FUNCTIONS(n) \
+  FUNCTION(n##0) FUNCTION(n##1) FUNCTION(n##2) FUNCTION(n##3) \
+  FUNCTION(n##4) FUNCTION(n##5) FUNCTION(n##6) FUNCTION(n##7)
+
+#define CALLS(n) \
+  function##n##0(x) + function##n##1(x) + function##n##2(x) + \
+  function##n##3(x) + function##n##4(x) + function##n##5(x) + \
+  function##n##6(x) + function##n##7(x)
+
+#define POINTERS(n) \
+  function##n##0, function##n##1, function##n##2, function##n##3, \
+  function##n##4, function##n##5, function##n##6, function##n##7
+
+FUNCTIONS(1) FUNCTIONS(2) FUNCTIONS(3) FUNCTIONS(4)
+FUNCTIONS(5) FUNCTIONS(6) FUNCTIONS(7) FUNCTIONS(8)
+
+int (*functions[])(int) = {
+  POINTERS(1), POINTERS(2), POINTERS(3), POINTERS(4),
+  POINTERS(5), POINTERS(6), POINTERS(7), POINTERS(8)
+};
+
+int
+sum(int x)
+{
+  return CALLS(1) + CALLS(2) + CALLS(3) + CALLS(4) +
+    CALLS(5) + CALLS(6) + CALLS(7) + CALLS(8);
+}
+
+/* What the loader looks for, without the processes of a real module */
+void * const autostart_processes[] = { 0 };
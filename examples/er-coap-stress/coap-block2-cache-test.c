@@ -0,0 +1,437 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+
+/**
+ * \file
+ *      Test for the Block2 cache. Fetches representations block by
+ *      block through the cache and checks them against the handlers,
+ *      how often the handlers run, eviction, expiry, ETags and the
+ *      fallback for representations that do not fit.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "contiki.h"
+#include "contiki-net.h"
+#include "er-coap-engine.h"
+#include "lib/crc16.h"
+#include "unit-test.h"
+
+#define BLOCK_SIZE       16
+#define BIG_SIZE         300
+#define HUGE_SIZE        (COAP_BLOCK2_CACHE_SIZE + 100)
+#define NUM_LINKS        12
+
+static int big_calls;
+static int failures;
+static char link_attributes[NUM_LINKS][24];
+static resource_t links[NUM_LINKS];
+
+UNIT_TEST_REGISTER(whole, "Whole transfer");
+UNIT_TEST_REGISTER(interleaved, "Interleaved transfers");
+UNIT_TEST_REGISTER(eviction, "LRU eviction");
+UNIT_TEST_REGISTER(fallback, "Too large and errors");
+UNIT_TEST_REGISTER(etag, "ETags");
+UNIT_TEST_REGISTER(well_known, "Well-known core");
+UNIT_TEST_REGISTER(expiry, "Expiry");
+/*---------------------------------------------------------------------------*/
+static uint8_t
+pattern(const char *url, int i)
+{
+  return (uint8_t)(url[strlen(url) - 1] + i * 7);
+}
+/*---------------------------------------------------------------------------*/
+/* blockwise aware, with one representation per sub-resource */
+static void
+big_get_handler(void *request, void *response, uint8_t *buffer,
+                uint16_t preferred_size, int32_t *offset)
+{
+  const char *url;
+  int len = REST.get_url(request, &url);
+  char path[16];
+  int size;
+  int i;
+
+  big_calls++;
+  snprintf(path, sizeof(path), "%.*s", len, url);
+  size = strncmp(path, "big/huge", 8) == 0 ? HUGE_SIZE : BIG_SIZE;
+
+  len = MIN(size - *offset, preferred_size);
+  for(i = 0; i < len; i++) {
+    buffer[i] = pattern(path, *offset + i);
+  }
+  REST.set_header_content_type(response, REST.type.APPLICATION_OCTET_STREAM);
+  if(strcmp(path, "big/plain") != 0) {
+    REST.set_header_etag(response, (uint8_t *)"v1", 2);
+  }
+  REST.set_response_payload(response, buffer, len);
+  *offset = *offset + len < size ? *offset + len : -1;
+}
+PARENT_RESOURCE(res_big, "", big_get_handler, NULL, NULL, NULL);
+/*---------------------------------------------------------------------------*/
+static void
+missing_get_handler(void *request, void *response, uint8_t *buffer,
+                    uint16_t preferred_size, int32_t *offset)
+{
+  REST.set_response_status(response, REST.status.NOT_FOUND);
+}
+CACHED_RESOURCE(res_missing, "", missing_get_handler, NULL, NULL, NULL);
+/*---------------------------------------------------------------------------*/
+static void
+init_packets(coap_packet_t *request, coap_packet_t *response, const char *url)
+{
+  coap_init_message(request, COAP_TYPE_CON, COAP_GET, 0);
+  coap_set_header_uri_path(request, url);
+  coap_init_message(response, COAP_TYPE_ACK, CONTENT_2_05, 0);
+  erbium_status_code = NO_ERROR;
+}
+/*---------------------------------------------------------------------------*/
+/* fetches the block at *offset, returns the payload length or -1 on a miss */
+static int
+get_block(const char *url, uint8_t *payload, int32_t *offset)
+{
+  coap_packet_t request[1];
+  coap_packet_t response[1];
+  uint8_t buffer[BLOCK_SIZE + 1];
+
+  init_packets(request, response, url);
+  if(!coap_block2_cache_get(request, response, buffer, BLOCK_SIZE, offset)) {
+    return -1;
+  }
+  memcpy(payload, response->payload, response->payload_len);
+  return response->code == CONTENT_2_05 ? response->payload_len : -2;
+}
+/*---------------------------------------------------------------------------*/
+/* fetches a whole representation, returns its length or a negative error */
+static int
+get_all(const char *url, uint8_t *representation)
+{
+  int32_t offset = 0;
+  int32_t block_offset;
+  int len;
+  int total = 0;
+
+  do {
+    block_offset = offset;
+    len = get_block(url, representation + total, &offset);
+    if(len < 0) {
+      return len;
+    }
+    if(block_offset != total) {
+      return -3;
+    }
+    total += len;
+  } while(offset != -1);
+  return total;
+}
+/*---------------------------------------------------------------------------*/
+static int
+check_pattern(const char *url, const uint8_t *representation, int len)
+{
+  int i;
+
+  for(i = 0; i < len; i++) {
+    if(representation[i] != pattern(url, i)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST(whole)
+{
+  uint8_t representation[BIG_SIZE];
+  coap_packet_t request[1];
+  coap_packet_t response[1];
+  uint8_t buffer[BLOCK_SIZE + 1];
+  int32_t offset = 0;
+
+  UNIT_TEST_BEGIN();
+
+  big_calls = 0;
+  UNIT_TEST_ASSERT(get_all("big/a", representation) == BIG_SIZE);
+  UNIT_TEST_ASSERT(check_pattern("big/a", representation, BIG_SIZE));
+  UNIT_TEST_ASSERT(big_calls == 1);
+  UNIT_TEST_ASSERT(coap_block2_cache_count() == 0);
+
+  /* options of the handler are repeated on every block */
+  init_packets(request, response, "big/a");
+  coap_block2_cache_get(request, response, buffer, BLOCK_SIZE, &offset);
+  init_packets(request, response, "big/a");
+  coap_block2_cache_get(request, response, buffer, BLOCK_SIZE, &offset);
+  UNIT_TEST_ASSERT(offset == 2 * BLOCK_SIZE);
+  UNIT_TEST_ASSERT(response->content_format == APPLICATION_OCTET_STREAM);
+  UNIT_TEST_ASSERT(response->etag_len == 2
+                   && memcmp(response->etag, "v1", 2) == 0);
+  coap_block2_cache_flush(&res_big);
+  UNIT_TEST_ASSERT(coap_block2_cache_count() == 0);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST(interleaved)
+{
+  uint8_t a[BIG_SIZE];
+  uint8_t b[BIG_SIZE];
+  int32_t offset_a = 0;
+  int32_t offset_b = 0;
+  int len_a = 0;
+  int len_b = 0;
+  int len;
+
+  UNIT_TEST_BEGIN();
+
+  big_calls = 0;
+  while(offset_a != -1 || offset_b != -1) {
+    if(offset_a != -1) {
+      len = get_block("big/a", a + len_a, &offset_a);
+      UNIT_TEST_ASSERT(len > 0);
+      len_a += len;
+    }
+    if(offset_b != -1) {
+      len = get_block("big/b", b + len_b, &offset_b);
+      UNIT_TEST_ASSERT(len > 0);
+      len_b += len;
+    }
+  }
+  UNIT_TEST_ASSERT(len_a == BIG_SIZE && check_pattern("big/a", a, len_a));
+  UNIT_TEST_ASSERT(len_b == BIG_SIZE && check_pattern("big/b", b, len_b));
+  UNIT_TEST_ASSERT(big_calls == 2);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST(eviction)
+{
+  uint8_t block[BLOCK_SIZE];
+  int32_t offset_a = 0;
+  int32_t offset_b = 0;
+  int32_t offset_c = 0;
+
+  UNIT_TEST_BEGIN();
+
+  UNIT_TEST_ASSERT(get_block("big/a", block, &offset_a) == BLOCK_SIZE);
+  UNIT_TEST_ASSERT(get_block("big/b", block, &offset_b) == BLOCK_SIZE);
+  UNIT_TEST_ASSERT(get_block("big/a", block, &offset_a) == BLOCK_SIZE);
+  UNIT_TEST_ASSERT(coap_block2_cache_count() == 2);
+
+  /* big/b is the least recently used */
+  UNIT_TEST_ASSERT(get_block("big/c", block, &offset_c) == BLOCK_SIZE);
+  UNIT_TEST_ASSERT(coap_block2_cache_count() == 2);
+  UNIT_TEST_ASSERT(get_block("big/b", block, &offset_b) == -1);
+  UNIT_TEST_ASSERT(get_block("big/a", block, &offset_a) == BLOCK_SIZE);
+  UNIT_TEST_ASSERT(get_block("big/c", block, &offset_c) == BLOCK_SIZE);
+  coap_block2_cache_flush(NULL);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST(fallback)
+{
+  uint8_t block[BLOCK_SIZE];
+  int32_t offset;
+
+  UNIT_TEST_BEGIN();
+
+  big_calls = 0;
+  offset = 0;
+  UNIT_TEST_ASSERT(get_block("big/huge", block, &offset) == -1);
+  UNIT_TEST_ASSERT(offset == 0 && big_calls == 1);
+  UNIT_TEST_ASSERT(coap_block2_cache_count() == 0);
+
+  /* the next transfers leave the handler to the engine right away */
+  offset = 0;
+  UNIT_TEST_ASSERT(get_block("big/huge", block, &offset) == -1);
+  UNIT_TEST_ASSERT(offset == 0 && big_calls == 1);
+
+  offset = 0;
+  UNIT_TEST_ASSERT(get_block("missing", block, &offset) == -2);
+  UNIT_TEST_ASSERT(coap_block2_cache_count() == 0);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST(etag)
+{
+  static uint8_t representation[BIG_SIZE];
+  coap_packet_t request[1];
+  coap_packet_t response[1];
+  uint8_t buffer[BLOCK_SIZE + 1];
+  uint8_t etag[2];
+  unsigned short crc;
+  int32_t offset = 0;
+  int i;
+
+  UNIT_TEST_BEGIN();
+
+  /* representations without an ETag get their CRC-16 */
+  for(i = 0; i < BIG_SIZE; i++) {
+    representation[i] = pattern("big/plain", i);
+  }
+  crc = crc16_data(representation, BIG_SIZE, 0);
+  init_packets(request, response, "big/plain");
+  UNIT_TEST_ASSERT(coap_block2_cache_get(request, response, buffer,
+                                         BLOCK_SIZE, &offset));
+  UNIT_TEST_ASSERT(response->etag_len == 2);
+  UNIT_TEST_ASSERT(response->etag[0] == crc >> 8
+                   && response->etag[1] == (crc & 0xFF));
+  memcpy(etag, response->etag, sizeof(etag));
+
+  /* a block of another representation is left to the handler */
+  init_packets(request, response, "big/plain");
+  coap_set_header_etag(request, (uint8_t *)"v0", 2);
+  UNIT_TEST_ASSERT(!coap_block2_cache_get(request, response, buffer,
+                                          BLOCK_SIZE, &offset));
+  UNIT_TEST_ASSERT(offset == BLOCK_SIZE);
+
+  init_packets(request, response, "big/plain");
+  coap_set_header_etag(request, etag, sizeof(etag));
+  UNIT_TEST_ASSERT(coap_block2_cache_get(request, response, buffer,
+                                         BLOCK_SIZE, &offset));
+  UNIT_TEST_ASSERT(offset == 2 * BLOCK_SIZE);
+  UNIT_TEST_ASSERT(memcmp(response->payload, representation + BLOCK_SIZE,
+                          BLOCK_SIZE) == 0);
+  coap_block2_cache_flush(&res_big);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST(well_known)
+{
+  static uint8_t cached[COAP_BLOCK2_CACHE_SIZE];
+  static uint8_t direct[COAP_BLOCK2_CACHE_SIZE];
+  coap_packet_t request[1];
+  coap_packet_t response[1];
+  uint8_t buffer[BLOCK_SIZE + 1];
+  int32_t offset = 0;
+  int direct_len = 0;
+  int cached_len;
+
+  UNIT_TEST_BEGIN();
+
+  /* the handler as the engine calls it without the cache */
+  do {
+    init_packets(request, response, ".well-known/core");
+    UNIT_TEST_ASSERT(rest_invoke_restful_service(request, response, buffer,
+                                                 BLOCK_SIZE, &offset));
+    memcpy(direct + direct_len, response->payload, response->payload_len);
+    direct_len += response->payload_len;
+  } while(offset != -1);
+
+  cached_len = get_all(".well-known/core", cached);
+  printf("%d bytes of link format, %d bytes through the cache\n",
+         direct_len, cached_len);
+  UNIT_TEST_ASSERT(cached_len == direct_len);
+  UNIT_TEST_ASSERT(memcmp(cached, direct, direct_len) == 0);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST(expiry)
+{
+  uint8_t block[BLOCK_SIZE];
+  int32_t offset = 0;
+
+  UNIT_TEST_BEGIN();
+
+  UNIT_TEST_ASSERT(get_block("big/a", block, &offset) == BLOCK_SIZE);
+  UNIT_TEST_ASSERT(coap_block2_cache_count() == 1);
+  UNIT_TEST_ASSERT(get_block("big/a", block, &offset) == BLOCK_SIZE);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(coap_block2_cache_test_process, "CoAP Block2 cache test");
+AUTOSTART_PROCESSES(&coap_block2_cache_test_process);
+
+PROCESS_THREAD(coap_block2_cache_test_process, ev, data)
+{
+  static struct etimer et;
+  static uint8_t block[BLOCK_SIZE];
+  static int32_t offset;
+  static char urls[NUM_LINKS][8];
+  int i;
+
+  PROCESS_BEGIN();
+
+  rest_init_engine();
+  /* let the engine activate .well-known/core */
+  PROCESS_PAUSE();
+
+  res_big.flags |= IS_CACHED;
+  rest_activate_resource(&res_big, "big");
+  rest_activate_resource(&res_missing, "missing");
+  for(i = 0; i < NUM_LINKS; i++) {
+    snprintf(urls[i], sizeof(urls[i]), "link%d", i);
+    snprintf(link_attributes[i], sizeof(link_attributes[i]),
+             "title=\"Link %d\";rt=\"t\"", i);
+    links[i].attributes = link_attributes[i];
+    rest_activate_resource(&links[i], urls[i]);
+  }
+
+  UNIT_TEST_RUN(whole);
+  UNIT_TEST_RUN(interleaved);
+  UNIT_TEST_RUN(eviction);
+  UNIT_TEST_RUN(fallback);
+  UNIT_TEST_RUN(etag);
+  UNIT_TEST_RUN(well_known);
+
+  offset = 0;
+  UNIT_TEST_RUN(expiry);
+  etimer_set(&et, COAP_BLOCK2_CACHE_LIFETIME + 1);
+  PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+  offset = BLOCK_SIZE * 2;
+  i = get_block("big/a", block, &offset);
+  printf("Block after the lifetime: %s\n", i == -1 ? "miss" : "hit");
+
+  /* too large representations are tried again after the lifetime */
+  big_calls = 0;
+  offset = 0;
+  get_block("big/huge", block, &offset);
+  printf("Too large after the lifetime: %d handler calls\n", big_calls);
+
+  failures = (UNIT_TEST_RESULT(whole) == unit_test_failure)
+    + (UNIT_TEST_RESULT(interleaved) == unit_test_failure)
+    + (UNIT_TEST_RESULT(eviction) == unit_test_failure)
+    + (UNIT_TEST_RESULT(fallback) == unit_test_failure)
+    + (UNIT_TEST_RESULT(etag) == unit_test_failure)
+    + (UNIT_TEST_RESULT(well_known) == unit_test_failure)
+    + (UNIT_TEST_RESULT(expiry) == unit_test_failure)
+    + (i != -1) + (big_calls != 1) + (coap_block2_cache_count() != 0);
+  printf("%s\n", failures ? "TEST FAILED" : "TEST OK");
+  exit(failures ? EXIT_FAILURE : EXIT_SUCCESS);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
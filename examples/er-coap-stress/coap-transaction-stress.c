@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+
+/**
+ * \file
+ *      Stress test for the CoAP transaction layer. Opens
+ *      COAP_MAX_OPEN_TRANSACTIONS confirmable requests at once, measures
+ *      MID lookups, acknowledges half of them and lets the rest time out
+ *      through the retransmission timer wheel.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "contiki.h"
+#include "contiki-net.h"
+#include "er-coap-engine.h"
+#include "unit-test.h"
+
+#define NUM_TRANSACTIONS COAP_MAX_OPEN_TRANSACTIONS
+#define LOOKUP_ROUNDS    1000
+
+/* upper bound for the last retransmission to time out, plus margin */
+#define EXPIRY_TIMEOUT   (COAP_RESPONSE_TIMEOUT_TICKS * 3 / 2 * \
+                          ((2 << COAP_MAX_RETRANSMIT) - 1) + CLOCK_SECOND)
+
+static uint16_t first_mid;
+static int timeouts;
+static clock_time_t reopened;
+/* total of the retransmission intervals of each reopened transaction */
+static clock_time_t late_lifetime[NUM_TRANSACTIONS / 2];
+static int late_timeouts;
+static int early_timeouts;
+static int failures;
+
+UNIT_TEST_REGISTER(open, "Open transactions");
+UNIT_TEST_REGISTER(lookup, "MID lookup");
+UNIT_TEST_REGISTER(ack, "Acknowledge half");
+UNIT_TEST_REGISTER(reopen, "Open between wheel ticks");
+UNIT_TEST_REGISTER(expire, "Retransmission timeouts");
+/*---------------------------------------------------------------------------*/
+static void
+timeout_callback(void *data, void *response)
+{
+  if(response == NULL) {
+    timeouts++;
+    /* data is set for the transactions opened by reopen */
+    if(data != NULL) {
+      late_timeouts++;
+      if(clock_time() - reopened < *(clock_time_t *)data) {
+        early_timeouts++;
+      }
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static coap_transaction_t *
+open_transaction(void *callback_data)
+{
+  coap_packet_t request[1];
+  coap_transaction_t *t;
+  uip_ipaddr_t addr;
+
+  uip_ip6addr(&addr, 0xfd00, 0, 0, 0, 0, 0, 0, 1);
+  coap_init_message(request, COAP_TYPE_CON, COAP_GET, coap_get_mid());
+  coap_set_header_uri_path(request, "stress");
+
+  t = coap_new_transaction(request->mid, &addr, COAP_DEFAULT_PORT);
+  if(t != NULL) {
+    t->callback = timeout_callback;
+    t->callback_data = callback_data;
+    t->packet_len = coap_serialize_message(request, t->packet);
+    coap_send_transaction(t);
+  }
+  return t;
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST(open)
+{
+  coap_transaction_t *t;
+  uip_ipaddr_t addr;
+  int i;
+
+  UNIT_TEST_BEGIN();
+
+  uip_ip6addr(&addr, 0xfd00, 0, 0, 0, 0, 0, 0, 1);
+
+  for(i = 0; i < NUM_TRANSACTIONS; i++) {
+    t = open_transaction(NULL);
+    UNIT_TEST_ASSERT(t != NULL);
+    if(i == 0) {
+      first_mid = t->mid;
+    }
+  }
+
+  UNIT_TEST_ASSERT(coap_transaction_count() == NUM_TRANSACTIONS);
+  UNIT_TEST_ASSERT(coap_new_transaction(coap_get_mid(), &addr,
+                                        COAP_DEFAULT_PORT) == NULL);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST(lookup)
+{
+  coap_transaction_t *t;
+  uint16_t mid;
+  int round;
+  int i;
+
+  UNIT_TEST_BEGIN();
+
+  for(round = 0; round < LOOKUP_ROUNDS; round++) {
+    for(i = 0; i < NUM_TRANSACTIONS; i++) {
+      mid = first_mid + i;
+      t = coap_get_transaction_by_mid(mid);
+      UNIT_TEST_ASSERT(t != NULL && t->mid == mid);
+    }
+  }
+  UNIT_TEST_ASSERT(coap_get_transaction_by_mid(first_mid - 1) == NULL);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST(ack)
+{
+  coap_transaction_t *t;
+  int i;
+
+  UNIT_TEST_BEGIN();
+
+  for(i = 0; i < NUM_TRANSACTIONS; i += 2) {
+    t = coap_get_transaction_by_mid(first_mid + i);
+    UNIT_TEST_ASSERT(t != NULL);
+    coap_clear_transaction(t);
+  }
+
+  UNIT_TEST_ASSERT(coap_transaction_count() == NUM_TRANSACTIONS / 2);
+  for(i = 0; i < NUM_TRANSACTIONS; i++) {
+    t = coap_get_transaction_by_mid(first_mid + i);
+    UNIT_TEST_ASSERT((i & 1) ? t != NULL : t == NULL);
+  }
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+/* Opens transactions while the wheel is between two ticks */
+UNIT_TEST(reopen)
+{
+  coap_transaction_t *t;
+  int i;
+
+  UNIT_TEST_BEGIN();
+
+  reopened = clock_time();
+  for(i = 0; i < NUM_TRANSACTIONS / 2; i++) {
+    t = open_transaction(&late_lifetime[i]);
+    UNIT_TEST_ASSERT(t != NULL);
+    late_lifetime[i] = t->retrans_interval * ((1 << COAP_MAX_RETRANSMIT) - 1);
+  }
+  UNIT_TEST_ASSERT(coap_transaction_count() == NUM_TRANSACTIONS);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+UNIT_TEST(expire)
+{
+  UNIT_TEST_BEGIN();
+
+  UNIT_TEST_ASSERT(coap_transaction_count() == 0);
+  UNIT_TEST_ASSERT(timeouts == NUM_TRANSACTIONS);
+  /* retransmissions must not fire before their interval has elapsed */
+  UNIT_TEST_ASSERT(late_timeouts == NUM_TRANSACTIONS / 2);
+  UNIT_TEST_ASSERT(early_timeouts == 0);
+
+  UNIT_TEST_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(coap_stress_process, "CoAP transaction stress test");
+AUTOSTART_PROCESSES(&coap_stress_process);
+
+PROCESS_THREAD(coap_stress_process, ev, data)
+{
+  static struct etimer et;
+  static clock_time_t start;
+
+  PROCESS_BEGIN();
+
+  rest_init_engine();
+
+  UNIT_TEST_RUN(open);
+  UNIT_TEST_RUN(lookup);
+  printf("%d lookups over %d open transactions\n",
+         LOOKUP_ROUNDS * NUM_TRANSACTIONS, NUM_TRANSACTIONS);
+  UNIT_TEST_RUN(ack);
+
+  /* less than a wheel tick, so that the wheel lags behind */
+  etimer_set(&et, COAP_TRANSACTION_WHEEL_TICK / 2);
+  PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+  UNIT_TEST_RUN(reopen);
+
+  start = clock_time();
+  while(coap_transaction_count() > 0
+        && clock_time() - start < EXPIRY_TIMEOUT) {
+    etimer_set(&et, CLOCK_SECOND / 10);
+    PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+  }
+  printf("Remaining transactions timed out after %lu ticks\n",
+         (unsigned long)(clock_time() - start));
+  UNIT_TEST_RUN(expire);
+
+  failures = (UNIT_TEST_RESULT(open) == unit_test_failure)
+    + (UNIT_TEST_RESULT(lookup) == unit_test_failure)
+    + (UNIT_TEST_RESULT(ack) == unit_test_failure)
+    + (UNIT_TEST_RESULT(reopen) == unit_test_failure)
+    + (UNIT_TEST_RESULT(expire) == unit_test_failure);
+  printf("%s\n", failures ? "TEST FAILED" : "TEST OK");
+  exit(failures ? EXIT_FAILURE : EXIT_SUCCESS);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+
+/**
+ * \file
+ *      Project configuration for the CoAP transaction stress test.
+ */
+
+#ifndef PROJECT_CONF_H_
+#define PROJECT_CONF_H_
+
+/* Many open transactions, as on a busy gateway */
+#undef COAP_MAX_OPEN_TRANSACTIONS
+#define COAP_MAX_OPEN_TRANSACTIONS     256
+
+#undef COAP_MAX_OBSERVERS
+#define COAP_MAX_OBSERVERS             1
+
+#undef COAP_TRANSACTION_HASH_SIZE
+#define COAP_TRANSACTION_HASH_SIZE     64
+
+/* Short timeouts so that the test does not run for minutes */
+#define COAP_RESPONSE_TIMEOUT          1
+#define COAP_MAX_RETRANSMIT            1
+
+/* Block2 cache with a short lifetime for the expiry test */
+#define COAP_BLOCK2_CACHE              1
+#define COAP_BLOCK2_CACHE_SIZE         1024
+#define COAP_BLOCK2_CACHE_LIFETIME     (CLOCK_SECOND / 2)
+
+#undef REST_MAX_CHUNK_SIZE
+#define REST_MAX_CHUNK_SIZE            16
+
+#undef UIP_CONF_TCP
+#define UIP_CONF_TCP                   0
+
+#endif /* PROJECT_CONF_H_ */
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      Observable resource with binary powertrace records
+ */
+
+#include <string.h>
+#include "rest-engine.h"
+#include "er-coap.h"
+#include "powertrace.h"
+
+static void res_get_handler(void *request, void *response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset);
+static void res_periodic_handler(void);
+
+PERIODIC_RESOURCE(res_powertrace,
+                  "title=\"Powertrace\";obs",
+                  res_get_handler,
+                  NULL,
+                  NULL,
+                  NULL,
+                  10 * CLOCK_SECOND,
+                  res_periodic_handler);
+
+/* Channels that a record has room for. The others wait for the next one. */
+#define RECORD_CHANNELS 2
+
+/*
+ * A record holds the deltas since the previous one, so it is taken once per
+ * period and every observer and GET of that period gets the same record.
+ */
+static uint8_t record[POWERTRACE_RECORD_NODE_MAX_LEN +
+                      RECORD_CHANNELS * POWERTRACE_RECORD_STATS_MAX_LEN];
+static int record_len;
+/* Tells blocks of different records apart */
+static uint8_t record_etag;
+
+static void
+res_get_handler(void *request, void *response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
+{
+  int len;
+
+  /* A record longer than the block size is sent blockwise. */
+  if(*offset >= record_len && *offset > 0) {
+    REST.set_response_status(response, REST.status.BAD_OPTION);
+    /* A block error message should not exceed the minimum block size (16). */
+
+    const char *error_msg = "BlockOutOfScope";
+    REST.set_response_payload(response, error_msg, strlen(error_msg));
+    return;
+  }
+
+  len = record_len - *offset;
+  if(len > preferred_size) {
+    len = preferred_size;
+  }
+
+  REST.set_header_content_type(response, REST.type.APPLICATION_OCTET_STREAM);
+  REST.set_header_max_age(response, res_powertrace.periodic->period / CLOCK_SECOND);
+  REST.set_header_etag(response, &record_etag, 1);
+  memcpy(buffer, record + *offset, len);
+  REST.set_response_payload(response, buffer, len);
+
+  *offset += len;
+  if(*offset >= record_len) {
+    *offset = -1;
+  }
+}
+static void
+res_periodic_handler()
+{
+  record_len = powertrace_record(record, sizeof(record));
+  if(record_len < 0) {
+    record_len = 0;
+  }
+  record_etag++;
+
+  REST.notify_subscribers(&res_powertrace);
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      Resource with the CPU time of processes
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "rest-engine.h"
+
+static void res_get_handler(void *request, void *response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset);
+
+/*
+ * One line per process: name, calls, ticks and max ticks, as accounted
+ * with PROCESS_CONF_PROFILE. The list can be longer than a chunk, so the
+ * lines are regenerated for every block and only the requested part is sent.
+ */
+RESOURCE(res_processes,
+         "title=\"Process CPU time\";rt=\"Text\"",
+         res_get_handler,
+         NULL,
+         NULL,
+         NULL);
+
+static void
+res_get_handler(void *request, void *response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
+{
+#if PROCESS_CONF_PROFILE
+  struct process *p;
+  char line[64];
+  int32_t pos = 0;
+  int strpos = 0;
+  int len, skip, n;
+
+  for(p = PROCESS_LIST(); p != NULL && strpos < preferred_size; p = p->next) {
+    len = snprintf(line, sizeof(line), "%s %lu %lu %lu\n", PROCESS_NAME_STRING(p),
+                   p->profile.calls, p->profile.ticks, p->profile.max_ticks);
+    if(len >= sizeof(line)) {
+      len = sizeof(line) - 1;
+    }
+
+    /* Copy the part of the line that falls in the requested block. */
+    if(pos + len > *offset) {
+      skip = *offset > pos ? *offset - pos : 0;
+      n = len - skip;
+      if(n > preferred_size - strpos) {
+        n = preferred_size - strpos;
+      }
+      memcpy(buffer + strpos, line + skip, n);
+      strpos += n;
+    }
+    pos += len;
+  }
+
+  REST.set_header_content_type(response, REST.type.TEXT_PLAIN);
+  REST.set_response_payload(response, buffer, strpos);
+
+  *offset += strpos;
+  if(p == NULL && *offset >= pos) {
+    *offset = -1;
+  }
+#else
+  REST.set_response_status(response, REST.status.NOT_IMPLEMENTED);
+#endif
+}
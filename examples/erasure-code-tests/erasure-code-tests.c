@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      Checks that the erasure code recovers a block from any k
+ *      distinct symbols, and measures how fast blocks are decoded from
+ *      repair symbols only.
+ */
+
+#include "contiki.h"
+#include "lib/erasure-code.h"
+#include "lib/random.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define SYMBOL_LEN   32
+#define RANDOM_RUNS  200
+#define BENCH_K      8
+#define BENCH_ROUNDS 20000UL
+
+static uint8_t source[ERASURE_CODE_MAX_K * SYMBOL_LEN];
+static uint8_t block[ERASURE_CODE_MAX_K * SYMBOL_LEN];
+static uint8_t symbol[SYMBOL_LEN];
+static struct erasure_decoder decoder;
+
+/*---------------------------------------------------------------------------*/
+static void
+fill_source(void)
+{
+  int i;
+
+  for(i = 0; i < sizeof(source); i++) {
+    source[i] = random_rand();
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Feeds the symbols of indices in order, returns how many were useful */
+static int
+decode(uint8_t k, const uint8_t *indices, int count)
+{
+  int i, useful;
+
+  erasure_decoder_init(&decoder, k, block, SYMBOL_LEN);
+  useful = 0;
+  for(i = 0; i < count; i++) {
+    erasure_code_encode(k, indices[i], source, SYMBOL_LEN, symbol);
+    useful += erasure_decoder_add(&decoder, indices[i], symbol);
+  }
+  return useful;
+}
+/*---------------------------------------------------------------------------*/
+static int
+recovered(uint8_t k)
+{
+  return erasure_decoder_missing(&decoder) == 0 &&
+    memcmp(block, source, k * SYMBOL_LEN) == 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_streaming_encode(void)
+{
+  uint8_t k = ERASURE_CODE_MAX_K;
+  uint8_t expected[SYMBOL_LEN];
+  int index, i;
+  unsigned long errors;
+
+  printf("Testing repair symbols built one source symbol at a time ... ");
+  fill_source();
+  errors = 0;
+  for(index = 0; index < ERASURE_CODE_SYMBOLS; index++) {
+    erasure_code_encode(k, index, source, SYMBOL_LEN, expected);
+    memset(symbol, 0, sizeof(symbol));
+    for(i = 0; i < k; i++) {
+      erasure_code_mul_add(symbol, source + i * SYMBOL_LEN,
+                           erasure_code_coeff(k, index, i), SYMBOL_LEN);
+    }
+    errors += memcmp(symbol, expected, SYMBOL_LEN) != 0;
+  }
+
+  if(errors == 0) {
+    printf("Success\n");
+  } else {
+    printf("Failure (%lu mismatches)\n", errors);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_all_subsets(void)
+{
+  /* Every 4 of the 4 source and 12 first repair symbols */
+  uint8_t indices[4];
+  unsigned long subsets, errors;
+  int a, b, c, d;
+
+  printf("Testing every set of 4 out of 16 symbols, k = 4 ... ");
+  fill_source();
+  subsets = errors = 0;
+  for(a = 0; a < 16; a++) {
+    for(b = a + 1; b < 16; b++) {
+      for(c = b + 1; c < 16; c++) {
+        for(d = c + 1; d < 16; d++) {
+          indices[0] = d;
+          indices[1] = b;
+          indices[2] = a;
+          indices[3] = c;
+          if(decode(4, indices, 4) != 4 || !recovered(4)) {
+            errors++;
+          }
+          subsets++;
+        }
+      }
+    }
+  }
+
+  if(errors == 0) {
+    printf("Success (%lu sets)\n", subsets);
+  } else {
+    printf("Failure (%lu of %lu sets)\n", errors, subsets);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+test_random_subsets(void)
+{
+  uint8_t indices[ERASURE_CODE_SYMBOLS];
+  uint8_t k, tmp;
+  int run, i, j;
+  unsigned long errors;
+
+  printf("Testing random sets with duplicates, k = 1 .. %u ... ",
+         ERASURE_CODE_MAX_K);
+  errors = 0;
+  for(run = 0; run < RANDOM_RUNS; run++) {
+    k = 1 + run % ERASURE_CODE_MAX_K;
+    fill_source();
+
+    /* A shuffle of every index, with the first ones repeated */
+    for(i = 0; i < ERASURE_CODE_SYMBOLS; i++) {
+      indices[i] = i;
+    }
+    for(i = ERASURE_CODE_SYMBOLS - 1; i > 0; i--) {
+      j = random_rand() % (i + 1);
+      tmp = indices[i];
+      indices[i] = indices[j];
+      indices[j] = tmp;
+    }
+    for(i = 0; i < k - 1; i++) {
+      indices[k - 1 + i] = indices[i];
+    }
+    indices[2 * k - 2] = indices[ERASURE_CODE_SYMBOLS - 1];
+
+    /* The duplicates are worthless, the last symbol completes the block */
+    if(decode(k, indices, 2 * k - 1) != k || !recovered(k)) {
+      errors++;
+    }
+    /* Nothing is useful once the block is complete */
+    if(erasure_decoder_add(&decoder, indices[k], symbol) != 0) {
+      errors++;
+    }
+  }
+
+  if(errors == 0) {
+    printf("Success\n");
+  } else {
+    printf("Failure (%lu errors)\n", errors);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+bench(void)
+{
+  uint8_t indices[BENCH_K];
+  unsigned long i;
+  clock_time_t start, elapsed;
+  int j;
+
+  fill_source();
+  for(j = 0; j < BENCH_K; j++) {
+    indices[j] = BENCH_K + 7 * j;
+  }
+
+  start = clock_time();
+  for(i = 0; i < BENCH_ROUNDS; i++) {
+    decode(BENCH_K, indices, BENCH_K);
+  }
+  elapsed = clock_time() - start;
+  if(elapsed == 0) {
+    elapsed = 1;
+  }
+  printf("Encoding and decoding from repair symbols, k = %u: %lu KiB/s\n",
+         BENCH_K, (unsigned long)((BENCH_ROUNDS * BENCH_K * SYMBOL_LEN / 1024
+                                   * CLOCK_SECOND) / elapsed));
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(erasure_code_tests_process, "Erasure code tests");
+AUTOSTART_PROCESSES(&erasure_code_tests_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(erasure_code_tests_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  test_streaming_encode();
+  test_all_subsets();
+  test_random_subsets();
+  bench();
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      Downloads resources from test-server.py, which cuts its
+ *      responses off at random, and checks that http-socket resumes
+ *      them into the exact bytes of the resource. The resources are
+ *      fetched one after the other from the callback, so that the
+ *      connection is reused when the server keeps it open.
+ *
+ *      /changing has a new version for every request, with an ETag too
+ *      long to keep. Its download may end early with an error, but must
+ *      never mix the bytes of two versions.
+ */
+
+#include "contiki-net.h"
+#include "http-socket.h"
+
+#include <stdio.h>
+
+#define SIZE   20000L
+#define ROUNDS 10
+
+static const struct {
+  const char *path;
+  int64_t pos;
+  uint64_t length;
+  int may_end_early;
+} downloads[] = {
+  { "/plain", 0, 0, 0 },
+  { "/chunked", 0, 0, 0 },
+  { "/norange", 0, 0, 0 },
+  { "/close", 0, 0, 0 },
+  { "/plain", 1000, 5000, 0 },
+  { "/plain", -3000, 3000, 0 },
+  { "/changing", 0, 0, 1 },
+};
+#define DOWNLOADS (sizeof(downloads) / sizeof(downloads[0]))
+
+static struct http_socket s;
+static int download, round;
+static long offset, received, errors;
+static unsigned long failures, ended_early;
+/* /changing XORs the pattern with its version */
+static uint8_t version;
+static clock_time_t start;
+
+PROCESS(http_socket_tests_process, "http-socket tests");
+AUTOSTART_PROCESSES(&http_socket_tests_process);
+/*---------------------------------------------------------------------------*/
+static uint8_t
+pattern(long i)
+{
+  return (i * 7 + i / 251) & 0xff;
+}
+/*---------------------------------------------------------------------------*/
+static void callback(struct http_socket *s, void *ptr,
+                     http_socket_event_t e,
+                     const uint8_t *data, uint16_t datalen);
+/*---------------------------------------------------------------------------*/
+static void
+get(void)
+{
+  static char url[48];
+
+  sprintf(url, "http://" SERVER "%s", downloads[download].path);
+  offset = downloads[download].pos >= 0 ? downloads[download].pos :
+    SIZE + downloads[download].pos;
+  received = 0;
+  errors = 0;
+  version = 0;
+  http_socket_get(&s, url, downloads[download].pos,
+                  downloads[download].length, callback, NULL);
+}
+/*---------------------------------------------------------------------------*/
+static void
+callback(struct http_socket *s, void *ptr,
+         http_socket_event_t e,
+         const uint8_t *data, uint16_t datalen)
+{
+  long expected;
+  int i;
+
+  if(e == HTTP_SOCKET_DATA) {
+    if(received == 0 && datalen > 0) {
+      version = data[0] ^ pattern(offset);
+    }
+    for(i = 0; i < datalen; i++) {
+      errors += data[i] != (pattern(offset + received + i) ^ version);
+    }
+    received += datalen;
+    return;
+  } else if(e == HTTP_SOCKET_HEADER) {
+    return;
+  }
+
+  expected = downloads[download].length ? downloads[download].length :
+    SIZE - offset;
+  if(e == HTTP_SOCKET_ERR && downloads[download].may_end_early &&
+     errors == 0) {
+    ended_early++;
+  } else if(e != HTTP_SOCKET_CLOSED || received != expected || errors != 0 ||
+            (version != 0 && !downloads[download].may_end_early)) {
+    printf("%s from %ld: failure, event %d, %ld of %ld bytes, %ld errors\n",
+           downloads[download].path, (long)downloads[download].pos,
+           e, received, expected, errors);
+    failures++;
+  }
+
+  if(++download == DOWNLOADS) {
+    download = 0;
+    round++;
+  }
+  if(round < ROUNDS) {
+    /* From the callback, to reuse the connection */
+    get();
+  } else {
+    printf("%d downloads, %lu failures, %lu ended early, %lu ms\n",
+           ROUNDS * (int)DOWNLOADS, failures, ended_early,
+           (unsigned long)((clock_time() - start) * 1000 / CLOCK_SECOND));
+    process_poll(&http_socket_tests_process);
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(http_socket_tests_process, ev, data)
+{
+  static struct etimer et;
+
+  PROCESS_BEGIN();
+
+  /* Time for the host to set up the tap interface */
+  etimer_set(&et, CLOCK_SECOND * 5);
+  PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+
+  http_socket_init(&s);
+  start = clock_time();
+  get();
+
+  PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_POLL);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+"""
+HTTP server for http-socket-tests, that breaks its connections.
+
+Every resource is SIZE bytes of a pattern the node checks, byte i being
+(i * 7 + i // 251) & 0xff. The path picks how it is sent:
+
+  /plain    Content-Length, honours Range and If-Range
+  /chunked  chunked transfer-coding in chunks of random size
+  /norange  Content-Length, ignores Range
+  /close    no length, the body ends when the connection does
+  /changing Content-Length, honours Range and If-Range, and changes on
+            every request: each version has a long ETag, and its bytes
+            are XORed with the version number
+
+Responses are cut off after a random number of bytes with probability
+DROP, to make the node resume them. The connections are kept open
+between requests, and the number of requests, connections and drops is
+printed as they happen.
+
+Usage: test-server.py [port] [drop probability]
+"""
+
+import random
+import socket
+import socketserver
+import struct
+import sys
+
+SIZE = 20000
+DROP = float(sys.argv[2]) if len(sys.argv) > 2 else 0.5
+ETAG = '"v1"'
+
+BODY = bytes((i * 7 + i // 251) & 0xff for i in range(SIZE))
+
+stats = {'connections': 0, 'requests': 0, 'drops': 0}
+version = 0
+
+
+class Dropped(Exception):
+    pass
+
+
+def parse_range(value, size):
+    """Return (first, last) of a single bytes range, or None."""
+    if not value or not value.startswith('bytes='):
+        return None
+    first, _, last = value[len('bytes='):].partition('-')
+    if first == '':
+        return max(size - int(last), 0), size - 1
+    return int(first), min(int(last), size - 1) if last else size - 1
+
+
+class Handler(socketserver.StreamRequestHandler):
+    def send(self, data):
+        # Lose the connection somewhere in the response, now and then
+        if self.drop_at is not None:
+            if self.drop_at < len(data):
+                self.wfile.write(data[:self.drop_at])
+                self.wfile.flush()
+                stats['drops'] += 1
+                if random.random() < 0.5:
+                    # Reset the connection rather than close it
+                    self.request.setsockopt(socket.SOL_SOCKET, socket.SO_LINGER,
+                                            struct.pack('ii', 1, 0))
+                raise Dropped()
+            self.drop_at -= len(data)
+        self.wfile.write(data)
+
+    def handle(self):
+        stats['connections'] += 1
+        try:
+            while self.handle_request():
+                pass
+        except (Dropped, ConnectionError):
+            pass
+
+    def handle_request(self):
+        line = self.rfile.readline().decode('latin-1')
+        if not line:
+            return False
+        headers = {}
+        while True:
+            header = self.rfile.readline().decode('latin-1').strip()
+            if not header:
+                break
+            name, _, value = header.partition(':')
+            headers[name.strip().lower()] = value.strip()
+
+        stats['requests'] += 1
+        path = line.split()[1]
+        print('%s %s, range %s, %s' % (line.split()[0], path, headers.get('range'), stats))
+        sys.stdout.flush()
+
+        self.drop_at = None
+        if path != '/close' and random.random() < DROP:
+            self.drop_at = random.randrange(SIZE + 200)
+
+        etag, data = ETAG, BODY
+        if path == '/changing':
+            global version
+            version = version % 255 + 1
+            # Longer than the ETags http-socket can keep
+            etag = '"v%d-%s"' % (version, 'x' * 96)
+            data = bytes(b ^ version for b in BODY)
+
+        body_range = None
+        if path in ('/plain', '/changing') and headers.get('if-range', etag) == etag:
+            body_range = parse_range(headers.get('range'), SIZE)
+        first, last = body_range or (0, SIZE - 1)
+        body = data[first:last + 1]
+
+        status = '206 Partial Content' if body_range else '200 OK'
+        head = 'HTTP/1.1 %s\r\nETag: %s\r\n' % (status, etag)
+        if body_range:
+            head += 'Content-Range: bytes %d-%d/%d\r\n' % (first, last, SIZE)
+
+        if path == '/chunked':
+            head += 'Transfer-Encoding: chunked\r\n\r\n'
+            self.send(head.encode())
+            pos = 0
+            while pos < len(body):
+                n = random.randint(1, 3000)
+                chunk = body[pos:pos + n]
+                self.send(b'%x;ext=1\r\n' % len(chunk) + chunk + b'\r\n')
+                pos += n
+            self.send(b'0\r\nX-Trailer: yes\r\n\r\n')
+        elif path == '/close':
+            head += 'Connection: close\r\n\r\n'
+            self.send(head.encode() + body)
+            return False
+        else:
+            head += 'Content-Length: %d\r\n\r\n' % len(body)
+            self.send(head.encode() + body)
+        self.wfile.flush()
+        return True
+
+
+class Server(socketserver.ThreadingTCPServer):
+    address_family = socket.AF_INET6
+    allow_reuse_address = True
+    daemon_threads = True
+
+
+if __name__ == '__main__':
+    port = int(sys.argv[1]) if len(sys.argv) > 1 else 8080
+    Server(('::', port), Handler).serve_forever()
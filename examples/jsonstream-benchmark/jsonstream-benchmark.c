@@ -0,0 +1,568 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      Fuzzer and throughput benchmark for the streaming JSON tokenizer.
+ *
+ *      Random valid documents are tokenized by jsonparse in one buffer
+ *      and by jsonstream in random chunks, down to a byte at a time, and
+ *      the token sequences and values have to match. Randomly mutated
+ *      documents have to give the same tokens and the same error whether
+ *      they are fed whole or in chunks. Every chunk is copied into a
+ *      buffer followed by garbage, so reads past the end of a chunk show
+ *      up as differences.
+ *
+ *      The throughput of both tokenizers is then measured on a large
+ *      document.
+ */
+
+#include "contiki.h"
+#include "jsonparse.h"
+#include "jsonstream.h"
+#include "lib/random.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define DOC_SIZE        2048
+#define TRANSCRIPT_SIZE 4096
+#define MAX_DEPTH       8
+#define DOCUMENTS       20000UL
+#define MUTATIONS       20000UL
+
+#define BIG_DOC_SIZE    32768
+#define CHUNK_SIZE      64
+
+struct transcript {
+  char raw[TRANSCRIPT_SIZE];
+  char decoded[TRANSCRIPT_SIZE];
+  int raw_len;
+  int decoded_len;
+  int tokens;
+  int error;
+};
+
+static char doc[DOC_SIZE + 1];
+static int doc_len;
+static char chunk[DOC_SIZE + 16];
+static struct transcript expected, whole, chunked;
+static char big_doc[BIG_DOC_SIZE + 1];
+static int big_doc_len;
+
+/*---------------------------------------------------------------------------*/
+static void
+put(const char *s)
+{
+  while(*s && doc_len < DOC_SIZE) {
+    doc[doc_len++] = *s++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+put_ws(void)
+{
+  /* literals only end at a space for jsonparse */
+  if(random_rand() % 4 == 0) {
+    put(" ");
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+gen_string(void)
+{
+  static const char *const escapes[] = {
+    "\\\"", "\\\\", "\\/", "\\n", "\\t", "\\r", "\\b", "\\u00e9",
+    "\\u20AC", "\\u0041", "\\ud83d\\ude00", "\\uD800", "\\udc00",
+    "\xc3\xa9", "\xf0\x9f\x98\x80"
+  };
+  static const char chars[] = "abcXYZ019 -_:,{}[]";
+  int n;
+
+  put("\"");
+  for(n = random_rand() % 24; n > 0; n--) {
+    if(random_rand() % 6 == 0) {
+      put(escapes[random_rand() % (sizeof(escapes) / sizeof(escapes[0]))]);
+    } else {
+      char c[2] = { chars[random_rand() % (sizeof(chars) - 1)], 0 };
+      put(c);
+    }
+  }
+  put("\"");
+}
+/*---------------------------------------------------------------------------*/
+static void
+gen_number(void)
+{
+  char num[24];
+
+  sprintf(num, "%s%u", random_rand() % 3 == 0 ? "-" : "", random_rand());
+  put(num);
+  if(random_rand() % 2) {
+    sprintf(num, ".%u", random_rand() % 1000);
+    put(num);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+gen_value(int depth)
+{
+  static const char *const literals[] = { "null", "true", "false" };
+  int n, r;
+
+  r = random_rand() % 8;
+  if(depth >= MAX_DEPTH || doc_len > DOC_SIZE / 2) {
+    r = 2 + r % 3;
+  }
+
+  put_ws();
+  switch(r) {
+  case 0:
+  case 1:
+    put(r == 0 ? "[" : "{");
+    put_ws();
+    for(n = random_rand() % 6; n > 0; n--) {
+      if(r == 1) {
+        gen_string();
+        put_ws();
+        put(":");
+      }
+      gen_value(depth + 1);
+      put_ws();
+      if(n > 1) {
+        put(",");
+      }
+    }
+    put(r == 0 ? "]" : "}");
+    break;
+  case 2:
+    gen_number();
+    break;
+  case 3:
+    put(literals[random_rand() % 3]);
+    break;
+  default:
+    gen_string();
+    break;
+  }
+  put_ws();
+}
+/*---------------------------------------------------------------------------*/
+static void
+mutate(void)
+{
+  static const char alphabet[] = "{}[]:,\"\\ \n\t0123456789-.eEnulltruefas\xe9";
+  int n, pos;
+
+  for(n = 1 + random_rand() % 4; n > 0 && doc_len > 0; n--) {
+    pos = random_rand() % doc_len;
+    switch(random_rand() % 4) {
+    case 0:
+      doc[pos] = alphabet[random_rand() % (sizeof(alphabet) - 1)];
+      break;
+    case 1:
+      memmove(&doc[pos], &doc[pos + 1], doc_len - pos - 1);
+      doc_len--;
+      break;
+    case 2:
+      if(doc_len < DOC_SIZE) {
+        memmove(&doc[pos + 1], &doc[pos], doc_len - pos);
+        doc[pos] = alphabet[random_rand() % (sizeof(alphabet) - 1)];
+        doc_len++;
+      }
+      break;
+    case 3:
+      doc_len = pos;
+      break;
+    }
+  }
+  doc[doc_len] = 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+append(char *buf, int *len, const char *s, int n)
+{
+  if(*len + n > TRANSCRIPT_SIZE) {
+    n = TRANSCRIPT_SIZE - *len;
+  }
+  memcpy(buf + *len, s, n);
+  *len += n;
+}
+/*---------------------------------------------------------------------------*/
+static int
+is_value(int type)
+{
+  return type == JSON_TYPE_STRING || type == JSON_TYPE_PAIR_NAME ||
+    type == JSON_TYPE_NUMBER || type == JSON_TYPE_NULL ||
+    type == JSON_TYPE_TRUE || type == JSON_TYPE_FALSE;
+}
+/*---------------------------------------------------------------------------*/
+static void
+run_jsonparse(struct transcript *t)
+{
+  struct jsonparse_state state;
+  char type;
+  int c;
+
+  memset(t, 0, sizeof(*t));
+  jsonparse_setup(&state, doc, doc_len);
+  while((c = jsonparse_next(&state)) != JSON_TYPE_ERROR) {
+    type = c;
+    append(t->raw, &t->raw_len, &type, 1);
+    if(is_value(c)) {
+      append(t->raw, &t->raw_len, doc + state.vstart, state.vlen);
+    }
+    append(t->raw, &t->raw_len, "", 1);
+    t->tokens++;
+  }
+  t->error = state.error;
+}
+/*---------------------------------------------------------------------------*/
+/* feed the document in chunks of up to max_chunk bytes */
+static void
+run_jsonstream(struct transcript *t, int max_chunk)
+{
+  static struct jsonstream_state state;
+  static char value[DOC_SIZE];
+  int pos, len, n, c;
+  int first;
+  char type;
+
+  memset(t, 0, sizeof(*t));
+  jsonstream_init(&state);
+  pos = 0;
+  first = 1;
+  while(1) {
+    c = jsonstream_next(&state);
+    if(c == JSONSTREAM_MORE) {
+      if(pos == doc_len) {
+        jsonstream_end(&state);
+        continue;
+      }
+      len = 1 + random_rand() % max_chunk;
+      if(len > doc_len - pos) {
+        len = doc_len - pos;
+      }
+      /* whatever the tokenizer reads past the chunk is garbage */
+      memcpy(chunk, doc + pos, len);
+      for(n = len; n < len + 16; n++) {
+        chunk[n] = "\"]}, 0"[random_rand() % 6];
+      }
+      jsonstream_feed(&state, chunk, len);
+      pos += len;
+      continue;
+    }
+    if(c == JSON_TYPE_ERROR) {
+      break;
+    }
+
+    if(first) {
+      type = c;
+      append(t->raw, &t->raw_len, &type, 1);
+      append(t->decoded, &t->decoded_len, &type, 1);
+    }
+    if(is_value(c)) {
+      append(t->raw, &t->raw_len, jsonstream_get_value(&state),
+             jsonstream_get_len(&state));
+      n = jsonstream_copy_value(&state, value, sizeof(value));
+      append(t->decoded, &t->decoded_len, value, n);
+    }
+    first = !jsonstream_is_partial(&state);
+    if(first) {
+      append(t->raw, &t->raw_len, "", 1);
+      append(t->decoded, &t->decoded_len, "", 1);
+      t->tokens++;
+    }
+  }
+  t->error = state.error;
+}
+/*---------------------------------------------------------------------------*/
+static int
+same_raw(const struct transcript *a, const struct transcript *b)
+{
+  return a->raw_len == b->raw_len && a->tokens == b->tokens &&
+    a->error == b->error && memcmp(a->raw, b->raw, a->raw_len) == 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+same_decoded(const struct transcript *a, const struct transcript *b)
+{
+  return a->decoded_len == b->decoded_len &&
+    memcmp(a->decoded, b->decoded, a->decoded_len) == 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+max_chunk(void)
+{
+  switch(random_rand() % 3) {
+  case 0:
+    return 1;
+  case 1:
+    return 2 + random_rand() % 15;
+  default:
+    return CHUNK_SIZE;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+failure(const char *what, int max)
+{
+  printf("%s with chunks of up to %d bytes: %.*s\n", what, max, doc_len, doc);
+}
+/*---------------------------------------------------------------------------*/
+static const struct {
+  const char *json;
+  const char *utf8;
+} unicode_tests[] = {
+  { "[\"\\u00e9\\u20ac\"]", "\xc3\xa9\xe2\x82\xac" },
+  { "[\"\\ud83d\\ude00\"]", "\xf0\x9f\x98\x80" },
+  { "[\"\\uD834\\uDD1E!\"]", "\xf0\x9d\x84\x9e!" },
+  { "[\"a\\ud800b\"]", "a\xef\xbf\xbd" "b" },
+  { "[\"\\ud800\\ud83d\\ude00\"]", "\xef\xbf\xbd\xf0\x9f\x98\x80" },
+  { "[\"\\udc00\\ud800\"]", "\xef\xbf\xbd\xef\xbf\xbd" },
+  { "[\"x\xf0\x9f\x98\x80\xc3\xa9\"]", "x\xf0\x9f\x98\x80\xc3\xa9" },
+};
+/*---------------------------------------------------------------------------*/
+/* decode known strings into buffers of every size */
+static unsigned long
+test_unicode(void)
+{
+  static struct jsonstream_state state;
+  char value[32];
+  unsigned long errors;
+  int i, size, len, n;
+
+  errors = 0;
+  for(i = 0; i < sizeof(unicode_tests) / sizeof(unicode_tests[0]); i++) {
+    len = strlen(unicode_tests[i].utf8);
+    for(size = 1; size <= len + 1; size++) {
+      jsonstream_init(&state);
+      jsonstream_feed(&state, unicode_tests[i].json,
+                      strlen(unicode_tests[i].json));
+      if(jsonstream_next(&state) != '[' ||
+         jsonstream_next(&state) != JSON_TYPE_STRING) {
+        errors++;
+        continue;
+      }
+      n = jsonstream_copy_value(&state, value, size);
+      /* a prefix of the whole value, cut before a UTF-8 sequence */
+      if(n >= size || value[n] != 0 ||
+         memcmp(value, unicode_tests[i].utf8, n) != 0 ||
+         (n < len && (unicode_tests[i].utf8[n] & 0xc0) == 0x80) ||
+         (size == len + 1 && n != len)) {
+        printf("%s decoded into %d bytes: %.*s\n", unicode_tests[i].json,
+               size, n, value);
+        errors++;
+      }
+    }
+  }
+  return errors;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+test_documents(void)
+{
+  unsigned long i, errors;
+  int max;
+
+  errors = 0;
+  for(i = 0; i < DOCUMENTS; i++) {
+    doc_len = 0;
+    gen_value(0);
+    doc[doc_len] = 0;
+
+    max = max_chunk();
+    run_jsonparse(&expected);
+    run_jsonstream(&whole, DOC_SIZE);
+    run_jsonstream(&chunked, max);
+    if(expected.error != JSON_ERROR_OK || !same_raw(&expected, &whole)) {
+      failure("jsonparse and jsonstream differ", DOC_SIZE);
+      errors++;
+    } else if(!same_raw(&whole, &chunked) || !same_decoded(&whole, &chunked)) {
+      failure("chunked jsonstream differs", max);
+      errors++;
+    }
+  }
+  return errors;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+test_mutations(unsigned long *rejected)
+{
+  unsigned long i, errors;
+  int max;
+
+  errors = 0;
+  *rejected = 0;
+  for(i = 0; i < MUTATIONS; i++) {
+    doc_len = 0;
+    gen_value(0);
+    mutate();
+
+    max = max_chunk();
+    run_jsonstream(&whole, DOC_SIZE);
+    run_jsonstream(&chunked, max);
+    if(!same_raw(&whole, &chunked) || !same_decoded(&whole, &chunked)) {
+      failure("chunked jsonstream differs", max);
+      errors++;
+    }
+    *rejected += whole.error != JSON_ERROR_OK;
+  }
+  return errors;
+}
+/*---------------------------------------------------------------------------*/
+static void
+make_big_doc(void)
+{
+  char record[128];
+  int i, n;
+
+  big_doc_len = 0;
+  big_doc[big_doc_len++] = '[';
+  for(i = 0; ; i++) {
+    n = sprintf(record, "%s{\"id\": %d, \"name\": \"sensor-%d\", "
+                "\"values\": [1.5, 22.25, -3], \"ok\": true}\n",
+                i == 0 ? "" : ",", i, i % 97);
+    if(big_doc_len + n + 2 > BIG_DOC_SIZE) {
+      break;
+    }
+    memcpy(big_doc + big_doc_len, record, n);
+    big_doc_len += n;
+  }
+  big_doc[big_doc_len++] = ']';
+  big_doc[big_doc_len] = 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+report(const char *name, unsigned long rounds, clock_time_t elapsed,
+       unsigned long tokens)
+{
+  if(elapsed == 0) {
+    elapsed = 1;
+  }
+  printf("%s: %lu KB/s, %lu tokens per document\n", name,
+         (unsigned long)((unsigned long long)rounds * big_doc_len *
+                         CLOCK_SECOND / elapsed / 1000),
+         tokens);
+}
+/*---------------------------------------------------------------------------*/
+static void
+bench_jsonparse(void)
+{
+  struct jsonparse_state state;
+  unsigned long rounds, tokens;
+  clock_time_t start;
+
+  start = clock_time();
+  for(rounds = 0; clock_time() - start < CLOCK_SECOND; rounds++) {
+    tokens = 0;
+    jsonparse_setup(&state, big_doc, big_doc_len);
+    while(jsonparse_next(&state) != JSON_TYPE_ERROR) {
+      tokens++;
+    }
+  }
+  report("jsonparse, whole document", rounds, clock_time() - start, tokens);
+}
+/*---------------------------------------------------------------------------*/
+static void
+bench_jsonstream(int chunk_size)
+{
+  static struct jsonstream_state state;
+  unsigned long rounds, tokens;
+  clock_time_t start;
+  char name[48];
+  int pos, len, c;
+
+  start = clock_time();
+  for(rounds = 0; clock_time() - start < CLOCK_SECOND; rounds++) {
+    tokens = 0;
+    pos = 0;
+    jsonstream_init(&state);
+    while((c = jsonstream_next(&state)) != JSON_TYPE_ERROR) {
+      if(c != JSONSTREAM_MORE) {
+        tokens++;
+      } else if(pos == big_doc_len) {
+        jsonstream_end(&state);
+      } else {
+        len = big_doc_len - pos < chunk_size ? big_doc_len - pos : chunk_size;
+        jsonstream_feed(&state, big_doc + pos, len);
+        pos += len;
+      }
+    }
+  }
+  sprintf(name, "jsonstream, %d byte chunks", chunk_size);
+  report(name, rounds, clock_time() - start, tokens);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(jsonstream_benchmark_process, "jsonstream benchmark");
+AUTOSTART_PROCESSES(&jsonstream_benchmark_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(jsonstream_benchmark_process, ev, data)
+{
+  unsigned long errors, rejected;
+
+  PROCESS_BEGIN();
+
+  printf("Testing unicode escapes and truncation ... ");
+  errors = test_unicode();
+  if(errors == 0) {
+    printf("Success\n");
+  } else {
+    printf("Failure (%lu errors)\n", errors);
+  }
+
+  printf("Testing %lu valid documents ... ", DOCUMENTS);
+  errors = test_documents();
+  if(errors == 0) {
+    printf("Success\n");
+  } else {
+    printf("Failure (%lu errors)\n", errors);
+  }
+
+  printf("Testing %lu mutated documents ... ", MUTATIONS);
+  errors = test_mutations(&rejected);
+  if(errors == 0) {
+    printf("Success (%lu rejected)\n", rejected);
+  } else {
+    printf("Failure (%lu errors)\n", errors);
+  }
+
+  make_big_doc();
+  printf("%d byte document, %u byte tokenizer state\n",
+         big_doc_len, (unsigned)sizeof(struct jsonstream_state));
+  bench_jsonparse();
+  bench_jsonstream(big_doc_len);
+  bench_jsonstream(CHUNK_SIZE);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      Measures the throughput of the reference and T-table AES-128
+ *      drivers in blocks per second, and of CCM* in authenticated and
+ *      encrypted 100-byte frames per second.
+ */
+
+#include "contiki.h"
+#include "lib/aes-128.h"
+#include "lib/ccm-star.h"
+#include <stdio.h>
+#include <string.h>
+
+#define BLOCK_ROUNDS 200000UL
+#define FRAME_ROUNDS 20000UL
+#define FRAME_LEN 100
+#define HEADER_LEN 21
+#define MIC_LEN 8
+
+/*---------------------------------------------------------------------------*/
+static void
+print_rate(const char *name, unsigned long rounds, clock_time_t elapsed)
+{
+  if(elapsed == 0) {
+    elapsed = 1;
+  }
+  printf("%s: %lu/s\n", name,
+      (unsigned long)((rounds * CLOCK_SECOND) / elapsed));
+}
+/*---------------------------------------------------------------------------*/
+static void
+bench_aes_128(const char *name, const struct aes_128_driver *driver)
+{
+  uint8_t key[16] = { 0x00 , 0x01 , 0x02 , 0x03 ,
+                      0x04 , 0x05 , 0x06 , 0x07 ,
+                      0x08 , 0x09 , 0x0A , 0x0B ,
+                      0x0C , 0x0D , 0x0E , 0x0F };
+  uint8_t data[16];
+  unsigned long i;
+  clock_time_t start;
+  
+  memset(data, 0, sizeof(data));
+  driver->set_key(key);
+  start = clock_time();
+  for(i = 0; i < BLOCK_ROUNDS; i++) {
+    driver->encrypt(data);
+  }
+  print_rate(name, BLOCK_ROUNDS, clock_time() - start);
+}
+/*---------------------------------------------------------------------------*/
+static void
+bench_ccm_star(void)
+{
+  uint8_t key[16] = { 0xC0 , 0xC1 , 0xC2 , 0xC3 ,
+                      0xC4 , 0xC5 , 0xC6 , 0xC7 ,
+                      0xC8 , 0xC9 , 0xCA , 0xCB ,
+                      0xCC , 0xCD , 0xCE , 0xCF };
+  uint8_t nonce[CCM_STAR_NONCE_LENGTH];
+  uint8_t frame[FRAME_LEN];
+  uint8_t mic[MIC_LEN];
+  unsigned long i;
+  clock_time_t start;
+  
+  memset(nonce, 0, sizeof(nonce));
+  memset(frame, 0xA5, sizeof(frame));
+  CCM_STAR.set_key(key);
+  start = clock_time();
+  for(i = 0; i < FRAME_ROUNDS; i++) {
+    nonce[CCM_STAR_NONCE_LENGTH - 1] = (uint8_t)i;
+    CCM_STAR.aead(nonce,
+        frame + HEADER_LEN, FRAME_LEN - HEADER_LEN,
+        frame, HEADER_LEN,
+        mic, MIC_LEN,
+        1);
+  }
+  print_rate("CCM* frames", FRAME_ROUNDS, clock_time() - start);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(ccm_star_benchmark_process, "CCM* benchmark process");
+AUTOSTART_PROCESSES(&ccm_star_benchmark_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(ccm_star_benchmark_process, ev, data)
+{
+  PROCESS_BEGIN();
+  
+  bench_aes_128("AES-128 blocks", &aes_128_driver);
+  bench_aes_128("AES-128 (T-table) blocks", &aes_128_ttable_driver);
+  bench_ccm_star();
+  
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -127,6 +127,51 @@ test_sec_lvl_6()
   }
 }
 /*---------------------------------------------------------------------------*/
+/* Packet vector #1 from RFC 3610, a payload spanning multiple blocks */
+static void
+test_multi_block()
+{
+  uint8_t key[16] = { 0xC0 , 0xC1 , 0xC2 , 0xC3 ,
+                      0xC4 , 0xC5 , 0xC6 , 0xC7 ,
+                      0xC8 , 0xC9 , 0xCA , 0xCB ,
+                      0xCC , 0xCD , 0xCE , 0xCF };
+  uint8_t nonce[13] = { 0x00 , 0x00 , 0x00 , 0x03 , 0x02 , 0x01 , 0x00 ,
+                        0xA0 , 0xA1 , 0xA2 , 0xA3 , 0xA4 , 0xA5 };
+  uint8_t a[8] = { 0x00 , 0x01 , 0x02 , 0x03 , 0x04 , 0x05 , 0x06 , 0x07 };
+  uint8_t m[23] = { 0x08 , 0x09 , 0x0A , 0x0B , 0x0C , 0x0D , 0x0E , 0x0F ,
+                    0x10 , 0x11 , 0x12 , 0x13 , 0x14 , 0x15 , 0x16 , 0x17 ,
+                    0x18 , 0x19 , 0x1A , 0x1B , 0x1C , 0x1D , 0x1E };
+  uint8_t oracle[23] = { 0x58 , 0x8C , 0x97 , 0x9A , 0x61 , 0xC6 , 0x63 , 0xD2 ,
+                         0xF0 , 0x66 , 0xD0 , 0xC2 , 0xC0 , 0xF9 , 0x89 , 0x80 ,
+                         0x6D , 0x5F , 0x6B , 0x61 , 0xDA , 0xC3 , 0x84 };
+  uint8_t mic_oracle[8] = { 0x17 , 0xE8 , 0xD1 , 0x2C ,
+                            0xFD , 0xF9 , 0x26 , 0xE0 };
+  uint8_t mic[8];
+  
+  printf("Testing multi-block encryption ... ");
+  
+  CCM_STAR.set_key(key);
+  CCM_STAR.aead(nonce, m, sizeof(m), a, sizeof(a), mic, sizeof(mic), 1);
+  
+  if(memcmp(m, oracle, sizeof(m)) == 0
+     && memcmp(mic, mic_oracle, sizeof(mic)) == 0) {
+    printf("Success\n");
+  } else {
+    printf("Failure\n");
+  }
+  
+  printf("Testing multi-block decryption ... ");
+  
+  CCM_STAR.aead(nonce, m, sizeof(m), a, sizeof(a), mic, sizeof(mic), 0);
+  
+  if(m[0] == 0x08 && m[22] == 0x1E
+     && memcmp(mic, mic_oracle, sizeof(mic)) == 0) {
+    printf("Success\n");
+  } else {
+    printf("Failure\n");
+  }
+}
+/*---------------------------------------------------------------------------*/
 PROCESS(ccm_star_tests_process, "CCM* tests process");
 AUTOSTART_PROCESSES(&ccm_star_tests_process);
 /*---------------------------------------------------------------------------*/
@@ -135,6 +180,7 @@ PROCESS_THREAD(ccm_star_tests_process, ev, data)
   PROCESS_BEGIN();
   
   test_sec_lvl_6();
+  test_multi_block();
   
   PROCESS_END();
 }
@@ -81,6 +81,35 @@ test_aes_128()
   }
 }
 /*---------------------------------------------------------------------------*/
+/* Test vector C.1 from FIPS Pub 197, table-driven implementation */
+static void
+test_aes_128_ttable()
+{
+  uint8_t key[16] = { 0x00 , 0x01 , 0x02 , 0x03 ,
+                      0x04 , 0x05 , 0x06 , 0x07 ,
+                      0x08 , 0x09 , 0x0A , 0x0B ,
+                      0x0C , 0x0D , 0x0E , 0x0F };
+  uint8_t data[16] = { 0x00 , 0x11 , 0x22 , 0x33 ,
+                       0x44 , 0x55 , 0x66 , 0x77 ,
+                       0x88 , 0x99 , 0xAA , 0xBB ,
+                       0xCC , 0xDD , 0xEE , 0xFF };
+  uint8_t oracle[16] = { 0x69 , 0xC4 , 0xE0 , 0xD8 ,
+                         0x6A , 0x7B , 0x04 , 0x30 ,
+                         0xD8 , 0xCD , 0xB7 , 0x80 ,
+                         0x70 , 0xB4 , 0xC5 , 0x5A };
+  
+  printf("Testing AES-128 (T-table) ... ");
+  
+  aes_128_ttable_driver.set_key(key);
+  aes_128_ttable_driver.encrypt(data);
+  
+  if(memcmp(data, oracle, 16) == 0) {
+    printf("Success\n");
+  } else {
+    printf("Failure\n");
+  }
+}
+/*---------------------------------------------------------------------------*/
 /* Test vector C.2.1.2 from IEEE 802.15.4-2006 */
 static void
 test_sec_lvl_2()
@@ -141,6 +170,7 @@ PROCESS_THREAD(ccm_star_tests_process, ev, data)
   PROCESS_BEGIN();
   
   test_aes_128();
+  test_aes_128_ttable();
   test_sec_lvl_2();
   
   PROCESS_END();
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      Benchmark for the ROLL TM multicast engine. Datagrams from
+ *      SEEDS seeds are fed to the engine, every new datagram followed
+ *      by two copies of datagrams already seen, as in a dense network
+ *      where every neighbour forwards everything. Then the engine is
+ *      fed ICMPv6 advertisements listing every buffered message.
+ *
+ *      The rates are printed, and the counters of the multicast stats
+ *      show whether every duplicate was caught. Build with HASH=1 to
+ *      compare against a scan of the windows and of the buffer.
+ *
+ *      Finally the messages are left to dwell out, after which the last
+ *      datagram of a seed has to be accepted as new again.
+ */
+
+#include "contiki-net.h"
+#include "net/ipv6/multicast/uip-mcast6.h"
+#include "net/ipv6/multicast/uip-mcast6-stats.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define SEEDS       8
+#define ROUNDS      20000UL
+#define ADVERTS     100000UL
+#define PAYLOAD_LEN 32
+
+/* Messages per seed left in the buffer after the datagrams */
+#define LISTED      (ROLL_TM_BUFF_NUM / SEEDS)
+
+#define HBHO_LEN    8
+#define SEQ_HDR_LEN (2 + sizeof(uip_ipaddr_t))
+
+#define UIP_IP_BUF   ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+#define UIP_HBHO_BUF ((uint8_t *)&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN])
+#define UIP_ICMP_BUF ((struct uip_icmp_hdr *)&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN])
+
+PROCESS(multicast_benchmark_process, "Multicast benchmark");
+AUTOSTART_PROCESSES(&multicast_benchmark_process);
+/*---------------------------------------------------------------------------*/
+static void
+seed_addr(uip_ipaddr_t *addr, uint8_t seed)
+{
+  uip_ip6addr(addr, 0xfe80, 0, 0, 0, 0, 0, 0, 0x100 + seed);
+}
+/*---------------------------------------------------------------------------*/
+static void
+build_datagram(uint8_t seed, uint16_t seq)
+{
+  uint8_t *hbho = UIP_HBHO_BUF;
+
+  uip_len = UIP_IPH_LEN + HBHO_LEN + UIP_UDPH_LEN + PAYLOAD_LEN;
+  memset(uip_buf, 0, uip_len + UIP_LLH_LEN);
+
+  UIP_IP_BUF->vtc = 0x60;
+  UIP_IP_BUF->len[0] = (uip_len - UIP_IPH_LEN) >> 8;
+  UIP_IP_BUF->len[1] = (uip_len - UIP_IPH_LEN) & 0xff;
+  UIP_IP_BUF->proto = UIP_PROTO_HBHO;
+  UIP_IP_BUF->ttl = 64;
+  seed_addr(&UIP_IP_BUF->srcipaddr, seed);
+  uip_ip6addr(&UIP_IP_BUF->destipaddr, 0xff03, 0, 0, 0, 0, 0, 0, 0xfc);
+
+  /* Trickle option with M set and a long seed, padded with PadN */
+  hbho[0] = UIP_PROTO_UDP;
+  hbho[1] = 0;
+  hbho[2] = 0x0C;
+  hbho[3] = 2;
+  hbho[4] = 0x80 | ((seq >> 8) & 0x7F);
+  hbho[5] = seq & 0xFF;
+  hbho[6] = UIP_EXT_HDR_OPT_PADN;
+  hbho[7] = 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+build_advert(uint16_t last_seq)
+{
+  uint8_t *p = (uint8_t *)UIP_ICMP_BUF + UIP_ICMPH_LEN;
+  uint8_t seed;
+  uint8_t i;
+  uint16_t seq;
+
+  uip_len = UIP_IPH_LEN + UIP_ICMPH_LEN + SEEDS * (SEQ_HDR_LEN + LISTED * 2);
+  memset(uip_buf, 0, uip_len + UIP_LLH_LEN);
+
+  UIP_IP_BUF->vtc = 0x60;
+  UIP_IP_BUF->len[0] = (uip_len - UIP_IPH_LEN) >> 8;
+  UIP_IP_BUF->len[1] = (uip_len - UIP_IPH_LEN) & 0xff;
+  UIP_IP_BUF->proto = UIP_PROTO_ICMP6;
+  UIP_IP_BUF->ttl = 0xFF;
+  uip_ip6addr(&UIP_IP_BUF->srcipaddr, 0xfe80, 0, 0, 0, 0, 0, 0, 1);
+  uip_create_linklocal_allrouters_mcast(&UIP_IP_BUF->destipaddr);
+  UIP_ICMP_BUF->type = ICMP6_ROLL_TM;
+  UIP_ICMP_BUF->icode = 0;
+
+  for(seed = 0; seed < SEEDS; seed++) {
+    /* M set, long seed */
+    p[0] = 0x40;
+    p[1] = LISTED;
+    seed_addr((uip_ipaddr_t *)&p[2], seed);
+    p += SEQ_HDR_LEN;
+    for(i = 0; i < LISTED; i++) {
+      seq = last_seq - i;
+      *p++ = seq >> 8;
+      *p++ = seq & 0xFF;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+rate(unsigned long count, clock_time_t start)
+{
+  clock_time_t elapsed = clock_time() - start;
+
+  return (count * CLOCK_SECOND) / (elapsed ? elapsed : 1);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(multicast_benchmark_process, ev, data)
+{
+  static uint16_t seq;
+  static uint8_t seed;
+  static unsigned long i;
+  static clock_time_t start;
+  static struct etimer et;
+  static unsigned long unique;
+
+  PROCESS_BEGIN();
+
+  printf("%u seeds, %u windows, %u messages, %u hash buckets\n",
+         SEEDS, ROLL_TM_WINS, ROLL_TM_BUFF_NUM, ROLL_TM_HASH_SIZE);
+
+  start = clock_time();
+  for(seq = 1; seq <= ROUNDS; seq++) {
+    for(seed = 0; seed < SEEDS; seed++) {
+      build_datagram(seed, seq);
+      UIP_MCAST6.in();
+      build_datagram(seed, seq);
+      UIP_MCAST6.in();
+      build_datagram(seed, seq - 1);
+      UIP_MCAST6.in();
+    }
+  }
+  printf("datagrams: %lu/s\n", rate(ROUNDS * SEEDS * 3, start));
+
+  start = clock_time();
+  for(i = 0; i < ADVERTS; i++) {
+    build_advert(ROUNDS);
+    uip_ext_len = 0;
+    uip_icmp6_input(ICMP6_ROLL_TM, 0);
+  }
+  printf("advertisements: %lu/s\n", rate(ADVERTS, start));
+
+  printf("unique %lu, duplicates %lu, dropped %lu of %lu\n",
+         (unsigned long)UIP_MCAST6_STATS_GET(mcast_in_unique),
+         (unsigned long)UIP_MCAST6_STATS_GET(mcast_dup),
+         (unsigned long)UIP_MCAST6_STATS_GET(mcast_dropped),
+         ROUNDS * SEEDS * 3);
+
+  etimer_set(&et, CLOCK_SECOND * 5);
+  PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+
+  unique = UIP_MCAST6_STATS_GET(mcast_in_unique);
+  build_datagram(0, ROUNDS);
+  UIP_MCAST6.in();
+  printf("after dwell: %s, %lu forwarded\n",
+         UIP_MCAST6_STATS_GET(mcast_in_unique) == unique + 1 ?
+         "forgotten" : "still buffered",
+         (unsigned long)UIP_MCAST6_STATS_GET(mcast_fwd));
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      Checks that binary powertrace records with channel statistics
+ *      decode to the packets sent on each channel, in buffers sized with
+ *      POWERTRACE_RECORD_NODE_MAX_LEN and POWERTRACE_RECORD_STATS_MAX_LEN.
+ */
+
+#include "contiki.h"
+#include "net/rime/rime.h"
+#include "powertrace.h"
+
+#include <stdio.h>
+
+#define CHANNELS      3
+#define FIRST_CHANNEL 129
+
+static struct broadcast_conn bc[CHANNELS];
+static const struct broadcast_callbacks bc_callbacks;
+static uint8_t record[POWERTRACE_RECORD_NODE_MAX_LEN +
+                      CHANNELS * POWERTRACE_RECORD_STATS_MAX_LEN];
+
+struct decoder {
+  const uint8_t *buf;
+  int len;
+  int pos;
+  int error;
+};
+
+PROCESS(powertrace_tests_process, "Powertrace tests");
+AUTOSTART_PROCESSES(&powertrace_tests_process);
+/*---------------------------------------------------------------------------*/
+static uint8_t
+get_byte(struct decoder *d)
+{
+  if(d->pos >= d->len) {
+    d->error = 1;
+    return 0;
+  }
+  return d->buf[d->pos++];
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+get_varint(struct decoder *d)
+{
+  unsigned long value;
+  uint8_t b;
+  int shift;
+
+  value = 0;
+  shift = 0;
+  do {
+    b = get_byte(d);
+    value |= (unsigned long)(b & 0x7f) << shift;
+    shift += 7;
+  } while((b & 0x80) && !d->error);
+  return value;
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_packets(int channel, int count)
+{
+  while(count-- > 0) {
+    packetbuf_copyfrom("powertrace", 10);
+    broadcast_send(&bc[channel]);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Decodes a record and checks that channel i shows sent[i] outputs.
+ * Returns the number of channels of the record, or -1 if it does not
+ * decode.
+ */
+static int
+check_record(int len, int keyframe, const int *sent)
+{
+  struct decoder d;
+  uint8_t type;
+  uint8_t count;
+  unsigned long channel;
+  unsigned long values[POWERTRACE_RECORD_CHANNEL_VALUES];
+  int c, i;
+
+  d.buf = record;
+  d.len = len;
+  d.pos = 0;
+  d.error = 0;
+
+  type = get_byte(&d);
+  if((type & 0xf0) != POWERTRACE_RECORD_TYPE ||
+     !(type & POWERTRACE_RECORD_KEYFRAME) != !keyframe) {
+    return -1;
+  }
+  if(get_byte(&d) != linkaddr_node_addr.u8[0] ||
+     get_byte(&d) != linkaddr_node_addr.u8[1]) {
+    return -1;
+  }
+  get_varint(&d); /* seqno */
+  get_varint(&d); /* time */
+  for(i = 0; i < POWERTRACE_RECORD_COUNTERS; i++) {
+    get_varint(&d);
+  }
+
+  count = get_byte(&d);
+  for(c = 0; c < count; c++) {
+    channel = get_varint(&d);
+    if(type & POWERTRACE_RECORD_PROTO) {
+      get_varint(&d);
+    }
+    for(i = 0; i < POWERTRACE_RECORD_CHANNEL_VALUES; i++) {
+      values[i] = get_varint(&d);
+    }
+    /* values[3] is num_output */
+    if(channel >= FIRST_CHANNEL && channel < FIRST_CHANNEL + CHANNELS &&
+       values[3] != sent[channel - FIRST_CHANNEL]) {
+      return -1;
+    }
+  }
+
+  if(d.error || d.pos != len) {
+    return -1;
+  }
+  return count;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(powertrace_tests_process, ev, data)
+{
+  static const int keyframe_sent[CHANNELS] = { 1, 2, 3 };
+  static const int delta_sent[CHANNELS] = { 4, 0, 2 };
+  static const int none_sent[CHANNELS];
+  int len;
+  int count;
+  int i;
+
+  PROCESS_BEGIN();
+
+  for(i = 0; i < CHANNELS; i++) {
+    broadcast_open(&bc[i], FIRST_CHANNEL + i, &bc_callbacks);
+  }
+  powertrace_sniff(POWERTRACE_ON);
+
+  printf("Testing a keyframe with %u channels ... ", CHANNELS);
+  for(i = 0; i < CHANNELS; i++) {
+    send_packets(i, keyframe_sent[i]);
+  }
+  len = powertrace_record(record, sizeof(record));
+  count = check_record(len, 1, keyframe_sent);
+  if(count >= CHANNELS) {
+    printf("Success (%d bytes)\n", len);
+  } else {
+    printf("Failure (%d channels)\n", count);
+  }
+
+  printf("Testing a delta record with %u channels ... ", CHANNELS);
+  for(i = 0; i < CHANNELS; i++) {
+    send_packets(i, delta_sent[i]);
+  }
+  len = powertrace_record(record, sizeof(record));
+  count = check_record(len, 0, delta_sent);
+  if(count >= CHANNELS) {
+    printf("Success (%d bytes)\n", len);
+  } else {
+    printf("Failure (%d channels)\n", count);
+  }
+
+  printf("Testing an idle record with room for one channel ... ");
+  len = powertrace_record(record, POWERTRACE_RECORD_NODE_MAX_LEN +
+                          POWERTRACE_RECORD_STATS_MAX_LEN);
+  count = check_record(len, 0, none_sent);
+  if(count == 1) {
+    printf("Success (%d bytes)\n", len);
+  } else {
+    printf("Failure (%d channels)\n", count);
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      Checks that lib/ringbuf16 delivers a stream of bytes unchanged and
+ *      in order through random mixes of single byte and block operations,
+ *      for buffer sizes that are and aren't powers of two.
+ */
+
+#include "contiki.h"
+#include "lib/ringbuf16.h"
+#include "lib/random.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_SIZE    300
+#define STREAM_LEN  20000U
+
+static uint8_t ring_data[MAX_SIZE];
+static uint8_t block[MAX_SIZE];
+
+/*---------------------------------------------------------------------------*/
+static unsigned long
+test_stream(uint16_t size)
+{
+  struct ringbuf16 r;
+  uint16_t in, out, len, n, i;
+  uint8_t *span;
+  unsigned long errors;
+  int c;
+
+  ringbuf16_init(&r, ring_data, size);
+  errors = 0;
+
+  /* Byte i of the stream is (uint8_t)i. */
+  in = out = 0;
+  while(out < STREAM_LEN) {
+    len = random_rand() % size;
+
+    switch(random_rand() % 2) {
+    case 0:
+      for(i = 0; i < len && in < STREAM_LEN; i++) {
+        if(!ringbuf16_put(&r, in)) {
+          break;
+        }
+        in++;
+      }
+      break;
+    case 1:
+      if(len > STREAM_LEN - in) {
+        len = STREAM_LEN - in;
+      }
+      for(i = 0; i < len; i++) {
+        block[i] = in + i;
+      }
+      n = ringbuf16_write(&r, block, len);
+      errors += n != (len < size - 1 - (in - out) ? len : size - 1 - (in - out));
+      in += n;
+      break;
+    }
+
+    errors += ringbuf16_elements(&r) != in - out;
+    errors += ringbuf16_space(&r) != size - 1 - (in - out);
+
+    len = random_rand() % size;
+    switch(random_rand() % 3) {
+    case 0:
+      for(i = 0; i < len; i++) {
+        if((c = ringbuf16_get(&r)) == -1) {
+          errors += in != out;
+          break;
+        }
+        errors += c != (uint8_t)out++;
+      }
+      break;
+    case 1:
+      n = ringbuf16_read(&r, block, len);
+      errors += n != (len < in - out ? len : in - out);
+      for(i = 0; i < n; i++) {
+        errors += block[i] != (uint8_t)out++;
+      }
+      break;
+    case 2:
+      n = ringbuf16_peek(&r, &span);
+      errors += (n == 0) != (in == out);
+      if(n > len) {
+        n = len;
+      }
+      for(i = 0; i < n; i++) {
+        errors += span[i] != (uint8_t)(out + i);
+      }
+      ringbuf16_consume(&r, n);
+      out += n;
+      break;
+    }
+  }
+
+  return errors;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(ringbuf16_tests_process, "ringbuf16 tests");
+AUTOSTART_PROCESSES(&ringbuf16_tests_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(ringbuf16_tests_process, ev, data)
+{
+  static const uint16_t sizes[] = { 2, 3, 16, 17, 128, 255, MAX_SIZE };
+  unsigned long errors;
+  int i;
+
+  PROCESS_BEGIN();
+
+  for(i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    printf("Testing size %u ... ", sizes[i]);
+    errors = test_stream(sizes[i]);
+    if(errors == 0) {
+      printf("Success\n");
+    } else {
+      printf("Failure (%lu errors)\n", errors);
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
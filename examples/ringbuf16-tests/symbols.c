@@ -0,0 +1,4 @@
+#include "symbols.h"
+
+const int symbols_nelts = 0;
+const struct symbols symbols[] = {{0,0}};
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      Floods a file from node 1 with rudolph2, or with rudolph3 when
+ *      built with RUDOLPH=3, and prints when the file is complete. Run
+ *      by run-benchmark.py, which plays the radio medium.
+ */
+
+#include "contiki.h"
+#include "net/rime/rime.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define FILESIZE 2048
+
+#if RUDOLPH == 3
+#include "net/rime/rudolph3.h"
+#define rudolph_conn rudolph3_conn
+#define rudolph_callbacks rudolph3_callbacks
+#define rudolph_open rudolph3_open
+#define rudolph_send rudolph3_send
+#define RUDOLPH_FLAG_LASTCHUNK RUDOLPH3_FLAG_LASTCHUNK
+#else
+#include "net/rime/rudolph2.h"
+#define rudolph_conn rudolph2_conn
+#define rudolph_callbacks rudolph2_callbacks
+#define rudolph_open rudolph2_open
+#define rudolph_send rudolph2_send
+#define RUDOLPH_FLAG_LASTCHUNK RUDOLPH2_FLAG_LASTCHUNK
+#endif
+
+static uint8_t file[FILESIZE];
+static struct rudolph_conn rudolph;
+
+/*---------------------------------------------------------------------------*/
+PROCESS(rudolph_benchmark_process, "Rudolph benchmark");
+AUTOSTART_PROCESSES(&rudolph_benchmark_process);
+/*---------------------------------------------------------------------------*/
+static uint8_t
+expected(int offset)
+{
+  return offset * 7 + offset / 256;
+}
+/*---------------------------------------------------------------------------*/
+static void
+write_chunk(struct rudolph_conn *c, int offset, int flag,
+            uint8_t *data, int datalen)
+{
+  int i;
+
+  if(offset + datalen > FILESIZE) {
+    datalen = FILESIZE - offset;
+  }
+  if(datalen > 0) {
+    memcpy(&file[offset], data, datalen);
+  }
+
+  if(flag == RUDOLPH_FLAG_LASTCHUNK) {
+    for(i = 0; i < FILESIZE && file[i] == expected(i); i++);
+    printf("done %s at %lu\n", i == FILESIZE ? "ok" : "corrupt",
+           (unsigned long)clock_time());
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+read_chunk(struct rudolph_conn *c, int offset, uint8_t *to, int maxsize)
+{
+  if(offset >= FILESIZE) {
+    return 0;
+  }
+  if(offset + maxsize > FILESIZE) {
+    maxsize = FILESIZE - offset;
+  }
+  memcpy(to, &file[offset], maxsize);
+  return maxsize;
+}
+/*---------------------------------------------------------------------------*/
+static const struct rudolph_callbacks callbacks = { write_chunk, read_chunk };
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(rudolph_benchmark_process, ev, data)
+{
+  static struct etimer et;
+  int i;
+
+  PROCESS_BEGIN();
+
+  rudolph_open(&rudolph, 142, &callbacks);
+
+  if(linkaddr_node_addr.u8[0] == 1) {
+    for(i = 0; i < FILESIZE; i++) {
+      file[i] = expected(i);
+    }
+    /* Give the other nodes time to start */
+    etimer_set(&et, CLOCK_SECOND);
+    PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+    printf("start at %lu\n", (unsigned long)clock_time());
+    rudolph_send(&rudolph, CLOCK_SECOND / 2);
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
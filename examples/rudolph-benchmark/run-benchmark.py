@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+"""
+Run rudolph-benchmark on a line of native nodes, with node 1 at one end
+sending the file, and report how long it took to reach every node and
+how many frames were sent.
+
+The script is the radio medium: every node sends its frames to the hub
+socket, and the hub passes each frame on to the neighbours of the
+sender, dropping it on each link with the given probability.
+
+Usage: run-benchmark.py [-n nodes] [-l loss] [-s seed] [-t timeout]
+"""
+
+import argparse
+import random
+import select
+import socket
+import subprocess
+import sys
+import time
+
+PORT = 30000
+BINARY = './rudolph-benchmark.native'
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Run rudolph-benchmark on a lossy line of nodes.')
+    parser.add_argument('-n', '--nodes', type=int, default=5)
+    parser.add_argument('-l', '--loss', type=float, default=0.2, help='loss probability of each link')
+    parser.add_argument('-s', '--seed', type=int, default=1)
+    parser.add_argument('-t', '--timeout', type=float, default=600, help='seconds before giving up')
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+
+    hub = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    hub.bind(('127.0.0.1', PORT))
+
+    nodes = {}
+    for node in range(1, args.nodes + 1):
+        nodes[node] = subprocess.Popen(['stdbuf', '-oL', BINARY, str(node)],
+                                       stdout=subprocess.PIPE, stderr=subprocess.DEVNULL)
+    pipes = {p.stdout.fileno(): node for node, p in nodes.items()}
+
+    frames = 0
+    octets = 0
+    start = None
+    done = {}
+    failed = []
+    deadline = time.time() + args.timeout
+
+    try:
+        while len(done) + len(failed) < args.nodes - 1 and time.time() < deadline:
+            readable, _, _ = select.select([hub] + list(pipes), [], [], 1)
+            for f in readable:
+                if f is hub:
+                    frame, (_, port) = hub.recvfrom(256)
+                    sender = port - PORT
+                    if start is not None:
+                        frames += 1
+                        octets += len(frame)
+                    for neighbour in (sender - 1, sender + 1):
+                        if neighbour in nodes and rng.random() >= args.loss:
+                            hub.sendto(frame, ('127.0.0.1', PORT + neighbour))
+                    continue
+
+                node = pipes[f]
+                line = nodes[node].stdout.readline().decode(errors='replace')
+                if line.startswith('start'):
+                    start = time.time()
+                elif line.startswith('done') and node not in done:
+                    if 'ok' not in line:
+                        failed.append(node)
+                    done[node] = time.time() - start
+    finally:
+        for p in nodes.values():
+            p.kill()
+            p.wait()
+
+    for node in sorted(done):
+        print('node %d: %.1f s%s' % (node, done[node], ' CORRUPT' if node in failed else ''))
+    if len(done) < args.nodes - 1 or failed:
+        print('incomplete: %d of %d nodes' % (len(done) - len(failed), args.nodes - 1))
+    print('total %.1f s, %d frames, %d bytes' % (max(done.values() or [0]), frames, octets))
+    sys.exit(0 if len(done) == args.nodes - 1 and not failed else 1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      A radio driver for native that sends every frame as a UDP
+ *      datagram to a hub on the same host, which decides who hears it.
+ *      Node n listens on UDP_RADIO_PORT + n, and the node number is
+ *      the first command line argument.
+ */
+
+#include "contiki.h"
+#include "net/packetbuf.h"
+#include "net/netstack.h"
+#include "dev/radio.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define UDP_RADIO_PORT 30000
+
+extern int contiki_argc;
+extern char **contiki_argv;
+
+static int sock = -1;
+static struct sockaddr_in hub;
+static uint8_t pending[PACKETBUF_SIZE];
+static int pending_len;
+
+/*---------------------------------------------------------------------------*/
+static int
+set_fd(fd_set *rset, fd_set *wset)
+{
+  FD_SET(sock, rset);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_fd(fd_set *rset, fd_set *wset)
+{
+  int len;
+
+  if(!FD_ISSET(sock, rset)) {
+    return;
+  }
+  packetbuf_clear();
+  len = recv(sock, packetbuf_dataptr(), PACKETBUF_SIZE, 0);
+  if(len > 0) {
+    packetbuf_set_datalen(len);
+    NETSTACK_RDC.input();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static const struct select_callback udp_radio_fd = { set_fd, handle_fd };
+/*---------------------------------------------------------------------------*/
+static int
+init(void)
+{
+  struct sockaddr_in addr;
+  linkaddr_t lladdr;
+  int node;
+
+  node = contiki_argc > 1 ? atoi(contiki_argv[1]) : 1;
+
+  memset(&lladdr, 0, sizeof(lladdr));
+  lladdr.u8[0] = node;
+  linkaddr_set_node_addr(&lladdr);
+
+  sock = socket(AF_INET, SOCK_DGRAM, 0);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(UDP_RADIO_PORT + node);
+  if(sock < 0 || bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    perror("udp-radio");
+    exit(1);
+  }
+
+  hub = addr;
+  hub.sin_port = htons(UDP_RADIO_PORT);
+
+  select_set_callback(sock, &udp_radio_fd);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+radio_send(const void *payload, unsigned short payload_len)
+{
+  if(sendto(sock, payload, payload_len, 0,
+            (struct sockaddr *)&hub, sizeof(hub)) != payload_len) {
+    return RADIO_TX_ERR;
+  }
+  return RADIO_TX_OK;
+}
+/*---------------------------------------------------------------------------*/
+static int
+prepare(const void *payload, unsigned short payload_len)
+{
+  pending_len = MIN(payload_len, sizeof(pending));
+  memcpy(pending, payload, pending_len);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+transmit(unsigned short transmit_len)
+{
+  return radio_send(pending, pending_len);
+}
+/*---------------------------------------------------------------------------*/
+static int
+radio_read(void *buf, unsigned short buf_len)
+{
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+channel_clear(void)
+{
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+receiving_packet(void)
+{
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+pending_packet(void)
+{
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+on(void)
+{
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+off(void)
+{
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static radio_result_t
+get_value(radio_param_t param, radio_value_t *value)
+{
+  return RADIO_RESULT_NOT_SUPPORTED;
+}
+/*---------------------------------------------------------------------------*/
+static radio_result_t
+set_value(radio_param_t param, radio_value_t value)
+{
+  return RADIO_RESULT_NOT_SUPPORTED;
+}
+/*---------------------------------------------------------------------------*/
+static radio_result_t
+get_object(radio_param_t param, void *dest, size_t size)
+{
+  return RADIO_RESULT_NOT_SUPPORTED;
+}
+/*---------------------------------------------------------------------------*/
+static radio_result_t
+set_object(radio_param_t param, const void *src, size_t size)
+{
+  return RADIO_RESULT_NOT_SUPPORTED;
+}
+/*---------------------------------------------------------------------------*/
+const struct radio_driver udp_radio_driver = {
+  init,
+  prepare,
+  transmit,
+  radio_send,
+  radio_read,
+  channel_clear,
+  receiving_packet,
+  pending_packet,
+  on,
+  off,
+  get_value,
+  set_value,
+  get_object,
+  set_object
+};
+/*---------------------------------------------------------------------------*/
@@ -33,6 +33,7 @@
  */
 
 #include "contiki-net.h"
+#include "lib/crc16.h"
 #include "httpd.h"
 #include "httpd-fs.h"
 #include "httpd-fsdata.h"
@@ -80,6 +81,8 @@ httpd_fs_open(const char *name, struct httpd_fs_file *file)
     if(httpd_fs_strcmp(name, f->name) == 0) {
       file->data = f->data;
       file->len = f->len - 1;
+      file->etag = crc16_data((unsigned char *)f->data, f->len, 0);
+      file->flags = f->flags;
 #if HTTPD_FS_STATISTICS
       ++count[i];
 #endif /* HTTPD_FS_STATISTICS */
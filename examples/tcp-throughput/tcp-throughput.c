@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2016, University of Southampton.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      TCP bulk transfer benchmark. Every connection to THROUGHPUT_PORT
+ *      receives THROUGHPUT_BYTES bytes, after which the connection is
+ *      closed and the transfer rate is printed. Build with
+ *      WINDOW=<segments> to compare send window sizes.
+ *
+ *      Frames from the tap interface are held back for THROUGHPUT_DELAY
+ *      before they reach uIP, which emulates the round-trip time of a
+ *      multi-hop 6LoWPAN path. THROUGHPUT_LOSS drops the given
+ *      percentage of outgoing frames to exercise retransmissions.
+ */
+
+#include "contiki-net.h"
+#include "sys/cc.h"
+#include "tapdev-drv.h"
+#include "tapdev6.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef THROUGHPUT_PORT
+#define THROUGHPUT_PORT 5001
+#endif
+
+#ifndef THROUGHPUT_BYTES
+#define THROUGHPUT_BYTES (256UL * 1024)
+#endif
+
+#ifndef THROUGHPUT_DELAY
+#define THROUGHPUT_DELAY (CLOCK_SECOND / 10)
+#endif
+
+#ifndef THROUGHPUT_LOSS
+#define THROUGHPUT_LOSS 0
+#endif
+
+#define DELAY_LINE_SIZE 32
+
+struct delayed_frame {
+  clock_time_t arrival;
+  uint16_t len;
+  uint8_t data[UIP_BUFSIZE];
+};
+
+static struct delayed_frame delay_line[DELAY_LINE_SIZE];
+static uint8_t delay_head, delay_count;
+static struct ctimer delay_timer;
+
+static struct tcp_socket socket;
+
+static uint8_t inputbuf[64];
+
+#define OUTPUTBUFSIZE (UIP_TCP_SEND_WINDOW * UIP_TCP_MSS)
+static uint8_t outputbuf[OUTPUTBUFSIZE];
+
+/* Byte n of the stream is n % PATTERN_PERIOD, so that the receiver can
+   verify the data */
+#define PATTERN_PERIOD 251
+static uint8_t pattern[UIP_TCP_MSS + PATTERN_PERIOD];
+static unsigned long bytes_left;
+static clock_time_t start;
+
+PROCESS(tcp_throughput_process, "TCP throughput benchmark");
+AUTOSTART_PROCESSES(&tcp_throughput_process);
+/*---------------------------------------------------------------------------*/
+static void
+release_frames(void *ptr)
+{
+  struct delayed_frame *f;
+
+  while(delay_count > 0) {
+    f = &delay_line[delay_head];
+    if((clock_time_t)(clock_time() - f->arrival) < THROUGHPUT_DELAY) {
+      ctimer_set(&delay_timer,
+                 THROUGHPUT_DELAY - (clock_time_t)(clock_time() - f->arrival),
+                 release_frames, NULL);
+      return;
+    }
+    memcpy(uip_buf, f->data, f->len);
+    uip_len = f->len;
+    delay_head = (delay_head + 1) % DELAY_LINE_SIZE;
+    delay_count--;
+    tcpip_input();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+delay_frame(void)
+{
+  struct delayed_frame *f;
+  uint16_t len;
+
+  len = tapdev_poll();
+  /* Only IPv6 frames are of interest, and a full delay line drops them */
+  if(len < UIP_LLH_LEN || len > UIP_BUFSIZE ||
+     uip_buf[12] != 0x86 || uip_buf[13] != 0xdd ||
+     delay_count == DELAY_LINE_SIZE) {
+    uip_clear_buf();
+    return;
+  }
+  f = &delay_line[(delay_head + delay_count) % DELAY_LINE_SIZE];
+  f->arrival = clock_time();
+  f->len = len;
+  memcpy(f->data, uip_buf, len);
+  uip_clear_buf();
+  if(delay_count++ == 0) {
+    PROCESS_CONTEXT_BEGIN(&tcp_throughput_process);
+    ctimer_set(&delay_timer, THROUGHPUT_DELAY, release_frames, NULL);
+    PROCESS_CONTEXT_END(&tcp_throughput_process);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+lossy_output(const uip_lladdr_t *lladdr)
+{
+  if(THROUGHPUT_LOSS > 0 && rand() % 100 < THROUGHPUT_LOSS) {
+    return 0;
+  }
+  return tapdev_send(lladdr);
+}
+/*---------------------------------------------------------------------------*/
+static int
+tap_set_fd(fd_set *rset, fd_set *wset)
+{
+  FD_SET(tapdev_fd(), rset);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+tap_handle_fd(fd_set *rset, fd_set *wset)
+{
+  if(FD_ISSET(tapdev_fd(), rset)) {
+    delay_frame();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static const struct select_callback tap_callback = {
+  tap_set_fd, tap_handle_fd
+};
+/*---------------------------------------------------------------------------*/
+static void
+fill(void)
+{
+  int len;
+
+  while(bytes_left > 0) {
+    len = tcp_socket_send(&socket,
+                          &pattern[(THROUGHPUT_BYTES - bytes_left) % PATTERN_PERIOD],
+                          MIN(bytes_left, UIP_TCP_MSS));
+    if(len <= 0) {
+      return;
+    }
+    bytes_left -= len;
+  }
+  tcp_socket_close(&socket);
+}
+/*---------------------------------------------------------------------------*/
+static int
+input(struct tcp_socket *s, void *ptr,
+      const uint8_t *inputptr, int inputdatalen)
+{
+  /* Discard everything */
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+event(struct tcp_socket *s, void *ptr,
+      tcp_socket_event_t ev)
+{
+  clock_time_t elapsed;
+
+  switch(ev) {
+  case TCP_SOCKET_CONNECTED:
+    printf("connected, sending %lu bytes with a window of %d segments\n",
+           (unsigned long)THROUGHPUT_BYTES, UIP_TCP_SEND_WINDOW);
+    bytes_left = THROUGHPUT_BYTES;
+    start = clock_time();
+    fill();
+    break;
+  case TCP_SOCKET_DATA_SENT:
+    fill();
+    break;
+  case TCP_SOCKET_CLOSED:
+  case TCP_SOCKET_TIMEDOUT:
+  case TCP_SOCKET_ABORTED:
+    elapsed = clock_time() - start;
+    if(elapsed == 0) {
+      elapsed = 1;
+    }
+    printf("done (event %d) after %lu ms, %lu bytes/s\n", ev,
+           (unsigned long)(elapsed * 1000 / CLOCK_SECOND),
+           (unsigned long)((THROUGHPUT_BYTES - bytes_left) *
+                           CLOCK_SECOND / elapsed));
+    break;
+  default:
+    break;
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(tcp_throughput_process, ev, data)
+{
+  static int i;
+
+  PROCESS_BEGIN();
+
+  for(i = 0; i < sizeof(pattern); i++) {
+    pattern[i] = i % PATTERN_PERIOD;
+  }
+
+  process_start(&tapdev_process, NULL);
+  PROCESS_PAUSE();
+  tcpip_set_outputfunc(lossy_output);
+  select_set_callback(tapdev_fd(), &tap_callback);
+
+  tcp_socket_register(&socket, NULL,
+                      inputbuf, sizeof(inputbuf),
+                      outputbuf, sizeof(outputbuf),
+                      input, event);
+  tcp_socket_listen(&socket, THROUGHPUT_PORT);
+
+  printf("Listening on %d\n", THROUGHPUT_PORT);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,231 @@
+/**
+ * @file
+ * Delta encoding of Samples into blocks.
+ */
+
+#include <string.h>
+#include "sample-block.h"
+
+/**
+ * Map signed deltas to unsigned ones, so that small negative deltas stay small.
+ */
+#define ZIGZAG(x)   (((uint32_t)(x) << 1) ^ (uint32_t)((int32_t)(x) >> 31))
+#define UNZIGZAG(x) ((int32_t)((x) >> 1) ^ -(int32_t)((x) & 1))
+
+/**
+ * Append a varint to buffer.
+ * @return The number of bytes written.
+ */
+static uint8_t put_varint(uint8_t *buffer, uint32_t value);
+
+/**
+ * Read a varint from buffer.
+ * @return The number of bytes read, 0 if buffer ends before the varint does, -1 if the varint is too long.
+ */
+static int get_varint(const uint8_t *buffer, uint16_t len, uint32_t *value);
+
+/**
+ * Append the delta between two readings.
+ */
+static uint8_t put_delta(uint8_t *buffer, uint32_t value, uint32_t prev);
+
+void sample_block_init(struct sample_block_state *state, uint16_t first_id) {
+    memset(state, 0, sizeof(*state));
+    state->first_id = first_id;
+}
+
+uint8_t sample_block_write_header(const struct sample_block_state *state, uint8_t *buffer) {
+    buffer[0] = SAMPLE_BLOCK_MAGIC;
+    buffer[1] = state->first_id & 0xFF;
+    buffer[2] = state->first_id >> 8;
+    return SAMPLE_BLOCK_HEADER_LEN;
+}
+
+bool sample_block_read_header(struct sample_block_state *state, const uint8_t *buffer) {
+    if (buffer[0] != SAMPLE_BLOCK_MAGIC) {
+        return false;
+    }
+
+    sample_block_init(state, buffer[1] | ((uint16_t)buffer[2] << 8));
+    return true;
+}
+
+uint8_t sample_block_encode(const struct sample_block_state *state,
+        const struct sample_block_values *values, uint8_t *buffer) {
+    const struct sample_block_values *prev = &state->prev;
+    uint8_t len = 0;
+    uint8_t i;
+
+    buffer[len++] = values->fields & ~SAMPLE_BLOCK_DELETED;
+    len += put_varint(buffer + len, values->id - state->first_id);
+    len += put_delta(buffer + len, values->time, prev->time);
+
+    if (values->fields & SAMPLE_BLOCK_TEMP) {
+        len += put_delta(buffer + len, values->temp, prev->temp);
+    }
+    if (values->fields & SAMPLE_BLOCK_HUMID) {
+        len += put_delta(buffer + len, values->humid, prev->humid);
+    }
+    if (values->fields & SAMPLE_BLOCK_ADC1) {
+        len += put_delta(buffer + len, values->adc1, prev->adc1);
+    }
+    if (values->fields & SAMPLE_BLOCK_ADC2) {
+        len += put_delta(buffer + len, values->adc2, prev->adc2);
+    }
+    if (values->fields & SAMPLE_BLOCK_RAIN) {
+        len += put_delta(buffer + len, values->rain, prev->rain);
+    }
+    if (values->fields & SAMPLE_BLOCK_ACC) {
+        for (i = 0; i < 3; i++) {
+            len += put_delta(buffer + len, values->acc[i], prev->acc[i]);
+        }
+    }
+    if (values->fields & SAMPLE_BLOCK_BATT) {
+        len += put_delta(buffer + len, values->batt, prev->batt);
+    }
+
+    buffer[len++] = SAMPLE_BLOCK_ROW_END;
+    return len;
+}
+
+void sample_block_commit(struct sample_block_state *state, const struct sample_block_values *values) {
+    struct sample_block_values *prev = &state->prev;
+
+    // Fields a row does not have keep their previous reference
+    prev->id = values->id;
+    prev->time = values->time;
+
+    if (values->fields & SAMPLE_BLOCK_TEMP) {
+        prev->temp = values->temp;
+    }
+    if (values->fields & SAMPLE_BLOCK_HUMID) {
+        prev->humid = values->humid;
+    }
+    if (values->fields & SAMPLE_BLOCK_ADC1) {
+        prev->adc1 = values->adc1;
+    }
+    if (values->fields & SAMPLE_BLOCK_ADC2) {
+        prev->adc2 = values->adc2;
+    }
+    if (values->fields & SAMPLE_BLOCK_RAIN) {
+        prev->rain = values->rain;
+    }
+    if (values->fields & SAMPLE_BLOCK_ACC) {
+        memcpy(prev->acc, values->acc, sizeof(prev->acc));
+    }
+    if (values->fields & SAMPLE_BLOCK_BATT) {
+        prev->batt = values->batt;
+    }
+}
+
+uint8_t sample_block_encode_deleted(const struct sample_block_state *state, uint16_t id, uint8_t *buffer) {
+    uint8_t len = 0;
+
+    buffer[len++] = SAMPLE_BLOCK_DELETED;
+    len += put_varint(buffer + len, id - state->first_id);
+    buffer[len++] = SAMPLE_BLOCK_ROW_END;
+    return len;
+}
+
+int sample_block_decode(struct sample_block_state *state,
+        const uint8_t *buffer, uint16_t len, struct sample_block_values *values) {
+    // Every value a row can have, in encoding order
+    uint32_t *fields[9];
+    uint8_t flags[9] = {
+        SAMPLE_BLOCK_TEMP, SAMPLE_BLOCK_HUMID, SAMPLE_BLOCK_ADC1, SAMPLE_BLOCK_ADC2, SAMPLE_BLOCK_RAIN,
+        SAMPLE_BLOCK_ACC, SAMPLE_BLOCK_ACC, SAMPLE_BLOCK_ACC, SAMPLE_BLOCK_BATT
+    };
+    uint32_t value;
+    uint16_t pos;
+    uint8_t i;
+    int n;
+
+    if (len == 0) {
+        return 0;
+    }
+
+    *values = state->prev;
+    values->fields = buffer[0];
+    pos = 1;
+
+    if ((n = get_varint(buffer + pos, len - pos, &value)) <= 0) {
+        return n;
+    }
+    pos += n;
+    values->id = state->first_id + value;
+
+    if (!(values->fields & SAMPLE_BLOCK_DELETED)) {
+        if ((n = get_varint(buffer + pos, len - pos, &value)) <= 0) {
+            return n;
+        }
+        pos += n;
+        values->time += UNZIGZAG(value);
+
+        fields[0] = (uint32_t *)&values->temp;
+        fields[1] = (uint32_t *)&values->humid;
+        fields[2] = &values->adc1;
+        fields[3] = &values->adc2;
+        fields[4] = &values->rain;
+        fields[5] = (uint32_t *)&values->acc[0];
+        fields[6] = (uint32_t *)&values->acc[1];
+        fields[7] = (uint32_t *)&values->acc[2];
+        fields[8] = (uint32_t *)&values->batt;
+
+        for (i = 0; i < 9; i++) {
+            if (!(values->fields & flags[i])) {
+                continue;
+            }
+            if ((n = get_varint(buffer + pos, len - pos, &value)) <= 0) {
+                return n;
+            }
+            pos += n;
+            *fields[i] += UNZIGZAG(value);
+        }
+    }
+
+    if (pos >= len) {
+        return 0;
+    }
+    if (buffer[pos++] != SAMPLE_BLOCK_ROW_END) {
+        return -1;
+    }
+
+    if (!(values->fields & SAMPLE_BLOCK_DELETED)) {
+        sample_block_commit(state, values);
+    }
+
+    return pos;
+}
+
+uint8_t put_varint(uint8_t *buffer, uint32_t value) {
+    uint8_t len = 0;
+
+    while (value >= 0x80) {
+        buffer[len++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    buffer[len++] = value;
+    return len;
+}
+
+int get_varint(const uint8_t *buffer, uint16_t len, uint32_t *value) {
+    uint8_t shift = 0;
+    uint16_t pos = 0;
+
+    *value = 0;
+    while (pos < len) {
+        if (shift > 28) {
+            return -1;
+        }
+        *value |= (uint32_t)(buffer[pos] & 0x7F) << shift;
+        if (!(buffer[pos++] & 0x80)) {
+            return pos;
+        }
+        shift += 7;
+    }
+    return 0;
+}
+
+uint8_t put_delta(uint8_t *buffer, uint32_t value, uint32_t prev) {
+    return put_varint(buffer, ZIGZAG(value - prev));
+}
@@ -0,0 +1,147 @@
+/**
+ * @file
+ * Delta encoding of Samples into blocks.
+ *
+ * Consecutive samples barely change, so instead of one protocol buffer per sample
+ * a block holds one row per sample with the zig-zag varint encoded difference
+ * of every field to the same field in the previous row that had it.
+ * The first row of a block holds the difference to 0, ie the base value.
+ *
+ * A block file is a SAMPLE_BLOCK_HEADER_LEN byte header followed by rows:
+ *
+ *  header: SAMPLE_BLOCK_MAGIC, first id (16 bit little endian)
+ *  row:    fields, varint(id - first id), [zig-zag varint deltas], SAMPLE_BLOCK_ROW_END
+ *
+ * Data rows carry the time, followed by the fields flagged in fields in bit order
+ * (the accelerometer is 3 deltas: x, y, z).
+ * Rows with SAMPLE_BLOCK_DELETED set carry no deltas, and mark an earlier row of the same id as deleted.
+ * Every row ends with a non zero byte, so that Coffee never drops trailing zeros of a block.
+ *
+ * Floating point readings are stored in fixed point:
+ * temperature and humidity in hundredths, the battery voltage in thousandths.
+ *
+ * This file has no dependency on the protocol buffers, so that it can be tested on native.
+ */
+
+#ifndef SAMPLE_BLOCK_H
+#define SAMPLE_BLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * First byte of a block, doubles as a format version.
+ */
+#define SAMPLE_BLOCK_MAGIC      0xB1
+
+/**
+ * Length of the block header.
+ */
+#define SAMPLE_BLOCK_HEADER_LEN 3
+
+/**
+ * Last byte of every row.
+ */
+#define SAMPLE_BLOCK_ROW_END    0xAF
+
+/**
+ * Fields of a row.
+ */
+#define SAMPLE_BLOCK_TEMP       0x01
+#define SAMPLE_BLOCK_HUMID      0x02
+#define SAMPLE_BLOCK_ADC1       0x04
+#define SAMPLE_BLOCK_ADC2       0x08
+#define SAMPLE_BLOCK_RAIN       0x10
+#define SAMPLE_BLOCK_ACC        0x20
+#define SAMPLE_BLOCK_BATT       0x40
+#define SAMPLE_BLOCK_DELETED    0x80
+
+/**
+ * Maximum length of a row: fields, id, time and 9 values, and the end marker.
+ */
+#define SAMPLE_BLOCK_MAX_ROW    (1 + 3 + 5 * 10 + 1)
+
+/**
+ * Length of a row marking a sample as deleted.
+ */
+#define SAMPLE_BLOCK_DELETED_ROW (1 + 3 + 1)
+
+/**
+ * Readings of one sample.
+ */
+struct sample_block_values {
+    uint16_t id;
+    uint8_t fields;
+    uint32_t time;
+    int32_t temp;   /**< Hundredths of a degree. */
+    int32_t humid;  /**< Hundredths of a percent. */
+    uint32_t adc1;
+    uint32_t adc2;
+    uint32_t rain;
+    int32_t acc[3];
+    int32_t batt;   /**< Thousandths of a volt. */
+};
+
+/**
+ * Encoder / decoder state of a block.
+ */
+struct sample_block_state {
+    uint16_t first_id;
+    struct sample_block_values prev;
+};
+
+/**
+ * Start a new block.
+ * @param state The state to initialize.
+ * @param first_id The id of the first sample the block may hold.
+ */
+void sample_block_init(struct sample_block_state *state, uint16_t first_id);
+
+/**
+ * Write the header of a block.
+ * @param state The state of the block.
+ * @param buffer A buffer at least SAMPLE_BLOCK_HEADER_LEN long.
+ * @return SAMPLE_BLOCK_HEADER_LEN
+ */
+uint8_t sample_block_write_header(const struct sample_block_state *state, uint8_t *buffer);
+
+/**
+ * Read the header of a block, and initialize the state from it.
+ * @return `true` if the header is valid, `false` otherwise.
+ */
+bool sample_block_read_header(struct sample_block_state *state, const uint8_t *buffer);
+
+/**
+ * Encode a sample as the next row of a block.
+ * The state is only updated when the row is committed with `sample_block_commit`,
+ * so that a row that can not be stored does not break the block.
+ * @param state The state of the block.
+ * @param values The sample to encode. Its id must be >= the first id of the block.
+ * @param buffer A buffer at least SAMPLE_BLOCK_MAX_ROW long.
+ * @return The length of the row.
+ */
+uint8_t sample_block_encode(const struct sample_block_state *state,
+        const struct sample_block_values *values, uint8_t *buffer);
+
+/**
+ * Make values the reference for the deltas of the next row.
+ */
+void sample_block_commit(struct sample_block_state *state, const struct sample_block_values *values);
+
+/**
+ * Encode a row marking a sample as deleted.
+ * @param buffer A buffer at least SAMPLE_BLOCK_DELETED_ROW long.
+ * @return The length of the row.
+ */
+uint8_t sample_block_encode_deleted(const struct sample_block_state *state, uint16_t id, uint8_t *buffer);
+
+/**
+ * Decode the next row of a block, and advance the state past it.
+ * Rows marking a sample as deleted have SAMPLE_BLOCK_DELETED set in values->fields,
+ * and only values->id is valid.
+ * @return The length of the row, 0 if buffer does not hold a complete row, -1 if the row is corrupt.
+ */
+int sample_block_decode(struct sample_block_state *state,
+        const uint8_t *buffer, uint16_t len, struct sample_block_values *values);
+
+#endif // ifndef SAMPLE_BLOCK_H
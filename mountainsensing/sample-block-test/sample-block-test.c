@@ -0,0 +1,223 @@
+/**
+ * @file
+ * Unit tests of the sample block encoding.
+ * Encodes a day of readings, and checks that they decode to the same values.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "contiki.h"
+#include "sample-block.h"
+
+/**
+ * Number of samples in the test block.
+ */
+#define SAMPLES 96
+
+/**
+ * Sampling interval, in seconds.
+ */
+#define INTERVAL 900
+
+PROCESS(sample_block_test_process, "Sample block test");
+
+AUTOSTART_PROCESSES(&sample_block_test_process);
+
+static uint8_t block[SAMPLE_BLOCK_HEADER_LEN + SAMPLES * SAMPLE_BLOCK_MAX_ROW];
+
+static struct sample_block_values samples[SAMPLES];
+
+/**
+ * Fill samples with a slowly changing series of readings.
+ * Some fields come and go, the temperature goes below 0 and ADC2 wraps around.
+ */
+static void make_samples(void) {
+    uint16_t i;
+
+    for (i = 0; i < SAMPLES; i++) {
+        struct sample_block_values *v = &samples[i];
+
+        memset(v, 0, sizeof(*v));
+        v->id = 1000 + i + (i >= SAMPLES / 2 ? 1 : 0);
+        v->time = 1476000000UL + i * INTERVAL + (i % 3);
+        v->fields = SAMPLE_BLOCK_TEMP | SAMPLE_BLOCK_HUMID | SAMPLE_BLOCK_ACC | SAMPLE_BLOCK_BATT;
+        v->temp = 150 - i * 4;
+        v->humid = 8500 + (i % 7) * 10;
+        v->acc[0] = -3 + (i % 2);
+        v->acc[1] = 2;
+        v->acc[2] = 254 - (i % 3);
+        v->batt = 3700 - i / 8;
+
+        if (i % 4 == 0) {
+            v->fields |= SAMPLE_BLOCK_ADC1;
+            v->adc1 = 2048 + i;
+        }
+        if (i % 10 != 5) {
+            v->fields |= SAMPLE_BLOCK_ADC2;
+            v->adc2 = 0xFFFFFFF0UL + i;
+        }
+        if (i > 10) {
+            v->fields |= SAMPLE_BLOCK_RAIN;
+            v->rain = i / 10;
+        }
+    }
+}
+
+/**
+ * Compare the fields of two samples that are set.
+ */
+static bool same_values(const struct sample_block_values *a, const struct sample_block_values *b) {
+    if (a->id != b->id || a->fields != b->fields || a->time != b->time) {
+        return false;
+    }
+    if ((a->fields & SAMPLE_BLOCK_TEMP) && a->temp != b->temp) {
+        return false;
+    }
+    if ((a->fields & SAMPLE_BLOCK_HUMID) && a->humid != b->humid) {
+        return false;
+    }
+    if ((a->fields & SAMPLE_BLOCK_ADC1) && a->adc1 != b->adc1) {
+        return false;
+    }
+    if ((a->fields & SAMPLE_BLOCK_ADC2) && a->adc2 != b->adc2) {
+        return false;
+    }
+    if ((a->fields & SAMPLE_BLOCK_RAIN) && a->rain != b->rain) {
+        return false;
+    }
+    if ((a->fields & SAMPLE_BLOCK_ACC) && memcmp(a->acc, b->acc, sizeof(a->acc))) {
+        return false;
+    }
+    if ((a->fields & SAMPLE_BLOCK_BATT) && a->batt != b->batt) {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Encode all samples into block, deleting every 8th sample after it has been written.
+ * @return The length of the block.
+ */
+static uint16_t encode_block(void) {
+    struct sample_block_state state;
+    uint16_t len;
+    uint16_t i;
+
+    sample_block_init(&state, samples[0].id);
+    len = sample_block_write_header(&state, block);
+
+    for (i = 0; i < SAMPLES; i++) {
+        len += sample_block_encode(&state, &samples[i], block + len);
+        sample_block_commit(&state, &samples[i]);
+
+        if (i % 8 == 7) {
+            len += sample_block_encode_deleted(&state, samples[i - 1].id, block + len);
+        }
+    }
+
+    return len;
+}
+
+static bool test_round_trip(uint16_t len) {
+    struct sample_block_state state;
+    struct sample_block_values values;
+    uint16_t pos = SAMPLE_BLOCK_HEADER_LEN;
+    uint16_t i = 0;
+    uint16_t deleted = 0;
+    int n;
+
+    if (!sample_block_read_header(&state, block) || state.first_id != samples[0].id) {
+        return false;
+    }
+
+    while ((n = sample_block_decode(&state, block + pos, len - pos, &values)) > 0) {
+        pos += n;
+
+        if (values.fields & SAMPLE_BLOCK_DELETED) {
+            if (i < 2 || values.id != samples[i - 2].id) {
+                return false;
+            }
+            deleted++;
+            continue;
+        }
+
+        if (i >= SAMPLES || !same_values(&values, &samples[i])) {
+            return false;
+        }
+        i++;
+    }
+
+    return n == 0 && pos == len && i == SAMPLES && deleted == SAMPLES / 8;
+}
+
+static bool test_truncated(uint16_t len) {
+    struct sample_block_state state;
+    struct sample_block_values values;
+    uint16_t pos = SAMPLE_BLOCK_HEADER_LEN;
+    uint16_t cut;
+    int n;
+
+    sample_block_read_header(&state, block);
+
+    // Every prefix of a row must be reported as incomplete, without touching the state
+    while (pos < len) {
+        struct sample_block_state before = state;
+
+        n = sample_block_decode(&state, block + pos, len - pos, &values);
+        if (n <= 0) {
+            return false;
+        }
+        for (cut = 0; cut < n; cut++) {
+            struct sample_block_state copy = before;
+            if (sample_block_decode(&copy, block + pos, cut, &values) != 0 ||
+                    memcmp(&copy, &before, sizeof(copy))) {
+                return false;
+            }
+        }
+        pos += n;
+    }
+
+    return true;
+}
+
+static bool test_corrupt(void) {
+    struct sample_block_state state;
+    struct sample_block_values values;
+    uint8_t row[SAMPLE_BLOCK_MAX_ROW];
+    uint8_t len;
+
+    sample_block_init(&state, samples[0].id);
+    len = sample_block_encode(&state, &samples[0], row);
+    row[len - 1] = 0;
+
+    if (sample_block_decode(&state, row, len, &values) != -1) {
+        return false;
+    }
+
+    // Overlong varint
+    memset(row, 0xFF, sizeof(row));
+    row[0] = 0;
+    return sample_block_decode(&state, row, sizeof(row), &values) == -1;
+}
+
+static void print_result(const char *name, bool success) {
+    printf("Testing %s ... %s\n", name, success ? "Success" : "Failure");
+}
+
+PROCESS_THREAD(sample_block_test_process, ev, data) {
+    uint16_t len;
+
+    PROCESS_BEGIN();
+
+    make_samples();
+    len = encode_block();
+
+    print_result("round trip", test_round_trip(len));
+    print_result("truncated rows", test_truncated(len));
+    print_result("corrupt rows", test_corrupt());
+
+    printf("%u samples in %u bytes, %u.%02u bytes per sample\n", SAMPLES, len,
+            len / SAMPLES, (len % SAMPLES) * 100 / SAMPLES);
+
+    PROCESS_END();
+}
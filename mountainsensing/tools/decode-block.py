@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+"""
+Decode sample blocks stored by z1-coap with STORE_COMPRESS,
+as served by GET /block/<id>.
+
+See mountainsensing/common/sample-block.h for the format.
+
+Usage: decode-block.py block.bin [block.bin ...]
+Prints one CSV line per live sample.
+"""
+
+import sys
+
+MAGIC = 0xB1
+ROW_END = 0xAF
+
+TEMP = 0x01
+HUMID = 0x02
+ADC1 = 0x04
+ADC2 = 0x08
+RAIN = 0x10
+ACC = 0x20
+BATT = 0x40
+DELETED = 0x80
+
+# Fields in encoding order: (name, flag, signed, scale)
+FIELDS = [
+    ('temp', TEMP, True, 100.0),
+    ('humid', HUMID, True, 100.0),
+    ('ADC1', ADC1, False, None),
+    ('ADC2', ADC2, False, None),
+    ('rain', RAIN, False, None),
+    ('accX', ACC, True, None),
+    ('accY', ACC, True, None),
+    ('accZ', ACC, True, None),
+    ('batt', BATT, True, 1000.0),
+]
+
+COLUMNS = ['id', 'time'] + [name for name, _, _, _ in FIELDS]
+
+
+class BlockError(Exception):
+    pass
+
+
+def get_varint(data, pos):
+    value = 0
+    for shift in range(0, 35, 7):
+        if pos >= len(data):
+            raise BlockError('truncated row')
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        if not byte & 0x80:
+            return value & 0xFFFFFFFF, pos
+    raise BlockError('varint too long')
+
+
+def unzigzag(value):
+    return (value >> 1) ^ -(value & 1)
+
+
+def to_signed(value):
+    return value - (1 << 32) if value & 0x80000000 else value
+
+
+def decode_block(data):
+    """
+    Decode a block.
+    Returns the list of live samples, as dicts with the keys of COLUMNS that are present.
+    Decoding stops at the first corrupt or truncated row, like on the node.
+    """
+    if len(data) < 3 or data[0] != MAGIC:
+        raise BlockError('invalid header')
+
+    first_id = data[1] | (data[2] << 8)
+    prev = dict((name, 0) for name in COLUMNS)
+    samples = {}
+    pos = 3
+
+    try:
+        while pos < len(data):
+            fields = data[pos]
+            offset, pos = get_varint(data, pos + 1)
+            row = {'id': (first_id + offset) & 0xFFFF}
+
+            if not fields & DELETED:
+                delta, pos = get_varint(data, pos)
+                prev['time'] = (prev['time'] + unzigzag(delta)) & 0xFFFFFFFF
+                row['time'] = prev['time']
+
+                for name, flag, signed, scale in FIELDS:
+                    if not fields & flag:
+                        continue
+                    delta, pos = get_varint(data, pos)
+                    prev[name] = (prev[name] + unzigzag(delta)) & 0xFFFFFFFF
+                    value = to_signed(prev[name]) if signed else prev[name]
+                    row[name] = value / scale if scale else value
+
+            if pos >= len(data):
+                raise BlockError('truncated row')
+            if data[pos] != ROW_END:
+                raise BlockError('invalid row end')
+            pos += 1
+
+            if fields & DELETED:
+                samples.pop(row['id'], None)
+            else:
+                samples[row['id']] = row
+
+    except BlockError as e:
+        sys.stderr.write('Block %d: %s at byte %d\n' % (first_id, e, pos))
+
+    return [samples[k] for k in sorted(samples)]
+
+
+def main(files):
+    print(','.join(COLUMNS))
+    for name in files:
+        with open(name, 'rb') as f:
+            for sample in decode_block(bytearray(f.read())):
+                print(','.join(str(sample.get(c, '')) for c in COLUMNS))
+
+
+if __name__ == '__main__':
+    if len(sys.argv) < 2:
+        sys.stderr.write(__doc__)
+        sys.exit(1)
+    main(sys.argv[1:])
@@ -0,0 +1,142 @@
+#!/usr/bin/env python3
+"""
+Receive a binary dump from z1-coap-serial-dumper.
+
+Writes the samples to a file as delimited protocol buffers, in the same format
+as the hex dump decoded by the fetcher, and the config to a separate file.
+The dump resumes from the last sample received after a CRC error or a timeout.
+
+Usage: serial-dump-receiver.py [-s first_id] [-c config_file] port samples_file
+
+Requires pyserial.
+"""
+
+import argparse
+import sys
+import time
+
+import serial
+
+SLIP_END = 0xC0
+SLIP_ESC = 0xDB
+SLIP_ESC_END = 0xDC
+SLIP_ESC_ESC = 0xDD
+
+FRAME_NODE_ID = ord('N')
+FRAME_SAMPLE = ord('S')
+FRAME_CONFIG = ord('C')
+FRAME_END = ord('E')
+
+# Seconds without a frame before the dump is restarted
+TIMEOUT = 5
+
+# Attempts at the dump without any progress before giving up
+MAX_RETRIES = 10
+
+
+class FrameError(Exception):
+    pass
+
+
+def crc16(data, crc=0):
+    """CRC-16 of core/lib/crc16.c (CCITT polynomial, reflected)."""
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0x8408 if crc & 1 else crc >> 1
+    return crc
+
+
+def read_frames(port):
+    """Yield the (type, id, payload) of frames received, raise FrameError on errors and timeouts."""
+    frame = bytearray()
+    escaped = False
+    synced = False
+    last = time.time()
+
+    while True:
+        data = port.read(256)
+
+        if not data:
+            if time.time() - last > TIMEOUT:
+                raise FrameError('timeout')
+            continue
+
+        for byte in bytearray(data):
+            if byte == SLIP_END:
+                if len(frame) >= 5:
+                    if crc16(frame[:-2]) == frame[-2] | (frame[-1] << 8):
+                        synced = True
+                        last = time.time()
+                        yield frame[0], frame[1] | (frame[2] << 8), bytes(frame[3:-2])
+                    elif synced:
+                        raise FrameError('CRC error')
+                # Anything before the first good frame, or too short, is line noise or text from the node
+                frame = bytearray()
+                escaped = False
+            elif escaped:
+                frame.append({SLIP_ESC_END: SLIP_END, SLIP_ESC_ESC: SLIP_ESC}.get(byte, byte))
+                escaped = False
+            elif byte == SLIP_ESC:
+                escaped = True
+            else:
+                frame.append(byte)
+
+
+def receive(port, samples, config_name, next_id):
+    """Run the dump until it completes, resuming after errors. Returns the id to resume from."""
+    retries = 0
+
+    while retries < MAX_RETRIES:
+        port.reset_input_buffer()
+        port.write(b'dump %d\n' % next_id)
+        progress = False
+
+        try:
+            for kind, sample_id, payload in read_frames(port):
+                if kind == FRAME_NODE_ID:
+                    sys.stderr.write('Node %s, dumping from sample %d\n' % (payload.hex(), next_id))
+
+                elif kind == FRAME_SAMPLE and sample_id >= next_id:
+                    samples.write(payload)
+                    samples.flush()
+                    next_id = sample_id + 1
+                    progress = True
+
+                elif kind == FRAME_CONFIG and config_name:
+                    with open(config_name, 'wb') as config:
+                        config.write(payload)
+
+                elif kind == FRAME_END:
+                    sys.stderr.write('Dump complete, latest sample %d\n' % sample_id)
+                    return next_id
+
+        except FrameError as e:
+            sys.stderr.write('%s, resuming from sample %d\n' % (e, next_id))
+
+        retries = 0 if progress else retries + 1
+
+    raise FrameError('giving up, resume with -s %d' % next_id)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Receive a binary dump from z1-coap-serial-dumper.')
+    parser.add_argument('-s', '--start', type=int, default=1, help='id of the first sample to dump')
+    parser.add_argument('-c', '--config', help='file to write the config to')
+    parser.add_argument('-b', '--baud', type=int, default=115200)
+    parser.add_argument('port')
+    parser.add_argument('samples', help='file to append the samples to')
+    args = parser.parse_args()
+
+    port = serial.Serial(args.port, args.baud, timeout=0.5)
+
+    with open(args.samples, 'ab') as samples:
+        try:
+            receive(port, samples, args.config, args.start)
+        except FrameError as e:
+            sys.stderr.write('%s\n' % e)
+            sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
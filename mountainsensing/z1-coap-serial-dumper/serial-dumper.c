@@ -7,12 +7,42 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "contiki.h"
 #include "store.h"
 #include "net/ipv6/uip-ds6.h"
+#include "dev/serial-line.h"
+#include "dev/uart0.h"
+#include "lib/crc16.h"
 #include "readings.pb.h"
 #include "settings.pb.h"
 
+/**
+ * Time to wait for a command from the host before falling back to the hex dump.
+ */
+#define COMMAND_TIMEOUT (CLOCK_SECOND * 5)
+
+/**
+ * Number of samples sent in a row before the dumper yields to process host commands.
+ */
+#define DUMP_BURST 8
+
+/**
+ * SLIP special characters.
+ */
+#define SLIP_END        0300
+#define SLIP_ESC        0333
+#define SLIP_ESC_END    0334
+#define SLIP_ESC_ESC    0335
+
+/**
+ * Frame types.
+ */
+#define FRAME_NODE_ID   'N'
+#define FRAME_SAMPLE    'S'
+#define FRAME_CONFIG    'C'
+#define FRAME_END       'E'
+
 PROCESS(serial_dumper_process, "Serial Dumper");
 
 AUTOSTART_PROCESSES(&serial_dumper_process);
@@ -24,35 +54,120 @@ AUTOSTART_PROCESSES(&serial_dumper_process);
  */
 static void dump_buffer(uint8_t *buffer, uint8_t len);
 
+/**
+ * Dump all the samples and the config as hex lines.
+ */
+static void dump_hex(void);
+
+/**
+ * Send a SLIP framed binary frame over serial:
+ * type, id (16 bit little endian), payload, CRC-16 of all the previous bytes (little endian).
+ * @param type The type of the frame.
+ * @param id The id of the sample in the frame, or any other value.
+ * @param payload The payload of the frame.
+ * @param len The length of the payload.
+ */
+static void send_frame(uint8_t type, uint16_t id, const uint8_t *payload, uint8_t len);
+
+/**
+ * Send a byte of a SLIP frame, escaping it if needed.
+ */
+static void send_escaped(uint8_t byte);
+
+/**
+ * Send the next DUMP_BURST samples of a binary dump.
+ * @return `true` if there are samples left, `false` once the dump is done.
+ */
+static bool dump_binary(struct store_iterator *iterator);
+
+/**
+ * The link local address of the node, that identifies it.
+ */
+static uip_ds6_addr_t *lladdr;
+
 PROCESS_THREAD(serial_dumper_process, ev, data) {
+    static struct etimer timeout;
+    static struct store_iterator iterator;
+    static bool dumping;
+    unsigned long first_id;
+    char *end;
+
     PROCESS_BEGIN();
 
     // Initialize the store before anything else
     store_init();
 
+    // The platform only sets up the serial line for commands without networking
+    uart0_set_input(serial_line_input_byte);
+    serial_line_init();
+
     printf("+++SERIALDUMP+++NODEID+++\n");
-    {
-        uip_ds6_addr_t *lladdr = uip_ds6_get_link_local(-1);
-        printf("%02x%02x:%02x%02x:%02x%02x:%02x%02x\n",
-               lladdr->ipaddr.u8[8],
-               lladdr->ipaddr.u8[9],
-               lladdr->ipaddr.u8[10],
-               lladdr->ipaddr.u8[11],
-               lladdr->ipaddr.u8[12],
-               lladdr->ipaddr.u8[13],
-               lladdr->ipaddr.u8[14],
-               lladdr->ipaddr.u8[15]
-        );
+    lladdr = uip_ds6_get_link_local(-1);
+    printf("%02x%02x:%02x%02x:%02x%02x:%02x%02x\n",
+           lladdr->ipaddr.u8[8],
+           lladdr->ipaddr.u8[9],
+           lladdr->ipaddr.u8[10],
+           lladdr->ipaddr.u8[11],
+           lladdr->ipaddr.u8[12],
+           lladdr->ipaddr.u8[13],
+           lladdr->ipaddr.u8[14],
+           lladdr->ipaddr.u8[15]
+    );
+
+    // Hosts that don't send commands get the hex dump
+    etimer_set(&timeout, COMMAND_TIMEOUT);
+
+    while (true) {
+        PROCESS_WAIT_EVENT();
+
+        if (ev == PROCESS_EVENT_TIMER && data == &timeout) {
+            dump_hex();
+        }
+
+        if (ev == serial_line_event_message) {
+            etimer_stop(&timeout);
+
+            // A new command replaces the running dump, so that the host can resume after an error
+            if (strncmp(data, "dump", 4) == 0) {
+                first_id = strtoul((char *)data + 4, &end, 10);
+
+                if (*end == '\0' && first_id <= UINT16_MAX) {
+                    send_frame(FRAME_NODE_ID, 0, &lladdr->ipaddr.u8[8], 8);
+                    store_iterator_init(&iterator, first_id);
+                    dumping = true;
+                    process_poll(&serial_dumper_process);
+                }
+
+            } else if (strcmp(data, "hex") == 0) {
+                dumping = false;
+                dump_hex();
+            }
+        }
+
+        if (ev == PROCESS_EVENT_POLL && dumping) {
+            dumping = dump_binary(&iterator);
+
+            if (dumping) {
+                process_poll(&serial_dumper_process);
+            }
+        }
     }
 
+    PROCESS_END();
+}
+
+void dump_hex(void) {
+    struct store_iterator iterator;
+
     printf("+++SERIALDUMP+++SAMPLE+++START+++\n");
     {
         uint8_t buffer[Sample_size];
         uint8_t buffer_len;
         uint16_t id;
 
-        // Keep going as long as the ID is valid
-        for (id = store_get_latest_sample_id(); id > 0; id--) {
+        // Only visit the samples that exist
+        store_iterator_init(&iterator, 1);
+        while ((id = store_iterator_next(&iterator))) {
             if ((buffer_len = store_get_raw_sample(id, buffer))) {
                 dump_buffer(buffer, buffer_len);
             }
@@ -72,8 +187,6 @@ PROCESS_THREAD(serial_dumper_process, ev, data) {
 
     }
     printf("+++SERIALDUMP+++CONFIG+++END+++\n");
-
-    PROCESS_END();
 }
 
 void dump_buffer(uint8_t *buffer, uint8_t len) {
@@ -83,3 +196,75 @@ void dump_buffer(uint8_t *buffer, uint8_t len) {
     }
     printf("\n");
 }
+
+bool dump_binary(struct store_iterator *iterator) {
+    uint8_t buffer[Sample_size > SensorConfig_size ? Sample_size : SensorConfig_size];
+    uint8_t buffer_len;
+    uint8_t i;
+    uint16_t id;
+
+    for (i = 0; i < DUMP_BURST; i++) {
+        if (!(id = store_iterator_next(iterator))) {
+            break;
+        }
+
+        if ((buffer_len = store_get_raw_sample(id, buffer))) {
+            send_frame(FRAME_SAMPLE, id, buffer, buffer_len);
+        }
+    }
+
+    if (id) {
+        return true;
+    }
+
+    if ((buffer_len = store_get_raw_config(buffer))) {
+        send_frame(FRAME_CONFIG, 0, buffer, buffer_len);
+    }
+
+    // Tell the host where the dump ended, in case samples were saved since it started
+    send_frame(FRAME_END, store_get_latest_sample_id(), NULL, 0);
+
+    return false;
+}
+
+void send_frame(uint8_t type, uint16_t id, const uint8_t *payload, uint8_t len) {
+    uint8_t header[3];
+    uint16_t crc;
+    uint8_t i;
+
+    header[0] = type;
+    header[1] = id & 0xFF;
+    header[2] = id >> 8;
+
+    crc = crc16_data(header, sizeof(header), 0);
+    crc = crc16_data(payload, len, crc);
+
+    // Flush any line noise on the host side
+    putchar(SLIP_END);
+
+    for (i = 0; i < sizeof(header); i++) {
+        send_escaped(header[i]);
+    }
+    for (i = 0; i < len; i++) {
+        send_escaped(payload[i]);
+    }
+    send_escaped(crc & 0xFF);
+    send_escaped(crc >> 8);
+
+    putchar(SLIP_END);
+}
+
+void send_escaped(uint8_t byte) {
+    switch (byte) {
+    case SLIP_END:
+        putchar(SLIP_ESC);
+        putchar(SLIP_ESC_END);
+        break;
+    case SLIP_ESC:
+        putchar(SLIP_ESC);
+        putchar(SLIP_ESC_ESC);
+        break;
+    default:
+        putchar(byte);
+    }
+}
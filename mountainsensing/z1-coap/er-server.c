@@ -1,9 +1,13 @@
 #include "er-server.h"
 #include "rest-engine.h"
 #include "contiki-net.h"
+#include "store.h"
 
 /* declare the resources functions from the separate files */
 extern resource_t res_date, res_sample, res_config, res_reboot, res_routes, res_uptime;
+#if STORE_COMPRESS
+extern resource_t res_block;
+#endif
 
 void er_server_init(void) {
 
@@ -16,4 +20,7 @@ void er_server_init(void) {
     rest_activate_resource(&res_reboot, "reboot");
     rest_activate_resource(&res_routes, "routes");
     rest_activate_resource(&res_uptime, "uptime");
+#if STORE_COMPRESS
+    rest_activate_resource(&res_block, "block");
+#endif
 }
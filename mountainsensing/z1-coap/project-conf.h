@@ -60,6 +60,14 @@
 /* Enable client-side support for COAP observe */
 #define COAP_OBSERVE_CLIENT            0
 
+/* Generate .well-known/core and the routes once per blockwise transfer.
+ * 256 bytes hold the link format (~180 bytes) or a full route table
+ * (~240 bytes), together with their URI. */
+#define COAP_BLOCK2_CACHE              1
+#define COAP_BLOCK2_CACHE_ENTRIES      1
+#define COAP_BLOCK2_CACHE_SIZE         256
+#define MMEM_CONF_SIZE                 256
+
 /* Disable .well-known/core ressource. 
 #define COAP_RES_WITHOUT_WELL_KNOWN
 */
@@ -14,6 +14,7 @@
 #include "net/ip/uip.h"
 #include "net/ipv6/uip-ds6.h"
 #include "net/rpl/rpl.h"
+#include "er-coap-block2-cache.h"
 
 #define DEBUG_ON
 #include "debug.h"
@@ -41,6 +42,23 @@ static uip_ds6_nbr_t *nbr;
  */
 static bool hasReachedRoutes;
 
+#if UIP_DS6_NOTIFICATIONS
+/**
+ * Notification of route table changes.
+ */
+static struct uip_ds6_notification route_notification;
+
+/**
+ * True once route_notification has been registered.
+ */
+static bool isNotified;
+
+/**
+ * Drop the cached tables when a route is added or removed.
+ */
+static void route_changed(int event, uip_ipaddr_t *ipaddr, uip_ipaddr_t *nexthop, int num_routes);
+#endif
+
 /**
  * Get last 2 bytes of an IP as a uint16_t that can be hex printed.
  */
@@ -76,14 +94,23 @@ static void res_get_handler(void* request, void* response, uint8_t *buffer, uint
 
 /**
  * Route resource.
+ * Cached, so that a blockwise transfer sees one snapshot of the tables.
  */
-RESOURCE(res_routes, "Routes", res_get_handler, NULL, NULL, NULL);
+CACHED_RESOURCE(res_routes, "Routes", res_get_handler, NULL, NULL, NULL);
 
 void res_get_handler(void *request, void *response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset) {
     int buffer_len = 0;
 
     DEBUG("Serving routes req Offset %d, PrefSize %d\n", (int) *offset, preferred_size);
 
+#if UIP_DS6_NOTIFICATIONS
+    // Don't serve a stale snapshot once the routes have changed
+    if (!isNotified) {
+        uip_ds6_notification_add(&route_notification, route_changed);
+        isNotified = true;
+    }
+#endif
+
     // If this is the first request get the first ip address
     if (*offset == 0) {
         reset_nbr_route();
@@ -133,6 +160,13 @@ void res_get_handler(void *request, void *response, uint8_t *buffer, uint16_t pr
     REST.set_response_payload(response, buffer, buffer_len);
 }
 
+#if UIP_DS6_NOTIFICATIONS
+void route_changed(int event, uip_ipaddr_t *ipaddr, uip_ipaddr_t *nexthop, int num_routes) {
+    DEBUG("Routes changed, flushing cache\n");
+    coap_block2_cache_flush(&res_routes);
+}
+#endif
+
 inline uint16_t get_hex_ip(uip_ipaddr_t *ipaddr) {
     return (ipaddr->u8[14] << 8) + ipaddr->u8[15];
 }
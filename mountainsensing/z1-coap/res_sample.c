@@ -2,6 +2,7 @@
  * @file res_sample.c
  * Sample resource.
  * Serves stored samples, and can delete them.
+ * With STORE_COMPRESS, also serves the blocks samples are stored in.
  * Arthur Fabre 2015
  */
 
@@ -54,6 +55,22 @@ static void res_get_handler(void* request, void* response, uint8_t *buffer, uint
  */
 static void res_delete_handler(void* request, void* response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset);
 
+#if STORE_COMPRESS
+/**
+ * Get handler for Blocks.
+ * Serves the block holding a sample, as stored in flash.
+ * Format is GET /block/23 to get the block holding sample #23.
+ */
+static void res_block_get_handler(void* request, void* response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset);
+
+/**
+ * Delete handler for Blocks.
+ * Deletes a block, and all the samples it holds.
+ * Format is DELETE /block/23 to delete the block holding sample #23.
+ */
+static void res_block_delete_handler(void* request, void* response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset);
+#endif /* STORE_COMPRESS */
+
 /**
  * Parse a trailing sample id from a URI.
  * Deals with validating the ID, trailing slashes.
@@ -69,6 +86,14 @@ static int16_t parse_sample_id(void *request);
  */
 PARENT_RESOURCE(res_sample, "Sample", res_get_handler, NULL, NULL, res_delete_handler);
 
+#if STORE_COMPRESS
+/**
+ * Block ressource.
+ * Parent ressource as we use URL based parametes (like GET /block/32)
+ */
+PARENT_RESOURCE(res_block, "Block", res_block_get_handler, NULL, NULL, res_block_delete_handler);
+#endif /* STORE_COMPRESS */
+
 void res_get_handler(void* request, void* response, uint8_t *payload_buffer, uint16_t preferred_size, int32_t *offset) {
     static uint8_t sample_buffer[Sample_size];
     static uint8_t sample_len;
@@ -154,6 +179,64 @@ void res_delete_handler(void* request, void* response, uint8_t *buffer, uint16_t
     REST.set_response_status(response, REST.status.DELETED);
 }
 
+#if STORE_COMPRESS
+void res_block_get_handler(void* request, void* response, uint8_t *payload_buffer, uint16_t preferred_size, int32_t *offset) {
+    int16_t sample_id;
+    int payload_len;
+
+    sample_id = parse_sample_id(request);
+
+    if (sample_id == NO_SAMPLE_ID || sample_id == INVALID_SAMPLE_ID) {
+        DEBUG("Get request with invalid / missing sample id!\n");
+        REST.set_response_status(response, REST.status.BAD_REQUEST);
+        return;
+    }
+
+    DEBUG("Serving block request! Offset %" PRId32 ", PrefSize %d\n", *offset, preferred_size);
+
+    // Blocks don't fit in RAM, read every chunk from flash
+    payload_len = store_get_raw_block(sample_id, payload_buffer, *offset, preferred_size);
+
+    if (payload_len < 0) {
+        DEBUG("Unable to get block!\n");
+        REST.set_response_status(response, REST.status.NOT_FOUND);
+        return;
+    }
+
+    // A short chunk is the last one
+    if (payload_len < preferred_size) {
+        *offset = -1;
+    } else {
+        *offset += payload_len;
+    }
+
+    REST.set_header_content_type(response, REST.type.APPLICATION_OCTET_STREAM);
+    REST.set_response_payload(response, payload_buffer, payload_len);
+}
+
+void res_block_delete_handler(void* request, void* response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset) {
+    int16_t sample_id;
+
+    sample_id = parse_sample_id(request);
+
+    if (sample_id == NO_SAMPLE_ID || sample_id == INVALID_SAMPLE_ID) {
+        DEBUG("Delete request with invalid / missing sample id!\n");
+        REST.set_response_status(response, REST.status.BAD_REQUEST);
+        return;
+    }
+
+    DEBUG("Delete request for block of: %d\n", sample_id);
+
+    if (!store_delete_block(sample_id)) {
+        DEBUG("Failed to delete block\n");
+        REST.set_response_status(response, REST.status.NOT_FOUND);
+        return;
+    }
+
+    REST.set_response_status(response, REST.status.DELETED);
+}
+#endif /* STORE_COMPRESS */
+
 int16_t parse_sample_id(void *request) {
     const char *uri_path;
     int uri_length;
@@ -16,6 +16,7 @@
 #include "readings.pb.h"
 #include "power.pb.h"
 #include "net/rpl/rpl.h"
+#include "sys/energest.h"
 
 #define DEBUG_ON
 #include "debug.h"
@@ -40,9 +41,10 @@ PROCESS(sample_process, "Sample Process");
 #define CONFIG_MIN_INTERVAL 2
 
 /**
- * Delay required for the AVR to reply over RS485 after booting
+ * Delay required for the AVR to reply over RS485 after booting.
+ * Rounded up, as the etimer might fire up to a tick early.
  */
-#define AVR_ACTIVATE_DELAY (RTIMER_SECOND / 10)
+#define AVR_ACTIVATE_DELAY (CLOCK_SECOND / 10 + 1)
 
 /**
  * The current sensor config being used.
@@ -54,6 +56,25 @@ static SensorConfig config;
  */
 static Sample sample;
 
+#if SAMPLER_QUEUE_LEN
+/**
+ * Samples done, but not yet written to the Store.
+ */
+static Sample queue[SAMPLER_QUEUE_LEN];
+
+/**
+ * Number of samples in queue.
+ */
+static uint8_t queue_len;
+#endif
+
+#if ENERGEST_CONF_ON
+/**
+ * Time the sensors were on for when the current sample was started.
+ */
+static unsigned long sensors_start;
+#endif
+
 /**
  * True if the AVRs have been handled and we should do the PowerBoards now, False otherwise.
  */
@@ -105,6 +126,31 @@ static bool start_power(void);
  */
 static void end_power(bool isSuccess);
 
+/**
+ * Read the onboard sensors into the current sample.
+ */
+static void read_sensors(void);
+
+/**
+ * Turn sense on, and account for it.
+ */
+static void sense_on(void);
+
+/**
+ * Turn sense off, and account for it.
+ */
+static void sense_off(void);
+
+/**
+ * Queue the current sample, and write the queue to the Store if it is full.
+ */
+static void queue_sample(void);
+
+/**
+ * Write samples to the Store.
+ */
+static void write_samples(Sample *samples, uint8_t count);
+
 /**
  * Instruct us to turn sense off,
  * and save the current sample we're working on (ie we're done with it).
@@ -124,11 +170,15 @@ static void print_config(SensorConfig *conf);
 
 PROCESS_THREAD(sample_process, ev, data) {
     static struct etimer sample_timer;
+    static struct etimer avr_timer;
 
     PROCESS_BEGIN();
 
     refresh_config();
 
+    // Queued samples are written before the store reads or deletes any
+    store_set_flush_callback(&sampler_flush);
+
     ms_init();
 
     // Set the AVR callback
@@ -146,39 +196,21 @@ PROCESS_THREAD(sample_process, ev, data) {
         PROCESS_WAIT_EVENT();
 
         // If it's time to sample
-        if (ev == PROCESS_EVENT_TIMER && etimer_expired(&sample_timer)) {
+        if (ev == PROCESS_EVENT_TIMER && data == &sample_timer && etimer_expired(&sample_timer)) {
 
             DEBUG("Sampling\n");
 
             // Clear the previous sample, as it may have leftover things set we don't anticipate
             memset(&sample, 0, sizeof(sample));
 
-            ms_sense_on();
-
-            ms_get_time(&sample.time);
-
-            sample.has_temp = ms_get_temp(&sample.temp);
+            sense_on();
 
-            sample.has_humid = ms_get_humid(&sample.humid);
-
-            if (config.hasADC1) {
-                sample.has_ADC1 = ms_get_adc1(&sample.ADC1);
+            // The AVR boots while we read the onboard sensors, instead of busy waiting for it afterwards
+            if (config.has_avrID) {
+                etimer_set(&avr_timer, AVR_ACTIVATE_DELAY);
             }
 
-            if (config.hasADC2) {
-                sample.has_ADC2 = ms_get_adc2(&sample.ADC2);
-            }
-
-            if (config.hasRain) {
-                sample.has_rain = ms_get_rain(&sample.rain);
-            }
-
-            sample.has_accX = sample.has_accY = sample.has_accZ = ms_get_acc(&sample.accX, &sample.accY, &sample.accZ);
-
-            // If we don't have a power board, use good old batt volts
-            if (!config.has_powerID && ms_get_batt(&sample.batt)) {
-                sample.which_battery = Sample_batt_tag;
-            }
+            read_sensors();
 
             // If we have no AVR, consider it done
             is_avr_complete = !config.has_avrID;
@@ -192,30 +224,28 @@ PROCESS_THREAD(sample_process, ev, data) {
 
                 // Otherwise we're done
                 save_sample();
-                continue;
             }
 
-            // If we have an AVR, and it has been queud successfully for getting data, wait for that
+            // Otherwise serve the network until the AVR is up
+
+        } else if (ev == PROCESS_EVENT_TIMER && data == &avr_timer) {
+
+            // If the AVR has been queud successfully for getting data, wait for that
             // Let the sampler know we'll call it back
-            if (config.has_avrID && start_avr()) {
-                continue;
+            if (!start_avr()) {
+                // Otherwise we're done
+                save_sample();
             }
 
-            // Otherwise we're done
-            save_sample();
-
         } else if (ev == SAMPLER_EVENT_SAVE_SAMPLE) {
-            ms_sense_off();
-
-            int16_t id = store_save_sample(&sample);
+            sense_off();
 
-            if (id) {
-                DEBUG("Sample saved with id %d\n", id);
-            } else {
-                DEBUG("Failed to save sample!\n");
-            }
+            queue_sample();
 
         } else if (ev == SAMPLER_EVENT_RELOAD_CONFIG) {
+            // Samples taken with the old config are done
+            sampler_flush();
+
             refresh_config();
 
             DEBUG("Refreshed Sensor config to:\n");
@@ -271,6 +301,92 @@ void save_sample(void) {
     process_post(&sample_process, SAMPLER_EVENT_SAVE_SAMPLE, NULL);
 }
 
+void read_sensors(void) {
+    ms_get_time(&sample.time);
+
+    sample.has_temp = ms_get_temp(&sample.temp);
+
+    sample.has_humid = ms_get_humid(&sample.humid);
+
+    if (config.hasADC1) {
+        sample.has_ADC1 = ms_get_adc1(&sample.ADC1);
+    }
+
+    if (config.hasADC2) {
+        sample.has_ADC2 = ms_get_adc2(&sample.ADC2);
+    }
+
+    if (config.hasRain) {
+        sample.has_rain = ms_get_rain(&sample.rain);
+    }
+
+    sample.has_accX = sample.has_accY = sample.has_accZ = ms_get_acc(&sample.accX, &sample.accY, &sample.accZ);
+
+    // If we don't have a power board, use good old batt volts
+    if (!config.has_powerID && ms_get_batt(&sample.batt)) {
+        sample.which_battery = Sample_batt_tag;
+    }
+}
+
+void sense_on(void) {
+    ms_sense_on();
+#if ENERGEST_CONF_ON
+    sensors_start = energest_type_time(ENERGEST_TYPE_SENSORS);
+    ENERGEST_ON(ENERGEST_TYPE_SENSORS);
+#endif
+}
+
+void sense_off(void) {
+    ms_sense_off();
+    ENERGEST_OFF(ENERGEST_TYPE_SENSORS);
+#if ENERGEST_CONF_ON
+    printf("Sampler: sensors on for %lu ticks\n", energest_type_time(ENERGEST_TYPE_SENSORS) - sensors_start);
+#endif
+}
+
+void queue_sample(void) {
+#if SAMPLER_QUEUE_LEN
+    queue[queue_len++] = sample;
+
+    DEBUG("Sample queued, %u in queue\n", queue_len);
+
+    if (queue_len == SAMPLER_QUEUE_LEN) {
+        sampler_flush();
+    }
+#else
+    write_samples(&sample, 1);
+#endif
+}
+
+void sampler_flush(void) {
+#if SAMPLER_QUEUE_LEN
+    if (queue_len) {
+        write_samples(queue, queue_len);
+        queue_len = 0;
+    }
+#endif
+}
+
+void write_samples(Sample *samples, uint8_t count) {
+    uint8_t saved;
+#if ENERGEST_CONF_ON
+    unsigned long lock_start = store_get_lock_time();
+#endif
+
+    saved = store_save_samples(samples, count);
+
+    if (saved) {
+        DEBUG("Samples saved with ids %d to %d\n", (int)samples[0].id, (int)samples[saved - 1].id);
+    }
+    if (saved != count) {
+        DEBUG("Failed to save %u samples!\n", count - saved);
+    }
+
+#if ENERGEST_CONF_ON
+    printf("Sampler: radio locked for %lu ticks to save %u samples\n", store_get_lock_time() - lock_start, count);
+#endif
+}
+
 void avr_callback(bool isSuccess) {
     // If the avr isn't done yet, this must be the end of it
     if (!is_avr_complete) {
@@ -291,10 +407,6 @@ void avr_callback(bool isSuccess) {
 }
 
 bool start_avr(void) {
-    // Wait for the AVR to fully power on
-    rtimer_clock_t end = RTIMER_NOW() + AVR_ACTIVATE_DELAY;
-    while (RTIMER_CLOCK_LT(RTIMER_NOW(), end));
-
     // Use the buffer in the sample directly
     data.data = sample.AVR.bytes;
     data.len = &sample.AVR.size;
@@ -4,6 +4,10 @@
  * The sensors to sample as well as the sampling interval are defined by the SampleConfig stored in the Store.
  * The sampler can be instrcuted to reload it from the Store by calling sampler_refresh_config()
  *
+ * The onboard sensors are read while the AVR powers up, and finished samples are queued in RAM,
+ * to be written to the Store SAMPLER_QUEUE_LEN at a time with a single radio lock.
+ * With ENERGEST_CONF_ON, the time the sensors are powered and the radio is locked for is printed after every write.
+ *
  * @author
  *      Dan Playle      <djap1g12@soton.ac.uk>
  *      Philip Basford  <pjb@ecs.soton.ac.uk>
@@ -20,6 +24,17 @@
 #include "contiki.h"
 #include "settings.pb.h"
 
+/**
+ * Number of samples kept in RAM before they are written to the Store.
+ * Every sample in the queue costs sizeof(Sample) of RAM.
+ * 0 writes every sample as soon as it is done.
+ */
+#ifdef SAMPLER_CONF_QUEUE_LEN
+#define SAMPLER_QUEUE_LEN SAMPLER_CONF_QUEUE_LEN
+#else
+#define SAMPLER_QUEUE_LEN 0
+#endif
+
 /**
  * Process the sampler runs as.
  */
@@ -31,6 +46,12 @@ PROCESS_NAME(sample_process);
  */
 void sampler_refresh_config(void);
 
+/**
+ * Write the queued samples to the Store.
+ * The Store calls this before reading or deleting samples.
+ */
+void sampler_flush(void);
+
 /**
  * Check a config for sanity.
  * @return True if the config is sane, false otherwise.
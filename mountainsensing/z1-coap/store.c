@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <string.h>
 #include "store.h"
 #include "contiki.h"
 #include "cfs/cfs.h"
@@ -10,6 +11,10 @@
 #include "pb_encode.h"
 #include "math.h"
 
+#if STORE_COMPRESS
+    #include "sample-block.h"
+#endif
+
 #ifdef SPI_LOCKING
     #include "cc1120.h"
     #include "cc1120-arch.h"
@@ -55,6 +60,157 @@ static const uint8_t END_CANARY = 0xAF;
  */
 static uint16_t last_id;
 
+#if STORE_COMPRESS
+
+/**
+ * First character of block filenames, followed by the number of the block.
+ */
+#define BLOCK_PREFIX 'b'
+
+_Static_assert(STORE_BLOCK_SAMPLES <= 32, "STORE_BLOCK_SAMPLES too big for the live sample bitmap");
+
+// Block numbers go up to UINT16_MAX / STORE_BLOCK_SAMPLES
+_Static_assert(1 + (UINT16_MAX / STORE_BLOCK_SAMPLES >= 10000 ? 5 : 4) <= (FILENAME_LENGTH - 1), "FILENAME_LENGTH too small to store all blocks");
+
+/**
+ * Space kept at the end of a block for rows marking samples as deleted.
+ * The id of a sample is less than 128 past the first id of the block, so a row is 3 bytes.
+ */
+#define BLOCK_DELETED_SPACE (STORE_BLOCK_SAMPLES * 3)
+
+_Static_assert(STORE_ITERATOR_WINDOW % STORE_BLOCK_SAMPLES == 0, "STORE_ITERATOR_WINDOW must hold whole blocks");
+
+_Static_assert(STORE_BLOCK_SIZE > BLOCK_DELETED_SPACE + SAMPLE_BLOCK_HEADER_LEN + SAMPLE_BLOCK_MAX_ROW, "STORE_BLOCK_SIZE too small to hold a sample");
+
+/**
+ * Indicates no block is open for saving samples.
+ */
+#define NO_BLOCK UINT16_MAX
+
+/**
+ * Number of the block samples are appended to.
+ */
+static uint16_t block_current = NO_BLOCK;
+
+/**
+ * Encoder state of block_current.
+ */
+static struct sample_block_state block_state;
+
+/**
+ * Length of block_current. STORE_BLOCK_SIZE if it can not be appended to.
+ */
+static uint16_t block_len;
+
+/**
+ * Result of reading a block from flash.
+ */
+struct block_scan {
+    /** Decoder state after the last valid row. */
+    struct sample_block_state state;
+    /** Length of the valid rows, including the header. */
+    uint16_t len;
+    /** Whether the block ends with a complete and valid row, and can be appended to. */
+    bool intact;
+    /** Samples of the block that have not been deleted, bit n is the nth id of the block. */
+    uint32_t live;
+    /** Values of the sample that was looked for, if it is live. */
+    struct sample_block_values values;
+};
+
+/**
+ * Get the number of the block a sample id belongs to.
+ */
+static uint16_t id_to_block(uint16_t id);
+
+/**
+ * Get the bit of a sample id in the live bitmap of its block.
+ */
+static uint32_t id_to_bit(uint16_t id);
+
+/**
+ * Convert a block number to a filename.
+ * @return The pointer to filename(usefull for avoiding temp vars).
+ */
+static char* block_to_file(uint16_t block, char *filename);
+
+/**
+ * Convert a filename to a block number.
+ * @return True if the filename is a block, false otherwise.
+ */
+static bool file_to_block(char *filename, uint16_t *block);
+
+/**
+ * Decode a block from flash.
+ * @param id The id of a sample to get the values of, 0 for none.
+ * @return `true` if the block exists, `false` otherwise.
+ */
+static bool scan_block(uint16_t block, uint16_t id, struct block_scan *scan);
+
+/**
+ * Make block the block samples are appended to.
+ */
+static void load_block(uint16_t block);
+
+/**
+ * Append a sample to its block.
+ * @return `true` on success, `false` if the sample must be saved in its own file.
+ */
+static bool save_block_sample(const Sample *sample);
+
+/**
+ * Get a sample from its block, as a protocol buffer.
+ * @return The number of bytes written to the buffer on success, `false` otherwise.
+ */
+static uint8_t get_block_sample(uint16_t id, uint8_t buffer[Sample_size]);
+
+/**
+ * Mark a sample in its block as deleted, and remove the block once all its samples are.
+ * @return `true` on success, `false` otherwise.
+ */
+static bool delete_block_sample(uint16_t id);
+
+/**
+ * Convert a sample to the values stored in a block.
+ * @return `true` on success, `false` if the sample has readings that can not be stored in a block.
+ */
+static bool sample_to_values(const Sample *sample, struct sample_block_values *values);
+
+/**
+ * Convert the values stored in a block to a sample.
+ */
+static void values_to_sample(const struct sample_block_values *values, Sample *sample);
+
+#endif /* STORE_COMPRESS */
+
+#if ENERGEST_CONF_ON
+/**
+ * When the radio was last locked.
+ */
+static rtimer_clock_t lock_start;
+
+/**
+ * Total time the radio has been locked for, in rtimer ticks.
+ */
+static unsigned long lock_time;
+#endif
+
+/**
+ * Writes the samples held back by the sampler, if any.
+ */
+static void (*flush_callback)(void);
+
+/**
+ * Call the flush callback before reading or deleting samples.
+ */
+static void flush_pending(void);
+
+/**
+ * Save a sample, with the radio already locked.
+ * @return The id of the sample on success, `false` on failure.
+ */
+static uint16_t save_sample(Sample *sample);
+
 /**
  * Lock the radio for cfs access.
  */
@@ -97,7 +253,64 @@ static char* id_to_file(uint16_t id, char* filename);
  */
 static bool file_to_id(char *filename, uint16_t *id);
 
+/**
+ * Load the window of an iterator holding iterator->next_id, with a pass over the directory.
+ */
+static void load_window(struct store_iterator *iterator);
+
+/**
+ * Check if a sample exists.
+ */
+static bool sample_exists(uint16_t id);
+
+/**
+ * Set last_id to the latest existing sample that is <= last_id.
+ */
+static void find_previous_sample(void);
+
 uint16_t store_save_sample(Sample *sample) {
+    if (!store_save_samples(sample, 1)) {
+        return false;
+    }
+
+    return sample->id;
+}
+
+uint8_t store_save_samples(Sample *samples, uint8_t count) {
+    uint8_t saved;
+
+    radio_lock();
+
+    for (saved = 0; saved < count; saved++) {
+        if (!save_sample(&samples[saved])) {
+            break;
+        }
+    }
+
+    radio_release();
+
+    return saved;
+}
+
+void store_set_flush_callback(void (*flush)(void)) {
+    flush_callback = flush;
+}
+
+void flush_pending(void) {
+    if (flush_callback) {
+        flush_callback();
+    }
+}
+
+unsigned long store_get_lock_time(void) {
+#if ENERGEST_CONF_ON
+    return lock_time;
+#else
+    return 0;
+#endif
+}
+
+uint16_t save_sample(Sample *sample) {
     pb_ostream_t pb_ostream;
     uint8_t pb_buffer[Sample_size];
     char filename[FILENAME_LENGTH];
@@ -108,31 +321,34 @@ uint16_t store_save_sample(Sample *sample) {
 
     DEBUG("Attempting to save reading with id %d\n", last_id);
 
+#if STORE_COMPRESS
+    if (save_block_sample(sample)) {
+        return last_id;
+    }
+#endif
+
     pb_ostream = pb_ostream_from_buffer(pb_buffer, sizeof(pb_buffer));
     if (!pb_encode_delimited(&pb_ostream, Sample_fields, sample)) {
         last_id--;
         return false;
     }
 
-    radio_lock();
-
     if (!write_file(id_to_file(last_id, filename), pb_buffer, pb_ostream.bytes_written)) {
         DEBUG("Failed to save reading %d\n", last_id);
         last_id--;
-        radio_release();
         return false;
     }
 
-    radio_release();
-
     return last_id;
 }
 
 bool store_get_latest_sample(Sample *sample) {
+    flush_pending();
     return store_get_sample(last_id, sample);
 }
 
 uint8_t store_get_latest_raw_sample(uint8_t buffer[Sample_size]) {
+    flush_pending();
     return store_get_raw_sample(last_id, buffer);
 }
 
@@ -158,21 +374,61 @@ uint8_t store_get_raw_sample(uint16_t id, uint8_t buffer[Sample_size]) {
 
     DEBUG("Attempting to get sample %d\n", id);
 
+    flush_pending();
+
     radio_lock();
 
     bytes = read_file(id_to_file(id, filename), buffer, Sample_size);
 
+#if STORE_COMPRESS
+    if (!bytes) {
+        bytes = get_block_sample(id, buffer);
+    }
+#endif
+
     radio_release();
 
     return bytes;
 }
 
 uint16_t store_get_latest_sample_id(void) {
+    flush_pending();
     return last_id;
 }
 
+void store_iterator_init(struct store_iterator *iterator, uint16_t first_id) {
+    flush_pending();
+    iterator->next_id = first_id < 1 ? 1 : first_id;
+    iterator->window = 0;
+}
+
+uint16_t store_iterator_next(struct store_iterator *iterator) {
+    uint16_t offset;
+
+    while (iterator->next_id != 0) {
+
+        if (iterator->window == 0 || iterator->next_id - iterator->window >= STORE_ITERATOR_WINDOW) {
+            flush_pending();
+            radio_lock();
+            load_window(iterator);
+            radio_release();
+        }
+
+        for (offset = iterator->next_id - iterator->window; offset < STORE_ITERATOR_WINDOW; offset++) {
+            if (iterator->present[offset / 8] & (1 << (offset % 8))) {
+                iterator->next_id = iterator->window + offset + 1;
+                return iterator->window + offset;
+            }
+        }
+
+        // Nothing left in this window, skip straight to the next id that might exist
+        iterator->next_id = iterator->after;
+    }
+
+    return 0;
+}
+
 bool store_delete_sample(uint16_t sample) {
-    int fd = 0;
     char filename[FILENAME_LENGTH];
 
     if (sample < 1) {
@@ -184,9 +440,15 @@ bool store_delete_sample(uint16_t sample) {
 
     id_to_file(sample, filename);
 
+    flush_pending();
+
     radio_lock();
 
-    if (cfs_remove(filename) == -1) {
+    if (cfs_remove(filename) == -1
+#if STORE_COMPRESS
+            && !delete_block_sample(sample)
+#endif
+            ) {
         DEBUG("Error deleting sample %d\n", sample);
         radio_release();
         return false;
@@ -197,25 +459,90 @@ bool store_delete_sample(uint16_t sample) {
         DEBUG("Sample %d is last known sample. Searching for previous sample...\n", sample);
 
         last_id--;
+        find_previous_sample();
+    }
 
-        id_to_file(last_id, filename);
+    DEBUG("Sample %d deleted. Last_id is now %d\n", sample, last_id);
 
-        // Keep going until we reach a file that exists
-        while (last_id != 0 && (fd = cfs_open(filename, CFS_READ)) < 0) {
-            //DEBUG("Sample %d does not exist, continuing..\n", last_id);
-            last_id--;
-            id_to_file(last_id, filename);
-        }
+    radio_release();
 
-        cfs_close(fd);
+    return true;
+}
+
+#if STORE_COMPRESS
+int store_get_raw_block(uint16_t id, uint8_t *buffer, uint16_t offset, uint16_t length) {
+    char filename[FILENAME_LENGTH];
+    int fd;
+    int bytes;
+
+    DEBUG("Attempting to get block of sample %d, offset %u\n", id, offset);
+
+    if (id < 1) {
+        return -1;
     }
 
-    DEBUG("Sample %d deleted. Last_id is now %d\n", sample, last_id);
+    flush_pending();
+
+    radio_lock();
+
+    fd = cfs_open(block_to_file(id_to_block(id), filename), CFS_READ);
+
+    if (fd < 0) {
+        DEBUG("Failed to open file %s\n", filename);
+        radio_release();
+        return -1;
+    }
+
+    bytes = -1;
+    if (cfs_seek(fd, offset, CFS_SEEK_SET) == offset) {
+        bytes = cfs_read(fd, buffer, length);
+    }
+
+    cfs_close(fd);
+
+    radio_release();
+
+    // Reading at the end of the block is not an error
+    return bytes < 0 ? 0 : bytes;
+}
+
+bool store_delete_block(uint16_t id) {
+    char filename[FILENAME_LENGTH];
+    uint16_t block = id_to_block(id);
+
+    if (id < 1) {
+        DEBUG("Attempting to delete invalid block of sample %d\n", id);
+        return false;
+    }
+
+    DEBUG("Attempting to delete block %u\n", block);
+
+    flush_pending();
+
+    radio_lock();
+
+    if (cfs_remove(block_to_file(block, filename)) == -1) {
+        DEBUG("Error deleting block %u\n", block);
+        radio_release();
+        return false;
+    }
+
+    if (block == block_current) {
+        block_current = NO_BLOCK;
+    }
+
+    // Samples of the block saved in their own file are still there
+    if (id_to_block(last_id) == block) {
+        find_previous_sample();
+    }
+
+    DEBUG("Block %u deleted. Last_id is now %d\n", block, last_id);
 
     radio_release();
 
     return true;
 }
+#endif /* STORE_COMPRESS */
 
 bool store_save_config(SensorConfig *config) {
     pb_ostream_t pb_ostream;
@@ -345,6 +672,9 @@ void store_init(void) {
 }
 
 void radio_lock(void) {
+#if ENERGEST_CONF_ON
+    lock_start = RTIMER_NOW();
+#endif
 #ifdef SPI_LOCKING
     NETSTACK_MAC.off(0);
     cc1120_arch_interrupt_disable();
@@ -360,12 +690,22 @@ void radio_release(void) {
     NETSTACK_MAC.on();
     DEBUG("Radio Unlocked\n");
 #endif
+#if ENERGEST_CONF_ON
+    lock_time += (rtimer_clock_t)(RTIMER_NOW() - lock_start);
+#endif
 }
 
 uint16_t find_latest_sample(void) {
     struct cfs_dirent dirent;
     struct cfs_dir dir;
     uint16_t max_id = 0;
+#if STORE_COMPRESS
+    struct block_scan scan;
+    uint16_t max_block = 0;
+    bool has_block = false;
+    uint16_t block;
+    uint8_t i;
+#endif
 
     DEBUG("Refreshing filename cache\n");
 
@@ -382,11 +722,33 @@ uint16_t find_latest_sample(void) {
 
                 //DEBUG("File %s has sample id %u (Max id %u)\n", dirent.name, file_id, max_id);
             }
+
+#if STORE_COMPRESS
+            if (file_to_block(dirent.name, &block) && (!has_block || block > max_block)) {
+                max_block = block;
+                has_block = true;
+            }
+#endif
         }
 
         cfs_closedir(&dir);
     }
 
+#if STORE_COMPRESS
+    // The latest sample of the latest block is the highest live one
+    if (has_block && scan_block(max_block, 0, &scan)) {
+        for (i = STORE_BLOCK_SAMPLES; i > 0; i--) {
+            if (scan.live & (1UL << (i - 1))) {
+                break;
+            }
+        }
+
+        if (i > 0 && max_block * STORE_BLOCK_SAMPLES + i > max_id) {
+            max_id = max_block * STORE_BLOCK_SAMPLES + i;
+        }
+    }
+#endif
+
     return max_id;
 }
 
@@ -415,3 +777,448 @@ bool file_to_id(char *filename, uint16_t *id) {
 
     return is_sample;
 }
+
+void load_window(struct store_iterator *iterator) {
+    struct cfs_dirent dirent;
+    struct cfs_dir dir;
+    uint16_t window_end;
+    uint16_t id;
+#if STORE_COMPRESS
+    struct block_scan scan;
+    uint16_t block;
+    uint8_t i;
+#endif
+
+    iterator->window = ((iterator->next_id - 1) / STORE_ITERATOR_WINDOW) * STORE_ITERATOR_WINDOW + 1;
+    iterator->after = 0;
+    memset(iterator->present, 0, sizeof(iterator->present));
+
+    // The last window ends at UINT16_MAX
+    window_end = iterator->window + (STORE_ITERATOR_WINDOW - 1);
+    if (window_end < iterator->window) {
+        window_end = UINT16_MAX;
+    }
+
+    DEBUG("Loading ids %u to %u\n", iterator->window, window_end);
+
+    if (cfs_opendir(&dir, DIRECTORY) != 0) {
+        return;
+    }
+
+    while (cfs_readdir(&dir, &dirent) != -1) {
+
+        if (file_to_id(dirent.name, &id) && id >= iterator->window) {
+            if (id <= window_end) {
+                id -= iterator->window;
+                iterator->present[id / 8] |= 1 << (id % 8);
+            } else if (iterator->after == 0 || id < iterator->after) {
+                iterator->after = id;
+            }
+        }
+
+#if STORE_COMPRESS
+        if (file_to_block(dirent.name, &block)) {
+            id = block * STORE_BLOCK_SAMPLES + 1;
+
+            // Windows hold whole blocks
+            if (id < iterator->window) {
+                continue;
+            }
+
+            if (id > window_end) {
+                // Any sample of the block is at least its first id
+                if (iterator->after == 0 || id < iterator->after) {
+                    iterator->after = id;
+                }
+                continue;
+            }
+
+            if (scan_block(block, 0, &scan)) {
+                id -= iterator->window;
+
+                for (i = 0; i < STORE_BLOCK_SAMPLES; i++, id++) {
+                    if (scan.live & (1UL << i)) {
+                        iterator->present[id / 8] |= 1 << (id % 8);
+                    }
+                }
+            }
+        }
+#endif
+    }
+
+    cfs_closedir(&dir);
+}
+
+bool sample_exists(uint16_t id) {
+    char filename[FILENAME_LENGTH];
+    int fd;
+#if STORE_COMPRESS
+    struct block_scan scan;
+#endif
+
+    fd = cfs_open(id_to_file(id, filename), CFS_READ);
+
+    if (fd >= 0) {
+        cfs_close(fd);
+        return true;
+    }
+
+#if STORE_COMPRESS
+    return scan_block(id_to_block(id), 0, &scan) && (scan.live & id_to_bit(id));
+#else
+    return false;
+#endif
+}
+
+void find_previous_sample(void) {
+    // Keep going until we reach a sample that exists
+    while (last_id != 0 && !sample_exists(last_id)) {
+        //DEBUG("Sample %d does not exist, continuing..\n", last_id);
+        last_id--;
+    }
+}
+
+#if STORE_COMPRESS
+uint16_t id_to_block(uint16_t id) {
+    return (id - 1) / STORE_BLOCK_SAMPLES;
+}
+
+uint32_t id_to_bit(uint16_t id) {
+    return 1UL << ((id - 1) % STORE_BLOCK_SAMPLES);
+}
+
+char* block_to_file(uint16_t block, char *filename) {
+    sprintf(filename, "%c%u", BLOCK_PREFIX, block);
+    return filename;
+}
+
+bool file_to_block(char *filename, uint16_t *block) {
+    if (filename[0] != BLOCK_PREFIX) {
+        return false;
+    }
+
+    return file_to_id(filename + 1, block);
+}
+
+bool scan_block(uint16_t block, uint16_t id, struct block_scan *scan) {
+    // Big enough to always hold a complete row after a partial one
+    uint8_t buffer[2 * SAMPLE_BLOCK_MAX_ROW];
+    struct sample_block_values values;
+    char filename[FILENAME_LENGTH];
+    uint16_t first_id = block * STORE_BLOCK_SAMPLES + 1;
+    uint16_t filled;
+    uint16_t pos;
+    int bytes;
+    int fd;
+    int n;
+
+    fd = cfs_open(block_to_file(block, filename), CFS_READ);
+
+    if (fd < 0) {
+        return false;
+    }
+
+    scan->len = 0;
+    scan->live = 0;
+    scan->intact = false;
+
+    bytes = cfs_read(fd, buffer, sizeof(buffer));
+
+    if (bytes < SAMPLE_BLOCK_HEADER_LEN || !sample_block_read_header(&scan->state, buffer) ||
+            scan->state.first_id != first_id) {
+        DEBUG("Block %u has an invalid header\n", block);
+        cfs_close(fd);
+        return true;
+    }
+
+    filled = bytes;
+    pos = scan->len = SAMPLE_BLOCK_HEADER_LEN;
+
+    while (true) {
+        n = sample_block_decode(&scan->state, buffer + pos, filled - pos, &values);
+
+        if (n > 0) {
+            if (values.id < first_id || values.id - first_id >= STORE_BLOCK_SAMPLES) {
+                break;
+            }
+
+            if (values.fields & SAMPLE_BLOCK_DELETED) {
+                scan->live &= ~id_to_bit(values.id);
+            } else {
+                scan->live |= id_to_bit(values.id);
+
+                if (values.id == id) {
+                    scan->values = values;
+                }
+            }
+
+            pos += n;
+            scan->len += n;
+            continue;
+        }
+
+        if (n < 0) {
+            break;
+        }
+
+        // Incomplete row, read more of the block
+        memmove(buffer, buffer + pos, filled - pos);
+        filled -= pos;
+        pos = 0;
+
+        bytes = cfs_read(fd, buffer + filled, sizeof(buffer) - filled);
+
+        if (bytes <= 0) {
+            // A block ending with part of a row was not written completely
+            scan->intact = (filled == 0);
+            break;
+        }
+
+        filled += bytes;
+    }
+
+    if (!scan->intact) {
+        DEBUG("Block %u is corrupt after %u bytes\n", block, scan->len);
+    }
+
+    cfs_close(fd);
+    return true;
+}
+
+void load_block(uint16_t block) {
+    struct block_scan scan;
+
+    if (block == block_current) {
+        return;
+    }
+
+    block_current = block;
+
+    if (scan_block(block, 0, &scan)) {
+        block_state = scan.state;
+        // Never append to a corrupt block, as the rows would not be decodable
+        block_len = scan.intact ? scan.len : STORE_BLOCK_SIZE;
+    } else {
+        sample_block_init(&block_state, block * STORE_BLOCK_SAMPLES + 1);
+        block_len = 0;
+    }
+}
+
+bool save_block_sample(const Sample *sample) {
+    struct sample_block_values values;
+    uint8_t row[SAMPLE_BLOCK_HEADER_LEN + SAMPLE_BLOCK_MAX_ROW];
+    char filename[FILENAME_LENGTH];
+    uint8_t len = 0;
+    int bytes;
+    int fd;
+
+    if (!sample_to_values(sample, &values)) {
+        DEBUG("Sample %d can not be stored in a block\n", sample->id);
+        return false;
+    }
+
+    load_block(id_to_block(sample->id));
+
+    if (block_len == 0) {
+        len = sample_block_write_header(&block_state, row);
+    }
+
+    len += sample_block_encode(&block_state, &values, row + len);
+
+    if (block_len + len > STORE_BLOCK_SIZE - BLOCK_DELETED_SPACE) {
+        DEBUG("Block %u is full\n", block_current);
+        return false;
+    }
+
+    block_to_file(block_current, filename);
+
+    if (block_len == 0 && cfs_coffee_reserve(filename, STORE_BLOCK_SIZE) < 0) {
+        DEBUG("Failed to reserve space for file %s\n", filename);
+        return false;
+    }
+
+    fd = cfs_open(filename, CFS_WRITE | CFS_APPEND);
+
+    if (fd < 0) {
+        DEBUG("Failed to open file %s for writing\n", filename);
+        return false;
+    }
+
+    // Instruct coffee to never extend a file - we've always reserved enough space
+    cfs_coffee_set_io_semantics(fd, CFS_COFFEE_IO_FIRM_SIZE);
+
+    bytes = cfs_write(fd, row, len);
+
+    cfs_close(fd);
+
+    if (bytes != len) {
+        DEBUG("Failed to write block %u, wrote %d bytes\n", block_current, bytes);
+        // Part of a row might have been written
+        block_len = STORE_BLOCK_SIZE;
+        return false;
+    }
+
+    block_len += len;
+    sample_block_commit(&block_state, &values);
+
+    DEBUG("%d bytes written to block %u\n", len, block_current);
+    return true;
+}
+
+uint8_t get_block_sample(uint16_t id, uint8_t buffer[Sample_size]) {
+    struct block_scan scan;
+    pb_ostream_t pb_ostream;
+    Sample sample;
+
+    if (id < 1 || !scan_block(id_to_block(id), id, &scan) || !(scan.live & id_to_bit(id))) {
+        DEBUG("Sample %d is not in a block\n", id);
+        return false;
+    }
+
+    values_to_sample(&scan.values, &sample);
+
+    pb_ostream = pb_ostream_from_buffer(buffer, Sample_size);
+    if (!pb_encode_delimited(&pb_ostream, Sample_fields, &sample)) {
+        return false;
+    }
+
+    return pb_ostream.bytes_written;
+}
+
+bool delete_block_sample(uint16_t id) {
+    struct block_scan scan;
+    uint8_t row[SAMPLE_BLOCK_DELETED_ROW];
+    char filename[FILENAME_LENGTH];
+    uint16_t block = id_to_block(id);
+    uint8_t len;
+    int bytes;
+    int fd;
+
+    if (!scan_block(block, 0, &scan) || !(scan.live & id_to_bit(id))) {
+        return false;
+    }
+
+    block_to_file(block, filename);
+
+    // Nothing left in the block
+    if (!(scan.live & ~id_to_bit(id))) {
+        if (block == block_current) {
+            block_current = NO_BLOCK;
+        }
+        return cfs_remove(filename) != -1;
+    }
+
+    if (!scan.intact) {
+        DEBUG("Unable to delete sample %d from corrupt block %u\n", id, block);
+        return false;
+    }
+
+    len = sample_block_encode_deleted(&scan.state, id, row);
+
+    fd = cfs_open(filename, CFS_WRITE | CFS_APPEND);
+
+    if (fd < 0) {
+        DEBUG("Failed to open file %s for writing\n", filename);
+        return false;
+    }
+
+    cfs_coffee_set_io_semantics(fd, CFS_COFFEE_IO_FIRM_SIZE);
+
+    bytes = cfs_write(fd, row, len);
+
+    cfs_close(fd);
+
+    if (block == block_current) {
+        block_len = (bytes == len) ? block_len + len : STORE_BLOCK_SIZE;
+    }
+
+    return bytes == len;
+}
+
+/**
+ * Convert a reading to fixed point, rounding to the nearest unit.
+ */
+static int32_t to_fixed(float value, int32_t units) {
+    return (int32_t)(value * units + (value < 0 ? -0.5f : 0.5f));
+}
+
+bool sample_to_values(const Sample *sample, struct sample_block_values *values) {
+    if (sample->has_AVR || sample->which_battery == Sample_power_tag) {
+        return false;
+    }
+
+    if ((sample->has_accX != sample->has_accY) || (sample->has_accX != sample->has_accZ)) {
+        return false;
+    }
+
+    memset(values, 0, sizeof(*values));
+
+    values->id = sample->id;
+    values->time = sample->time;
+
+    if (sample->has_temp) {
+        values->fields |= SAMPLE_BLOCK_TEMP;
+        values->temp = to_fixed(sample->temp, 100);
+    }
+    if (sample->has_humid) {
+        values->fields |= SAMPLE_BLOCK_HUMID;
+        values->humid = to_fixed(sample->humid, 100);
+    }
+    if (sample->has_ADC1) {
+        values->fields |= SAMPLE_BLOCK_ADC1;
+        values->adc1 = sample->ADC1;
+    }
+    if (sample->has_ADC2) {
+        values->fields |= SAMPLE_BLOCK_ADC2;
+        values->adc2 = sample->ADC2;
+    }
+    if (sample->has_rain) {
+        values->fields |= SAMPLE_BLOCK_RAIN;
+        values->rain = sample->rain;
+    }
+    if (sample->has_accX) {
+        values->fields |= SAMPLE_BLOCK_ACC;
+        values->acc[0] = sample->accX;
+        values->acc[1] = sample->accY;
+        values->acc[2] = sample->accZ;
+    }
+    if (sample->which_battery == Sample_batt_tag) {
+        values->fields |= SAMPLE_BLOCK_BATT;
+        values->batt = to_fixed(sample->batt, 1000);
+    }
+
+    return true;
+}
+
+void values_to_sample(const struct sample_block_values *values, Sample *sample) {
+    memset(sample, 0, sizeof(*sample));
+
+    sample->id = values->id;
+    sample->time = values->time;
+
+    sample->has_temp = (values->fields & SAMPLE_BLOCK_TEMP) != 0;
+    sample->temp = values->temp / 100.0f;
+
+    sample->has_humid = (values->fields & SAMPLE_BLOCK_HUMID) != 0;
+    sample->humid = values->humid / 100.0f;
+
+    sample->has_ADC1 = (values->fields & SAMPLE_BLOCK_ADC1) != 0;
+    sample->ADC1 = values->adc1;
+
+    sample->has_ADC2 = (values->fields & SAMPLE_BLOCK_ADC2) != 0;
+    sample->ADC2 = values->adc2;
+
+    sample->has_rain = (values->fields & SAMPLE_BLOCK_RAIN) != 0;
+    sample->rain = values->rain;
+
+    sample->has_accX = sample->has_accY = sample->has_accZ = (values->fields & SAMPLE_BLOCK_ACC) != 0;
+    sample->accX = values->acc[0];
+    sample->accY = values->acc[1];
+    sample->accZ = values->acc[2];
+
+    if (values->fields & SAMPLE_BLOCK_BATT) {
+        sample->which_battery = Sample_batt_tag;
+        sample->batt = values->batt / 1000.0f;
+    }
+}
+#endif /* STORE_COMPRESS */
@@ -9,6 +9,12 @@
  *
  * Callers are always responsible for allocating the required memory.
  *
+ * With STORE_COMPRESS, samples are delta encoded in blocks of STORE_BLOCK_SAMPLES consecutive ids
+ * (see sample-block.h), instead of one protocol buffer file per sample.
+ * Samples that can not be delta encoded (AVR data, power board readings, or a full block)
+ * are still stored in their own file. Both kinds are served as protocol buffers by `store_get_raw_sample`,
+ * and whole blocks can be retrieved with `store_get_raw_block`.
+ *
  * @author Arthur Fabre <af1g12@ecs.soton.ac.uk>
  */
 
@@ -21,6 +27,60 @@
 #include "settings.pb.h"
 #include "readings.pb.h"
 
+/**
+ * Store samples in delta encoded blocks.
+ */
+#ifdef STORE_CONF_COMPRESS
+#define STORE_COMPRESS STORE_CONF_COMPRESS
+#else
+#define STORE_COMPRESS 0
+#endif
+
+/**
+ * Number of sample ids a block covers. At most 32.
+ */
+#ifdef STORE_CONF_BLOCK_SAMPLES
+#define STORE_BLOCK_SAMPLES STORE_CONF_BLOCK_SAMPLES
+#else
+#define STORE_BLOCK_SAMPLES 32
+#endif
+
+/**
+ * Space reserved in flash for a block, in bytes.
+ * Rows marking every sample of the block as deleted must fit alongside the samples.
+ */
+#ifdef STORE_CONF_BLOCK_SIZE
+#define STORE_BLOCK_SIZE STORE_CONF_BLOCK_SIZE
+#else
+#define STORE_BLOCK_SIZE 640
+#endif
+
+/**
+ * Number of ids a store_iterator looks for in a single pass over the directory.
+ * Must be a multiple of 8, and of STORE_BLOCK_SAMPLES with STORE_COMPRESS.
+ */
+#ifdef STORE_CONF_ITERATOR_WINDOW
+#define STORE_ITERATOR_WINDOW STORE_CONF_ITERATOR_WINDOW
+#else
+#define STORE_ITERATOR_WINDOW 256
+#endif
+
+/**
+ * Iterator over the stored samples, in increasing id order.
+ * Finds the samples that exist with one pass over the directory per STORE_ITERATOR_WINDOW ids,
+ * instead of trying to open every id.
+ */
+struct store_iterator {
+    /** Next id to look at. 0 once the iterator is done. */
+    uint16_t next_id;
+    /** First id of the window in present, 0 if none is loaded. */
+    uint16_t window;
+    /** Lowest id after the window that might exist, 0 if there are none. */
+    uint16_t after;
+    /** Ids in the window that exist, bit n is the nth id of the window. */
+    uint8_t present[STORE_ITERATOR_WINDOW / 8];
+};
+
 /**
  * Initialize the data store.
  * Includes finding the latest reading.
@@ -35,6 +95,28 @@ void store_init(void);
  */
 uint16_t store_save_sample(Sample *sample);
 
+/**
+ * Store several samples in the flash, locking the radio only once.
+ * This will also set the id field of every sample saved.
+ * @param *samples The samples to save, in order.
+ * @param count The number of samples.
+ * @return The number of samples saved. Saving stops at the first sample that fails.
+ */
+uint8_t store_save_samples(Sample *samples, uint8_t count);
+
+/**
+ * Set a function that writes samples held back in RAM to the store.
+ * It is called before any sample is read or deleted, so that none are missed.
+ * @param flush The function, or NULL for none.
+ */
+void store_set_flush_callback(void (*flush)(void));
+
+/**
+ * Get the total time the store has kept the radio locked for.
+ * @return The time in rtimer ticks, always 0 without ENERGEST_CONF_ON.
+ */
+unsigned long store_get_lock_time(void);
+
 /**
  * Get a given sample from the flash,
  * @param id The id of the sample.
@@ -73,6 +155,19 @@ uint8_t store_get_latest_raw_sample(uint8_t buffer[Sample_size]);
  */
 uint16_t store_get_latest_sample_id(void);
 
+/**
+ * Start iterating over the stored samples.
+ * @param first_id The id to start at. Lower ids are skipped.
+ */
+void store_iterator_init(struct store_iterator *iterator, uint16_t first_id);
+
+/**
+ * Get the next stored sample.
+ * Samples saved or deleted while iterating might be missed.
+ * @return The id of the next sample, 0 once there are none left.
+ */
+uint16_t store_iterator_next(struct store_iterator *iterator);
+
 /**
  * Delete a given sample from the flash.
  * @param id The id of the sample to delete.
@@ -80,6 +175,25 @@ uint16_t store_get_latest_sample_id(void);
  */
 bool store_delete_sample(uint16_t id);
 
+#if STORE_COMPRESS
+/**
+ * Get part of the block holding a given sample, as stored in flash.
+ * @param id The id of any sample in the block.
+ * @param buffer An allocated buffer at least length big to which the block will be written.
+ * @param offset The offset in the block to start reading at.
+ * @param length The maximum number of bytes to read.
+ * @return The number of bytes written to the buffer (0 past the end of the block), -1 if there is no such block.
+ */
+int store_get_raw_block(uint16_t id, uint8_t *buffer, uint16_t offset, uint16_t length);
+
+/**
+ * Delete the block holding a given sample, and all the samples it holds.
+ * @param id The id of any sample in the block.
+ * @return `true` on success, `false` otherwise.
+ */
+bool store_delete_block(uint16_t id);
+#endif /* STORE_COMPRESS */
+
 /**
  * Save the configuration to flash.
  * @param *config The configuration to save.
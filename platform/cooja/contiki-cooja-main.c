@@ -49,6 +49,7 @@
 
 #include "lib/random.h"
 #include "lib/simEnvChange.h"
+#include "lib/memory-sync.h"
 
 #include "net/rime/rime.h"
 #include "net/netstack.h"
@@ -390,19 +391,19 @@ Java_org_contikios_cooja_corecomm_CLASSNAME_init(JNIEnv *env, jobject obj)
  *             ANY error checking, and the process may crash if addresses are
  *             not available/readable.
  *
+ *             Only the pages that differ from mem_arr are written, which
+ *             after a tick are those the mote wrote to.
+ *
  *             This is a JNI function and should only be called via the
  *             responsible Java part (MoteType.java).
  */
 JNIEXPORT void JNICALL
 Java_org_contikios_cooja_corecomm_CLASSNAME_getMemory(JNIEnv *env, jobject obj, jint rel_addr, jint length, jbyteArray mem_arr)
 {
-  (*env)->SetByteArrayRegion(
-      env,
-      mem_arr,
-      0,
-      (size_t) length,
-      (jbyte *) (((long)rel_addr) + referenceVar)
-  );
+  jbyte *arr = (*env)->GetPrimitiveArrayCritical(env, mem_arr, NULL);
+  memory_sync_copy((char *)arr, (char *)(((long)rel_addr) + referenceVar),
+                   length);
+  (*env)->ReleasePrimitiveArrayCritical(env, mem_arr, arr, 0);
 }
 /*---------------------------------------------------------------------------*/
 /**
@@ -417,17 +418,28 @@ Java_org_contikios_cooja_corecomm_CLASSNAME_getMemory(JNIEnv *env, jobject obj,
  *             This function does not perform ANY error checking, and the
  *             process may crash if addresses are not available/writable.
  *
+ *             Only the pages that differ from the process memory are
+ *             written.
+ *
  *             This is a JNI function and should only be called via the
  *             responsible Java part (MoteType.java).
  */
 JNIEXPORT void JNICALL
 Java_org_contikios_cooja_corecomm_CLASSNAME_setMemory(JNIEnv *env, jobject obj, jint rel_addr, jint length, jbyteArray mem_arr)
 {
-  jbyte *mem = (*env)->GetByteArrayElements(env, mem_arr, 0);
-  memcpy((char*) (((long)rel_addr) + referenceVar),
-         mem,
-         length);
-  (*env)->ReleaseByteArrayElements(env, mem_arr, mem, 0);
+  jbyte *arr = (*env)->GetPrimitiveArrayCritical(env, mem_arr, NULL);
+  memory_sync_copy((char *)(((long)rel_addr) + referenceVar), (char *)arr,
+                   length);
+  (*env)->ReleasePrimitiveArrayCritical(env, mem_arr, arr, JNI_ABORT);
+}
+/*---------------------------------------------------------------------------*/
+static clock_time_t
+time_until(clock_time_t t)
+{
+  if((long)(t - simCurrentTime) <= 0) {
+    return 0;
+  }
+  return t - simCurrentTime;
 }
 /*---------------------------------------------------------------------------*/
 /**
@@ -452,8 +464,7 @@ Java_org_contikios_cooja_corecomm_CLASSNAME_setMemory(JNIEnv *env, jobject obj,
 JNIEXPORT void JNICALL
 Java_org_contikios_cooja_corecomm_CLASSNAME_tick(JNIEnv *env, jobject obj)
 {
-  clock_time_t nextEtimer;
-  rtimer_clock_t nextRtimer;
+  clock_time_t nextEtimer, nextRtimer;
 
   simProcessRunValue = 0;
 
@@ -484,16 +495,17 @@ Java_org_contikios_cooja_corecomm_CLASSNAME_tick(JNIEnv *env, jobject obj)
     return;
   }
 
-  /* Save nearest expiration time */
-  nextEtimer = etimer_next_expiration_time() - (clock_time_t) simCurrentTime;
-  nextRtimer = rtimer_arch_next() - (rtimer_clock_t) simCurrentTime;
-  if(etimer_pending() && rtimer_arch_pending()) {
-    simNextExpirationTime = MIN(nextEtimer, nextRtimer);
-  } else if(etimer_pending()) {
-    simNextExpirationTime = nextEtimer;
-  } else if(rtimer_arch_pending()) {
-    simNextExpirationTime = nextRtimer;
+  /* Save nearest expiration time, so that Cooja leaves the mote alone
+     until then. Overdue timers expire at the next tick, as a negative
+     time would otherwise wrap around to a far future. */
+  nextEtimer = nextRtimer = (clock_time_t)-1;
+  if(etimer_pending()) {
+    nextEtimer = time_until(etimer_next_expiration_time());
+  }
+  if(rtimer_arch_pending()) {
+    nextRtimer = time_until(rtimer_arch_next());
   }
+  simNextExpirationTime = MIN(nextEtimer, nextRtimer);
 }
 /*---------------------------------------------------------------------------*/
 /**
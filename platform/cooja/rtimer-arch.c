@@ -85,7 +85,9 @@ rtimer_arch_pending(void)
 int
 rtimer_arch_check(void)
 {
-  if (simCurrentTime == next_rtimer) {
+  /* The mote may have been woken after the deadline, run overdue
+     rtimers too rather than never */
+  if(pending_rtimer && (long)(simCurrentTime - next_rtimer) >= 0) {
     /* Execute rtimer */
     pending_rtimer = 0;
     rtimer_run_next();
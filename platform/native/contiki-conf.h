@@ -261,6 +261,11 @@ typedef unsigned long clock_time_t;
 #define WWW_CONF_WEBPAGE_HEIGHT 17
 #endif /* PLATFORM_BUILD */
 
+/* Gateways checksum whole SLIP and serial frames, trade RAM for speed */
+#ifndef CRC16_CONF_METHOD
+#define CRC16_CONF_METHOD CRC16_METHOD_SLICE8
+#endif /* CRC16_CONF_METHOD */
+
 /* Not part of C99 but actually present */
 int strcasecmp(const char*, const char*);
 
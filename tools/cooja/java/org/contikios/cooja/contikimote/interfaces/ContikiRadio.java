@@ -195,6 +195,10 @@ public class ContikiRadio extends Radio implements ContikiMoteInterface, PolledA
   }
 
   public void signalReceptionEnd() {
+    /* Motes that never saw the reception start, e.g. with the radio off,
+     * have nothing to react to: don't wake them up */
+    boolean wake = isReceiving();
+
     if (isInterfered || packetToMote == null) {
       isInterfered = false;
       packetToMote = null;
@@ -202,10 +206,13 @@ public class ContikiRadio extends Radio implements ContikiMoteInterface, PolledA
     } else {
       myMoteMemory.setIntValueOf("simInSize", packetToMote.getPacketData().length - 2);
       myMoteMemory.setByteArray("simInDataBuffer", packetToMote.getPacketData());
+      wake = true;
     }
 
     myMoteMemory.setByteValueOf("simReceiving", (byte) 0);
-    mote.requestImmediateWakeup();
+    if (wake) {
+      mote.requestImmediateWakeup();
+    }
     lastEventTime = mote.getSimulation().getSimulationTime();
     lastEvent = RadioEvent.RECEPTION_FINISHED;
     this.setChanged();